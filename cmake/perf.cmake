@@ -0,0 +1,96 @@
+# Options for builds that are meant to be fast rather than debugged:
+#
+#   NES_NATIVE   -march=native, so the binary may not run on other machines
+#   NES_LTO      link time optimisation
+#   NES_PGO      profile guided optimisation, in two stages in the same
+#                build folder:
+#                  1. configure with -DNES_PGO=GENERATE, build, then build
+#                     the pgo_train target, which runs nes-cli over
+#                     NES_PGO_ROMS to collect profile data in NES_PGO_DIR
+#                  2. reconfigure with -DNES_PGO=USE and build again
+#
+# tools/perf_report.sh does all of this and compares the results.
+
+include(CheckCCompilerFlag)
+
+option(NES_NATIVE "Build for this machine's cpu with -march=native" OFF)
+option(NES_LTO "Build with link time optimisation" OFF)
+set(NES_PGO OFF CACHE STRING "Profile guided optimisation: OFF, GENERATE or USE")
+set_property(CACHE NES_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(NES_PGO_DIR ${CMAKE_BINARY_DIR}/pgo CACHE PATH
+    "Where profile data is written by GENERATE and read by USE")
+set(NES_PGO_ROMS ${PROJECT_SOURCE_DIR}/tests/nestest.nes CACHE STRING
+    "Roms run by pgo_train, separated by ;")
+set(NES_PGO_FRAMES 600 CACHE STRING "Frames each pgo_train run goes for")
+
+if(NES_NATIVE)
+    check_c_compiler_flag(-march=native HAVE_MARCH_NATIVE)
+    if(NOT HAVE_MARCH_NATIVE)
+        message(FATAL_ERROR "NES_NATIVE: compiler doesn't take -march=native")
+    endif()
+    add_compile_options(-march=native)
+endif()
+
+if(NES_LTO)
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT HAVE_IPO OUTPUT ipo_output)
+    if(NOT HAVE_IPO)
+        message(FATAL_ERROR "NES_LTO: not supported here: ${ipo_output}")
+    endif()
+    set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+endif()
+
+if(CMAKE_C_COMPILER_ID MATCHES "Clang")
+    # clang writes .profraw files that have to be merged before use
+    set(NES_PGO_DATA ${NES_PGO_DIR}/default.profdata)
+else()
+    set(NES_PGO_DATA ${NES_PGO_DIR})
+endif()
+
+if(NES_PGO STREQUAL "GENERATE")
+    add_compile_options(-fprofile-generate=${NES_PGO_DIR})
+    add_link_options(-fprofile-generate=${NES_PGO_DIR})
+elseif(NES_PGO STREQUAL "USE")
+    if(NOT EXISTS ${NES_PGO_DATA})
+        message(FATAL_ERROR "NES_PGO=USE: no profile data at ${NES_PGO_DATA}, "
+                            "build pgo_train with NES_PGO=GENERATE first")
+    endif()
+    add_compile_options(-fprofile-use=${NES_PGO_DATA})
+    if(CMAKE_C_COMPILER_ID STREQUAL "GNU")
+        # training only covers nes-cli, so the tests have no profile, and
+        # code that wasn't run should still be optimised as usual
+        add_compile_options(-fprofile-correction -fprofile-partial-training
+                            -Wno-missing-profile)
+    else()
+        add_compile_options(-Wno-profile-instr-unprofiled)
+    endif()
+elseif(NES_PGO)
+    message(FATAL_ERROR "NES_PGO must be OFF, GENERATE or USE, not ${NES_PGO}")
+endif()
+
+# pgo_train runs every rom in each mode nes-cli has that changes which
+# code is hot. Old profile data is removed first so a rebuild can't mix
+# in counts from a binary that no longer exists.
+if(NES_PGO STREQUAL "GENERATE")
+    set(pgo_modes "" "--idle-skip")
+    set(pgo_commands
+        COMMAND ${CMAKE_COMMAND} -E remove_directory ${NES_PGO_DIR}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${NES_PGO_DIR})
+    foreach(rom IN LISTS NES_PGO_ROMS)
+        foreach(mode IN LISTS pgo_modes)
+            string(REPLACE "," ";" mode "${mode}")
+            list(APPEND pgo_commands
+                COMMAND $<TARGET_FILE:nes-cli> ${mode}
+                        --frames ${NES_PGO_FRAMES} ${rom})
+        endforeach()
+    endforeach()
+    if(CMAKE_C_COMPILER_ID MATCHES "Clang")
+        find_program(LLVM_PROFDATA NAMES llvm-profdata REQUIRED)
+        list(APPEND pgo_commands
+            COMMAND sh -c "${LLVM_PROFDATA} merge -o ${NES_PGO_DATA} ${NES_PGO_DIR}/*.profraw")
+    endif()
+    add_custom_target(pgo_train ${pgo_commands}
+        COMMENT "Collecting profile data in ${NES_PGO_DIR}"
+        VERBATIM)
+    add_dependencies(pgo_train nes-cli)
+endif()
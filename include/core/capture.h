@@ -0,0 +1,107 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdint.h>
+
+/* Records frames (and audio, once there is something to give it) to files
+ * without holding up the emulation. capture_frame and capture_audio copy
+ * into fixed size queues that don't lock, and a thread of the capture's
+ * own does the converting and writing. If the writer falls so far behind
+ * that a queue is full, what doesn't fit is dropped and counted rather
+ * than waited for.
+ *
+ * Video is written as one of:
+ *   CAPTURE_Y4M    YUV4MPEG2, 4:4:4 BT.601, which most video tools read.
+ *                  A dropped frame is written as the frame before it
+ *                  again, so the timing stays right.
+ *   CAPTURE_DELTA  palette indices, each frame stored as only the runs of
+ *                  bytes that changed since the frame before, with its
+ *                  frame number so drops show as gaps. Lossless and
+ *                  small, read back with capture_reader_*.
+ * and audio, if a wav filename is given, as 16 bit mono WAV.
+ *
+ * Frames are CAPTURE_WIDTH x CAPTURE_HEIGHT palette indices, top row
+ * first, as put_pixel gives them, with the PPUMASK emphasis bits shifted
+ * down (bit 0 red, 1 green, 2 blue). */
+
+#define CAPTURE_WIDTH 256
+#define CAPTURE_HEIGHT 240
+#define CAPTURE_FRAME_SIZE (CAPTURE_WIDTH * CAPTURE_HEIGHT)
+/* frames the queue holds by default, about a second */
+#define CAPTURE_DEFAULT_QUEUE 64
+/* samples the audio queue holds */
+#define CAPTURE_AUDIO_QUEUE (1 << 16)
+
+/* 341 * 262 dots a frame at 236.25 / 11 / 4 MHz, about 60.0985 Hz */
+#define CAPTURE_FPS_NUM 29531250
+#define CAPTURE_FPS_DEN 491381
+
+typedef enum capture_format_e { CAPTURE_Y4M, CAPTURE_DELTA } capture_format_e;
+
+typedef struct capture_stats_s {
+  uint64_t frames;          /* given to capture_frame */
+  uint64_t frames_written;  /* not counting repeats for drops */
+  uint64_t frames_dropped;  /* because the queue was full */
+  uint64_t samples;         /* given to capture_audio */
+  uint64_t samples_written;
+  uint64_t samples_dropped;
+  uint64_t bytes_written;   /* to the video file */
+} capture_stats_s;
+
+typedef struct capture_s capture_s;
+
+/* start capturing video to video_filename and, if wav_filename isn't
+ * NULL, audio at sample_rate to wav_filename. queue_frames is how many
+ * frames can be waiting to be written. the files are created straight
+ * away */
+int capture_start(capture_s **capture, const char *video_filename,
+                  capture_format_e format, int queue_frames,
+                  const char *wav_filename, int sample_rate, char *e_context);
+
+/* queue a frame, only ever from one thread. returns 1, or 0 if it was
+ * dropped. never waits */
+int capture_frame(capture_s *capture, const uint8_t *frame, uint8_t emphasis);
+
+/* queue n samples, only ever from one thread. returns how many fit, the
+ * rest are dropped. never waits */
+int capture_audio(capture_s *capture, const int16_t *samples, int n);
+
+/* the counts so far, from any thread */
+void capture_get_stats(const capture_s *capture, capture_stats_s *stats);
+
+/* write everything still queued, close the files and free capture, after
+ * the last capture_frame/capture_audio has returned. stats can be NULL.
+ * returns -E_WRITE_FILE if anything couldn't be written */
+int capture_stop(capture_s *capture, capture_stats_s *stats,
+                 char *e_context);
+
+typedef struct capture_reader_s capture_reader_s;
+
+/* read back a CAPTURE_DELTA file */
+int capture_reader_open(capture_reader_s **reader, const char *filename,
+                        char *e_context);
+
+/* the next frame into frame (CAPTURE_FRAME_SIZE bytes) and its number and
+ * emphasis. returns 1, 0 at the end of the file, or -E_CAPTURE_FORMAT */
+int capture_reader_next(capture_reader_s *reader, uint8_t *frame,
+                        uint32_t *number, uint8_t *emphasis);
+
+void capture_reader_close(capture_reader_s *reader);
+
+#endif
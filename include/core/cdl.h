@@ -0,0 +1,75 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CDL_H_
+#define CDL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Code/data logger: a byte of flags for every byte of prg and chr rom,
+ * saying how the game has used it, in the .cdl layout FCEUX and most
+ * other tools read. That is the prg rom flags followed by the chr rom
+ * flags, with no header.
+ *
+ * Flags are or-ed in by the cpu for the bytes of each instruction it runs
+ * (code) and for what instructions read (data), and by the ppu for the
+ * pattern bytes it draws with and the chr bytes read through PPUDATA.
+ * While the logger is off that is one predicted branch per instruction,
+ * data read and pattern fetch. While it is on, a few or-s into arrays
+ * that are a few KB for most games.
+ *
+ * Loading a rom (memory_init) stops the logger and throws the log away.
+ * cdl_start, cdl_get, cdl_read and cdl_write should be called while the
+ * emulator isn't running, and with the ppu pipeline stopped or synced
+ * (ppu_pipeline_sync) since the render thread logs pattern fetches.
+ */
+
+/* prg rom flags */
+#define CDL_CODE 0x01
+#define CDL_DATA 0x02
+/* the 8KB window of 0x8000-0xFFFF the byte was last used through, 0-3 */
+#define CDL_PRG_WINDOW 0x0C
+#define CDL_PRG_WINDOW_SHIFT 2
+/* the target of a JMP ($nnnn) */
+#define CDL_INDIRECT_CODE 0x10
+/* read through ($nn,X) or ($nn),Y */
+#define CDL_INDIRECT_DATA 0x20
+
+/* chr rom flags */
+#define CDL_RENDERED 0x01
+#define CDL_CHR_READ 0x02
+
+/* start logging into an empty log sized for the rom loaded. Returns
+ * -E_CDL_ROM if there isn't one */
+int cdl_start(void);
+/* stop logging, keeping the log */
+void cdl_stop(void);
+int cdl_is_on(void);
+
+/* prg rom size plus chr rom size, 0 before cdl_start */
+size_t cdl_size(void);
+/* copy the log into buf in .cdl layout. Returns -E_BUF_SIZE if buf_len is
+ * less than cdl_size() */
+int cdl_get(uint8_t *buf, size_t buf_len);
+
+/* or a .cdl file from an earlier run into the log, e.g. to carry on a
+ * long playthrough or for cpu_decode_warmup(). Returns -E_OPEN_FILE or
+ * -E_READ_FILE, or -E_CDL_ROM if it isn't the same size as the log */
+int cdl_read(const char *filename, char *e_context);
+int cdl_write(const char *filename, char *e_context);
+
+#endif
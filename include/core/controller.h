@@ -14,7 +14,62 @@ enum {
   CTRLR_BUTTON_RIGHT = 1 << 7
 };
 
-/* registers callback which returns buttons currently being pressed */
+/* zapper input */
+enum {
+  CTRLR_ZAPPER_TRIGGER = 1 << 0, /* trigger pulled */
+  CTRLR_ZAPPER_LIGHT = 1 << 1    /* pointing at something bright */
+};
+
+/* what is plugged into a port. port 0 is read at $4016 and port 1 at
+ * $4017, and a write to $4016 strobes both.
+ *
+ * Each device gets its input from the get_input callback given to
+ * controller_set_device() once per strobe, and reads shift out that
+ * snapshot, except the zapper, which calls it on every read. What index is
+ * and what get_input should return depend on the device:
+ *
+ * CTRLR_DEVICE_PAD: index 0, the CTRLR_BUTTON_* pressed.
+ * CTRLR_DEVICE_FOUR_SCORE: takes up both ports. index 0 to 3, the
+ *   CTRLR_BUTTON_* pressed on pads 1 to 4.
+ * CTRLR_DEVICE_ZAPPER: index 0, CTRLR_ZAPPER_* bits. Light is what the
+ *   host sees at the time of the read, since the core doesn't keep the
+ *   frame.
+ * CTRLR_DEVICE_PADDLE: Arkanoid controller. index 0, the knob position,
+ *   index 1, nonzero if the button is pressed.
+ */
+typedef enum controller_device_e {
+  CTRLR_DEVICE_NONE,
+  CTRLR_DEVICE_PAD,
+  CTRLR_DEVICE_FOUR_SCORE,
+  CTRLR_DEVICE_ZAPPER,
+  CTRLR_DEVICE_PADDLE
+} controller_device_e;
+
+#define CTRLR_N_PORTS 2
+
+/* everything needed to carry on reading the controllers, for save states */
+typedef struct controller_state_s {
+  uint8_t strobe;                   /* 1 while $4016 bit 0 is held high */
+  uint32_t shift[CTRLR_N_PORTS];    /* bits still to be read, next in bit 0 */
+  uint8_t held[CTRLR_N_PORTS];      /* bits read on every read of the port */
+  uint8_t device[CTRLR_N_PORTS];    /* controller_device_e */
+} controller_state_s;
+
+/* registers callback which returns buttons currently being pressed, for a
+ * standard pad on port 0 */
 void controller_init(uint8_t (*get_pressed_buttons)(void *), void *data);
 
+/* plug device into port (0 or 1). setting a four score on either port
+ * sets it on both. */
+void controller_set_device(uint8_t port, controller_device_e device,
+                           uint8_t (*get_input)(uint8_t index, void *data),
+                           void *data);
+
+controller_device_e controller_get_device(uint8_t port);
+
+/* the callbacks aren't part of the state, so the same devices need to be
+ * set before loading */
+void controller_save_state(controller_state_s *state);
+void controller_load_state(const controller_state_s *state);
+
 #endif 
@@ -26,6 +26,15 @@ extern "C" {
 #include "ppu.h"
 #include "cpu.h"
 #include "controller.h"
+#include "movie.h"
+#include "palette.h"
+#include "profile.h"
+#include "ntsc.h"
+#include "scale.h"
+#include "capture.h"
+#include "debug.h"
+#include "disasm.h"
+#include "cdl.h"
 }
 
 extern std::string error_names[];
@@ -48,8 +57,42 @@ void nes_ppu_init(ppu_s **ppu, void (*put_pixel)(int, int, uint8_t, void *),
 void nes_ppu_init_no_alloc(ppu_s *ppu,
                            void (*put_pixel)(int, int, uint8_t, void *),
 			   void *);
+void nes_ppu_pipeline_start(ppu_s *ppu);
+void nes_ntsc_create(ntsc_s **ntsc, int out_per_3, int n_threads);
+void nes_scale_create(scale_s **scale, scale_filter_e filter, int factor,
+                      int n_threads);
+void nes_capture_start(capture_s **capture, const std::string &video_filename,
+                       capture_format_e format, int queue_frames,
+                       const char *wav_filename, int sample_rate);
+void nes_capture_stop(capture_s *capture, capture_stats_s *stats);
+void nes_capture_reader_open(capture_reader_s **reader,
+                             const std::string &filename);
 void nes_cpu_init(cpu_s **cpu, int nestest);
 void nes_cpu_init_no_alloc(cpu_s *cpu, int nestest);
-void nes_cpu_exec(cpu_s *cpu);
+/* returns CPU_BREAKPOINT if a breakpoint was hit, 0 otherwise */
+int nes_cpu_exec(cpu_s *cpu);
+
+/* execute instructions until ppu has finished another n_frames frames, or
+ * a breakpoint is hit, when it returns CPU_BREAKPOINT */
+int nes_run_frames(cpu_s *cpu, const ppu_s *ppu, uint32_t n_frames);
+
+/* returns the id of the breakpoint */
+int nes_debug_add(const debug_breakpoint_s &breakpoint);
+debug_breakpoint_s nes_debug_parse(const std::string &text);
+
+void nes_disasm_create(disasm_s **disasm);
+/* returns true if the listing changed */
+bool nes_disasm_update(disasm_s *disasm, const uint8_t *mem,
+                       const uint16_t *banks, uint16_t pc);
+
+void nes_cdl_start(void);
+/* returns false if there is no file to read, e.g. on the first run */
+bool nes_cdl_read(const std::string &filename);
+void nes_cdl_write(const std::string &filename);
+
+void nes_movie_record_start(const std::string &rom_filename);
+void nes_movie_record_stop(const std::string &filename);
+void nes_movie_play_start(const std::string &filename,
+                          const std::string &rom_filename);
 
 #endif
@@ -64,12 +64,51 @@ int cpu_init(cpu_s **, uint8_t nestest);
 /* free memory allocated from cpu_init */
 void cpu_destroy(cpu_s *);
 
+/* returned by cpu_exec when a breakpoint is hit, see core/debug.h */
+#define CPU_BREAKPOINT 1
+
 /* execute one instruction
  *
- * Return value < 0 if error
+ * Return value < 0 if error, CPU_BREAKPOINT if a breakpoint was hit,
+ * 0 otherwise
  */
 int cpu_exec(cpu_s *);
 
+/* Instructions in prg rom are decoded the first time they are run and the
+ * opcode and operand bytes kept, so running them again only steps the ppu
+ * for the fetches of them instead of going through the memory map. The
+ * fetch callback and read breakpoints still see every fetch.
+ *
+ * cpu_decode_warmup decodes the code in the code/data log (see cdl.h) now
+ * instead, e.g. before a replay or a run with a log from an earlier one.
+ * Only for the prg rom banks mapped at the time. Returns the number of
+ * instructions decoded, 0 if there is no log.
+ */
+int cpu_decode_warmup(void);
+
+/* skip idle loops, default off
+ *
+ * When on, short loops that make no writes and leave the registers as they
+ * found them (e.g. JMP *, or polling a ram flag or PPUSTATUS until nmi) are
+ * detected after one pass. After that the instructions in the loop that
+ * only touch rom and ram are not executed, the ppu is just stepped for the
+ * cycles they would have taken, until an nmi is pending or a frame ends.
+ * Instructions that read ppu or other registers are still executed. cpu
+ * and ppu state are the same as without skipping, but the fetch callback
+ * isn't called for the skipped instructions, and the cpu state callback is
+ * only called once for each run of them, with the state before the first.
+ */
+void cpu_set_idle_skip(uint8_t on);
+
+/* number of cpu cycles skipped in idle loops since cpu was initialised */
+uint64_t cpu_get_idle_cycles(void);
+
+/* number of instructions skipped in idle loops since cpu was initialised
+ * that the cpu state callback wasn't called for. added to the number of
+ * callbacks it gives the number of instructions there would have been
+ * without skipping */
+uint64_t cpu_get_idle_instructions(void);
+
 /* Resets cpu and sets cpu values to values in cpu_state
  *
  * Used for each harte test case
@@ -86,6 +125,7 @@ typedef struct cpu_s {
   uint16_t pc; // Programme counter
   uint8_t sp;  // Stack pointer
   uint8_t flags;
+  uint16_t nz; /* N and Z come from this if built with NES_LAZY_FLAGS */
   uint16_t to_update_flags; /* 0: No, 1: Yes, 2: After next instruction */
   uint8_t new_int_disable_flag;
   uint8_t to_oamdma;
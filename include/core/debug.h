@@ -0,0 +1,112 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DEBUG_H_
+#define DEBUG_H_
+
+#include "core/cpu.h"
+#include <stdint.h>
+
+/* Breakpoints on executing, reading or writing cpu addresses.
+ *
+ * Each kind of access has a bitmap with a bit for every address, so the
+ * check in cpu_exec, memory_fetch and memory_write is one bit test, and
+ * while no breakpoints are set at all it is one branch that is never
+ * taken. Addresses are cpu bus addresses as the instruction gave them,
+ * before mirroring, so a breakpoint on 0x0300 isn't hit by an access to
+ * 0x0B00.
+ *
+ * An execute breakpoint is hit before the instruction at its address runs:
+ * cpu_exec returns CPU_BREAKPOINT without doing anything, and calling it
+ * again runs the instruction. Read and write breakpoints are hit during an
+ * instruction, which finishes, then cpu_exec returns CPU_BREAKPOINT. Idle
+ * loops aren't skipped while any breakpoint is set.
+ *
+ * A breakpoint can have a condition on a register, as it was at the start
+ * of the instruction, or for reads and writes on the value read or
+ * written.
+ */
+
+#define DEBUG_MAX_BREAKPOINTS 64
+
+typedef enum debug_access_e {
+  DEBUG_EXEC,
+  DEBUG_READ,
+  DEBUG_WRITE,
+  DEBUG_N_ACCESS
+} debug_access_e;
+
+typedef enum debug_reg_e {
+  DEBUG_REG_NONE, /* no condition */
+  DEBUG_REG_A,
+  DEBUG_REG_X,
+  DEBUG_REG_Y,
+  DEBUG_REG_SP,
+  DEBUG_REG_P,
+  DEBUG_REG_VALUE /* value read or written, not for DEBUG_EXEC */
+} debug_reg_e;
+
+typedef enum debug_cmp_e {
+  DEBUG_CMP_EQ,
+  DEBUG_CMP_NE,
+  DEBUG_CMP_LT,
+  DEBUG_CMP_GE,
+  DEBUG_CMP_AND /* any of the bits in val set */
+} debug_cmp_e;
+
+typedef struct debug_breakpoint_s {
+  debug_access_e access;
+  uint16_t first; /* addresses first to last inclusive */
+  uint16_t last;
+  debug_reg_e reg;
+  debug_cmp_e cmp;
+  uint8_t val;
+} debug_breakpoint_s;
+
+typedef struct debug_hit_s {
+  int id;
+  debug_access_e access;
+  uint16_t addr;
+  uint8_t val;       /* value read or written, 0 for DEBUG_EXEC */
+  cpu_state_s regs;  /* at the start of the instruction */
+} debug_hit_s;
+
+/* add breakpoint, returning its id (>= 0), -E_DEBUG_FULL if there are
+ * DEBUG_MAX_BREAKPOINTS already, or -E_DEBUG_BREAKPOINT if it doesn't make
+ * sense, e.g. first > last */
+int debug_add(const debug_breakpoint_s *breakpoint);
+
+/* return -E_DEBUG_BREAKPOINT if there is no breakpoint id */
+int debug_remove(int id);
+
+void debug_clear(void);
+
+/* parse a breakpoint from text like
+ *   x c004               execute at c004
+ *   w 0300-03ff          write anywhere in 0300 to 03ff
+ *   r $2002 if val & 80  read 2002 giving a value with bit 7 set
+ *   x e000 if a == 5
+ * numbers are hex, optionally starting with $. registers are a, x, y, sp,
+ * p, and val for the value read or written, compared with ==, !=, <, >=
+ * or &. returns -E_DEBUG_BREAKPOINT if it can't be parsed */
+int debug_parse(const char *text, debug_breakpoint_s *breakpoint);
+
+/* copy the last breakpoint hit into hit, returning 0 if none has been hit
+ * since the last debug_clear() */
+int debug_get_hit(debug_hit_s *hit);
+
+#endif
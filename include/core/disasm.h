@@ -0,0 +1,90 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISASM_H_
+#define DISASM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 6502 disassembler, decoding with the same opcode table as the cpu.
+ *
+ * A disasm_s keeps a listing of the parts of the address space code can
+ * run from, one segment each: cpu ram, prg ram and the two 16KB halves of
+ * prg rom. It works on a copy of the address space (a MEMORY_REGION_CODE
+ * snapshot) rather than reading memory itself, so it can be used from any
+ * thread. disasm_update only decodes what changed since the last update:
+ * each prg rom segment keeps the listings of the last DISASM_CACHED_BANKS
+ * banks mapped there, so switching back to a bank costs nothing, and when
+ * bytes change (code written to ram) only the instructions from the first
+ * changed byte until decoding gets back in step with the old listing are
+ * decoded again.
+ *
+ * Lines hold the bytes of an instruction and are formatted as text with
+ * disasm_format only when they are wanted, e.g. for the rows of a view
+ * that are on screen.
+ *
+ * Decoding is a linear sweep from the start of each segment, which goes
+ * wrong where data is mixed in with code. Every pc passed to disasm_update
+ * is remembered as the start of an instruction, and bytes before it that
+ * would be decoded as an instruction running over it are listed as data
+ * instead, so the listing around code that has been run is right.
+ */
+
+#define DISASM_N_SEGMENTS 4
+#define DISASM_CACHED_BANKS 8
+/* longest disasm_format text, including the terminating 0 */
+#define DISASM_TEXT_LEN 16
+
+typedef struct disasm_line_s {
+  uint16_t addr;
+  uint8_t len; /* 1 to 3 */
+  uint8_t bytes[3];
+} disasm_line_s;
+
+typedef struct disasm_s disasm_s;
+
+int disasm_create(disasm_s **disasm);
+void disasm_destroy(disasm_s *disasm);
+
+/* decode the instruction at addr in mem, the 64KB cpu address space.
+ * Opcodes the cpu doesn't implement are one byte of data. Returns the
+ * length */
+int disasm_decode(const uint8_t *mem, uint16_t addr, disasm_line_s *line);
+
+/* e.g. "LDA ($20),Y", "BNE $c72a" with the branch target worked out,
+ * "*NOP $10" for illegal opcodes, ".db $02" for data. text_len should be
+ * at least DISASM_TEXT_LEN */
+void disasm_format(const disasm_line_s *line, char *text, size_t text_len);
+
+/* the prg rom bank mapped in each segment, 0 for the ram segments. call it
+ * from the thread running the emulator, when taking the snapshot */
+void disasm_get_banks(uint16_t *banks);
+
+/* bring the listing up to date with mem, the 64KB address space as a
+ * MEMORY_REGION_CODE snapshot, banks from disasm_get_banks and the pc
+ * when they were taken. Returns 1 if the listing changed, 0 if not, or
+ * -E_MALLOC */
+int disasm_update(disasm_s *disasm, const uint8_t *mem, const uint16_t *banks,
+                  uint16_t pc);
+
+/* lines of all the segments, in address order */
+size_t disasm_n_lines(const disasm_s *disasm);
+const disasm_line_s *disasm_get_line(const disasm_s *disasm, size_t i);
+/* index of the line addr is part of, or -1 if it isn't in a segment */
+long disasm_find_line(const disasm_s *disasm, uint16_t addr);
+
+#endif
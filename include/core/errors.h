@@ -30,7 +30,16 @@
       X(E_MAPPER_IMPLEMENTED, "Mapper number not implemented: "),              \
       X(E_CHR_ROM_SIZE, "CHR ROM size incompatible with mapper number: "),     \
       X(E_PRG_ROM_SIZE, "PRG ROM size incompatible with mapper number: "),     \
-      X(E_OPEN_FILE, "Unable to open file")
+      X(E_OPEN_FILE, "Unable to open file"),                                   \
+      X(E_MOVIE_FORMAT, "Not a movie file or unsupported version: "),          \
+      X(E_MOVIE_ROM, "Movie was recorded with a different rom: "),             \
+      X(E_MOVIE_DEVICES, "Movie was recorded with different controllers: "),   \
+      X(E_THREAD, "Unable to start thread"),                                   \
+      X(E_SCALE_FACTOR, "Scale factor not supported by filter"),               \
+      X(E_CAPTURE_FORMAT, "Not a capture file or unsupported version: "),      \
+      X(E_DEBUG_FULL, "Too many breakpoints"),                                 \
+      X(E_DEBUG_BREAKPOINT, "Invalid breakpoint: "),                           \
+      X(E_CDL_ROM, "Code/data log doesn't match the rom: ")
 
 #define X(error, message) error
 
@@ -46,21 +46,43 @@ int memory_init(const char *rom_filename, ppu_s *p, char *e_context);
 /* hexdump cpu memory contents to file */
 int memory_dump_file(FILE *fp);
 
-/* hexdump memory contents to string
- *
- * return <0 if error, 0 otherwise 
+/* what memory_snapshot copies, and its size in bytes:
+ *   CPU:     the whole 64KB cpu address space as stored, so ppu and apu
+ *            registers are the last values written rather than what a read
+ *            would give
+ *   VRAM:    the 16KB ppu address space before mirroring
+ *   OAM:     256 bytes of sprite attributes
+ *   PALETTE: the 32 palette entries at 0x3F00
+ *   CODE:    the 64KB cpu address space as an instruction fetch would see
+ *            it, with ram and prg rom mirrored and 0 for ppu and apu
+ *            registers, for the disassembler
  */
-int memory_dump_string(char *dump, size_t dump_len);
+typedef enum memory_region_e {
+  MEMORY_REGION_CPU,
+  MEMORY_REGION_VRAM,
+  MEMORY_REGION_OAM,
+  MEMORY_REGION_PALETTE,
+  MEMORY_REGION_CODE,
+  MEMORY_REGION_COUNT
+} memory_region_e;
+
+size_t memory_region_size(memory_region_e region);
 
-/* hexdump vram contents to string
+/* copy region into buf without side effects, for looking at memory from
+ * outside the emulator. call it from the thread running the emulator.
  *
- * return <0 if error, 0 otherwise
+ * return -E_BUF_SIZE if buf_len is less than memory_region_size(region),
+ * 0 otherwise
  */
-int memory_vram_dump_string(char *dump, size_t dump_len);
+int memory_snapshot(memory_region_e region, uint8_t *buf, size_t buf_len);
 
 /* Initialises memory to addrs and vals */
 void memory_init_harte_test_case(const uint16_t *addrs, const uint8_t *vals, size_t length);
 
+/* sets addrs to vals without clearing the rest of memory, so that a case
+ * can be set up by undoing only the addresses the previous case touched */
+void memory_set_harte_test_case(const uint16_t *addrs, const uint8_t *vals, size_t length);
+
 /* sets list of addresses to 0 and sets vals to the values at the addresses*/
 void memory_reset_harte(const uint16_t *addrs, uint8_t *final_vals, size_t length);
 
@@ -0,0 +1,63 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOVIE_H_
+#define MOVIE_H_
+
+#include <stdint.h>
+
+/* Movies record the input latched by the controllers on every strobe (and
+ * the zapper's on every read), so that a run can be repeated exactly
+ * without whatever supplied the input. Games normally strobe once a
+ * frame, so with one pad this is usually one byte per frame.
+ *
+ * The file has a header with a hash of the rom file, the devices plugged
+ * into each port and the power on state (cpu ram, which isn't cleared
+ * between runs in the same process), then the input of every strobe. It
+ * is read into memory in one go when playback starts, so playing it back
+ * doesn't touch the file system.
+ *
+ * Start recording or playback after memory_init() and setting the
+ * controllers, and before the first cpu_exec(). While playing, the
+ * controllers' callbacks aren't called, and once the movie runs out no
+ * buttons are pressed.
+ */
+
+/* start recording, rom_filename being the rom that was just loaded */
+int movie_record_start(const char *rom_filename, char *e_context);
+
+/* stop recording and write the movie to filename. the recording is
+ * discarded either way. Returns -E_MALLOC without writing anything if
+ * memory ran out for a strobe while recording */
+int movie_record_stop(const char *filename, char *e_context);
+
+/* load the movie in filename and start playing it back. restores the cpu
+ * ram recorded in it. returns -E_MOVIE_ROM if it wasn't recorded with the
+ * rom in rom_filename, or -E_MOVIE_DEVICES if it was recorded with
+ * different controllers */
+int movie_play_start(const char *filename, const char *rom_filename,
+                     char *e_context);
+
+/* stop playing back and free the movie */
+void movie_play_stop(void);
+
+/* nonzero if playing back and every strobe in the movie has been used */
+int movie_play_finished(void);
+
+/* number of strobes recorded so far, or in the movie being played */
+uint32_t movie_length(void);
+
+#endif
@@ -0,0 +1,67 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef NTSC_H_
+#define NTSC_H_
+
+#include <stdint.h>
+
+/* NTSC composite video filter: turns the palette indices put_pixel gives
+ * into the picture a TV would show, with the colour fringes and dot crawl
+ * that come from the colour being sent on a subcarrier with the
+ * brightness.
+ *
+ * Each pixel is 8 samples of the signal the PPU puts out, a square wave
+ * whose phase is the hue, and 3 pixels are exactly 2 periods of the
+ * subcarrier. The signal is decoded into YIQ and then RGB at out_per_3
+ * evenly spaced points for every 3 pixels. All of that is linear, so
+ * ntsc_create works out what each colour contributes to each output pixel
+ * near it once, for each position it can have relative to the subcarrier,
+ * and filtering a frame is adding those up.
+ *
+ * Input rows are NTSC_IN_WIDTH palette indices, as given to put_pixel.
+ * Output pixels are R, G, B, A bytes in that order in memory, A is 255. */
+
+#define NTSC_IN_WIDTH 256
+/* gives NTSC_DEFAULT_OUT_WIDTH pixels across */
+#define NTSC_DEFAULT_OUT_PER_3 7
+#define NTSC_DEFAULT_OUT_WIDTH 602
+#define NTSC_MAX_THREADS 16
+
+typedef struct ntsc_s ntsc_s;
+
+/* out_per_3 from 3 to 12 is the output pixels for each 3 input pixels,
+ * n_threads from 1 to NTSC_MAX_THREADS is how many threads (including the
+ * caller's) ntsc_filter splits the rows between. each ntsc_s has its own
+ * threads, so more than one can be used at once. */
+int ntsc_create(ntsc_s **ntsc, int out_per_3, int n_threads);
+void ntsc_destroy(ntsc_s *ntsc);
+
+/* width of each output row */
+int ntsc_out_width(const ntsc_s *ntsc);
+
+/* filter height rows of in into out, strides in pixels.
+ *
+ * emphasis is the PPUMASK colour emphasis bits shifted down (bit 0 red, 1
+ * green, 2 blue). burst_phase is the phase of the subcarrier at the start
+ * of the first row in units of a third of a period, see
+ * ppu_get_burst_phase. Each row starts a third of a period on from the
+ * last. */
+void ntsc_filter(ntsc_s *ntsc, const uint8_t *in, int in_stride, int height,
+                 uint8_t emphasis, uint8_t burst_phase, uint32_t *out,
+                 int out_stride);
+
+#endif
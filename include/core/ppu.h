@@ -72,6 +72,45 @@ int ppu_init(ppu_s **ppu,
 /* deallocate memory allocated to ppu with ppu_init */
 void ppu_destroy(ppu_s *ppu);
 
+/* Only draw every nth frame, n = 0 or 1 draws every frame.
+ *
+ * On a skipped frame the ppu still does all of its background fetches
+ * and PPUSTATUS/NMI timing, it just doesn't do palette lookups or call
+ * put_pixel, so the cpu can't tell the difference.
+ */
+void ppu_set_frame_skip(ppu_s *ppu, uint8_t n);
+
+/* number of frames completed since the ppu was initialised */
+uint32_t ppu_get_frame_count(const ppu_s *ppu);
+
+/* phase of the colour subcarrier at the start of the current frame, in
+ * thirds of a period, for ntsc_filter */
+uint8_t ppu_get_burst_phase(const ppu_s *ppu);
+
+/* Pipelined rendering: draw frame N on a second thread while the cpu runs
+ * frame N+1.
+ *
+ * While the pipeline is running, the ppu the cpu steps only keeps the
+ * timing the cpu can see: vblank, nmi, and the scroll registers for
+ * PPUDATA. It logs each register change and vram write with the dot it
+ * happened on. The render thread replays that log on its own copy of the
+ * ppu and vram to draw each frame, so put_pixel is called on the render
+ * thread, up to two frames behind the cpu. The frames drawn are the same
+ * as without the pipeline. The tile fetch fields of ppu_state_s (nt_byte
+ * to ptt_high) aren't updated while it is running.
+ *
+ * Return value < 0 if error
+ */
+int ppu_pipeline_start(ppu_s *ppu);
+
+/* wait until everything the cpu has run so far has been drawn, e.g. before
+ * reading the frame put_pixel drew. does nothing if not running */
+void ppu_pipeline_sync(ppu_s *ppu);
+
+/* sync then stop the render thread, after which the ppu draws as usual.
+ * ppu_destroy stops it too */
+void ppu_pipeline_stop(ppu_s *ppu);
+
 void ppu_draw_pattern_table(uint8_t is_right,
                             void (*put_pixel)(int, int, uint8_t, void *),
 			    void *data);
@@ -129,6 +168,14 @@ typedef struct ppu_s {
   uint8_t to_toggle_rendering; /* counts down each dot, toggles rendering when
                                   reaches 1 */
   uint8_t nmi_occurred;
+  uint32_t frame_count;
+  uint8_t frame_skip;  /* draw every frame_skip'th frame */
+  uint8_t skip_render; /* 1 if current frame is not being drawn */
+
+  /* pipelined rendering, see ppu_pipeline_start. pipeline is set on the
+   * ppu the cpu steps, vram on the copy the render thread steps */
+  struct ppu_pipeline_s *pipeline;
+  uint8_t *vram;
 } ppu_s;
 
 #endif
@@ -0,0 +1,79 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+/* When the core is built with NES_PROFILE, the sections below are timed
+ * with the cpu's time stamp counter (or a monotonic clock in ns where there
+ * isn't one), and on Linux the whole frame also gets hardware counters
+ * from perf_event_open if the kernel allows it.
+ *
+ * Sections nest, e.g. memory_fetch steps the ppu, so each section has its
+ * total time including the sections it calls, and its self time without
+ * them. Without NES_PROFILE none of this is compiled in, and the functions
+ * below report nothing. Only the thread that runs the cpu is counted, so
+ * drawing done by ppu_pipeline_start's render thread isn't.
+ */
+typedef enum profile_section_e {
+  PROFILE_CPU_EXEC,     /* whole instruction, including its bus accesses */
+  PROFILE_MEMORY_FETCH,
+  PROFILE_MEMORY_WRITE,
+  PROFILE_PPU_STEP,
+  PROFILE_RENDER_PIXEL,
+  PROFILE_PUT_PIXEL,    /* the put_pixel callback, the host's conversion */
+  PROFILE_N_SECTIONS
+} profile_section_e;
+
+typedef struct profile_section_s {
+  uint64_t calls;
+  uint64_t ticks;      /* including nested sections */
+  uint64_t self_ticks; /* not including nested sections */
+} profile_section_s;
+
+typedef struct profile_frame_s {
+  uint64_t frames;
+  uint64_t ticks; /* between frame ends, everything including the host */
+  profile_section_s sections[PROFILE_N_SECTIONS];
+
+  /* hardware counters over the same time as ticks, if have_counters */
+  uint8_t have_counters;
+  uint64_t instructions;
+  uint64_t cache_misses;
+  uint64_t branch_misses;
+} profile_frame_s;
+
+/* nonzero if built with NES_PROFILE */
+int profile_enabled(void);
+
+/* "ticks" is time stamp counter cycles or ns, see above */
+const char *profile_tick_unit(void);
+const char *profile_section_name(profile_section_e section);
+
+/* clear the totals and start counting from now */
+void profile_reset(void);
+
+/* sum of every frame since profile_reset() */
+void profile_get_total(profile_frame_s *total);
+
+/* called with the summary of each frame as it ends */
+void profile_register_frame_callback(
+    void (*on_frame)(const profile_frame_s *frame, void *data), void *data);
+void profile_unregister_frame_callback(void);
+
+#endif
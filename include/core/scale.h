@@ -0,0 +1,68 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCALE_H_
+#define SCALE_H_
+
+#include <stdint.h>
+
+/* Pixel art scalers for capturing frames at more than 256x240. They work
+ * on the palette indices put_pixel gives rather than RGB, so deciding
+ * whether two pixels are the same colour is comparing bytes, and how
+ * alike two colours are is looked up in tables made from the palette.
+ *
+ * SCALE_NEAREST repeats each pixel factor times each way, for factor 1 to
+ * SCALE_MAX_FACTOR.
+ * SCALE_SCALEX is Scale2x (AdvMAME2x) and Scale3x, for factor 2 and 3.
+ * SCALE_HQX is factor 2 or 3 in the style of hq2x/hq3x: colours count as
+ * the same if they are within hqx's YUV thresholds, and diagonal edges
+ * are blended rather than stepped.
+ * SCALE_XBR is xBR for factor 2 to 4: where weighing up the colour
+ * differences along both diagonals around a corner says an edge goes
+ * across it, the corner is blended with the colour on the other side.
+ *
+ * Output pixels are R, G, B, A bytes in that order in memory, A is 255, as
+ * for the ntsc filter. */
+
+#define SCALE_IN_WIDTH 256
+#define SCALE_MAX_FACTOR 10
+#define SCALE_MAX_THREADS 16
+
+typedef enum scale_filter_e {
+  SCALE_NEAREST,
+  SCALE_SCALEX,
+  SCALE_HQX,
+  SCALE_XBR
+} scale_filter_e;
+
+typedef struct scale_s scale_s;
+
+/* n_threads from 1 to SCALE_MAX_THREADS is how many threads (including the
+ * caller's) scale_frame splits the rows between, each scale_s has its own.
+ * Returns -E_SCALE_FACTOR if filter doesn't do factor. */
+int scale_create(scale_s **scale, scale_filter_e filter, int factor,
+                 int n_threads);
+void scale_destroy(scale_s *scale);
+
+int scale_factor(const scale_s *scale);
+
+/* scale height rows of SCALE_IN_WIDTH palette indices in into height *
+ * factor rows of SCALE_IN_WIDTH * factor pixels in out, strides in
+ * pixels. Doesn't allocate anything. */
+void scale_frame(scale_s *scale, const uint8_t *in, int in_stride, int height,
+                 uint32_t *out, int out_stride);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef COMMANDQUEUE_H_
+#define COMMANDQUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/* Fixed size queue for one thread pushing and one other thread popping,
+ * without locks. push returns false if full, pop returns false if empty.
+ * N must be a power of 2. */
+template <typename T, size_t N> class command_queue {
+  static_assert((N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+  command_queue() : head(0), tail(0) {}
+
+  bool push(const T &val) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    buf[t & (N - 1)] = val;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &val) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    val = buf[h & (N - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) ==
+           tail.load(std::memory_order_acquire);
+  }
+
+private:
+  std::array<T, N> buf;
+  /* on separate cache lines so the two threads don't fight over them */
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
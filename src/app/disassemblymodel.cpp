@@ -0,0 +1,110 @@
+#include "disassemblymodel.h"
+
+#include <QColor>
+
+#include <cstdio>
+
+static disasm_s *create_disasm(void) {
+  disasm_s *d;
+  nes_disasm_create(&d);
+  return d;
+}
+
+DisassemblyModel::DisassemblyModel(QObject *parent)
+    : QAbstractTableModel(parent), disasm(create_disasm(), &disasm_destroy),
+      pc_row(-1) {}
+
+void DisassemblyModel::setSnapshot(
+    const std::vector<uint8_t> &mem,
+    const std::array<uint16_t, DISASM_N_SEGMENTS> &banks, uint16_t pc) {
+  if (mem.size() != memory_region_size(MEMORY_REGION_CODE)) {
+    return;
+  }
+  int old_pc_row = pc_row;
+  bool changed = nes_disasm_update(disasm.get(), mem.data(), banks.data(), pc);
+  pc_row = disasm_find_line(disasm.get(), pc);
+  if (changed) {
+    /* the listing has already changed, but nothing can look at the model
+     * in between since it's all on the gui thread */
+    beginResetModel();
+    endResetModel();
+    return;
+  }
+  if (pc_row != old_pc_row) {
+    if (old_pc_row >= 0) {
+      emit dataChanged(index(old_pc_row, 0), index(old_pc_row, n_columns - 1));
+    }
+    if (pc_row >= 0) {
+      emit dataChanged(index(pc_row, 0), index(pc_row, n_columns - 1));
+    }
+  }
+}
+
+int DisassemblyModel::rowCount(const QModelIndex &parent) const {
+  if (parent.isValid()) {
+    return 0;
+  }
+  return disasm_n_lines(disasm.get());
+}
+
+int DisassemblyModel::columnCount(const QModelIndex &parent) const {
+  if (parent.isValid()) {
+    return 0;
+  }
+  return n_columns;
+}
+
+QVariant DisassemblyModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid()) {
+    return QVariant();
+  }
+  const disasm_line_s *line = disasm_get_line(disasm.get(), index.row());
+  if (line == nullptr) {
+    return QVariant();
+  }
+
+  switch (role) {
+  case Qt::DisplayRole:
+    switch (index.column()) {
+    case address_column:
+      return QStringLiteral("$%1").arg(line->addr, 4, 16, QLatin1Char('0'));
+    case bytes_column: {
+      char bytes[3 * 3];
+      int n = 0;
+      for (int i = 0; i < line->len; i++) {
+        n += std::snprintf(bytes + n, sizeof(bytes) - n, i ? " %02x" : "%02x",
+                           line->bytes[i]);
+      }
+      return QString::fromLatin1(bytes, n);
+    }
+    case instruction_column: {
+      char text[DISASM_TEXT_LEN];
+      disasm_format(line, text, sizeof(text));
+      return QString::fromLatin1(text);
+    }
+    }
+    break;
+  case Qt::BackgroundRole:
+    if (index.row() == pc_row) {
+      return QColor(255, 240, 160);
+    }
+    break;
+  }
+  return QVariant();
+}
+
+QVariant DisassemblyModel::headerData(int section, Qt::Orientation orientation,
+                                      int role) const {
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+    return QVariant();
+  }
+  switch (section) {
+  case address_column:
+    return QStringLiteral("Address");
+  case bytes_column:
+    return QStringLiteral("Bytes");
+  case instruction_column:
+    return QStringLiteral("Instruction");
+  }
+  return QVariant();
+}
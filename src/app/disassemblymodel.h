@@ -0,0 +1,45 @@
+#ifndef DISASSEMBLYMODEL_H_
+#define DISASSEMBLYMODEL_H_
+
+#include <QAbstractTableModel>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/cppwrapper.hpp"
+
+/* Disassembly of a MEMORY_REGION_CODE snapshot, one instruction a row with
+ * the row the pc is on highlighted. The listing is kept by a disasm_s, so a
+ * new snapshot only costs decoding what changed, and rows are formatted
+ * when the view asks for them. */
+class DisassemblyModel : public QAbstractTableModel {
+
+  Q_OBJECT
+
+public:
+  enum column_e { address_column, bytes_column, instruction_column, n_columns };
+
+  explicit DisassemblyModel(QObject *parent = nullptr);
+
+  /* the model is reset if the listing changed, otherwise only the rows the
+   * pc moved between are updated */
+  void setSnapshot(const std::vector<uint8_t> &mem,
+                   const std::array<uint16_t, DISASM_N_SEGMENTS> &banks,
+                   uint16_t pc);
+  /* row the pc is on, or -1 */
+  int pcRow(void) const { return pc_row; }
+
+  int rowCount(const QModelIndex &parent) const override;
+  int columnCount(const QModelIndex &parent) const override;
+  QVariant data(const QModelIndex &index, int role) const override;
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+private:
+  std::unique_ptr<disasm_s, void (*)(disasm_s *)> disasm;
+  int pc_row;
+};
+
+#endif
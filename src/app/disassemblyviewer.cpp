@@ -0,0 +1,79 @@
+#include "disassemblyviewer.h"
+
+#include <QBoxLayout>
+#include <QFontDatabase>
+#include <QHeaderView>
+#include <QtDebug>
+
+DisassemblyViewer::DisassemblyViewer(NESContext *context, QWidget *parent)
+    : QDialog(parent), context(context), generation(0), banks{}, pc(0) {
+  setAttribute(Qt::WA_DeleteOnClose);
+  setWindowTitle("Disassembly");
+
+  follow_box = new QCheckBox("Follow PC", this);
+  follow_box->setChecked(true);
+
+  model = new DisassemblyModel(this);
+  view = new QTableView(this);
+  view->setModel(model);
+  view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  view->setSelectionBehavior(QAbstractItemView::SelectRows);
+  view->setShowGrid(false);
+  view->verticalHeader()->hide();
+
+  /* fixed sizes, so the view never has to format every row to lay itself
+   * out */
+  QFontMetrics metrics(view->font());
+  view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  view->verticalHeader()->setDefaultSectionSize(metrics.height() + 2);
+  view->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  view->horizontalHeader()->resizeSection(
+      DisassemblyModel::address_column, metrics.horizontalAdvance("$00000"));
+  view->horizontalHeader()->resizeSection(
+      DisassemblyModel::bytes_column, metrics.horizontalAdvance("00 00 000"));
+  view->horizontalHeader()->setStretchLastSection(true);
+
+  QBoxLayout *layout = new QBoxLayout(QBoxLayout::TopToBottom, this);
+  layout->addWidget(follow_box);
+  layout->addWidget(view);
+  resize(400, 600);
+
+  if (this->context != nullptr) {
+    this->context->nes_watch_memory(MEMORY_REGION_CODE, true);
+  }
+  connect(follow_box, &QCheckBox::toggled, this,
+          &DisassemblyViewer::scroll_to_pc);
+
+  timer = new QTimer(this);
+  connect(timer, &QTimer::timeout, this, &DisassemblyViewer::refresh);
+  timer->start(refresh_ms);
+}
+
+DisassemblyViewer::~DisassemblyViewer() {
+  if (context != nullptr) {
+    context->nes_watch_memory(MEMORY_REGION_CODE, false);
+  }
+}
+
+void DisassemblyViewer::refresh(void) {
+  if (context == nullptr ||
+      !context->nes_get_snapshot(MEMORY_REGION_CODE, snapshot, generation, pc,
+                                 banks)) {
+    return;
+  }
+  try {
+    model->setSnapshot(snapshot, banks, pc);
+  } catch (NESError &e) {
+    qWarning() << "DisassemblyViewer:" << e.what();
+    timer->stop();
+    return;
+  }
+  scroll_to_pc();
+}
+
+void DisassemblyViewer::scroll_to_pc(void) {
+  int row = model->pcRow();
+  if (follow_box->isChecked() && row >= 0) {
+    view->scrollTo(model->index(row, 0), QAbstractItemView::PositionAtCenter);
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef DISASSEMBLYVIEWER_H_
+#define DISASSEMBLYVIEWER_H_
+
+#include <QCheckBox>
+#include <QDialog>
+#include <QPointer>
+#include <QTableView>
+#include <QTimer>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "disassemblymodel.h"
+#include "nescontext.h"
+
+/* Window with a disassembly of the code the cpu can run, which follows the
+ * pc while the emulator runs if "Follow PC" is ticked. Works from
+ * MEMORY_REGION_CODE snapshots like MemoryViewer, picked up a few times a
+ * second. Deletes itself when closed. */
+class DisassemblyViewer : public QDialog {
+
+  Q_OBJECT
+
+public:
+  DisassemblyViewer(NESContext *context, QWidget *parent = nullptr);
+  ~DisassemblyViewer();
+
+private slots:
+  void refresh(void);
+  void scroll_to_pc(void);
+
+private:
+  static const int refresh_ms = 100;
+
+  /* the context goes away if the emulator fails */
+  QPointer<NESContext> context;
+  uint64_t generation;
+  std::vector<uint8_t> snapshot;
+  std::array<uint16_t, DISASM_N_SEGMENTS> banks;
+  uint16_t pc;
+
+  QCheckBox *follow_box;
+  QTableView *view;
+  DisassemblyModel *model;
+  QTimer *timer;
+};
+
+#endif
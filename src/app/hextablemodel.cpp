@@ -0,0 +1,152 @@
+#include "hextablemodel.h"
+
+#include <QColor>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/* the two hex digits of every byte, so formatting a byte is a copy */
+struct hex_lut_s {
+  char digits[256][2];
+};
+
+constexpr hex_lut_s make_hex_lut() {
+  const char hex[] = "0123456789abcdef";
+  hex_lut_s lut{};
+  for (int i = 0; i < 256; i++) {
+    lut.digits[i][0] = hex[i >> 4];
+    lut.digits[i][1] = hex[i & 0xF];
+  }
+  return lut;
+}
+
+constexpr hex_lut_s hex_lut = make_hex_lut();
+
+} // namespace
+
+HexTableModel::HexTableModel(QObject *parent)
+    : QAbstractTableModel(parent), base_addr(0) {}
+
+void HexTableModel::setBytes(const std::vector<uint8_t> &new_bytes,
+                             uint16_t new_base_addr) {
+  if (new_bytes.size() != bytes.size() || new_base_addr != base_addr) {
+    beginResetModel();
+    bytes = new_bytes;
+    last_bytes = new_bytes;
+    dirty.assign((bytes.size() + bytes_per_row - 1) / bytes_per_row, 0);
+    base_addr = new_base_addr;
+    endResetModel();
+    return;
+  }
+
+  /* same size, so neither of these allocates */
+  last_bytes.swap(bytes);
+  bytes = new_bytes;
+
+  /* one dataChanged for each run of rows that changed now or were
+   * highlighted before */
+  int rows = dirty.size();
+  int first = -1;
+  for (int row = 0; row < rows; row++) {
+    size_t start = (size_t)row * bytes_per_row;
+    size_t len = std::min((size_t)bytes_per_row, bytes.size() - start);
+    bool changed =
+        std::memcmp(&bytes[start], &last_bytes[start], len) != 0;
+    bool update = changed || dirty[row];
+    dirty[row] = changed;
+    if (update && first < 0) {
+      first = row;
+    } else if (!update && first >= 0) {
+      emit dataChanged(index(first, 0), index(row - 1, text_column));
+      first = -1;
+    }
+  }
+  if (first >= 0) {
+    emit dataChanged(index(first, 0), index(rows - 1, text_column));
+  }
+}
+
+int HexTableModel::rowCount(const QModelIndex &parent) const {
+  if (parent.isValid()) {
+    return 0;
+  }
+  return dirty.size();
+}
+
+int HexTableModel::columnCount(const QModelIndex &parent) const {
+  if (parent.isValid()) {
+    return 0;
+  }
+  return bytes_per_row + 1;
+}
+
+QVariant HexTableModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid()) {
+    return QVariant();
+  }
+  int row = index.row();
+  int column = index.column();
+  if (row < 0 || row >= (int)dirty.size() || column < 0 ||
+      column > text_column) {
+    return QVariant();
+  }
+  size_t i = (size_t)row * bytes_per_row + column;
+
+  switch (role) {
+  case Qt::DisplayRole:
+    return (column == text_column) ? text_cell(row) : hex_cell(row, column);
+  case Qt::BackgroundRole:
+    if (dirty[row]) {
+      return QColor(255, 240, 160);
+    }
+    break;
+  case Qt::ForegroundRole:
+    if (dirty[row] && column != text_column && i < bytes.size() &&
+        bytes[i] != last_bytes[i]) {
+      return QColor(Qt::red);
+    }
+    break;
+  case Qt::TextAlignmentRole:
+    return (column == text_column) ? Qt::AlignLeft : Qt::AlignCenter;
+  }
+  return QVariant();
+}
+
+QVariant HexTableModel::headerData(int section, Qt::Orientation orientation,
+                                   int role) const {
+  if (role != Qt::DisplayRole) {
+    return QVariant();
+  }
+  if (orientation == Qt::Horizontal) {
+    if (section == text_column) {
+      return QStringLiteral("Text");
+    }
+    return QString(QLatin1Char(hex_lut.digits[section & 0xF][1]));
+  }
+  uint16_t addr = base_addr + section * bytes_per_row;
+  char label[5] = {'$'};
+  std::memcpy(label + 1, hex_lut.digits[addr >> 8], 2);
+  std::memcpy(label + 3, hex_lut.digits[addr & 0xFF], 2);
+  return QString::fromLatin1(label, 5);
+}
+
+QString HexTableModel::hex_cell(int row, int column) const {
+  size_t i = (size_t)row * bytes_per_row + column;
+  if (i >= bytes.size()) {
+    return QString();
+  }
+  return QString::fromLatin1(hex_lut.digits[bytes[i]], 2);
+}
+
+QString HexTableModel::text_cell(int row) const {
+  size_t start = (size_t)row * bytes_per_row;
+  size_t len = std::min((size_t)bytes_per_row, bytes.size() - start);
+  char text[bytes_per_row];
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = bytes[start + i];
+    text[i] = (c >= 0x20 && c < 0x7F) ? c : '.';
+  }
+  return QString::fromLatin1(text, len);
+}
@@ -0,0 +1,48 @@
+#ifndef HEXTABLEMODEL_H_
+#define HEXTABLEMODEL_H_
+
+#include <QAbstractTableModel>
+
+#include <cstdint>
+#include <vector>
+
+/* Hexdump of a snapshot of memory, 16 bytes to a row with the bytes as text
+ * in the last column. Nothing is formatted until the view asks for a cell,
+ * so only the rows on screen cost anything however big the snapshot is.
+ *
+ * Rows that changed in the last setBytes are highlighted, and the bytes in
+ * them that changed are coloured, until a setBytes where they don't
+ * change. */
+class HexTableModel : public QAbstractTableModel {
+
+  Q_OBJECT
+
+public:
+  static const int bytes_per_row = 16;
+  static const int text_column = bytes_per_row;
+
+  explicit HexTableModel(QObject *parent = nullptr);
+
+  /* rows are labelled from base_addr. a snapshot of a different size, or
+   * with a different base_addr, resets the model without highlighting
+   * anything */
+  void setBytes(const std::vector<uint8_t> &new_bytes, uint16_t base_addr);
+
+  int rowCount(const QModelIndex &parent) const override;
+  int columnCount(const QModelIndex &parent) const override;
+  QVariant data(const QModelIndex &index, int role) const override;
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+private:
+  QString hex_cell(int row, int column) const;
+  QString text_cell(int row) const;
+
+  std::vector<uint8_t> bytes;
+  std::vector<uint8_t> last_bytes;
+  /* one per row, nonzero if the row changed in the last setBytes */
+  std::vector<uint8_t> dirty;
+  uint16_t base_addr;
+};
+
+#endif
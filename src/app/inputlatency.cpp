@@ -0,0 +1,148 @@
+#include "inputlatency.h"
+
+#include <chrono>
+#include <cstdio>
+
+uint64_t input_latency_now(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+             .count() |
+         1;
+}
+
+/*============================================================*/
+
+latency_histogram::latency_histogram()
+    : count(0), total_ns(0), min_ns(UINT64_MAX), max_ns(0) {
+  for (auto &b : buckets) {
+    b.store(0, std::memory_order_relaxed);
+  }
+}
+
+void latency_histogram::record(uint64_t ns) {
+  uint64_t us = ns / 1000;
+  int i = 0;
+  while (us > 1 && i < n_buckets - 1) {
+    us >>= 1;
+    i++;
+  }
+  /* only one thread writes, so these don't need to be read-modify-write */
+  buckets[i].store(buckets[i].load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+  total_ns.store(total_ns.load(std::memory_order_relaxed) + ns,
+                 std::memory_order_relaxed);
+  if (ns < min_ns.load(std::memory_order_relaxed)) {
+    min_ns.store(ns, std::memory_order_relaxed);
+  }
+  if (ns > max_ns.load(std::memory_order_relaxed)) {
+    max_ns.store(ns, std::memory_order_relaxed);
+  }
+}
+
+/* us as e.g. 512us, 4ms or 1s */
+static std::string format_us(uint64_t us) {
+  char buf[32];
+  if (us < 1000) {
+    std::snprintf(buf, sizeof(buf), "%luus", (unsigned long)us);
+  } else if (us < 1000000) {
+    std::snprintf(buf, sizeof(buf), "%.3gms", us / 1e3);
+  } else {
+    std::snprintf(buf, sizeof(buf), "%.3gs", us / 1e6);
+  }
+  return buf;
+}
+
+std::string latency_histogram::report(const std::string &title) const {
+  const int bar_width = 50;
+  char line[160];
+  std::string s = title + "\n";
+
+  uint64_t n = count.load(std::memory_order_relaxed);
+  if (n == 0) {
+    return s + "  nothing yet\n";
+  }
+  std::snprintf(line, sizeof(line),
+                "  %lu samples, min %.3f ms, mean %.3f ms, max %.3f ms\n",
+                (unsigned long)n, min_ns.load(std::memory_order_relaxed) / 1e6,
+                total_ns.load(std::memory_order_relaxed) / 1e6 / n,
+                max_ns.load(std::memory_order_relaxed) / 1e6);
+  s += line;
+
+  uint32_t counts[n_buckets];
+  int first = -1, last = 0;
+  uint32_t most = 0;
+  for (int i = 0; i < n_buckets; i++) {
+    counts[i] = buckets[i].load(std::memory_order_relaxed);
+    if (counts[i]) {
+      first = (first < 0) ? i : first;
+      last = i;
+      most = (counts[i] > most) ? counts[i] : most;
+    }
+  }
+  for (int i = first; i <= last; i++) {
+    std::string range =
+        (i == 0) ? "< " + format_us(2)
+        : (i == n_buckets - 1)
+            ? ">= " + format_us(1ul << i)
+            : format_us(1ul << i) + " - " + format_us(1ul << (i + 1));
+    int len = (int)((uint64_t)counts[i] * bar_width / most);
+    std::snprintf(line, sizeof(line), "  %17s %8u %s\n", range.c_str(),
+                  counts[i], std::string(len, '#').c_str());
+    s += line;
+  }
+  return s;
+}
+
+/*============================================================*/
+
+InputLatency::InputLatency()
+    : last_latched(0), waiting_for_frame(0), in_frame(0), drawn(0),
+      painted(0) {}
+
+void InputLatency::latched(uint64_t stamp) {
+  if (stamp == last_latched) {
+    return;
+  }
+  last_latched = stamp;
+  latch.record(input_latency_now() - stamp);
+  /* if there is already a change waiting, the frame shows both, and the
+   * older one is the one to time it from */
+  if (!waiting_for_frame) {
+    waiting_for_frame = stamp;
+  }
+}
+
+void InputLatency::frame_started(bool frame_drawn) {
+  /* the frame that has just finished was drawn after the strobe */
+  if (in_frame) {
+    uint64_t expected = 0;
+    drawn.compare_exchange_strong(expected, in_frame,
+                                  std::memory_order_release,
+                                  std::memory_order_relaxed);
+    in_frame = 0;
+  }
+  if (waiting_for_frame && frame_drawn) {
+    in_frame = waiting_for_frame;
+    waiting_for_frame = 0;
+  }
+}
+
+void InputLatency::frame_painted(void) {
+  if (!painted) {
+    painted = drawn.exchange(0, std::memory_order_acquire);
+  }
+}
+
+void InputLatency::frame_presented(void) {
+  if (painted) {
+    present.record(input_latency_now() - painted);
+    painted = 0;
+  }
+}
+
+std::string InputLatency::report(void) const {
+  return latch.report("Key press to $4016 strobe") + "\n" +
+         present.report("Key press to frame on screen");
+}
@@ -0,0 +1,67 @@
+#ifndef INPUTLATENCY_H_
+#define INPUTLATENCY_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/* nanoseconds on a monotonic clock, never 0 */
+uint64_t input_latency_now(void);
+
+/* Counts of latencies in power of 2 buckets of microseconds. Written by one
+ * thread, can be read by any. */
+class latency_histogram {
+public:
+  /* bucket i is [2^i, 2^(i+1)) us, bucket 0 also has everything under 1 us,
+   * the last has everything over */
+  static const int n_buckets = 24;
+
+  latency_histogram();
+  void record(uint64_t ns);
+  std::string report(const std::string &title) const;
+
+private:
+  std::array<std::atomic<uint32_t>, n_buckets> buckets;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> total_ns;
+  std::atomic<uint64_t> min_ns;
+  std::atomic<uint64_t> max_ns;
+};
+
+/* Follows each change of the controller from the key press to
+ *   latch:   the first $4016 strobe that reads it, on the emulation thread
+ *   present: the first frame swapped to the screen that was drawn after
+ *            that strobe, on the gui thread
+ * A change is identified by the time it was made, see NESController. */
+class InputLatency {
+public:
+  InputLatency();
+
+  /* emulation thread: a strobe read input that changed at stamp */
+  void latched(uint64_t stamp);
+  /* emulation thread: the ppu has started a new frame, drawn is false if
+   * it is being skipped */
+  void frame_started(bool drawn);
+  /* gui thread: the screen is being painted from the frame buffer */
+  void frame_painted(void);
+  /* gui thread: what was painted is now on the screen */
+  void frame_presented(void);
+
+  std::string report(void) const;
+
+private:
+  /* emulation thread only */
+  uint64_t last_latched;
+  uint64_t waiting_for_frame; /* latched, the next frame will show it */
+  uint64_t in_frame;          /* latched, the current frame shows it */
+  /* emulation thread to gui thread, a frame has been drawn showing it */
+  std::atomic<uint64_t> drawn;
+  /* gui thread only, painted but not yet swapped */
+  uint64_t painted;
+
+  latency_histogram latch;
+  latency_histogram present;
+};
+
+#endif
@@ -15,6 +15,8 @@
  */
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QSurfaceFormat>
 
 #include <memory>
 
@@ -25,13 +27,36 @@ extern "C" void log_none(const char *format, ...) {}
 
 int main(int argc, char **argv) {
 
+  /* the screen shader needs integer textures, which Mesa's software
+   * renderer only has in a core profile context */
+  QSurfaceFormat format;
+  format.setVersion(3, 3);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  QSurfaceFormat::setDefaultFormat(format);
+
   QApplication a(argc, argv);
   std::unique_ptr<MainWindow> w;
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  QCommandLineOption cpu_option(
+      "cpu", "Run the emulator thread on cpu <n> only.", "n");
+  QCommandLineOption realtime_option(
+      "realtime", "Run the emulator thread with real time priority.");
+  parser.addOption(cpu_option);
+  parser.addOption(realtime_option);
+  parser.process(a);
+
+  NESThreadOptions thread_options;
+  if (parser.isSet(cpu_option)) {
+    thread_options.cpu = parser.value(cpu_option).toInt();
+  }
+  thread_options.realtime = parser.isSet(realtime_option);
   
   ppu_register_error_callback(&log_none);
   cpu_register_error_callback(&log_none);
   try {
-    w.reset(new MainWindow());
+    w.reset(new MainWindow(thread_options));
   } catch (NESError &e) {
     exit(EXIT_FAILURE);
   }
@@ -1,10 +1,16 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "disassemblyviewer.h"
+#include "memoryviewer.h"
 
 #include <QBoxLayout>
+#include <QDialogButtonBox>
 #include <QFileDialog>
+#include <QLabel>
 #include <QMessageBox>
 #include <QPlainTextEdit>
+#include <QSignalBlocker>
+#include <QStatusBar>
 #include <QThread>
 #include <QTimer>
 #include <QtDebug>
@@ -20,6 +26,7 @@ void on_memory_write();
 }
 
 Q_DECLARE_METATYPE(NESError)
+Q_DECLARE_METATYPE(debug_hit_s)
 Q_DECLARE_METATYPE(cpu_state_s)
 Q_DECLARE_METATYPE(ppu_state_s)
 Q_DECLARE_METATYPE(cycle)
@@ -286,8 +293,9 @@ void PPUTableModel::addState(ringbuffer<ppu_state_s> r) {
 }
 /*============================================================*/
 
-MainWindow::MainWindow(QWidget *parent)
-  : QMainWindow(parent), ui(new Ui::MainWindow), paused(true) {
+MainWindow::MainWindow(const NESThreadOptions &thread_options, QWidget *parent)
+  : QMainWindow(parent), ui(new Ui::MainWindow), capture(nullptr),
+    paused(true) {
 
   qRegisterMetaType<ringbuffer<cycle>>();
   qRegisterMetaType<cycle>();
@@ -296,6 +304,7 @@ MainWindow::MainWindow(QWidget *parent)
   qRegisterMetaType<ringbuffer<ppu_state_s>>();
   qRegisterMetaType<ppu_state_s>();
   qRegisterMetaType<NESError>();
+  qRegisterMetaType<debug_hit_s>();
   
   /*----------------------Set up gui thread------------------------------*/
   cpu_model = new CPUTableModel(this);
@@ -318,10 +327,10 @@ MainWindow::MainWindow(QWidget *parent)
 
   NESScreen *s = new NESScreen(this);
   ui->openGLWidget->initScreen(s);
+  nes_screen = s;
 
   /*----------------------Set up emulator and other threads-----------------*/
 
-  nes_thread = new QThread();
   cb_buffer_thread = new QThread();
   
   // Get .nes file to open
@@ -333,7 +342,7 @@ MainWindow::MainWindow(QWidget *parent)
   init_callback_buffer();
   init_callback_forwarder();
   init_nes_controller();
-  init_nes_context(rom_filename, s);
+  init_nes_context(rom_filename, s, thread_options);
 
 
   // have to wait for emulator to pause and send everything to buffer
@@ -350,23 +359,33 @@ MainWindow::MainWindow(QWidget *parent)
   connect(this, SIGNAL(play_button_clicked()), this, SLOT(cb_buffer_mode()));
   connect(this, SIGNAL(play_button_clicked()), callback_buffer, SLOT(start()));
  
-  /* I think this should delete everything properly when exiting programme */
-
-  /*Nope it segfaults when closing window when nes context running */
-  connect(nes_context, SIGNAL(nes_done()), nes_thread, SLOT(quit()));
+  /* nes_context is a child of this window, so its thread is stopped when
+   * the window goes. the callbacks use the forwarder and controller, so
+   * they go after it */
   connect(nes_context, SIGNAL(nes_done()), nes_context, SLOT(deleteLater()));
   connect(nes_context, SIGNAL(nes_done()), callback_forwarder,
           SLOT(deleteLater()));
   connect(nes_context, SIGNAL(nes_done()), nes_controller, SLOT(deleteLater()));
-
-  connect(nes_thread, SIGNAL(finished()), nes_thread, SLOT(deleteLater()));
-  connect(nes_thread, SIGNAL(finished()), this, SLOT(done()));
-  qDebug() << "Starting nes thread";
-  nes_thread->start();
+  connect(nes_context, SIGNAL(nes_done()), this, SLOT(done()));
+  connect(nes_context, &NESContext::nes_done, this, [this]() {
+    nes_context = nullptr;
+    nes_controller = nullptr;
+  });
   cb_buffer_thread->start();
 }
 
-MainWindow::~MainWindow() { delete ui; }
+MainWindow::~MainWindow() {
+  /* stop the emulation thread before input_latency goes */
+  delete nes_context;
+  nes_context = nullptr;
+  ui->openGLWidget->setInputLatency(nullptr);
+  if (capture != nullptr) {
+    char e_context[LEN_E_CONTEXT];
+    capture_stop(capture, nullptr, e_context);
+  }
+  std::cout << input_latency.report();
+  delete ui;
+}
 
 /*============================================================*/
 
@@ -377,6 +396,34 @@ void MainWindow::error(NESError e) {
   // QApplication::quit();
 }
 
+/* the emulation thread has stopped, and nes_paused follows if it was
+ * running */
+void MainWindow::breakpoint(debug_hit_s hit) {
+  static const char *access_names[DEBUG_N_ACCESS] = {"execute", "read",
+                                                     "write"};
+  paused = true;
+  const cpu_state_s &r = hit.regs;
+  QString where =
+      (hit.access == DEBUG_EXEC)
+          ? QString()
+          : QStringLiteral(" $%1 = $%2")
+                .arg(hit.addr, 4, 16, QLatin1Char('0'))
+                .arg(hit.val, 2, 16, QLatin1Char('0'));
+  statusBar()->showMessage(
+      QStringLiteral("Breakpoint %1: %2%3 at $%4 %5  A:%6 X:%7 Y:%8 P:%9 "
+                     "SP:%10")
+          .arg(hit.id)
+          .arg(access_names[hit.access])
+          .arg(where)
+          .arg(r.pc, 4, 16, QLatin1Char('0'))
+          .arg(r.curr_instruction)
+          .arg(r.a, 2, 16, QLatin1Char('0'))
+          .arg(r.x, 2, 16, QLatin1Char('0'))
+          .arg(r.y, 2, 16, QLatin1Char('0'))
+          .arg(r.p, 2, 16, QLatin1Char('0'))
+          .arg(r.sp, 2, 16, QLatin1Char('0')));
+}
+
 void MainWindow::mousePressEvent(QMouseEvent *event) {
   Q_UNUSED(event);
 
@@ -386,15 +433,15 @@ void MainWindow::mousePressEvent(QMouseEvent *event) {
 
 void MainWindow::keyPressEvent(QKeyEvent *event) {
   // qDebug() << "Pressed key " << event->key();
-  if (!event->isAutoRepeat()) {
-    emit nes_button_pressed(event->key());
+  if (!event->isAutoRepeat() && nes_controller != nullptr) {
+    nes_controller->nes_button_pressed(event->key());
   }
 }
 
 void MainWindow::keyReleaseEvent(QKeyEvent *event) {
   // qDebug() << "Released key " << event->key();
-  if (!event->isAutoRepeat()) {
-    emit nes_button_released(event->key());
+  if (!event->isAutoRepeat() && nes_controller != nullptr) {
+    nes_controller->nes_button_released(event->key());
   }
 }
 
@@ -452,36 +499,149 @@ void MainWindow::on_stepButton_clicked() {
   emit step_button_clicked();
 }
 
-/* Double check this is ok with threads */
+void MainWindow::on_resetButton_clicked() { emit reset_button_clicked(); }
+
+/* the viewers follow the emulator as it runs, so no need to pause */
 void MainWindow::on_memoryDumpButton_clicked() {
-  on_pauseButton_clicked();
+  show_memory_viewer(MEMORY_REGION_CPU);
+}
 
-  // why not just dump it to a file and read it?
-  char dump_data[1 << 19];
-  size_t dump_len = 1 << 19;
-  if (memory_dump_string(dump_data, dump_len) < 0) {
-    qDebug() << "Memory dump didn't work";
+void MainWindow::on_VRAMDumpButton_clicked() {
+  show_memory_viewer(MEMORY_REGION_VRAM);
+}
+
+void MainWindow::show_memory_viewer(memory_region_e region) {
+  MemoryViewer *viewer = new MemoryViewer(nes_context, region, this);
+  viewer->show();
+}
+
+void MainWindow::on_disassemblyButton_clicked() {
+  DisassemblyViewer *viewer = new DisassemblyViewer(nes_context, this);
+  viewer->show();
+}
+
+void MainWindow::on_inputLatencyButton_clicked() {
+  show_text_dialog(input_latency.report().c_str());
+}
+
+void MainWindow::on_breakpointsButton_clicked() {
+  QDialog dialog(this);
+  dialog.setWindowTitle("Breakpoints");
+  QLabel *help = new QLabel(
+      "One a line, e.g.\n"
+      "  x c004  (execute)\n"
+      "  w 0300-03ff  (write)\n"
+      "  r 2002 if val & 80\n"
+      "  x e000 if a == 5\n"
+      "Registers a, x, y, sp, p, val; compare with ==, !=, <, >=, &",
+      &dialog);
+  QPlainTextEdit *text_edit = new QPlainTextEdit(&dialog);
+  text_edit->setPlainText(breakpoint_text);
+  text_edit->setFont(QFont("Monospace"));
+  QDialogButtonBox *buttons = new QDialogButtonBox(
+      QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+  QBoxLayout layout(QBoxLayout::TopToBottom);
+  layout.addWidget(help);
+  layout.addWidget(text_edit);
+  layout.addWidget(buttons);
+  dialog.setLayout(&layout);
+
+  if (dialog.exec() != QDialog::Accepted) {
     return;
   }
+  std::vector<debug_breakpoint_s> list;
+  try {
+    for (const QString &line : text_edit->toPlainText().split('\n')) {
+      if (!line.trimmed().isEmpty()) {
+        list.push_back(nes_debug_parse(line.toStdString()));
+      }
+    }
+    if (list.size() > DEBUG_MAX_BREAKPOINTS) {
+      throw NESError(E_DEBUG_FULL);
+    }
+  } catch (NESError &e) {
+    show_error(this, e);
+    return;
+  }
+  breakpoint_text = text_edit->toPlainText();
+  if (nes_context != nullptr) {
+    nes_context->nes_set_breakpoints(list);
+  }
+}
 
-  show_hexdump_dialog(dump_data);
+void MainWindow::on_turboCheckBox_toggled(bool checked) {
+  emit turbo_toggled(checked);
 }
 
-void MainWindow::on_VRAMDumpButton_clicked() {
-  on_pauseButton_clicked();
-  
-  char dump_data[1 << 18];
-  size_t dump_len = 1 << 18;
-  if (memory_vram_dump_string(dump_data, dump_len) < 0) {
-    qDebug() << "VRAM dump didn't work";
+void MainWindow::on_frameSkipSpinBox_valueChanged(int n) {
+  emit frame_skip_changed(n);
+}
+
+void MainWindow::on_ntscCheckBox_toggled(bool checked) {
+  try {
+    ui->openGLWidget->setNTSC(checked);
+  } catch (NESError &e) {
+    show_error(this, e);
+    QSignalBlocker blocker(ui->ntscCheckBox);
+    ui->ntscCheckBox->setChecked(false);
+  }
+}
+
+void MainWindow::on_recordCheckBox_toggled(bool checked) {
+  if (!checked) {
+    stop_capture();
+    return;
+  }
+  QString filename = QFileDialog::getSaveFileName(
+      this, "Record to", "",
+      "YUV4MPEG2 video (*.y4m);;Delta compressed frames (*.nesv)");
+  if (filename.isEmpty() || nes_context == nullptr) {
+    QSignalBlocker blocker(ui->recordCheckBox);
+    ui->recordCheckBox->setChecked(false);
+    return;
+  }
+  try {
+    nes_capture_start(&capture, filename.toStdString(),
+                      filename.endsWith(".nesv") ? CAPTURE_DELTA : CAPTURE_Y4M,
+                      CAPTURE_DEFAULT_QUEUE, nullptr, 0);
+  } catch (NESError &e) {
+    capture = nullptr;
+    show_error(this, e);
+    QSignalBlocker blocker(ui->recordCheckBox);
+    ui->recordCheckBox->setChecked(false);
     return;
   }
+  nes_context->nes_set_capture(capture, nes_screen->getPBufPtr()->data());
+}
 
-  show_hexdump_dialog(dump_data);
+/* the writer finishes what is queued, which can take a moment */
+void MainWindow::stop_capture() {
+  if (capture == nullptr) {
+    return;
+  }
+  if (nes_context != nullptr) {
+    nes_context->nes_set_capture(nullptr, nullptr);
+  }
+  capture_stats_s stats;
+  try {
+    nes_capture_stop(capture, &stats);
+    statusBar()->showMessage(QString("Recorded %1 frames, %2 dropped")
+                                 .arg(stats.frames_written)
+                                 .arg(stats.frames_dropped));
+  } catch (NESError &e) {
+    show_error(this, e);
+  }
+  capture = nullptr;
 }
 
 void MainWindow::on_patternTableButton_clicked() {
   on_pauseButton_clicked();
+  if (nes_context != nullptr) {
+    nes_context->nes_pause_wait();
+  }
   
   QDialog pattern_table_dialog(this);
 
@@ -502,20 +662,20 @@ void MainWindow::on_patternTableButton_clicked() {
   pattern_table_dialog.exec();
 }
 
-void MainWindow::show_hexdump_dialog(const char *dump_data) {
-  QDialog hexdump_dialog(this);
-  QPlainTextEdit *hexdump_text_view = new QPlainTextEdit(&hexdump_dialog);
+void MainWindow::show_text_dialog(const char *text) {
+  QDialog text_dialog(this);
+  QPlainTextEdit *text_view = new QPlainTextEdit(&text_dialog);
 
-  hexdump_text_view->setReadOnly(true);
-  hexdump_text_view->setLineWrapMode(QPlainTextEdit::NoWrap);
-  hexdump_text_view->setPlainText(dump_data);
-  hexdump_text_view->setFont(QFont("Monospace"));
+  text_view->setReadOnly(true);
+  text_view->setLineWrapMode(QPlainTextEdit::NoWrap);
+  text_view->setPlainText(text);
+  text_view->setFont(QFont("Monospace"));
 
-  QBoxLayout hexdump_dialog_layout(QBoxLayout::TopToBottom);
-  hexdump_dialog_layout.addWidget(hexdump_text_view);
-  hexdump_dialog.setLayout(&hexdump_dialog_layout);
+  QBoxLayout text_dialog_layout(QBoxLayout::TopToBottom);
+  text_dialog_layout.addWidget(text_view);
+  text_dialog.setLayout(&text_dialog_layout);
 
-  hexdump_dialog.exec();
+  text_dialog.exec();
 }
 
 void MainWindow::init_callback_buffer() {
@@ -535,8 +695,8 @@ connect(callback_buffer, SIGNAL(batch_memory_states(ringbuffer<cycle>)),
 }
 
 void MainWindow::init_callback_forwarder() {
+  /* stays on the gui thread, it only emits from the emulation thread */
   callback_forwarder = new NESCallbackForwarder();
-  callback_forwarder->moveToThread(nes_thread);
   
   // start in single step mode as opposed to buffer mode 
   cpu_register_state_callback(&on_cpu_state_update, callback_forwarder);
@@ -553,33 +713,39 @@ void MainWindow::init_callback_forwarder() {
 }
 
 void MainWindow::init_nes_controller() {
-  nes_controller = new NESController();
-  nes_controller->moveToThread(nes_thread);
-  // controller signals 
-  connect(this, SIGNAL(nes_button_pressed(int)), nes_controller,
-          SLOT(nes_button_pressed(int)), Qt::QueuedConnection);
-  connect(this, SIGNAL(nes_button_released(int)), nes_controller,
-          SLOT(nes_button_released(int)), Qt::QueuedConnection);
+  /* key events go straight to it, the emulation thread reads the buttons
+   * atomically */
+  nes_controller = new NESController(&input_latency);
+  ui->openGLWidget->setInputLatency(&input_latency);
 }
 
-void MainWindow::init_nes_context(const std::string &rom_filename, NESScreen *s) {
+void MainWindow::init_nes_context(const std::string &rom_filename, NESScreen *s,
+                                  const NESThreadOptions &thread_options) {
   try {
     qDebug() << "Initialising NESContext";
     nes_context = new NESContext(rom_filename, s->get_put_pixel(), s,
-                                 &get_pressed_buttons, nes_controller);
+                                 &get_pressed_buttons, nes_controller,
+                                 &input_latency, thread_options, this);
   } catch (NESError &e) {
     error(e);
     throw e;
   }
 
-  nes_context->moveToThread(nes_thread);
-
-  connect(this, SIGNAL(pause_button_clicked()), nes_context, SLOT(nes_pause()),
-          Qt::BlockingQueuedConnection);
-  connect(this, SIGNAL(play_button_clicked()), nes_context, SLOT(nes_start()),
-          Qt::BlockingQueuedConnection);
-  
+  /* nes_context stays on this thread, its slots just queue a command for
+   * the emulation thread and return, so none of these block */
+  connect(this, SIGNAL(pause_button_clicked()), nes_context, SLOT(nes_pause()));
+  connect(this, SIGNAL(play_button_clicked()), nes_context, SLOT(nes_start()));
   connect(this, SIGNAL(step_button_clicked()), nes_context, SLOT(nes_step()));
+  connect(this, SIGNAL(reset_button_clicked()), nes_context, SLOT(nes_reset()));
+  connect(this, SIGNAL(turbo_toggled(bool)), nes_context,
+          SLOT(nes_set_turbo(bool)));
+  connect(this, SIGNAL(frame_skip_changed(int)), nes_context,
+          SLOT(nes_set_frame_skip(int)));
+  /* emitted from the emulation thread */
   connect(nes_context, SIGNAL(nes_error(NESError)), this,
-          SLOT(error(NESError)));
+          SLOT(error(NESError)), Qt::QueuedConnection);
+  connect(nes_context, SIGNAL(nes_breakpoint(debug_hit_s)), this,
+          SLOT(breakpoint(debug_hit_s)), Qt::QueuedConnection);
+  connect(nes_context, SIGNAL(nes_frame_drawn(int, int)), ui->openGLWidget,
+          SLOT(setFrameInfo(int, int)), Qt::QueuedConnection);
 }
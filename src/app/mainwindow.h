@@ -144,7 +144,7 @@ class MainWindow;
 
 /* Main window that everything goes in, namely
  * table views for memory, cpu, ppu data, buttons to start/stop/step
- * emulator, memory hexdump button, and openglwidget containing
+ * emulator, memory viewer buttons, and openglwidget containing
  * the graphical output of the emulator, etc
  */
 class MainWindow : public QMainWindow {
@@ -152,20 +152,23 @@ class MainWindow : public QMainWindow {
   Q_OBJECT
 
 public:
-  explicit MainWindow(QWidget *parent = nullptr);
+  explicit MainWindow(const NESThreadOptions &thread_options =
+                          NESThreadOptions(),
+                      QWidget *parent = nullptr);
   ~MainWindow();
 
 public slots:
   void done(void);
   void error(NESError e);
+  void breakpoint(debug_hit_s hit);
 
 signals:
-  void nes_button_pressed(int key);
-  void nes_button_released(int key);
-  
   void pause_button_clicked();
   void play_button_clicked();
   void step_button_clicked();
+  void reset_button_clicked();
+  void turbo_toggled(bool on);
+  void frame_skip_changed(int n);
 
 protected:
   void mousePressEvent(QMouseEvent *event) override;
@@ -176,8 +179,11 @@ private:
   void init_callback_buffer();
   void init_callback_forwarder();
   void init_nes_controller();
-  void init_nes_context(const std::string &rom_filename, NESScreen *s);
-  void show_hexdump_dialog(const char *dump_data);
+  void init_nes_context(const std::string &rom_filename, NESScreen *s,
+                        const NESThreadOptions &thread_options);
+  void show_text_dialog(const char *text);
+  void show_memory_viewer(memory_region_e region);
+  void stop_capture();
 
   Ui::MainWindow *ui;
 
@@ -186,11 +192,16 @@ private:
   PPUTableModel *ppu_model;
   MemoryTableModel *memory_model;
 
-  // NES thread
-  QThread *nes_thread;
+  // NES thread is started by nes_context, the rest are on the gui thread
   NESContext *nes_context;
   NESController *nes_controller;
+  InputLatency input_latency;
   NESCallbackForwarder *callback_forwarder;
+  NESScreen *nes_screen;
+  /* frames are recorded while this isn't null */
+  capture_s *capture;
+  /* what was typed in the breakpoints dialog, one breakpoint a line */
+  QString breakpoint_text;
 
   // Buffer thread
   QThread *cb_buffer_thread;
@@ -206,9 +217,17 @@ private slots:
   void on_pauseButton_clicked();
   void on_playButton_clicked();
   void on_stepButton_clicked();
+  void on_resetButton_clicked();
   void on_memoryDumpButton_clicked();
   void on_VRAMDumpButton_clicked();
   void on_patternTableButton_clicked();
+  void on_disassemblyButton_clicked();
+  void on_inputLatencyButton_clicked();
+  void on_breakpointsButton_clicked();
+  void on_turboCheckBox_toggled(bool checked);
+  void on_frameSkipSpinBox_valueChanged(int n);
+  void on_ntscCheckBox_toggled(bool checked);
+  void on_recordCheckBox_toggled(bool checked);
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,88 @@
+#include "memoryviewer.h"
+
+#include <QBoxLayout>
+#include <QFontDatabase>
+#include <QHeaderView>
+
+static const char *region_names[MEMORY_REGION_COUNT] = {
+    "CPU memory", "VRAM", "OAM", "Palette", "CPU memory as read"};
+
+/* where each region starts in its address space, for the row labels */
+static const uint16_t region_base_addrs[MEMORY_REGION_COUNT] = {0, 0, 0,
+                                                                0x3F00, 0};
+
+MemoryViewer::MemoryViewer(NESContext *context, memory_region_e region,
+                           QWidget *parent)
+    : QDialog(parent), context(context), region(region), generation(0) {
+  setAttribute(Qt::WA_DeleteOnClose);
+  setWindowTitle("Memory");
+
+  region_box = new QComboBox(this);
+  for (int i = 0; i < MEMORY_REGION_COUNT; i++) {
+    region_box->addItem(region_names[i]);
+  }
+  region_box->setCurrentIndex(region);
+
+  model = new HexTableModel(this);
+  view = new QTableView(this);
+  view->setModel(model);
+  view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  view->setSelectionMode(QAbstractItemView::NoSelection);
+  view->setShowGrid(false);
+
+  /* fixed sizes, so the view never has to format every row to lay itself
+   * out */
+  QFontMetrics metrics(view->font());
+  view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  view->verticalHeader()->setDefaultSectionSize(metrics.height() + 2);
+  view->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  view->horizontalHeader()->setDefaultSectionSize(
+      metrics.horizontalAdvance("000"));
+  view->horizontalHeader()->resizeSection(
+      HexTableModel::text_column,
+      metrics.horizontalAdvance(
+          QString(HexTableModel::bytes_per_row + 2, QLatin1Char('M'))));
+
+  QBoxLayout *layout = new QBoxLayout(QBoxLayout::TopToBottom, this);
+  layout->addWidget(region_box);
+  layout->addWidget(view);
+  resize(720, 480);
+
+  if (this->context != nullptr) {
+    this->context->nes_watch_memory(region, true);
+  }
+  connect(region_box, QOverload<int>::of(&QComboBox::currentIndexChanged),
+          this, &MemoryViewer::set_region);
+
+  timer = new QTimer(this);
+  connect(timer, &QTimer::timeout, this, &MemoryViewer::refresh);
+  timer->start(refresh_ms);
+}
+
+MemoryViewer::~MemoryViewer() {
+  if (context != nullptr) {
+    context->nes_watch_memory(region, false);
+  }
+}
+
+void MemoryViewer::set_region(int new_region) {
+  if (new_region < 0 || new_region >= MEMORY_REGION_COUNT) {
+    return;
+  }
+  if (context != nullptr) {
+    context->nes_watch_memory((memory_region_e)new_region, true);
+    context->nes_watch_memory(region, false);
+  }
+  region = (memory_region_e)new_region;
+  generation = 0;
+  view->scrollToTop();
+}
+
+void MemoryViewer::refresh(void) {
+  if (context == nullptr) {
+    return;
+  }
+  if (context->nes_get_snapshot(region, snapshot, generation)) {
+    model->setBytes(snapshot, region_base_addrs[region]);
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef MEMORYVIEWER_H_
+#define MEMORYVIEWER_H_
+
+#include <QComboBox>
+#include <QDialog>
+#include <QPointer>
+#include <QTableView>
+#include <QTimer>
+
+#include <cstdint>
+#include <vector>
+
+#include "hextablemodel.h"
+#include "nescontext.h"
+
+/* Window with a hexdump of one memory region (see memory_snapshot), which
+ * follows the emulator while it runs. Snapshots are taken by the emulation
+ * thread, see NESContext::nes_watch_memory, and picked up here a few times
+ * a second. Deletes itself when closed. */
+class MemoryViewer : public QDialog {
+
+  Q_OBJECT
+
+public:
+  MemoryViewer(NESContext *context, memory_region_e region,
+               QWidget *parent = nullptr);
+  ~MemoryViewer();
+
+private slots:
+  void set_region(int region);
+  void refresh(void);
+
+private:
+  static const int refresh_ms = 100;
+
+  /* the context goes away if the emulator fails */
+  QPointer<NESContext> context;
+  memory_region_e region;
+  uint64_t generation;
+  std::vector<uint8_t> snapshot;
+
+  QComboBox *region_box;
+  QTableView *view;
+  HexTableModel *model;
+  QTimer *timer;
+};
+
+#endif
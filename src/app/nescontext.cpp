@@ -1,57 +1,333 @@
 #include <QtDebug>
 #include "nescontext.h"
 
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 NESContext::NESContext(const std::string &rom_filename,
 		       void (*put_pixel)(int, int, uint8_t, void *),
 		       void *put_pixel_data,
 		       uint8_t (*get_pressed_buttons_cb)(void *),
 		       void *get_pressed_buttons_data,
+		       InputLatency *latency,
+		       const NESThreadOptions &thread_options,
 		       QObject *parent)
-    : QObject(parent) {
+    : QObject(parent), rom_filename(rom_filename), put_pixel(put_pixel),
+      put_pixel_data(put_pixel_data), thread_options(thread_options),
+      latency(latency), last_frame(0), last_frame_drawn(true),
+      last_frame_burst_phase(0), running(false),
+      turbo(false), recording(nullptr), recording_frame(nullptr),
+      in_capture(false), pauses_sent(0), pauses_done(0) {
 
-  nes_timer = new QTimer(this);
-  nes_timer->setInterval(0);
-  connect(nes_timer, SIGNAL(timeout()), this, SLOT(nes_tick()));
-  
-  /* init ppu_ptr */
-  qDebug() << "NESContext: Initialising ppu";
-  nes_ppu_init_no_alloc(&ppu, put_pixel, put_pixel_data);
+  for (int i = 0; i < MEMORY_REGION_COUNT; i++) {
+    snapshots[i].bytes.resize(memory_region_size((memory_region_e)i));
+  }
 
   qDebug() << "NESContext: Initialising controller";
   controller_init(get_pressed_buttons_cb, get_pressed_buttons_data);
-  
+
+  /* on this thread so a bad rom throws to whoever made the context */
+  power_on();
+
+  qDebug() << "NESContext: Starting emulation thread";
+  thread = std::thread(&NESContext::run, this);
+  qDebug() << "NESContext: Init done";
+}
+
+NESContext::~NESContext() {
+  send(command::QUIT);
+  thread.join();
+}
+
+void NESContext::power_on(void) {
+  std::memset(&ppu, 0, sizeof(ppu));
+  std::memset(&cpu, 0, sizeof(cpu));
+
+  qDebug() << "NESContext: Initialising ppu";
+  nes_ppu_init_no_alloc(&ppu, put_pixel, put_pixel_data);
+
   qDebug() << "NESContext: Initialising memory";
   nes_memory_init(rom_filename, &ppu);
 
-  /* init cpu_ptr */
   qDebug() << "NESContext: Initialising cpu";
   nes_cpu_init_no_alloc(&cpu, 0);
-  qDebug() << "NESContext: Init done";
+  last_frame = ppu_get_frame_count(&ppu);
+  last_frame_drawn = !ppu.skip_render;
+  last_frame_burst_phase = ppu_get_burst_phase(&ppu);
+}
+
+/* Slots, called on the gui thread */
+
+void NESContext::nes_step() { send(command::STEP); }
+
+void NESContext::nes_start() { send(command::START); }
+
+void NESContext::nes_pause() {
+  pauses_sent++;
+  send(command::PAUSE);
+}
+
+void NESContext::nes_pause_wait() {
+  uint64_t n = ++pauses_sent;
+  send(command::PAUSE);
+  std::unique_lock<std::mutex> lock(pause_lock);
+  paused.wait(lock, [this, n]() { return pauses_done >= n; });
+}
+
+void NESContext::nes_reset() { send(command::RESET); }
+
+void NESContext::nes_set_turbo(bool on) { send(command::SET_TURBO, on); }
+
+void NESContext::nes_set_frame_skip(int n) {
+  send(command::SET_FRAME_SKIP, (n < 0) ? 0 : (n > 0xFF) ? 0xFF : n);
+}
+
+void NESContext::nes_set_capture(capture_s *capture, const uint8_t *frame) {
+  recording_frame = frame;
+  recording = capture;
+  /* if the emulation thread got the old one before the store above, wait
+   * for it to finish with it */
+  while (in_capture) {
+    std::this_thread::yield();
+  }
+}
+
+void NESContext::nes_watch_memory(memory_region_e region, bool on) {
+  if (on) {
+    snapshots[region].watchers++;
+    /* so there is something to show while paused */
+    send(command::SNAPSHOT);
+  } else {
+    snapshots[region].watchers--;
+  }
 }
 
-/* Slots */
+bool NESContext::nes_get_snapshot(memory_region_e region,
+                                  std::vector<uint8_t> &bytes,
+                                  uint64_t &generation) {
+  memory_snapshot_s &s = snapshots[region];
+  std::lock_guard<std::mutex> lock(s.lock);
+  if (s.generation == generation) {
+    return false;
+  }
+  bytes = s.bytes;
+  generation = s.generation;
+  return true;
+}
+
+bool NESContext::nes_get_snapshot(
+    memory_region_e region, std::vector<uint8_t> &bytes, uint64_t &generation,
+    uint16_t &pc, std::array<uint16_t, DISASM_N_SEGMENTS> &banks) {
+  memory_snapshot_s &s = snapshots[region];
+  std::lock_guard<std::mutex> lock(s.lock);
+  if (s.generation == generation) {
+    return false;
+  }
+  bytes = s.bytes;
+  generation = s.generation;
+  pc = s.pc;
+  banks = s.banks;
+  return true;
+}
+
+void NESContext::nes_set_breakpoints(
+    const std::vector<debug_breakpoint_s> &list) {
+  {
+    std::lock_guard<std::mutex> lock(breakpoints_lock);
+    breakpoints = list;
+  }
+  send(command::SET_BREAKPOINTS);
+}
+
+void NESContext::send(command::type_e type, int arg) {
+  while (!commands.push(command{type, arg})) {
+    /* 64 commands behind, let it catch up */
+    std::this_thread::yield();
+  }
+  /* take the lock so the emulation thread can't miss this between
+   * checking the queue and going to sleep */
+  { std::lock_guard<std::mutex> lock(wake_lock); }
+  wake.notify_one();
+}
+
+/* Emulation thread */
+
+void NESContext::run(void) {
+  apply_thread_options();
+  for (;;) {
+    command c;
+    while (commands.pop(c)) {
+      if (!handle(c)) {
+        return;
+      }
+    }
+    if (running) {
+      tick();
+    } else {
+      std::unique_lock<std::mutex> lock(wake_lock);
+      wake.wait(lock, [this]() { return !commands.empty(); });
+    }
+  }
+}
+
+/* returns false to quit */
+bool NESContext::handle(const command &c) {
+  switch (c.type) {
+  case command::START:
+    running = true;
+    break;
+  case command::PAUSE:
+    running = false;
+    take_snapshots();
+    emit nes_paused();
+    {
+      std::lock_guard<std::mutex> lock(pause_lock);
+      pauses_done++;
+    }
+    paused.notify_all();
+    break;
+  case command::STEP:
+    running = false;
+    tick();
+    take_snapshots();
+    break;
+  case command::RESET:
+    try {
+      power_on();
+    } catch (NESError &e) {
+      running = false;
+      emit nes_error(e);
+      emit nes_done();
+    }
+    take_snapshots();
+    break;
+  case command::SET_TURBO:
+    turbo = c.arg;
+    break;
+  case command::SET_FRAME_SKIP:
+    ppu_set_frame_skip(&ppu, c.arg);
+    break;
+  case command::SNAPSHOT:
+    take_snapshots();
+    break;
+  case command::SET_BREAKPOINTS:
+    set_breakpoints();
+    break;
+  case command::QUIT:
+    return false;
+  }
+  return true;
+}
 
-void NESContext::nes_tick(void) {
+void NESContext::tick(void) {
+  int status;
   try {
-    nes_cpu_exec(&cpu);
+    if (turbo) {
+      status = nes_run_frames(&cpu, &ppu, 1);
+    } else {
+      status = nes_cpu_exec(&cpu);
+    }
   } catch (NESError &e) {
-    nes_timer->stop();
+    running = false;
     emit nes_error(e);
     emit nes_done();
+    return;
+  }
+  if (ppu_get_frame_count(&ppu) != last_frame) {
+    last_frame = ppu_get_frame_count(&ppu);
+    if (last_frame_drawn) {
+      capture_last_frame();
+      emit nes_frame_drawn(ppu.ppumask >> 5, last_frame_burst_phase);
+    }
+    last_frame_drawn = !ppu.skip_render;
+    last_frame_burst_phase = ppu_get_burst_phase(&ppu);
+    if (latency != nullptr) {
+      latency->frame_started(last_frame_drawn);
+    }
+    take_snapshots();
+  }
+  if (status == CPU_BREAKPOINT) {
+    stop_at_breakpoint();
   }
 }
 
-void NESContext::nes_step() {
-  nes_timer->stop();
-  nes_tick();
+/* in_capture is set before looking at recording, so nes_set_capture
+ * either sees it set or this sees the new recording */
+void NESContext::capture_last_frame(void) {
+  in_capture = true;
+  capture_s *capture = recording;
+  if (capture != nullptr) {
+    capture_frame(capture, recording_frame, ppu.ppumask >> 5);
+  }
+  in_capture = false;
 }
 
-void NESContext::nes_start() {
-  nes_timer->start();
+void NESContext::take_snapshots(void) {
+  for (int i = 0; i < MEMORY_REGION_COUNT; i++) {
+    memory_snapshot_s &s = snapshots[i];
+    if (s.watchers > 0 && s.lock.try_lock()) {
+      memory_snapshot((memory_region_e)i, s.bytes.data(), s.bytes.size());
+      s.pc = cpu.pc;
+      disasm_get_banks(s.banks.data());
+      s.generation++;
+      s.lock.unlock();
+    }
+  }
 }
 
-void NESContext::nes_pause() {
-  nes_timer->stop();
-  emit nes_paused();
+void NESContext::set_breakpoints(void) {
+  std::lock_guard<std::mutex> lock(breakpoints_lock);
+  debug_clear();
+  try {
+    for (const debug_breakpoint_s &breakpoint : breakpoints) {
+      nes_debug_add(breakpoint);
+    }
+  } catch (NESError &e) {
+    emit nes_error(e);
+  }
 }
 
+/* like a PAUSE command if running, with the hit sent first so it is there
+ * by the time the gui sees the pause. when stepping the gui is already
+ * paused */
+void NESContext::stop_at_breakpoint(void) {
+  debug_hit_s hit;
+  bool was_running = running;
+  running = false;
+  take_snapshots();
+  if (debug_get_hit(&hit)) {
+    emit nes_breakpoint(hit);
+  }
+  if (was_running) {
+    emit nes_paused();
+  }
+}
+
+void NESContext::apply_thread_options(void) {
+#ifdef __linux__
+  if (thread_options.cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(thread_options.cpu, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+      qWarning() << "NESContext: Couldn't pin emulation thread to cpu"
+                 << thread_options.cpu;
+    }
+  }
+  if (thread_options.realtime) {
+    sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+      qWarning() << "NESContext: Couldn't get real time priority";
+    }
+  }
+#else
+  if (thread_options.cpu >= 0 || thread_options.realtime) {
+    qWarning() << "NESContext: Thread options are only supported on Linux";
+  }
+#endif
+}
@@ -2,13 +2,33 @@
 #define NESCONTEXT_H_
 
 #include <QObject>
-#include <QTimer>
 
-#include <memory>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "commandqueue.h"
+#include "inputlatency.h"
 #include "core/cppwrapper.hpp"
 
+/* how the emulation thread is run */
+struct NESThreadOptions {
+  int cpu = -1;          /* pin to this cpu if >= 0 */
+  bool realtime = false; /* ask for SCHED_FIFO, usually needs privileges */
+};
+
+/* Runs the emulator on its own thread, in a loop that doesn't go through
+ * the Qt event loop. The slots can be called from any one thread (the gui
+ * thread), they only put a command on a queue for the emulation thread and
+ * return straight away. nes_paused() is emitted from the emulation thread
+ * once it has actually stopped, nes_error()/nes_done() if the emulator
+ * fails, and nes_frame_drawn() after each frame, so connect to them with
+ * queued connections. */
 class NESContext : public QObject {
   Q_OBJECT
 
@@ -19,25 +39,137 @@ public:
 	     void *put_pixel_data,
 	     uint8_t (*get_pressed_buttons)(void *),
 	     void *get_pressed_buttons_data,
+	     InputLatency *latency = nullptr,
+	     const NESThreadOptions &thread_options = NESThreadOptions(),
 	     QObject *parent = nullptr);
+  ~NESContext();
 
 public slots:
   void nes_step(void);
   void nes_start(void);
   void nes_pause(void);
+  /* pause, and wait until the emulation thread has stopped, e.g. before
+   * looking at memory from another thread */
+  void nes_pause_wait(void);
+  /* power cycle, reloading the rom */
+  void nes_reset(void);
+
+  /* turbo: do a whole frame per tick instead of one instruction */
+  void nes_set_turbo(bool on);
+  /* only draw every nth frame */
+  void nes_set_frame_skip(int n);
+  /* give each frame drawn in frame (the NESScreen's pbuf) to capture, or
+   * stop with nullptr. doesn't go through the queue: once this returns the
+   * emulation thread won't use the old capture again, so it can be
+   * stopped */
+  void nes_set_capture(capture_s *capture, const uint8_t *frame);
+  /* while region is watched, the emulation thread snapshots it at the start
+   * of each frame and whenever it stops. watching nests, so every viewer
+   * can watch and unwatch independently */
+  void nes_watch_memory(memory_region_e region, bool on);
+  /* replace all the breakpoints. when one is hit the emulation thread
+   * stops and emits nes_breakpoint(), then nes_paused() if it wasn't
+   * stepping */
+  void nes_set_breakpoints(const std::vector<debug_breakpoint_s> &list);
+
+public:
+  /* if there is a snapshot of region newer than generation, copy it into
+   * bytes, update generation and return true. can be called from any
+   * thread, and never makes the emulation thread wait */
+  bool nes_get_snapshot(memory_region_e region, std::vector<uint8_t> &bytes,
+                        uint64_t &generation);
+  /* and the pc and prg banks (see disasm_get_banks) when it was taken, for
+   * disassembling a MEMORY_REGION_CODE snapshot */
+  bool nes_get_snapshot(memory_region_e region, std::vector<uint8_t> &bytes,
+                        uint64_t &generation, uint16_t &pc,
+                        std::array<uint16_t, DISASM_N_SEGMENTS> &banks);
   
 signals:
   void nes_error(NESError e);
   void nes_done(void);
   void nes_paused(void);
+  void nes_breakpoint(debug_hit_s hit);
+  /* a frame has been drawn, with the PPUMASK emphasis bits (0 to 7) at the
+   * end of it and the burst phase at the start, see ntsc_filter */
+  void nes_frame_drawn(int emphasis, int burst_phase);
 
 private:
-  QTimer *nes_timer;
+  struct command {
+    enum type_e {
+      START,
+      PAUSE,
+      STEP,
+      RESET,
+      SET_TURBO,
+      SET_FRAME_SKIP,
+      SNAPSHOT,
+      SET_BREAKPOINTS,
+      QUIT
+    };
+    type_e type;
+    int arg;
+  };
+
+  void send(command::type_e type, int arg = 0);
+  void run(void);
+  bool handle(const command &c);
+  void tick(void);
+  void power_on(void);
+  void apply_thread_options(void);
+  void capture_last_frame(void);
+  void take_snapshots(void);
+  void set_breakpoints(void);
+  void stop_at_breakpoint(void);
+
+  /* only touched by the emulation thread once it has started */
+  std::string rom_filename;
+  void (*put_pixel)(int, int, uint8_t, void *);
+  void *put_pixel_data;
+  NESThreadOptions thread_options;
+  /* told when a frame starts, if not null */
+  InputLatency *latency;
+  uint32_t last_frame;
+  bool last_frame_drawn;
+  uint8_t last_frame_burst_phase;
+  bool running;
+  bool turbo;
   cpu_s cpu;
   ppu_s ppu;
 
-private slots:
-  void nes_tick(void);
+  /* set from the gui thread, in_capture is true while the emulation
+   * thread might be using recording */
+  std::atomic<capture_s *> recording;
+  std::atomic<const uint8_t *> recording_frame;
+  std::atomic<bool> in_capture;
+
+  /* generation counts the snapshots taken, 0 means none yet. the
+   * emulation thread only try_locks, skipping a snapshot rather than
+   * waiting for a reader */
+  struct memory_snapshot_s {
+    std::atomic<int> watchers{0};
+    std::mutex lock;
+    std::vector<uint8_t> bytes;
+    uint64_t generation = 0;
+    uint16_t pc = 0;
+    std::array<uint16_t, DISASM_N_SEGMENTS> banks{};
+  };
+  std::array<memory_snapshot_s, MEMORY_REGION_COUNT> snapshots;
+
+  /* for nes_set_breakpoints, the emulation thread takes them from here */
+  std::mutex breakpoints_lock;
+  std::vector<debug_breakpoint_s> breakpoints;
+
+  command_queue<command, 64> commands;
+  /* for nes_pause_wait, counts PAUSE commands sent and handled */
+  uint64_t pauses_sent;
+  uint64_t pauses_done;
+  std::mutex pause_lock;
+  std::condition_variable paused;
+
+  /* only for sleeping while paused, the queue itself doesn't lock */
+  std::mutex wake_lock;
+  std::condition_variable wake;
+  std::thread thread;
 };
 
 #endif
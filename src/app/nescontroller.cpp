@@ -8,67 +8,84 @@ extern "C" {
 uint8_t get_pressed_buttons(void *controller) {
   static NESController *nes_controller =
       static_cast<NESController *>(controller);
-  return nes_controller->buttons_pressed;
+  uint64_t input = nes_controller->input.load(std::memory_order_acquire);
+  if (input && nes_controller->latency != nullptr) {
+    nes_controller->latency->latched(input >> 8);
+  }
+  return input & 0xFF;
+}
+
+void NESController::set_buttons(uint8_t buttons) {
+  /* only this thread writes input, so no need for a compare and swap */
+  uint64_t old = input.load(std::memory_order_relaxed);
+  if ((old & 0xFF) != buttons) {
+    input.store((input_latency_now() << 8) | buttons,
+                std::memory_order_release);
+  }
 }
 
 void NESController::nes_button_pressed(int key) {
+  uint8_t buttons = input.load(std::memory_order_relaxed) & 0xFF;
   switch (key) {
   case Qt::Key_W:
-    buttons_pressed |= CTRLR_BUTTON_UP;
+    buttons |= CTRLR_BUTTON_UP;
     break;
   case Qt::Key_A:
-    buttons_pressed |= CTRLR_BUTTON_LEFT;
+    buttons |= CTRLR_BUTTON_LEFT;
     break;
   case Qt::Key_S:
-    buttons_pressed |= CTRLR_BUTTON_DOWN;
+    buttons |= CTRLR_BUTTON_DOWN;
     break;
   case Qt::Key_D:
-    buttons_pressed |= CTRLR_BUTTON_RIGHT;
+    buttons |= CTRLR_BUTTON_RIGHT;
     break;
   case Qt::Key_M:
-    buttons_pressed |= CTRLR_BUTTON_A;
+    buttons |= CTRLR_BUTTON_A;
     break;
   case Qt::Key_Comma:
-    buttons_pressed |= CTRLR_BUTTON_B;
+    buttons |= CTRLR_BUTTON_B;
     break;
   case Qt::Key_Period: // Like fullstop??
-    buttons_pressed |= CTRLR_BUTTON_SELECT;
+    buttons |= CTRLR_BUTTON_SELECT;
     break;
   case Qt::Key_Slash:
-    buttons_pressed |= CTRLR_BUTTON_START;
+    buttons |= CTRLR_BUTTON_START;
     break;
   default:
     break;
   }
+  set_buttons(buttons);
 }
 
 void NESController::nes_button_released(int key) {
+  uint8_t buttons = input.load(std::memory_order_relaxed) & 0xFF;
   switch (key) {
   case Qt::Key_W:
-    buttons_pressed &= ~CTRLR_BUTTON_UP;
+    buttons &= ~CTRLR_BUTTON_UP;
     break;
   case Qt::Key_A:
-    buttons_pressed &= ~CTRLR_BUTTON_LEFT;
+    buttons &= ~CTRLR_BUTTON_LEFT;
     break;
   case Qt::Key_S:
-    buttons_pressed &= ~CTRLR_BUTTON_DOWN;
+    buttons &= ~CTRLR_BUTTON_DOWN;
     break;
   case Qt::Key_D:
-    buttons_pressed &= ~CTRLR_BUTTON_RIGHT;
+    buttons &= ~CTRLR_BUTTON_RIGHT;
     break;
   case Qt::Key_M:
-    buttons_pressed &= ~CTRLR_BUTTON_A;
+    buttons &= ~CTRLR_BUTTON_A;
     break;
   case Qt::Key_Comma:
-    buttons_pressed &= ~CTRLR_BUTTON_B;
+    buttons &= ~CTRLR_BUTTON_B;
     break;
   case Qt::Key_Period: // Like fullstop??
-    buttons_pressed &= ~CTRLR_BUTTON_SELECT;
+    buttons &= ~CTRLR_BUTTON_SELECT;
     break;
   case Qt::Key_Slash:
-    buttons_pressed &= ~CTRLR_BUTTON_START;
+    buttons &= ~CTRLR_BUTTON_START;
     break;
   default:
     break;
-  } 
+  }
+  set_buttons(buttons);
 }
@@ -3,14 +3,22 @@
 
 #include <QObject>
 
+#include <atomic>
+
+#include "inputlatency.h"
+
 extern "C" uint8_t get_pressed_buttons(void *controller);
 
+/* The gui thread calls nes_button_pressed/released straight from the key
+ * events, and the emulation thread reads the buttons on a $4016 strobe,
+ * with nothing queued in between. */
 class NESController : public QObject {
 
   Q_OBJECT
 
 public:
-  explicit NESController(QObject *parent = nullptr) : QObject(parent), buttons_pressed(0) {}
+  explicit NESController(InputLatency *latency, QObject *parent = nullptr)
+      : QObject(parent), input(0), latency(latency) {}
   ~NESController() {}
   friend uint8_t get_pressed_buttons(void *controller);
   
@@ -19,7 +27,13 @@ public slots:
   void nes_button_released(int key);
 
 private:
-  uint8_t buttons_pressed;
+  void set_buttons(uint8_t buttons);
+
+  /* the buttons pressed in the low 8 bits, and the input_latency_now()
+   * time they last changed in the rest, so the reader gets both at once.
+   * written on the gui thread, read on the emulation thread */
+  std::atomic<uint64_t> input;
+  InputLatency *latency;
 };
 
 #endif
@@ -6,7 +6,8 @@
 
 const auto nes_screen_width = 256;
 const auto nes_screen_height =  240;
-const auto nes_screen_size =  nes_screen_width * nes_screen_height * 3;
+/* one palette index per pixel, the colours are looked up when it is drawn */
+const auto nes_screen_size =  nes_screen_width * nes_screen_height;
 
 const auto pattern_table_width = 128;
 const auto pattern_table_height = 128;
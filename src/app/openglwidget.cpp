@@ -3,8 +3,26 @@
 #include <QTimer>
 #include <QtDebug>
 
+#include <algorithm>
+#include <thread>
+
 #include "openglwidget.h"
 
+extern "C" {
+#include "core/palette.h"
+}
+
+static const char *vertex_shader =
+    "#version 330\n"
+    "layout (location = 0) in vec3 vPos;\n"
+    "layout (location = 1) in vec2 vTex;\n"
+    "out vec2 texCoords;\n"
+    "void main(void)\n"
+    "{\n"
+    "    gl_Position = vec4(vPos, 1.0);\n"
+    "    texCoords = vTex;\n"
+    "}";
+
 /* vec3 vertex co-ordinates then vec2 texture co-ordinates */
 static const GLfloat vertices[] = {
     -1.0f, -1.0f,  0.0f,  0.0f,  0.0f,
@@ -15,7 +33,20 @@ static const GLfloat vertices[] = {
   
 OpenGLWidget::OpenGLWidget(QWidget *parent) : QOpenGLWidget(parent) {
   program = new QOpenGLShaderProgram(this);
+  ntsc_program = new QOpenGLShaderProgram(this);
   pbuf_ptr = nullptr;
+  input_latency = nullptr;
+  frame_emphasis = 0;
+  frame_burst_phase = 0;
+  screen_texture = 0;
+  palette_texture = 0;
+  ntsc = nullptr;
+  ntsc_texture = 0;
+  connect(this, &QOpenGLWidget::frameSwapped, this, [this]() {
+    if (input_latency != nullptr) {
+      input_latency->frame_presented();
+    }
+  });
 }
 
 OpenGLWidget::~OpenGLWidget() {
@@ -26,10 +57,15 @@ OpenGLWidget::~OpenGLWidget() {
   if (program != nullptr) {
     program->removeAllShaders();
   }
+  ntsc_program->removeAllShaders();
   vao.destroy();
   vbo.destroy();
+  glDeleteTextures(1, &screen_texture);
+  glDeleteTextures(1, &palette_texture);
+  glDeleteTextures(1, &ntsc_texture);
   
   doneCurrent();
+  ntsc_destroy(ntsc);
 }
 
 void OpenGLWidget::initScreen(NESScreen *s) {
@@ -41,37 +77,79 @@ void OpenGLWidget::initScreen(NESScreen *s) {
   // connect(s, SIGNAL(pbuf_full()), this, SLOT(update()));
 }
 
+void OpenGLWidget::setInputLatency(InputLatency *latency) {
+  input_latency = latency;
+}
+
+void OpenGLWidget::setFrameInfo(int emphasis, int burst_phase) {
+  frame_emphasis = emphasis & (palette_emphasis_rows - 1);
+  frame_burst_phase = burst_phase % 3;
+}
+
+void OpenGLWidget::setNTSC(bool on) {
+  if (on && ntsc == nullptr) {
+    int n_threads = std::clamp((int)std::thread::hardware_concurrency(), 1, 4);
+    nes_ntsc_create(&ntsc, NTSC_DEFAULT_OUT_PER_3, n_threads);
+    ntsc_frame.resize((size_t)ntsc_out_width(ntsc) * nes_screen_height);
+  } else if (!on && ntsc != nullptr) {
+    ntsc_destroy(ntsc);
+    ntsc = nullptr;
+  }
+}
+
 void OpenGLWidget::resizeGL(int w, int h) {}
 
 void OpenGLWidget::initializeGL() {
   initializeOpenGLFunctions();
 
   if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex,
-                                        "#version 330\n"
-                                        "layout (location = 0) in vec3 vPos;\n"
-                                        "layout (location = 1) in vec2 vTex;\n"
-                                        "out vec2 texCoords;\n"
-                                        "void main(void)\n"
-                                        "{\n"
-                                        "    gl_Position = vec4(vPos, 1.0);\n"
-                                        "    texCoords = vTex;\n"
-                                        "}")) {
+                                        vertex_shader)) {
     qDebug() << program->log();
   }
 
+  /* the screen is palette indices, top row first, and palette has the
+   * colour of each index in x and the colour emphasis bits in y */
   if (!program->addShaderFromSourceCode(QOpenGLShader::Fragment,
                                         "#version 330\n"
                                         "in vec2 texCoords;\n"
                                         "out vec4 color;\n"
-                                        "uniform sampler2D tex;\n"
+                                        "uniform usampler2D screen;\n"
+                                        "uniform sampler2D palette;\n"
+                                        "uniform int emphasis;\n"
                                         "void main(void)\n"
                                         "{\n"
-                                        "    color = texture(tex, texCoords);\n"
+                                        "    ivec2 size = textureSize(screen, 0);\n"
+                                        "    ivec2 p = ivec2(texCoords.x * size.x,\n"
+                                        "                    (1.0 - texCoords.y) * size.y);\n"
+                                        "    p = clamp(p, ivec2(0), size - 1);\n"
+                                        "    uint idx = texelFetch(screen, p, 0).r;\n"
+                                        "    color = texelFetch(palette,\n"
+                                        "        ivec2(int(idx & 63u), emphasis), 0);\n"
                                         "}")) {
     qDebug() << program->log();
   }
 
   program->link();
+
+  /* the filter's output is RGBA, top row first */
+  if (!ntsc_program->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                             vertex_shader) ||
+      !ntsc_program->addShaderFromSourceCode(
+          QOpenGLShader::Fragment,
+          "#version 330\n"
+          "in vec2 texCoords;\n"
+          "out vec4 color;\n"
+          "uniform sampler2D frame;\n"
+          "void main(void)\n"
+          "{\n"
+          "    color = texture(frame, vec2(texCoords.x, 1.0 - texCoords.y));\n"
+          "}")) {
+    qDebug() << ntsc_program->log();
+  }
+  ntsc_program->link();
+  ntsc_program->bind();
+  ntsc_program->setUniformValue("frame", 2);
+
   program->bind();
   
   vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
@@ -92,6 +170,60 @@ void OpenGLWidget::initializeGL() {
   glEnableVertexAttribArray(1);
   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat),
                         (void *)(3 * sizeof(GLfloat)));
+
+  init_textures();
+}
+
+/* An 8 bit unsigned integer texture for the screen, which paintGL fills in
+ * from pbuf each time, and the palette as an RGB texture with a row for
+ * each combination of emphasis bits, where the colours that aren't
+ * emphasised are darkened. Integer textures can't be filtered, so both
+ * are GL_NEAREST without mipmaps. */
+void OpenGLWidget::init_textures() {
+  /* bit 0 of the row emphasises red, 1 green and 2 blue */
+  static const float dim = 0.816328f;
+  uint8_t palette[palette_emphasis_rows][PALETTE_SIZE][3];
+  for (int e = 0; e < palette_emphasis_rows; e++) {
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+      for (int c = 0; c < 3; c++) {
+        float val = nes_palette[i * 3 + c];
+        if (e != 0 && !(e & (1 << c))) {
+          val *= dim;
+        }
+        palette[e][i][c] = (uint8_t)val;
+      }
+    }
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  glGenTextures(1, &palette_texture);
+  glBindTexture(GL_TEXTURE_2D, palette_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, PALETTE_SIZE, palette_emphasis_rows,
+               0, GL_RGB, GL_UNSIGNED_BYTE, palette);
+
+  glGenTextures(1, &screen_texture);
+  glBindTexture(GL_TEXTURE_2D, screen_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, nes_screen_width, nes_screen_height,
+               0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+
+  /* the NTSC filter's output is smooth enough to be scaled linearly */
+  glGenTextures(1, &ntsc_texture);
+  glBindTexture(GL_TEXTURE_2D, ntsc_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, NTSC_DEFAULT_OUT_WIDTH,
+               nes_screen_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  program->setUniformValue("screen", 0);
+  program->setUniformValue("palette", 1);
 }
 
 
@@ -99,26 +231,53 @@ void OpenGLWidget::paintGL() {
 
   glViewport(0, 0, width(), height());
   glClear(GL_COLOR_BUFFER_BIT);
+  if (input_latency != nullptr) {
+    input_latency->frame_painted();
+  }
  
-  GLuint texture_id;
-  glGenTextures(1, &texture_id);
+  if (pbuf_ptr == nullptr) {
+    return;
+  }
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture_id);
-  program->setUniformValue("tex", 0);
-  
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  if (ntsc != nullptr) {
+    paint_ntsc();
+    return;
+  }
 
+  program->bind();
+  program->setUniformValue("emphasis", frame_emphasis);
+  QOpenGLVertexArrayObject::Binder vao_binder(&vao);
+
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, palette_texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, screen_texture);
   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, nes_screen_width, nes_screen_height,
-  0, GL_RGB, GL_UNSIGNED_BYTE, pbuf_ptr->data());
-  glEnable(GL_TEXTURE_2D);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, nes_screen_width, nes_screen_height,
+                  GL_RED_INTEGER, GL_UNSIGNED_BYTE, pbuf_ptr->data());
+
   glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-  glDisable(GL_TEXTURE_2D);
   glBindTexture(GL_TEXTURE_2D, 0);
 }
+
+/* with the emphasis and burst phase of the last frame NESContext drew, so
+ * the dot crawl follows the ppu even when a frame isn't painted */
+void OpenGLWidget::paint_ntsc() {
+  ntsc_filter(ntsc, pbuf_ptr->data(), nes_screen_width, nes_screen_height,
+              frame_emphasis, frame_burst_phase, ntsc_frame.data(),
+              NTSC_DEFAULT_OUT_WIDTH);
+
+  ntsc_program->bind();
+  QOpenGLVertexArrayObject::Binder vao_binder(&vao);
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, ntsc_texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NTSC_DEFAULT_OUT_WIDTH,
+                  nes_screen_height, GL_RGBA, GL_UNSIGNED_BYTE,
+                  ntsc_frame.data());
+
+  glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -2,6 +2,7 @@
 #define OPENGLWIDGET_H_
 
 #include <array>
+#include <vector>
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
@@ -10,6 +11,8 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLShaderProgram>
 
+#include "core/cppwrapper.hpp"
+#include "inputlatency.h"
 #include "nesscreen.h"
 
 
@@ -24,17 +27,46 @@ public:
 
   /* connect pbuf_full signal to update slot, and set pbuf_ptr to pbuf in s */
   void initScreen(NESScreen *s);
-  
+  /* tell latency when a frame is painted and swapped, nullptr to stop */
+  void setInputLatency(InputLatency *latency);
+  /* draw through the NTSC filter (see core/ntsc.h) or not, throws NESError
+   * if the filter can't be made */
+  void setNTSC(bool on);
+
+public slots:
+  /* PPUMASK emphasis bits and burst phase of the frame in pbuf, see
+   * NESContext::nes_frame_drawn */
+  void setFrameInfo(int emphasis, int burst_phase);
+
 protected:
   void initializeGL() override;
   void paintGL() override;
   void resizeGL(int w, int h) override;
 
 private:
+  /* rows in the palette texture, one for each combination of the PPUMASK
+   * emphasis bits */
+  static const int palette_emphasis_rows = 8;
+
+  void init_textures();
+  void paint_ntsc();
+
   std::array<uint8_t, nes_screen_size> *pbuf_ptr;
   QOpenGLVertexArrayObject vao;
   QOpenGLBuffer vbo;
   QOpenGLShaderProgram *program;
+  GLuint screen_texture;
+  GLuint palette_texture;
+  InputLatency *input_latency;
+  int frame_emphasis;
+  uint8_t frame_burst_phase;
+
+  /* the NTSC filter's output is drawn as an RGBA texture by its own
+   * shader. ntsc is null when the filter is off */
+  ntsc_s *ntsc;
+  std::vector<uint32_t> ntsc_frame;
+  QOpenGLShaderProgram *ntsc_program;
+  GLuint ntsc_texture;
 };
 
 #endif
@@ -0,0 +1,634 @@
+/* headless driver: runs a rom without a display, for dumping frames and
+ * benchmarking */
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/cppwrapper.hpp"
+
+const auto screen_width = 256;
+const auto screen_height = 240;
+
+/* everything the callbacks need to get at */
+struct cli_state {
+  std::array<uint8_t, screen_width * screen_height> frame;
+  uint64_t instructions;
+  uint64_t cycles;
+  uint16_t last_cycles;
+};
+
+struct cli_options {
+  const char *rom_filename = nullptr;
+  uint64_t frames = 60;
+  uint64_t cycles = 0; /* run for this many cycles instead of frames if set */
+  const char *ppm_prefix = nullptr;
+  const char *raw_filename = nullptr;
+  int frame_skip = 0;
+  bool bench = false;
+  int runs = 10;
+  bool idle_skip = false;
+  const char *record_filename = nullptr;
+  const char *play_filename = nullptr;
+  bool profile = false;
+  bool pipeline = false;
+  bool ntsc = false;
+  bool scale = false;
+  scale_filter_e scale_filter = SCALE_NEAREST;
+  int scale_factor = 1;
+  const char *capture_filename = nullptr;
+  const char *cdl_filename = nullptr;
+};
+
+struct run_result {
+  uint64_t instructions;
+  uint64_t cycles;
+  uint64_t frames;
+  uint64_t idle_cycles;
+  double seconds;
+};
+
+static void log_none(const char *, ...) {}
+static void ppu_state_none(const ppu_state_s *, void *) {}
+static void memory_none(uint16_t, uint8_t, void *) {}
+static uint8_t buttons_none(void *) { return 0; }
+
+static void put_pixel(int i, int j, uint8_t palette_idx, void *data) {
+  cli_state *state = static_cast<cli_state *>(data);
+  state->frame[screen_width * i + j] = palette_idx % PALETTE_SIZE;
+}
+
+/* cpu state callback is called once per instruction (apart from skipped
+ * idle loops, see cpu_get_idle_instructions()), so count instructions and
+ * cycles here. cycles in cpu_state_s is 16 bit so accumulate the difference
+ * to avoid it wrapping. the state is from before the instruction, so the
+ * cycles of the last one are added after the run. */
+static void count_instruction(const cpu_state_s *cpu_state, void *data) {
+  cli_state *state = static_cast<cli_state *>(data);
+  state->instructions++;
+  state->cycles += (uint16_t)(cpu_state->cycles - state->last_cycles);
+  state->last_cycles = cpu_state->cycles;
+}
+
+static void usage(const char *argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " [options] rom.nes\n"
+      << "  -f, --frames N      run for N frames (default 60)\n"
+      << "  -c, --cycles N      run for N cpu cycles instead of frames\n"
+      << "  -p, --ppm PREFIX    write each frame to PREFIX_NNNNNN.ppm\n"
+      << "  -r, --raw FILE      write each frame's palette indices to FILE,\n"
+      << "                      256x240 bytes per frame\n"
+      << "  -s, --frame-skip N  only draw every Nth frame\n"
+      << "  -b, --bench         report instructions/s, cycles/s, frames/s\n"
+      << "  -n, --runs N        number of runs for --bench (default 10)\n"
+      << "  -i, --idle-skip     skip idle loops, see cpu_set_idle_skip\n"
+      << "  -R, --record FILE   record controller input to movie FILE\n"
+      << "  -P, --play FILE     play back controller input from movie FILE\n"
+      << "  -l, --pipeline      draw each frame on a second thread while the\n"
+      << "                      cpu runs the next one\n"
+      << "  -N, --ntsc          write --ppm frames through the NTSC filter\n"
+      << "  -S, --scale FILTER  write --ppm frames scaled by FILTER, one of\n"
+      << "                      nearest2 to nearest10, scale2x, scale3x,\n"
+      << "                      hq2x, hq3x, xbr2x, xbr3x, xbr4x\n"
+      << "  -C, --capture FILE  record the frames drawn to FILE in the background,\n"
+      << "                      as YUV4MPEG2 if it ends in .y4m, otherwise\n"
+      << "                      as delta compressed palette indices\n"
+      << "  -L, --cdl FILE      log the prg and chr rom used as code and data to\n"
+      << "                      FILE, adding to it if it exists, and decode\n"
+      << "                      the code in it up front\n"
+      << "  -t, --profile       report time spent in each part of the core,\n"
+      << "                      needs a build with NES_PROFILE\n"
+      << "  -h, --help          show this message\n";
+}
+
+/* --scale FILTER names other than nearestN */
+static const struct {
+  const char *name;
+  scale_filter_e filter;
+  int factor;
+} scale_names[] = {{"scale2x", SCALE_SCALEX, 2}, {"scale3x", SCALE_SCALEX, 3},
+                   {"hq2x", SCALE_HQX, 2},       {"hq3x", SCALE_HQX, 3},
+                   {"xbr2x", SCALE_XBR, 2},      {"xbr3x", SCALE_XBR, 3},
+                   {"xbr4x", SCALE_XBR, 4}};
+
+static bool parse_scale(const char *name, cli_options &opts) {
+  opts.scale = true;
+  if (std::strncmp(name, "nearest", 7) == 0) {
+    opts.scale_filter = SCALE_NEAREST;
+    opts.scale_factor = std::atoi(name + 7);
+    return opts.scale_factor >= 1 && opts.scale_factor <= SCALE_MAX_FACTOR;
+  }
+  for (const auto &s : scale_names) {
+    if (std::strcmp(name, s.name) == 0) {
+      opts.scale_filter = s.filter;
+      opts.scale_factor = s.factor;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* whole number from 0 to max, with nothing after it */
+static bool parse_number(const char *s, uint64_t max, uint64_t &val) {
+  if (!std::isdigit((unsigned char)s[0])) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  unsigned long long n = std::strtoull(s, &end, 10);
+  if (*end != '\0' || errno == ERANGE || n > max) {
+    return false;
+  }
+  val = n;
+  return true;
+}
+
+static bool parse_args(int argc, char **argv, cli_options &opts) {
+  static const struct option long_options[] = {
+      {"frames", required_argument, nullptr, 'f'},
+      {"cycles", required_argument, nullptr, 'c'},
+      {"ppm", required_argument, nullptr, 'p'},
+      {"raw", required_argument, nullptr, 'r'},
+      {"frame-skip", required_argument, nullptr, 's'},
+      {"bench", no_argument, nullptr, 'b'},
+      {"runs", required_argument, nullptr, 'n'},
+      {"idle-skip", no_argument, nullptr, 'i'},
+      {"record", required_argument, nullptr, 'R'},
+      {"play", required_argument, nullptr, 'P'},
+      {"profile", no_argument, nullptr, 't'},
+      {"pipeline", no_argument, nullptr, 'l'},
+      {"ntsc", no_argument, nullptr, 'N'},
+      {"scale", required_argument, nullptr, 'S'},
+      {"capture", required_argument, nullptr, 'C'},
+      {"cdl", required_argument, nullptr, 'L'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+
+  int c;
+  uint64_t n;
+  while ((c = getopt_long(argc, argv, "f:c:p:r:s:bn:iR:P:tlNS:C:L:h", long_options,
+                          nullptr)) != -1) {
+    switch (c) {
+    case 'f':
+      /* nes_run_frames takes a uint32_t */
+      if (!parse_number(optarg, UINT32_MAX, opts.frames)) {
+        std::cerr << "Invalid frame count " << optarg << "\n";
+        return false;
+      }
+      break;
+    case 'c':
+      if (!parse_number(optarg, UINT64_MAX, opts.cycles)) {
+        std::cerr << "Invalid cycle count " << optarg << "\n";
+        return false;
+      }
+      break;
+    case 'p':
+      opts.ppm_prefix = optarg;
+      break;
+    case 'r':
+      opts.raw_filename = optarg;
+      break;
+    case 's':
+      /* ppu_set_frame_skip takes a uint8_t */
+      if (!parse_number(optarg, UINT8_MAX, n)) {
+        std::cerr << "Invalid frame skip " << optarg << "\n";
+        return false;
+      }
+      opts.frame_skip = (int)n;
+      break;
+    case 'b':
+      opts.bench = true;
+      break;
+    case 'n':
+      if (!parse_number(optarg, INT_MAX, n)) {
+        std::cerr << "Invalid number of runs " << optarg << "\n";
+        return false;
+      }
+      opts.runs = std::max(1, (int)n);
+      break;
+    case 'i':
+      opts.idle_skip = true;
+      break;
+    case 'R':
+      opts.record_filename = optarg;
+      break;
+    case 'P':
+      opts.play_filename = optarg;
+      break;
+    case 't':
+      opts.profile = true;
+      break;
+    case 'l':
+      opts.pipeline = true;
+      break;
+    case 'N':
+      opts.ntsc = true;
+      break;
+    case 'S':
+      if (!parse_scale(optarg, opts)) {
+        std::cerr << "Unknown scale filter " << optarg << "\n";
+        return false;
+      }
+      break;
+    case 'C':
+      opts.capture_filename = optarg;
+      break;
+    case 'L':
+      opts.cdl_filename = optarg;
+      break;
+    default:
+      return false;
+    }
+  }
+  if (optind != argc - 1 || (opts.record_filename && opts.play_filename) ||
+      (opts.ntsc && opts.scale)) {
+    return false;
+  }
+  /* --cycles stops part way through a frame, so there is nothing to dump */
+  if (opts.cycles && (opts.ppm_prefix || opts.raw_filename ||
+                      opts.capture_filename)) {
+    std::cerr << "--cycles can't be used with --ppm, --raw or --capture\n";
+    return false;
+  }
+  opts.rom_filename = argv[optind];
+  return true;
+}
+
+static bool write_ppm(const std::string &filename, int width, int height,
+                      const std::vector<uint8_t> &rgb) {
+  FILE *fp;
+  if ((fp = std::fopen(filename.c_str(), "wb")) == nullptr) {
+    return false;
+  }
+  std::fprintf(fp, "P6\n%d %d\n255\n", width, height);
+  bool ok = std::fwrite(rgb.data(), 1, rgb.size(), fp) == rgb.size();
+  return (std::fclose(fp) == 0) && ok;
+}
+
+/* frame as RGB, through ntsc or scale if one isn't null */
+static std::vector<uint8_t>
+frame_rgb(const std::array<uint8_t, screen_width * screen_height> &frame,
+          ntsc_s *ntsc, scale_s *scale, uint8_t emphasis, uint8_t burst_phase,
+          int &width, int &height) {
+  std::vector<uint8_t> rgb;
+  if (ntsc == nullptr && scale == nullptr) {
+    width = screen_width;
+    height = screen_height;
+    rgb.resize(frame.size() * 3);
+    for (size_t i = 0; i < frame.size(); i++) {
+      std::memcpy(&rgb[3 * i], &nes_palette[3 * frame[i]], 3);
+    }
+    return rgb;
+  }
+  std::vector<uint32_t> rgba;
+  if (ntsc != nullptr) {
+    width = ntsc_out_width(ntsc);
+    height = screen_height;
+    rgba.resize(width * height);
+    ntsc_filter(ntsc, frame.data(), screen_width, screen_height, emphasis,
+                burst_phase, rgba.data(), width);
+  } else {
+    width = screen_width * scale_factor(scale);
+    height = screen_height * scale_factor(scale);
+    rgba.resize(width * height);
+    scale_frame(scale, frame.data(), screen_width, screen_height, rgba.data(),
+                width);
+  }
+  rgb.resize(rgba.size() * 3);
+  for (size_t i = 0; i < rgba.size(); i++) {
+    std::memcpy(&rgb[3 * i], &rgba[i], 3); /* R, G, B, A in memory */
+  }
+  return rgb;
+}
+
+static capture_format_e capture_format(const char *filename) {
+  size_t len = std::strlen(filename);
+  return (len >= 4 && std::strcmp(filename + len - 4, ".y4m") == 0)
+             ? CAPTURE_Y4M
+             : CAPTURE_DELTA;
+}
+
+/* for leaving early, the capture's errors don't matter then */
+static void abandon_capture(capture_s *capture) {
+  char e_context[LEN_E_CONTEXT];
+  capture_stop(capture, nullptr, e_context);
+}
+
+/* do one run of the rom from power on, dumping frames if asked */
+static run_result run(const cli_options &opts, cli_state &state, FILE *raw_fp) {
+  ppu_s ppu;
+  cpu_s cpu;
+  std::memset(&ppu, 0, sizeof(ppu));
+  state.frame.fill(0);
+  state.instructions = 0;
+  state.cycles = 0;
+
+  nes_ppu_init_no_alloc(&ppu, &put_pixel, &state);
+  ppu_set_frame_skip(&ppu, opts.frame_skip);
+  nes_memory_init(opts.rom_filename, &ppu);
+  if (opts.play_filename != nullptr) {
+    nes_movie_play_start(opts.play_filename, opts.rom_filename);
+  } else if (opts.record_filename != nullptr) {
+    nes_movie_record_start(opts.rom_filename);
+  }
+  if (opts.cdl_filename != nullptr) {
+    nes_cdl_start();
+    nes_cdl_read(opts.cdl_filename);
+  }
+  nes_cpu_init_no_alloc(&cpu, 0);
+  if (opts.cdl_filename != nullptr) {
+    cpu_decode_warmup();
+  }
+  state.last_cycles = 0;
+  if (opts.pipeline) {
+    nes_ppu_pipeline_start(&ppu);
+  }
+
+  bool dumping = (opts.ppm_prefix != nullptr) || (raw_fp != nullptr) ||
+                 (opts.capture_filename != nullptr);
+  int filter_threads =
+      std::clamp((int)std::thread::hardware_concurrency(), 1, 4);
+  std::unique_ptr<ntsc_s, void (*)(ntsc_s *)> ntsc(nullptr, &ntsc_destroy);
+  if (opts.ntsc && opts.ppm_prefix != nullptr) {
+    ntsc_s *n;
+    nes_ntsc_create(&n, NTSC_DEFAULT_OUT_PER_3, filter_threads);
+    ntsc.reset(n);
+  }
+  std::unique_ptr<scale_s, void (*)(scale_s *)> scale(nullptr, &scale_destroy);
+  if (opts.scale && opts.ppm_prefix != nullptr) {
+    scale_s *s;
+    nes_scale_create(&s, opts.scale_filter, opts.scale_factor, filter_threads);
+    scale.reset(s);
+  }
+  std::unique_ptr<capture_s, void (*)(capture_s *)> capture(nullptr,
+                                                            &abandon_capture);
+  if (opts.capture_filename != nullptr) {
+    capture_s *c;
+    nes_capture_start(&c, opts.capture_filename,
+                      capture_format(opts.capture_filename),
+                      CAPTURE_DEFAULT_QUEUE, nullptr, 0);
+    capture.reset(c);
+  }
+  auto start = std::chrono::steady_clock::now();
+  if (opts.cycles) {
+    while (state.cycles < opts.cycles) {
+      nes_cpu_exec(&cpu);
+    }
+  } else if (!dumping) {
+    nes_run_frames(&cpu, &ppu, opts.frames);
+  } else {
+    for (uint64_t i = 0; i < opts.frames; i++) {
+      bool skipped = ppu.skip_render; /* nothing drawn this frame */
+      uint8_t burst_phase = ppu_get_burst_phase(&ppu);
+      nes_run_frames(&cpu, &ppu, 1);
+      ppu_pipeline_sync(&ppu); /* wait for the frame to be drawn */
+      if (skipped) {
+        continue;
+      }
+      if (opts.ppm_prefix != nullptr) {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "_%06llu.ppm",
+                      (unsigned long long)i);
+        int width, height;
+        std::vector<uint8_t> rgb =
+            frame_rgb(state.frame, ntsc.get(), scale.get(), ppu.ppumask >> 5,
+                      burst_phase, width, height);
+        if (!write_ppm(std::string(opts.ppm_prefix) + suffix, width, height,
+                       rgb)) {
+          throw NESError(E_WRITE_FILE, std::string(opts.ppm_prefix) + suffix);
+        }
+      }
+      if (raw_fp != nullptr &&
+          std::fwrite(state.frame.data(), 1, state.frame.size(), raw_fp) !=
+              state.frame.size()) {
+        throw NESError(E_WRITE_FILE, opts.raw_filename);
+      }
+      if (capture != nullptr) {
+        capture_frame(capture.get(), state.frame.data(), ppu.ppumask >> 5);
+      }
+    }
+  }
+  ppu_pipeline_stop(&ppu); /* finish drawing the last frame */
+  auto end = std::chrono::steady_clock::now();
+
+  if (opts.cdl_filename != nullptr) {
+    nes_cdl_write(opts.cdl_filename);
+  }
+
+  if (capture != nullptr) {
+    capture_stats_s stats;
+    nes_capture_stop(capture.release(), &stats);
+    std::printf("capture: %llu frames written, %llu dropped, %llu bytes\n",
+                (unsigned long long)stats.frames_written,
+                (unsigned long long)stats.frames_dropped,
+                (unsigned long long)stats.bytes_written);
+  }
+
+  if (opts.record_filename != nullptr) {
+    nes_movie_record_stop(opts.record_filename);
+  }
+  movie_play_stop();
+
+  run_result result;
+  result.instructions = state.instructions + cpu_get_idle_instructions();
+  result.cycles =
+      state.cycles + (uint16_t)(cpu.cycles - state.last_cycles);
+  result.frames = ppu_get_frame_count(&ppu);
+  result.idle_cycles = cpu_get_idle_cycles();
+  result.seconds = std::chrono::duration<double>(end - start).count();
+  return result;
+}
+
+/* nearest rank percentile of sorted values */
+static double percentile(const std::vector<double> &sorted, double p) {
+  size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted.at(rank);
+}
+
+static void print_rates(const char *name, std::vector<double> rates) {
+  std::sort(rates.begin(), rates.end());
+  std::printf("%-10s %14.0f %14.0f %14.0f %14.0f %14.0f\n", name, rates.front(),
+              percentile(rates, 50), percentile(rates, 90),
+              percentile(rates, 99), rates.back());
+}
+
+/* ticks of each frame, for the spread in the profile report */
+static void profile_frame(const profile_frame_s *frame, void *data) {
+  std::vector<uint64_t> *frame_ticks = static_cast<std::vector<uint64_t> *>(data);
+  frame_ticks->push_back(frame->ticks);
+}
+
+static void report_profile(const std::vector<uint64_t> &frame_ticks) {
+  profile_frame_s total;
+  profile_get_total(&total);
+  if (total.frames == 0) {
+    std::printf("profile: no frames finished\n");
+    return;
+  }
+  const char *unit = profile_tick_unit();
+  uint64_t all = 0;
+  for (uint64_t t : frame_ticks) {
+    all += t;
+  }
+
+  std::printf("profile over %llu frames, times in %s\n",
+              (unsigned long long)total.frames, unit);
+  std::printf("%-14s %12s %16s %16s %7s %7s\n", "section", "calls", "total",
+              "self", "total%", "self%");
+  for (int i = 0; i < PROFILE_N_SECTIONS; i++) {
+    const profile_section_s &s = total.sections[i];
+    std::printf("%-14s %12llu %16llu %16llu %6.1f%% %6.1f%%\n",
+                profile_section_name((profile_section_e)i),
+                (unsigned long long)s.calls, (unsigned long long)s.ticks,
+                (unsigned long long)s.self_ticks,
+                all ? 100.0 * s.ticks / all : 0.0,
+                all ? 100.0 * s.self_ticks / all : 0.0);
+  }
+
+  std::vector<uint64_t> sorted(frame_ticks);
+  if (!sorted.empty()) {
+    std::sort(sorted.begin(), sorted.end());
+    std::printf("frame %s: min %llu, avg %llu, max %llu\n", unit,
+                (unsigned long long)sorted.front(),
+                (unsigned long long)(all / sorted.size()),
+                (unsigned long long)sorted.back());
+  }
+  if (total.have_counters) {
+    std::printf("per frame: %.0f instructions, %.0f cache misses, "
+                "%.0f branch misses\n",
+                (double)total.instructions / total.frames,
+                (double)total.cache_misses / total.frames,
+                (double)total.branch_misses / total.frames);
+  } else {
+    std::printf("hardware counters not available\n");
+  }
+}
+
+static void report_bench(const std::vector<run_result> &results) {
+  std::vector<double> ips, cps, fps;
+  for (const run_result &r : results) {
+    ips.push_back(r.instructions / r.seconds);
+    cps.push_back(r.cycles / r.seconds);
+    fps.push_back(r.frames / r.seconds);
+  }
+  std::printf("runs: %zu, instructions: %llu, cycles: %llu, frames: %llu\n",
+              results.size(), (unsigned long long)results[0].instructions,
+              (unsigned long long)results[0].cycles,
+              (unsigned long long)results[0].frames);
+  if (results[0].idle_cycles) {
+    std::printf("idle cycles skipped: %llu\n",
+                (unsigned long long)results[0].idle_cycles);
+  }
+  std::printf("%-10s %14s %14s %14s %14s %14s\n", "", "min", "p50", "p90",
+              "p99", "max");
+  print_rates("instr/s", ips);
+  print_rates("cycles/s", cps);
+  print_rates("frames/s", fps);
+}
+
+int main(int argc, char **argv) {
+  cli_options opts;
+  if (!parse_args(argc, argv, opts)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  cli_state state;
+  cpu_register_state_callback(&count_instruction, &state);
+  cpu_register_error_callback(&log_none);
+  ppu_register_state_callback(&ppu_state_none, NULL);
+  ppu_register_error_callback(&log_none);
+  memory_register_cb(&memory_none, NULL, MEMORY_CB_FETCH);
+  memory_register_cb(&memory_none, NULL, MEMORY_CB_WRITE);
+  controller_init(&buttons_none, NULL);
+  cpu_set_idle_skip(opts.idle_skip);
+
+  if (opts.profile && !profile_enabled()) {
+    std::cerr << "--profile needs the core built with -DNES_PROFILE=ON"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::vector<uint64_t> frame_ticks;
+  if (opts.profile) {
+    profile_register_frame_callback(&profile_frame, &frame_ticks);
+    profile_reset();
+  }
+
+  FILE *raw_fp = nullptr;
+  if (opts.raw_filename != nullptr &&
+      (raw_fp = std::fopen(opts.raw_filename, "wb")) == nullptr) {
+    std::cerr << NESError(E_OPEN_FILE, opts.raw_filename).what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<run_result> results;
+  try {
+    int runs = opts.bench ? opts.runs : 1;
+    for (int i = 0; i < runs; i++) {
+      /* only dump frames on the first run */
+      results.push_back(run(opts, state, (i == 0) ? raw_fp : nullptr));
+      if (i == 0) {
+        opts.ppm_prefix = nullptr;
+        opts.capture_filename = nullptr;
+      }
+    }
+  } catch (NESError &e) {
+    std::cerr << e.what() << std::endl;
+    if (raw_fp != nullptr) {
+      std::fclose(raw_fp);
+    }
+    return EXIT_FAILURE;
+  }
+
+  if (raw_fp != nullptr && std::fclose(raw_fp) != 0) {
+    std::cerr << NESError(E_WRITE_FILE, opts.raw_filename).what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (opts.bench) {
+    report_bench(results);
+  } else {
+    const run_result &r = results[0];
+    std::printf("instructions: %llu, cycles: %llu, frames: %llu, %.3fs\n",
+                (unsigned long long)r.instructions,
+                (unsigned long long)r.cycles, (unsigned long long)r.frames,
+                r.seconds);
+    if (opts.idle_skip) {
+      std::printf("idle cycles skipped: %llu\n",
+                  (unsigned long long)r.idle_cycles);
+    }
+  }
+  if (opts.profile) {
+    report_profile(frame_ticks);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bandpoolp.h"
+#include "core/errors.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct bandpool_s;
+
+typedef struct bandpool_worker_s {
+  struct bandpool_s *pool;
+  int index;
+  pthread_t thread;
+} bandpool_worker_s;
+
+struct bandpool_s {
+  bandpool_fn fn;
+  void *data;
+  int n_threads; /* started, including the caller */
+  bandpool_worker_s workers[BANDPOOL_MAX_THREADS];
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  void *job;
+  int height;
+  uint64_t generation; /* jobs started */
+  int pending;         /* workers still on the current job */
+  int quit;
+};
+
+static void *worker_thread(void *data);
+
+/*======================Public functions======================*/
+
+int bandpool_create(bandpool_s **pool, int n_threads, bandpool_fn fn,
+                    void *data) {
+  bandpool_s *p = calloc(1, sizeof(bandpool_s));
+  if (p == NULL) {
+    return -E_MALLOC;
+  }
+  p->fn = fn;
+  p->data = data;
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  p->n_threads = 1;
+  for (int i = 1; i < n_threads; i++) {
+    p->workers[i].pool = p;
+    p->workers[i].index = i;
+    if (pthread_create(&p->workers[i].thread, NULL, &worker_thread,
+                       &p->workers[i]) != 0) {
+      bandpool_destroy(p);
+      return -E_THREAD;
+    }
+    p->n_threads++;
+  }
+  *pool = p;
+  return E_NO_ERROR;
+}
+
+void bandpool_destroy(bandpool_s *pool) {
+  if (pool == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 1; i < pool->n_threads; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+  pthread_cond_destroy(&pool->cond);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
+
+void bandpool_run(bandpool_s *pool, void *job, int height) {
+  int n = pool->n_threads;
+  if (n == 1) {
+    pool->fn(pool->data, job, 0, 0, height);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->job = job;
+  pool->height = height;
+  pool->pending = n - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  pool->fn(pool->data, job, 0, 0, height / n);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending > 0) {
+    pthread_cond_wait(&pool->cond, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/*======================Workers======================*/
+
+static void *worker_thread(void *data) {
+  bandpool_worker_s *w = data;
+  bandpool_s *pool = w->pool;
+  uint64_t done = 0;
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->quit && pool->generation == done) {
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    if (pool->quit) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    done = pool->generation;
+    void *job = pool->job;
+    int height = pool->height;
+    int n = pool->n_threads;
+    pthread_mutex_unlock(&pool->lock);
+
+    pool->fn(pool->data, job, w->index, height * w->index / n,
+             height * (w->index + 1) / n);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0) {
+      pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef BANDPOOLP_H_
+#define BANDPOOLP_H_
+
+/* Threads that split the rows of a frame between them. bandpool_run calls
+ * fn on every thread with the same job, each with its own band of rows:
+ * worker i of n gets rows [height * i / n, height * (i + 1) / n). Worker 0
+ * is the thread that calls bandpool_run, and bandpool_run returns once
+ * every band is done. Used by the ntsc filter and the scalers. */
+
+#define BANDPOOL_MAX_THREADS 16
+
+typedef void (*bandpool_fn)(void *data, void *job, int worker, int first_row,
+                            int end_row);
+
+typedef struct bandpool_s bandpool_s;
+
+/* n_threads from 1 to BANDPOOL_MAX_THREADS, including the caller's. data
+ * is passed to every call of fn. returns -E_MALLOC or -E_THREAD */
+int bandpool_create(bandpool_s **pool, int n_threads, bandpool_fn fn,
+                    void *data);
+void bandpool_destroy(bandpool_s *pool);
+
+/* job has to stay valid until bandpool_run returns, only one thread can
+ * call bandpool_run on a pool at a time */
+void bandpool_run(bandpool_s *pool, void *job, int height);
+
+#endif
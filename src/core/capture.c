@@ -0,0 +1,667 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/capture.h"
+#include "core/errors.h"
+#include "core/palette.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* CAPTURE_DELTA file layout, all numbers little endian:
+ *   0  "NESV"
+ *   4  version
+ *   5  unused
+ *   8  16 bit width, 16 bit height
+ *  12  32 bit frame rate numerator, 32 bit denominator
+ *  20  then each frame:
+ *      32 bit length of the rest of the frame
+ *      32 bit frame number
+ *      emphasis
+ *      pairs of LEB128 numbers (same, changed) then changed bytes: same
+ *      bytes are as in the frame before, then changed bytes are new.
+ *      anything after the last pair is the same. the frame before the
+ *      first is all 0
+ */
+#define DELTA_MAGIC "NESV"
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 20
+#define DELTA_FRAME_HEADER_SIZE 9
+/* worst case is changed and same bytes taking turns, 3 bytes for 2 */
+#define DELTA_MAX_SIZE (DELTA_FRAME_HEADER_SIZE + CAPTURE_FRAME_SIZE * 2)
+/* equal bytes that end a changed run, any fewer are cheaper to store as
+ * changed than to start a new pair for */
+#define DELTA_MIN_SAME 4
+
+#define WAV_HEADER_SIZE 44
+
+/* emphasised colours: the other two channels are dimmed by this */
+#define EMPHASIS_DIM 0.816328
+
+typedef struct capture_slot_s {
+  uint32_t number;
+  uint8_t emphasis;
+  uint8_t pixels[CAPTURE_FRAME_SIZE];
+} capture_slot_s;
+
+struct capture_s {
+  capture_format_e format;
+  FILE *video;
+  FILE *wav;
+  char video_filename[LEN_E_CONTEXT];
+  char wav_filename[LEN_E_CONTEXT];
+
+  /* frames: the emulation thread adds at head, the writer takes from
+   * tail */
+  capture_slot_s *slots;
+  int n_slots;
+  _Alignas(64) _Atomic uint64_t head;
+  _Alignas(64) _Atomic uint64_t tail;
+  uint32_t next_number; /* emulation thread only */
+
+  /* audio, the same */
+  int16_t *samples;
+  _Alignas(64) _Atomic uint64_t audio_head;
+  _Alignas(64) _Atomic uint64_t audio_tail;
+
+  /* posted whenever something is queued, so the writer can sleep */
+  sem_t ready;
+  _Atomic int stopping;
+  pthread_t thread;
+
+  _Atomic uint64_t frames;
+  _Atomic uint64_t frames_written;
+  _Atomic uint64_t frames_dropped;
+  _Atomic uint64_t n_samples;
+  _Atomic uint64_t samples_written;
+  _Atomic uint64_t samples_dropped;
+  _Atomic uint64_t bytes_written;
+
+  /* writer thread only */
+  int video_error;
+  int wav_error;
+  uint32_t expected_number; /* of the next frame, for repeating drops */
+  uint8_t last[CAPTURE_FRAME_SIZE];
+  uint8_t last_emphasis;
+  uint8_t *out;                /* a frame ready to write */
+  uint8_t yuv[8][PALETTE_SIZE][3];
+};
+
+struct capture_reader_s {
+  FILE *fp;
+  uint8_t frame[CAPTURE_FRAME_SIZE];
+  uint8_t *record;
+};
+
+static void *writer_thread(void *data);
+static void put_le(uint8_t *p, uint64_t val, int n_bytes);
+static uint64_t get_le(const uint8_t *p, int n_bytes);
+static void make_yuv(capture_s *capture);
+static void free_capture(capture_s *capture);
+
+/*======================Public functions======================*/
+
+int capture_start(capture_s **capture, const char *video_filename,
+                  capture_format_e format, int queue_frames,
+                  const char *wav_filename, int sample_rate,
+                  char *e_context) {
+  if (video_filename == NULL) {
+    return -E_NO_FILE;
+  }
+  if (queue_frames < 1) {
+    return -E_BUF_SIZE;
+  }
+  /* aligned for the queue counters' cache lines */
+  size_t size = (sizeof(capture_s) + 63) / 64 * 64;
+  capture_s *c = aligned_alloc(64, size);
+  if (c == NULL) {
+    return -E_MALLOC;
+  }
+  memset(c, 0, size);
+  c->format = format;
+  c->n_slots = queue_frames;
+  c->slots = malloc(sizeof(capture_slot_s) * queue_frames);
+  c->out = malloc(format == CAPTURE_DELTA ? DELTA_MAX_SIZE
+                                          : 3 * CAPTURE_FRAME_SIZE);
+  if (wav_filename != NULL) {
+    c->samples = malloc(sizeof(int16_t) * CAPTURE_AUDIO_QUEUE);
+  }
+  if (c->slots == NULL || c->out == NULL ||
+      (wav_filename != NULL && c->samples == NULL)) {
+    free_capture(c);
+    return -E_MALLOC;
+  }
+  make_yuv(c);
+
+  strncpy(c->video_filename, video_filename, LEN_E_CONTEXT - 1);
+  if ((c->video = fopen(video_filename, "wb")) == NULL) {
+    strncpy(e_context, video_filename, LEN_E_CONTEXT - 1);
+    free_capture(c);
+    return -E_OPEN_FILE;
+  }
+  if (wav_filename != NULL) {
+    strncpy(c->wav_filename, wav_filename, LEN_E_CONTEXT - 1);
+    if ((c->wav = fopen(wav_filename, "wb")) == NULL) {
+      strncpy(e_context, wav_filename, LEN_E_CONTEXT - 1);
+      free_capture(c);
+      return -E_OPEN_FILE;
+    }
+  }
+
+  /* headers. the wav one has its sizes filled in by capture_stop */
+  int ok;
+  if (format == CAPTURE_DELTA) {
+    uint8_t header[DELTA_HEADER_SIZE] = {0};
+    memcpy(header, DELTA_MAGIC, 4);
+    header[4] = DELTA_VERSION;
+    put_le(header + 8, CAPTURE_WIDTH, 2);
+    put_le(header + 10, CAPTURE_HEIGHT, 2);
+    put_le(header + 12, CAPTURE_FPS_NUM, 4);
+    put_le(header + 16, CAPTURE_FPS_DEN, 4);
+    ok = fwrite(header, 1, DELTA_HEADER_SIZE, c->video) == DELTA_HEADER_SIZE;
+    c->bytes_written = DELTA_HEADER_SIZE;
+  } else {
+    /* NES pixels are 8:7 */
+    int n = fprintf(c->video, "YUV4MPEG2 W%d H%d F%d:%d Ip A8:7 C444\n",
+                    CAPTURE_WIDTH, CAPTURE_HEIGHT, CAPTURE_FPS_NUM,
+                    CAPTURE_FPS_DEN);
+    ok = n > 0;
+    c->bytes_written = (n > 0) ? n : 0;
+  }
+  if (!ok) {
+    strncpy(e_context, video_filename, LEN_E_CONTEXT - 1);
+    free_capture(c);
+    return -E_WRITE_FILE;
+  }
+  if (c->wav != NULL) {
+    uint8_t header[WAV_HEADER_SIZE] = {0};
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le(header + 16, 16, 4);              /* fmt chunk size */
+    put_le(header + 20, 1, 2);               /* PCM */
+    put_le(header + 22, 1, 2);               /* mono */
+    put_le(header + 24, sample_rate, 4);
+    put_le(header + 28, sample_rate * 2, 4); /* bytes per second */
+    put_le(header + 32, 2, 2);               /* bytes per sample */
+    put_le(header + 34, 16, 2);              /* bits per sample */
+    memcpy(header + 36, "data", 4);
+    if (fwrite(header, 1, WAV_HEADER_SIZE, c->wav) != WAV_HEADER_SIZE) {
+      strncpy(e_context, wav_filename, LEN_E_CONTEXT - 1);
+      free_capture(c);
+      return -E_WRITE_FILE;
+    }
+  }
+
+  sem_init(&c->ready, 0, 0);
+  if (pthread_create(&c->thread, NULL, &writer_thread, c) != 0) {
+    sem_destroy(&c->ready);
+    free_capture(c);
+    return -E_THREAD;
+  }
+  *capture = c;
+  return E_NO_ERROR;
+}
+
+int capture_frame(capture_s *capture, const uint8_t *frame, uint8_t emphasis) {
+  uint32_t number = capture->next_number++;
+  atomic_fetch_add_explicit(&capture->frames, 1, memory_order_relaxed);
+  uint64_t h = atomic_load_explicit(&capture->head, memory_order_relaxed);
+  uint64_t t = atomic_load_explicit(&capture->tail, memory_order_acquire);
+  if (h - t == (uint64_t)capture->n_slots) {
+    atomic_fetch_add_explicit(&capture->frames_dropped, 1,
+                              memory_order_relaxed);
+    return 0;
+  }
+  capture_slot_s *slot = &capture->slots[h % capture->n_slots];
+  slot->number = number;
+  slot->emphasis = emphasis & 7;
+  memcpy(slot->pixels, frame, CAPTURE_FRAME_SIZE);
+  atomic_store_explicit(&capture->head, h + 1, memory_order_release);
+  sem_post(&capture->ready);
+  return 1;
+}
+
+int capture_audio(capture_s *capture, const int16_t *samples, int n) {
+  if (capture->samples == NULL || n <= 0) {
+    return 0;
+  }
+  atomic_fetch_add_explicit(&capture->n_samples, n, memory_order_relaxed);
+  uint64_t h = atomic_load_explicit(&capture->audio_head, memory_order_relaxed);
+  uint64_t t = atomic_load_explicit(&capture->audio_tail, memory_order_acquire);
+  int fit = CAPTURE_AUDIO_QUEUE - (int)(h - t);
+  if (fit > n) {
+    fit = n;
+  }
+  for (int i = 0; i < fit; i++) {
+    capture->samples[(h + i) % CAPTURE_AUDIO_QUEUE] = samples[i];
+  }
+  if (fit < n) {
+    atomic_fetch_add_explicit(&capture->samples_dropped, n - fit,
+                              memory_order_relaxed);
+  }
+  if (fit > 0) {
+    atomic_store_explicit(&capture->audio_head, h + fit, memory_order_release);
+    sem_post(&capture->ready);
+  }
+  return fit;
+}
+
+void capture_get_stats(const capture_s *capture, capture_stats_s *stats) {
+  stats->frames = atomic_load(&capture->frames);
+  stats->frames_written = atomic_load(&capture->frames_written);
+  stats->frames_dropped = atomic_load(&capture->frames_dropped);
+  stats->samples = atomic_load(&capture->n_samples);
+  stats->samples_written = atomic_load(&capture->samples_written);
+  stats->samples_dropped = atomic_load(&capture->samples_dropped);
+  stats->bytes_written = atomic_load(&capture->bytes_written);
+}
+
+int capture_stop(capture_s *capture, capture_stats_s *stats,
+                 char *e_context) {
+  atomic_store(&capture->stopping, 1);
+  sem_post(&capture->ready);
+  pthread_join(capture->thread, NULL);
+  sem_destroy(&capture->ready);
+  if (stats != NULL) {
+    capture_get_stats(capture, stats);
+  }
+
+  int err = E_NO_ERROR;
+  if (capture->video_error || fclose(capture->video) != 0) {
+    snprintf(e_context, LEN_E_CONTEXT, "%s", capture->video_filename);
+    err = -E_WRITE_FILE;
+  }
+  capture->video = NULL;
+  if (capture->wav != NULL) {
+    /* sizes in the header, now they are known */
+    uint8_t size[4];
+    uint64_t data_size = atomic_load(&capture->samples_written) * 2;
+    int ok = !capture->wav_error;
+    put_le(size, data_size + WAV_HEADER_SIZE - 8, 4);
+    ok = ok && fseek(capture->wav, 4, SEEK_SET) == 0 &&
+         fwrite(size, 1, 4, capture->wav) == 4;
+    put_le(size, data_size, 4);
+    ok = ok && fseek(capture->wav, 40, SEEK_SET) == 0 &&
+         fwrite(size, 1, 4, capture->wav) == 4;
+    if (fclose(capture->wav) != 0 || !ok) {
+      snprintf(e_context, LEN_E_CONTEXT, "%s", capture->wav_filename);
+      err = -E_WRITE_FILE;
+    }
+    capture->wav = NULL;
+  }
+  free_capture(capture);
+  return err;
+}
+
+int capture_reader_open(capture_reader_s **reader, const char *filename,
+                        char *e_context) {
+  if (filename == NULL) {
+    return -E_NO_FILE;
+  }
+  capture_reader_s *r = calloc(1, sizeof(capture_reader_s));
+  if (r == NULL || (r->record = malloc(DELTA_MAX_SIZE)) == NULL) {
+    free(r);
+    return -E_MALLOC;
+  }
+  strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+  if ((r->fp = fopen(filename, "rb")) == NULL) {
+    capture_reader_close(r);
+    return -E_OPEN_FILE;
+  }
+  uint8_t header[DELTA_HEADER_SIZE];
+  if (fread(header, 1, DELTA_HEADER_SIZE, r->fp) != DELTA_HEADER_SIZE ||
+      memcmp(header, DELTA_MAGIC, 4) != 0 || header[4] != DELTA_VERSION ||
+      get_le(header + 8, 2) != CAPTURE_WIDTH ||
+      get_le(header + 10, 2) != CAPTURE_HEIGHT) {
+    capture_reader_close(r);
+    return -E_CAPTURE_FORMAT;
+  }
+  *e_context = '\0';
+  *reader = r;
+  return E_NO_ERROR;
+}
+
+static const uint8_t *get_leb128(const uint8_t *p, const uint8_t *end,
+                                 uint32_t *val);
+
+int capture_reader_next(capture_reader_s *reader, uint8_t *frame,
+                        uint32_t *number, uint8_t *emphasis) {
+  uint8_t len_bytes[4];
+  size_t n = fread(len_bytes, 1, 4, reader->fp);
+  if (n == 0 && feof(reader->fp)) {
+    return 0;
+  }
+  uint32_t len = get_le(len_bytes, 4);
+  if (n != 4 || len < DELTA_FRAME_HEADER_SIZE - 4 ||
+      len > DELTA_MAX_SIZE - 4 ||
+      fread(reader->record, 1, len, reader->fp) != len) {
+    return -E_CAPTURE_FORMAT;
+  }
+
+  const uint8_t *p = reader->record + 5;
+  const uint8_t *end = reader->record + len;
+  uint32_t pos = 0;
+  while (p < end) {
+    uint32_t same, changed;
+    if ((p = get_leb128(p, end, &same)) == NULL ||
+        (p = get_leb128(p, end, &changed)) == NULL ||
+        (uint64_t)pos + same + changed > CAPTURE_FRAME_SIZE ||
+        changed > (size_t)(end - p)) {
+      return -E_CAPTURE_FORMAT;
+    }
+    pos += same;
+    memcpy(reader->frame + pos, p, changed);
+    pos += changed;
+    p += changed;
+  }
+  memcpy(frame, reader->frame, CAPTURE_FRAME_SIZE);
+  *number = get_le(reader->record, 4);
+  *emphasis = reader->record[4];
+  return 1;
+}
+
+void capture_reader_close(capture_reader_s *reader) {
+  if (reader == NULL) {
+    return;
+  }
+  if (reader->fp != NULL) {
+    fclose(reader->fp);
+  }
+  free(reader->record);
+  free(reader);
+}
+
+/*======================Writer thread======================*/
+
+static uint8_t *put_leb128(uint8_t *p, uint32_t val) {
+  while (val >= 0x80) {
+    *p++ = (val & 0x7F) | 0x80;
+    val >>= 7;
+  }
+  *p++ = val;
+  return p;
+}
+
+static const uint8_t *get_leb128(const uint8_t *p, const uint8_t *end,
+                                 uint32_t *val) {
+  *val = 0;
+  for (int shift = 0; shift < 32; shift += 7) {
+    if (p == end) {
+      return NULL;
+    }
+    *val |= (uint32_t)(*p & 0x7F) << shift;
+    if (!(*p++ & 0x80)) {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+/* bytes from i on that are the same in a and b, 8 at a time while they
+ * are */
+static size_t same_run(const uint8_t *a, const uint8_t *b, size_t i) {
+  size_t start = i;
+  while (i + 8 <= CAPTURE_FRAME_SIZE) {
+    uint64_t x, y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    if (x != y) {
+      break;
+    }
+    i += 8;
+  }
+  while (i < CAPTURE_FRAME_SIZE && a[i] == b[i]) {
+    i++;
+  }
+  return i - start;
+}
+
+/* the runs of frame that differ from capture->last into out, returns the
+ * length */
+static size_t delta_encode(const capture_s *capture, const uint8_t *frame,
+                           uint8_t *out) {
+  const uint8_t *last = capture->last;
+  uint8_t *o = out;
+  size_t i = 0;
+  for (;;) {
+    size_t start = i;
+    i += same_run(frame, last, i);
+    if (i == CAPTURE_FRAME_SIZE) {
+      break;
+    }
+    size_t changed = i;
+    while (i < CAPTURE_FRAME_SIZE) {
+      if (frame[i] != last[i]) {
+        i++;
+        continue;
+      }
+      size_t same = 0;
+      while (i + same < CAPTURE_FRAME_SIZE && same < DELTA_MIN_SAME &&
+             frame[i + same] == last[i + same]) {
+        same++;
+      }
+      if (same == DELTA_MIN_SAME || i + same == CAPTURE_FRAME_SIZE) {
+        break;
+      }
+      i += same;
+    }
+    o = put_leb128(o, changed - start);
+    o = put_leb128(o, i - changed);
+    memcpy(o, frame + changed, i - changed);
+    o += i - changed;
+  }
+  return o - out;
+}
+
+static void write_video(capture_s *capture, const uint8_t *data, size_t n) {
+  if (capture->video_error) {
+    return;
+  }
+  if (fwrite(data, 1, n, capture->video) != n) {
+    capture->video_error = 1;
+    return;
+  }
+  atomic_fetch_add_explicit(&capture->bytes_written, n, memory_order_relaxed);
+}
+
+static void write_delta(capture_s *capture, const capture_slot_s *slot) {
+  uint8_t *out = capture->out;
+  size_t len = delta_encode(capture, slot->pixels,
+                            out + DELTA_FRAME_HEADER_SIZE);
+  put_le(out, len + DELTA_FRAME_HEADER_SIZE - 4, 4);
+  put_le(out + 4, slot->number, 4);
+  out[8] = slot->emphasis;
+  write_video(capture, out, len + DELTA_FRAME_HEADER_SIZE);
+}
+
+/* frames that were dropped before number are the last one again */
+static void y4m_repeat(capture_s *capture, uint32_t number) {
+  static const char frame_header[] = "FRAME\n";
+  for (; capture->expected_number < number; capture->expected_number++) {
+    write_video(capture, (const uint8_t *)frame_header,
+                sizeof(frame_header) - 1);
+    write_video(capture, capture->out, 3 * CAPTURE_FRAME_SIZE);
+  }
+}
+
+/* Convert to Y, Cb and Cr planes in capture->out. Only rows that changed
+ * since the last frame are converted, the rest are still there from
+ * it. */
+static void write_y4m(capture_s *capture, const capture_slot_s *slot) {
+  static const char frame_header[] = "FRAME\n";
+  uint8_t *planes = capture->out;
+  int first = atomic_load_explicit(&capture->frames_written,
+                                   memory_order_relaxed) == 0;
+  int all = first || slot->emphasis != capture->last_emphasis;
+  const uint8_t(*yuv)[3] = capture->yuv[slot->emphasis];
+
+  if (!first) {
+    y4m_repeat(capture, slot->number);
+  }
+
+  for (int row = 0; row < CAPTURE_HEIGHT; row++) {
+    size_t offset = (size_t)row * CAPTURE_WIDTH;
+    const uint8_t *in = slot->pixels + offset;
+    if (!all && memcmp(in, capture->last + offset, CAPTURE_WIDTH) == 0) {
+      continue;
+    }
+    for (int x = 0; x < CAPTURE_WIDTH; x++) {
+      const uint8_t *p = yuv[in[x] % PALETTE_SIZE];
+      planes[offset + x] = p[0];
+      planes[CAPTURE_FRAME_SIZE + offset + x] = p[1];
+      planes[2 * CAPTURE_FRAME_SIZE + offset + x] = p[2];
+    }
+  }
+  write_video(capture, (const uint8_t *)frame_header,
+              sizeof(frame_header) - 1);
+  write_video(capture, planes, 3 * CAPTURE_FRAME_SIZE);
+}
+
+static void drain_frames(capture_s *capture) {
+  uint64_t t = atomic_load_explicit(&capture->tail, memory_order_relaxed);
+  uint64_t h = atomic_load_explicit(&capture->head, memory_order_acquire);
+  for (; t != h; t++) {
+    const capture_slot_s *slot = &capture->slots[t % capture->n_slots];
+    if (capture->format == CAPTURE_DELTA) {
+      write_delta(capture, slot);
+    } else {
+      write_y4m(capture, slot);
+    }
+    memcpy(capture->last, slot->pixels, CAPTURE_FRAME_SIZE);
+    capture->last_emphasis = slot->emphasis;
+    capture->expected_number = slot->number + 1;
+    atomic_fetch_add_explicit(&capture->frames_written, 1,
+                              memory_order_relaxed);
+    atomic_store_explicit(&capture->tail, t + 1, memory_order_release);
+  }
+}
+
+static void drain_audio(capture_s *capture) {
+  if (capture->wav == NULL) {
+    return;
+  }
+  uint64_t t = atomic_load_explicit(&capture->audio_tail, memory_order_relaxed);
+  uint64_t h = atomic_load_explicit(&capture->audio_head, memory_order_acquire);
+  while (t != h) {
+    /* up to the end of the queue at a time */
+    size_t first = t % CAPTURE_AUDIO_QUEUE;
+    size_t n = h - t;
+    if (n > CAPTURE_AUDIO_QUEUE - first) {
+      n = CAPTURE_AUDIO_QUEUE - first;
+    }
+    uint8_t bytes[2 * 1024];
+    for (size_t done = 0; done < n;) {
+      size_t chunk = (n - done > 1024) ? 1024 : n - done;
+      for (size_t i = 0; i < chunk; i++) {
+        put_le(bytes + 2 * i, (uint16_t)capture->samples[first + done + i], 2);
+      }
+      if (!capture->wav_error &&
+          fwrite(bytes, 2, chunk, capture->wav) != chunk) {
+        capture->wav_error = 1;
+      }
+      done += chunk;
+    }
+    if (!capture->wav_error) {
+      atomic_fetch_add_explicit(&capture->samples_written, n,
+                                memory_order_relaxed);
+    }
+    t += n;
+    atomic_store_explicit(&capture->audio_tail, t, memory_order_release);
+  }
+}
+
+/* writes whatever is queued each time it is woken, until capture_stop. a
+ * write error stops anything more going to that file, but the queues are
+ * still emptied so capture_frame keeps counting drops properly */
+static void *writer_thread(void *data) {
+  capture_s *capture = data;
+  for (;;) {
+    sem_wait(&capture->ready);
+    /* before looking at the queues, so nothing queued before stopping is
+     * missed */
+    int stopping = atomic_load(&capture->stopping);
+    drain_frames(capture);
+    drain_audio(capture);
+    if (stopping) {
+      /* including any dropped after the last one written */
+      if (capture->format == CAPTURE_Y4M &&
+          atomic_load(&capture->frames_written) > 0) {
+        y4m_repeat(capture, capture->next_number);
+      }
+      return NULL;
+    }
+  }
+}
+
+/*======================Helpers======================*/
+
+static void put_le(uint8_t *p, uint64_t val, int n_bytes) {
+  for (int i = 0; i < n_bytes; i++) {
+    p[i] = (val >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, int n_bytes) {
+  uint64_t val = 0;
+  for (int i = 0; i < n_bytes; i++) {
+    val |= (uint64_t)p[i] << (8 * i);
+  }
+  return val;
+}
+
+static uint8_t clamp_byte(double val) {
+  return (val < 0) ? 0 : (val > 255) ? 255 : (uint8_t)(val + 0.5);
+}
+
+/* BT.601 studio range Y, Cb and Cr for each palette index with each
+ * combination of emphasis bits */
+static void make_yuv(capture_s *capture) {
+  for (int e = 0; e < 8; e++) {
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+      double rgb[3];
+      for (int c = 0; c < 3; c++) {
+        rgb[c] = nes_palette[i * 3 + c];
+        if (e != 0 && !(e & (1 << c))) {
+          rgb[c] *= EMPHASIS_DIM;
+        }
+      }
+      double r = rgb[0] / 255, g = rgb[1] / 255, b = rgb[2] / 255;
+      capture->yuv[e][i][0] =
+          clamp_byte(16 + 65.481 * r + 128.553 * g + 24.966 * b);
+      capture->yuv[e][i][1] =
+          clamp_byte(128 - 37.797 * r - 74.203 * g + 112.0 * b);
+      capture->yuv[e][i][2] =
+          clamp_byte(128 + 112.0 * r - 93.786 * g - 18.214 * b);
+    }
+  }
+}
+
+static void free_capture(capture_s *capture) {
+  if (capture->video != NULL) {
+    fclose(capture->video);
+  }
+  if (capture->wav != NULL) {
+    fclose(capture->wav);
+  }
+  free(capture->slots);
+  free(capture->samples);
+  free(capture->out);
+  free(capture);
+}
@@ -0,0 +1,152 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cdlp.h"
+#include "core/errors.h"
+#include "memoryp.h"
+
+uint8_t cdl_on = 0;
+uint8_t *cdl_prg = NULL;
+uint32_t cdl_prg_mask = 0;
+uint8_t *cdl_chr_rendered = NULL;
+uint8_t *cdl_chr_read = NULL;
+uint32_t cdl_chr_mask = 0;
+
+static size_t prg_size = 0;
+static size_t chr_size = 0;
+
+void cdl_reset(void) {
+  cdl_on = 0;
+  free(cdl_prg);
+  free(cdl_chr_rendered);
+  free(cdl_chr_read);
+  cdl_prg = cdl_chr_rendered = cdl_chr_read = NULL;
+  cdl_prg_mask = cdl_chr_mask = 0;
+  prg_size = chr_size = 0;
+}
+
+int cdl_start(void) {
+  size_t prg, chr;
+  memory_rom_sizes(&prg, &chr);
+  if (prg == 0) {
+    return -E_CDL_ROM;
+  }
+  cdl_reset();
+  if ((cdl_prg = calloc(prg, 1)) == NULL) {
+    return -E_MALLOC;
+  }
+  if (chr > 0 && ((cdl_chr_rendered = calloc(chr, 1)) == NULL ||
+                  (cdl_chr_read = calloc(chr, 1)) == NULL)) {
+    cdl_reset();
+    return -E_MALLOC;
+  }
+  prg_size = prg;
+  chr_size = chr;
+  cdl_prg_mask = prg - 1;
+  cdl_chr_mask = (chr > 0) ? chr - 1 : 0;
+  cdl_on = 1;
+  return E_NO_ERROR;
+}
+
+void cdl_stop(void) { cdl_on = 0; }
+
+int cdl_is_on(void) { return cdl_on; }
+
+size_t cdl_size(void) { return prg_size + chr_size; }
+
+const uint8_t *cdl_prg_log(size_t *size) {
+  *size = prg_size;
+  return cdl_prg;
+}
+
+int cdl_get(uint8_t *buf, size_t buf_len) {
+  if (buf_len < cdl_size()) {
+    return -E_BUF_SIZE;
+  }
+  if (prg_size == 0) {
+    return E_NO_ERROR;
+  }
+  memcpy(buf, cdl_prg, prg_size);
+  for (size_t i = 0; i < chr_size; i++) {
+    buf[prg_size + i] = (cdl_chr_rendered[i] ? CDL_RENDERED : 0) |
+                        (cdl_chr_read[i] ? CDL_CHR_READ : 0);
+  }
+  return E_NO_ERROR;
+}
+
+int cdl_read(const char *filename, char *e_context) {
+  FILE *fp;
+  int err = E_NO_ERROR;
+  if ((fp = fopen(filename, "rb")) == NULL) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+    return -E_OPEN_FILE;
+  }
+  uint8_t *buf = malloc(cdl_size() + 1);
+  if (buf == NULL) {
+    fclose(fp);
+    return -E_MALLOC;
+  }
+  /* one byte more than the log to tell if the file is bigger */
+  size_t n = fread(buf, 1, cdl_size() + 1, fp);
+  if (ferror(fp)) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+    err = -E_READ_FILE;
+  } else if (prg_size == 0 || n != cdl_size()) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+    err = -E_CDL_ROM;
+  } else {
+    for (size_t i = 0; i < prg_size; i++) {
+      cdl_prg[i] |= buf[i];
+    }
+    for (size_t i = 0; i < chr_size; i++) {
+      cdl_chr_rendered[i] |= buf[prg_size + i] & CDL_RENDERED;
+      cdl_chr_read[i] |= buf[prg_size + i] & CDL_CHR_READ;
+    }
+  }
+  free(buf);
+  fclose(fp);
+  return err;
+}
+
+int cdl_write(const char *filename, char *e_context) {
+  FILE *fp;
+  int err = E_NO_ERROR;
+  uint8_t *buf = malloc(cdl_size());
+  if (buf == NULL) {
+    return -E_MALLOC;
+  }
+  cdl_get(buf, cdl_size());
+  if ((fp = fopen(filename, "wb")) == NULL) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+    free(buf);
+    return -E_OPEN_FILE;
+  }
+  if (fwrite(buf, 1, cdl_size(), fp) != cdl_size()) {
+    err = -E_WRITE_FILE;
+  }
+  if (fclose(fp) != 0) {
+    err = -E_WRITE_FILE;
+  }
+  if (err < 0) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+  }
+  free(buf);
+  return err;
+}
@@ -0,0 +1,48 @@
+#ifndef CDLP_H_
+#define CDLP_H_
+
+#include "core/cdl.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* nonzero while logging */
+extern uint8_t cdl_on;
+
+/* prg rom sizes are powers of 2, so the offset of a cpu address is a mask.
+ * chr flags are kept in two arrays, since pattern fetches are logged by the
+ * pipeline's render thread and PPUDATA reads by the cpu's, and merged by
+ * cdl_get. chr_mask is 0 and the arrays are NULL with chr ram */
+extern uint8_t *cdl_prg;
+extern uint32_t cdl_prg_mask;
+extern uint8_t *cdl_chr_rendered;
+extern uint8_t *cdl_chr_read;
+extern uint32_t cdl_chr_mask;
+
+/* called by memory_init, a new rom means the log is no use */
+void cdl_reset(void);
+
+/* the prg rom flags so far, size bytes, for cpu_decode_warmup. NULL if
+ * there is no log */
+const uint8_t *cdl_prg_log(size_t *size);
+
+#define CDL_ON() __builtin_expect(cdl_on, 0)
+
+/* or flags into the prg rom byte at cpu address addr, if it is in prg rom,
+ * with the window it was used through */
+static inline void cdl_mark_prg(uint16_t addr, uint8_t flags) {
+  if (addr >= 0x8000) {
+    cdl_prg[(addr - 0x8000) & cdl_prg_mask] |=
+        flags | ((addr >> 13) & 3) << CDL_PRG_WINDOW_SHIFT;
+  }
+}
+
+/* mark the chr rom byte at ppu address addr in log, cdl_chr_rendered or
+ * cdl_chr_read, if it is in chr rom. a store rather than an or since each
+ * array only has the one flag */
+static inline void cdl_mark_chr(uint8_t *log, uint16_t addr) {
+  if (addr < 0x2000 && log != NULL) {
+    log[addr & cdl_chr_mask] = 1;
+  }
+}
+
+#endif
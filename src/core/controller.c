@@ -1,36 +1,161 @@
 #include "core/controller.h"
 #include "controllerp.h"
+#include "moviep.h"
 
 #include <stdlib.h>
+#include <string.h>
 
-enum {PARALLEL, SERIAL};
+/* four score signatures, shifted out after the two pads on each port.
+ * reads 17 to 24 give 0,0,0,1,0,0,0,0 on $4016 and 0,0,1,0,0,0,0,0 on
+ * $4017 */
+#define FOUR_SCORE_SIGNATURE_0 0x08
+#define FOUR_SCORE_SIGNATURE_1 0x04
 
-static uint8_t buttons = 0;
-static int mode = PARALLEL;
+/* bits of the value read for the zapper and paddle */
+#define ZAPPER_NO_LIGHT 0x08
+#define ZAPPER_TRIGGER 0x10
+#define PADDLE_BUTTON 0x08
+#define PADDLE_DATA 0x10
 
+typedef struct port_s {
+  uint8_t (*get_input)(uint8_t, void *);
+  void *data;
+} port_s;
+
+static controller_state_s state = {0};
+static port_s ports[CTRLR_N_PORTS] = {{NULL, NULL}, {NULL, NULL}};
+
+/* for controller_init, which takes a callback without an index */
 static uint8_t (*get_pressed_buttons)(void *) = NULL;
 static void *get_pressed_buttons_data = NULL;
 
+static void latch(uint8_t port);
+static uint8_t pad_input(uint8_t index, void *data);
+static uint8_t reverse_bits(uint8_t val);
+
 void controller_init(uint8_t (*get_pressed_buttons_cb)(void *), void *data) {
   get_pressed_buttons = get_pressed_buttons_cb;
   get_pressed_buttons_data = data;
+  controller_set_device(0, CTRLR_DEVICE_PAD, &pad_input, NULL);
 }
 
-uint8_t controller_fetch(void) {
-  if (mode == PARALLEL) {
-    return buttons & 1; // 'A' button
-  } else {
-    uint8_t val = buttons & 1;
-    buttons >>= 1;
+void controller_set_device(uint8_t port, controller_device_e device,
+                           uint8_t (*get_input)(uint8_t, void *),
+                           void *data) {
+  if (device == CTRLR_DEVICE_FOUR_SCORE) {
+    for (int i = 0; i < CTRLR_N_PORTS; i++) {
+      controller_set_device(i, CTRLR_DEVICE_PAD, get_input, data);
+      state.device[i] = CTRLR_DEVICE_FOUR_SCORE;
+    }
+    return;
+  }
+  /* unplugging one half of a four score unplugs the whole thing */
+  if (state.device[port] == CTRLR_DEVICE_FOUR_SCORE) {
+    state.device[!port] = CTRLR_DEVICE_NONE;
+    ports[!port].get_input = NULL;
+  }
+  state.device[port] = (get_input != NULL) ? device : CTRLR_DEVICE_NONE;
+  ports[port].get_input = get_input;
+  ports[port].data = data;
+  state.shift[port] = 0;
+  state.held[port] = 0;
+}
+
+controller_device_e controller_get_device(uint8_t port) {
+  return state.device[port];
+}
+
+void controller_save_state(controller_state_s *s) { *s = state; }
+
+void controller_load_state(const controller_state_s *s) {
+  memcpy(state.shift, s->shift, sizeof(state.shift));
+  memcpy(state.held, s->held, sizeof(state.held));
+  state.strobe = s->strobe;
+}
+
+void controller_reset(void) {
+  state.strobe = 0;
+  memset(state.shift, 0, sizeof(state.shift));
+  memset(state.held, 0, sizeof(state.held));
+}
+
+uint8_t controller_fetch(uint8_t port) {
+  switch (state.device[port]) {
+  case CTRLR_DEVICE_PAD:
+  case CTRLR_DEVICE_FOUR_SCORE: {
+    uint8_t val = state.shift[port] & 1;
+    if (!state.strobe) {
+      state.shift[port] >>= 1;
+    }
+    return val;
+  }
+  case CTRLR_DEVICE_PADDLE: {
+    uint8_t val = ((state.shift[port] & 1) ? PADDLE_DATA : 0) |
+                  state.held[port];
+    if (!state.strobe) {
+      state.shift[port] >>= 1;
+    }
     return val;
   }
+  case CTRLR_DEVICE_ZAPPER: {
+    /* not a shift register, the trigger and light sensor are read as they
+     * are now. light gun games poll without strobing */
+    uint8_t input = movie_latch(ports[port].get_input, 0, ports[port].data);
+    return ((input & CTRLR_ZAPPER_TRIGGER) ? ZAPPER_TRIGGER : 0) |
+           ((input & CTRLR_ZAPPER_LIGHT) ? 0 : ZAPPER_NO_LIGHT);
+  }
+  default:
+    return 0;
+  }
 }
 
 void controller_write(uint8_t val) {
   if (val & 1) {
-    mode = PARALLEL;
-    buttons = get_pressed_buttons(get_pressed_buttons_data);
+    state.strobe = 1;
+    for (int i = 0; i < CTRLR_N_PORTS; i++) {
+      latch(i);
+    }
   } else {
-    mode = SERIAL;
+    state.strobe = 0;
+  }
+}
+
+/* take a snapshot of the input to the device on port, for the devices
+ * that shift it out */
+static void latch(uint8_t port) {
+  port_s *p = &ports[port];
+  switch (state.device[port]) {
+  case CTRLR_DEVICE_PAD:
+    state.shift[port] = movie_latch(p->get_input, 0, p->data);
+    break;
+  case CTRLR_DEVICE_FOUR_SCORE:
+    /* port 0 has pads 1 and 3, port 1 has pads 2 and 4. separate
+     * statements so the movie sees them in a fixed order */
+    state.shift[port] = movie_latch(p->get_input, port, p->data);
+    state.shift[port] |= movie_latch(p->get_input, port + 2, p->data) << 8;
+    state.shift[port] |=
+        (port ? FOUR_SCORE_SIGNATURE_1 : FOUR_SCORE_SIGNATURE_0) << 16;
+    break;
+  case CTRLR_DEVICE_PADDLE:
+    /* position is shifted out inverted, high bit first */
+    state.shift[port] =
+        reverse_bits(~movie_latch(p->get_input, 0, p->data));
+    state.held[port] =
+        movie_latch(p->get_input, 1, p->data) ? PADDLE_BUTTON : 0;
+    break;
+  default:
+    break;
+  }
+}
+
+static uint8_t pad_input(uint8_t index, void *data) {
+  return get_pressed_buttons(get_pressed_buttons_data);
+}
+
+static uint8_t reverse_bits(uint8_t val) {
+  uint8_t reversed = 0;
+  for (int i = 0; i < 8; i++) {
+    reversed = (reversed << 1) | ((val >> i) & 1);
   }
+  return reversed;
 }
@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 
-uint8_t controller_fetch(void);
+/* read $4016 (port 0) or $4017 (port 1) */
+uint8_t controller_fetch(uint8_t port);
 void controller_write(uint8_t val);
 
+/* back to the power on state, nothing latched */
+void controller_reset(void);
+
 #endif 
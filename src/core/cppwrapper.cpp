@@ -72,6 +72,60 @@ void nes_ppu_init_no_alloc(ppu_s *ppu, void (*put_pixel)(int, int, uint8_t, void
   }
 }
 
+void nes_ppu_pipeline_start(ppu_s *ppu) {
+  int err;
+  if ((err = ppu_pipeline_start(ppu)) < 0) {
+    throw NESError(-err);
+  }
+}
+
+void nes_ntsc_create(ntsc_s **ntsc, int out_per_3, int n_threads) {
+  int err;
+  if ((err = ntsc_create(ntsc, out_per_3, n_threads)) < 0) {
+    throw NESError(-err);
+  }
+}
+
+void nes_scale_create(scale_s **scale, scale_filter_e filter, int factor,
+                      int n_threads) {
+  int err;
+  if ((err = scale_create(scale, filter, factor, n_threads)) < 0) {
+    throw NESError(-err);
+  }
+}
+
+void nes_capture_start(capture_s **capture, const std::string &video_filename,
+                       capture_format_e format, int queue_frames,
+                       const char *wav_filename, int sample_rate) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = capture_start(capture, video_filename.c_str(), format,
+                           queue_frames, wav_filename, sample_rate,
+                           e_context)) < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
+}
+
+void nes_capture_stop(capture_s *capture, capture_stats_s *stats) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = capture_stop(capture, stats, e_context)) < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
+}
+
+void nes_capture_reader_open(capture_reader_s **reader,
+                             const std::string &filename) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = capture_reader_open(reader, filename.c_str(), e_context)) < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
+}
+
 void nes_cpu_init(cpu_s **cpu, int nestest) {
   int err;
   if ((err = cpu_init(cpu, nestest)) < 0) {
@@ -86,9 +140,110 @@ void nes_cpu_init_no_alloc(cpu_s *cpu, int nestest) {
   }
 }
 
-void nes_cpu_exec(cpu_s *cpu) {
+int nes_cpu_exec(cpu_s *cpu) {
   static int exec_status;
   if ((exec_status = cpu_exec(cpu)) < 0) {
     throw NESError(-exec_status);
   }
+  return exec_status;
+}
+
+int nes_run_frames(cpu_s *cpu, const ppu_s *ppu, uint32_t n_frames) {
+  uint32_t target = ppu_get_frame_count(ppu) + n_frames;
+  while ((int32_t)(target - ppu_get_frame_count(ppu)) > 0) {
+    if (nes_cpu_exec(cpu) == CPU_BREAKPOINT) {
+      return CPU_BREAKPOINT;
+    }
+  }
+  return E_NO_ERROR;
+}
+
+int nes_debug_add(const debug_breakpoint_s &breakpoint) {
+  int id;
+  if ((id = debug_add(&breakpoint)) < 0) {
+    throw NESError(-id);
+  }
+  return id;
+}
+
+debug_breakpoint_s nes_debug_parse(const std::string &text) {
+  debug_breakpoint_s breakpoint;
+  int err;
+  if ((err = debug_parse(text.c_str(), &breakpoint)) < 0) {
+    throw NESError(-err, text);
+  }
+  return breakpoint;
+}
+
+void nes_disasm_create(disasm_s **disasm) {
+  int err;
+  if ((err = disasm_create(disasm)) < 0) {
+    throw NESError(-err);
+  }
+}
+
+bool nes_disasm_update(disasm_s *disasm, const uint8_t *mem,
+                       const uint16_t *banks, uint16_t pc) {
+  int err;
+  if ((err = disasm_update(disasm, mem, banks, pc)) < 0) {
+    throw NESError(-err);
+  }
+  return err;
+}
+
+void nes_cdl_start(void) {
+  int err;
+  if ((err = cdl_start()) < 0) {
+    throw NESError(-err);
+  }
+}
+
+bool nes_cdl_read(const std::string &filename) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = cdl_read(filename.c_str(), e_context)) == -E_OPEN_FILE) {
+    return false;
+  } else if (err < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
+  return true;
+}
+
+void nes_cdl_write(const std::string &filename) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = cdl_write(filename.c_str(), e_context)) < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
+}
+
+void nes_movie_record_start(const std::string &rom_filename) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = movie_record_start(rom_filename.c_str(), e_context)) < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
+}
+
+void nes_movie_record_stop(const std::string &filename) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = movie_record_stop(filename.c_str(), e_context)) < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
+}
+
+void nes_movie_play_start(const std::string &filename,
+                          const std::string &rom_filename) {
+  int err;
+  char e_context[LEN_E_CONTEXT];
+  *e_context = '\0';
+  if ((err = movie_play_start(filename.c_str(), rom_filename.c_str(),
+                              e_context)) < 0) {
+    throw NESError(-err, std::string(e_context));
+  }
 }
@@ -20,7 +20,11 @@
 
 #include "core/cpu.h"
 #include "core/errors.h"
+#include "cdlp.h"
+#include "debugp.h"
 #include "memoryp.h"
+#include "opcodesp.h"
+#include "profilep.h"
 
 /* Sets current instruction and address mode strings in cpu_state struct
  * by "stringifying" them e.g. opstr = ADC, mode = ABS_X -> "ADC", "ABS_X",
@@ -33,197 +37,6 @@
     cpu_state.opc = opcode;                                                    \
   } while (0)
 
-/* Same as above but asterix is prepended to opstr e.g. opstr = NOP -> "*NOP" */
-#define SET_ILLEGAL_INSTRUCTION(opstr, opcode, mode)                           \
-  do {                                                                         \
-    cpu_state.curr_instruction = "*" #opstr;                                   \
-    cpu_state.curr_addr_mode = #mode;                                          \
-    cpu_state.opc = opcode;                                                    \
-  } while (0)
-
-/*
- * These macros expand out all the cases for instructions with different
- * addressing modes, using that all of the different versions of an instruction
- * appear on the same row (or in one case column) of the opcode table.
- */
-
-#define OPC_CASE(op, offset, mode)                                             \
-  case (op##_BASE + offset):                                                   \
-    SET_INSTRUCTION(op, op##_BASE + offset, mode);                             \
-    op(cpu, mode);                                                             \
-    break;
-
-#define IS_ALU_OPC(op)                                                         \
-  OPC_CASE(op, 0x1, IND_X)                                                     \
-  OPC_CASE(op, 0x5, ZP)                                                        \
-  OPC_CASE(op, 0x9, IMM)                                                       \
-  OPC_CASE(op, 0xD, ABS)                                                       \
-  OPC_CASE(op, 0x11, IND_Y)                                                    \
-  OPC_CASE(op, 0x15, ZP_X)                                                     \
-  OPC_CASE(op, 0x19, ABS_Y)                                                    \
-  OPC_CASE(op, 0x1D, ABS_X)
-
-#define IS_RMW_OPC(op)                                                         \
-  OPC_CASE(op, 0x6, ZP)                                                        \
-  OPC_CASE(op, 0xA, IMP)                                                       \
-  OPC_CASE(op, 0xE, ABS)                                                       \
-  OPC_CASE(op, 0x16, ZP_X)                                                     \
-  OPC_CASE(op, 0x1E, ABS_X_EC)
-
-#define IS_INC_DEC(op)                                                         \
-  OPC_CASE(op, 0x6, ZP)                                                        \
-  OPC_CASE(op, 0xE, ABS)                                                       \
-  OPC_CASE(op, 0x16, ZP_X)                                                     \
-  OPC_CASE(op, 0x1E, ABS_X_EC)
-
-#define IS_CPX_CPY(op)                                                         \
-  OPC_CASE(op, 0x0, IMM)                                                       \
-  OPC_CASE(op, 0x4, ZP)                                                        \
-  OPC_CASE(op, 0xC, ABS)
-
-#define IS_STA()                                                               \
-  OPC_CASE(STA, 0x1, IND_X)                                                    \
-  OPC_CASE(STA, 0x5, ZP)                                                       \
-  OPC_CASE(STA, 0xD, ABS)                                                      \
-  OPC_CASE(STA, 0x11, IND_Y_EC)                                                \
-  OPC_CASE(STA, 0x15, ZP_X)                                                    \
-  OPC_CASE(STA, 0x19, ABS_Y_EC)                                                \
-  OPC_CASE(STA, 0x1D, ABS_X_EC)
-
-#define IS_STX()                                                               \
-  OPC_CASE(STX, 0x6, ZP)                                                       \
-  OPC_CASE(STX, 0xE, ABS)                                                      \
-  OPC_CASE(STX, 0x16, ZP_Y)
-
-#define IS_STY()                                                               \
-  OPC_CASE(STY, 0x4, ZP)                                                       \
-  OPC_CASE(STY, 0xC, ABS)                                                      \
-  OPC_CASE(STY, 0x14, ZP_X)
-
-#define IS_LDX()                                                               \
-  OPC_CASE(LDX, 0x2, IMM)                                                      \
-  OPC_CASE(LDX, 0x6, ZP)                                                       \
-  OPC_CASE(LDX, 0xE, ABS)                                                      \
-  OPC_CASE(LDX, 0x16, ZP_Y)                                                    \
-  OPC_CASE(LDX, 0x1E, ABS_Y)
-
-#define IS_LDY()                                                               \
-  OPC_CASE(LDY, 0x0, IMM)                                                      \
-  OPC_CASE(LDY, 0x4, ZP)                                                       \
-  OPC_CASE(LDY, 0xC, ABS)                                                      \
-  OPC_CASE(LDY, 0x14, ZP_X)                                                    \
-  OPC_CASE(LDY, 0x1C, ABS_X)
-
-#define IS_BIT()                                                               \
-  OPC_CASE(BIT, 0x4, ZP)                                                       \
-  OPC_CASE(BIT, 0xC, ABS)
-
-#define IS_JSR() OPC_CASE(JSR, 0x0, ABS)
-
-#define IS_BRANCH_OPC()                                                        \
-  OPC_CASE(BPL, 0x10, REL)                                                     \
-  OPC_CASE(BMI, 0x10, REL)                                                     \
-  OPC_CASE(BVC, 0x10, REL)                                                     \
-  OPC_CASE(BVS, 0x10, REL)                                                     \
-  OPC_CASE(BCC, 0x10, REL)                                                     \
-  OPC_CASE(BCS, 0x10, REL)                                                     \
-  OPC_CASE(BNE, 0x10, REL)                                                     \
-  OPC_CASE(BEQ, 0x10, REL)
-
-#define IS_OPC(op)                                                             \
-  case op##_OPC:                                                               \
-    SET_INSTRUCTION(op, op##_OPC, IMP);                                        \
-    op(cpu, IMP);                                                              \
-    break;
-
-#define _IS_JMP(base, mode)                                                    \
-  case (JMP_OFFSET + base):                                                    \
-    SET_INSTRUCTION(JMP, JMP_OFFSET + base, mode);                             \
-    JMP(cpu, mode);                                                            \
-    break;
-
-#define IS_JMP()                                                               \
-  _IS_JMP(0x40, ABS)                                                           \
-  _IS_JMP(0x60, ABS_IND)
-
-/* illegal opcodes */
-
-#define ILLEGAL_OPC_CASE(op, offset, mode)                                     \
-  case (op##_BASE + offset):                                                   \
-    SET_ILLEGAL_INSTRUCTION(op, op##_BASE + offset, mode);                     \
-    op(cpu, mode);                                                             \
-    break;
-
-/* For individual illegal opcodes */
-#define IS_ILLEGAL_OPC(op, opc, mode)                                          \
-  case (opc):                                                                  \
-    SET_ILLEGAL_INSTRUCTION(op, opc, mode);                                    \
-    op(cpu, mode);                                                             \
-    break;
-
-#define _IS_ILLEGAL_NOP(base, mode)                                            \
-  case (NOP_##mode##_OFFSET + base):                                           \
-    SET_ILLEGAL_INSTRUCTION(NOP, NOP_##mode##_OFFSET + base, mode);            \
-    NOP(cpu, mode);                                                            \
-    break;
-
-#define IS_ILLEGAL_NOP()                                                       \
-  _IS_ILLEGAL_NOP(0X0, ZP)                                                     \
-  _IS_ILLEGAL_NOP(0X40, ZP)                                                    \
-  _IS_ILLEGAL_NOP(0X60, ZP)                                                    \
-  _IS_ILLEGAL_NOP(0X0, ABS)                                                    \
-  _IS_ILLEGAL_NOP(0X0, ZP_X)                                                   \
-  _IS_ILLEGAL_NOP(0X20, ZP_X)                                                  \
-  _IS_ILLEGAL_NOP(0X40, ZP_X)                                                  \
-  _IS_ILLEGAL_NOP(0X60, ZP_X)                                                  \
-  _IS_ILLEGAL_NOP(0XC0, ZP_X)                                                  \
-  _IS_ILLEGAL_NOP(0XE0, ZP_X)                                                  \
-  _IS_ILLEGAL_NOP(0X0, ABS_X)                                                  \
-  _IS_ILLEGAL_NOP(0X20, ABS_X)                                                 \
-  _IS_ILLEGAL_NOP(0X40, ABS_X)                                                 \
-  _IS_ILLEGAL_NOP(0X60, ABS_X)                                                 \
-  _IS_ILLEGAL_NOP(0XC0, ABS_X)                                                 \
-  _IS_ILLEGAL_NOP(0XE0, ABS_X)                                                 \
-  _IS_ILLEGAL_NOP(0X0, IMP)                                                    \
-  _IS_ILLEGAL_NOP(0X20, IMP)                                                   \
-  _IS_ILLEGAL_NOP(0X40, IMP)                                                   \
-  _IS_ILLEGAL_NOP(0X60, IMP)                                                   \
-  _IS_ILLEGAL_NOP(0XC0, IMP)                                                   \
-  _IS_ILLEGAL_NOP(0XE0, IMP)                                                   \
-  IS_ILLEGAL_OPC(NOP, 0x80, IMM)                                               \
-  IS_ILLEGAL_OPC(NOP, 0X89, IMM)                                               \
-  IS_ILLEGAL_OPC(NOP, 0X82, IMM)                                               \
-  IS_ILLEGAL_OPC(NOP, 0XC2, IMM)                                               \
-  IS_ILLEGAL_OPC(NOP, 0XE2, IMM)
-
-#define IS_LAX()                                                               \
-  ILLEGAL_OPC_CASE(LAX, 0x03, IND_X)                                           \
-  ILLEGAL_OPC_CASE(LAX, 0X07, ZP)                                              \
-  ILLEGAL_OPC_CASE(LAX, 0X0F, ABS)                                             \
-  ILLEGAL_OPC_CASE(LAX, 0X13, IND_Y)                                           \
-  ILLEGAL_OPC_CASE(LAX, 0X17, ZP_Y)                                            \
-  ILLEGAL_OPC_CASE(LAX, 0X1F, ABS_Y)
-
-#define IS_SAX()                                                               \
-  ILLEGAL_OPC_CASE(SAX, 0X03, IND_X)                                           \
-  ILLEGAL_OPC_CASE(SAX, 0X07, ZP)                                              \
-  ILLEGAL_OPC_CASE(SAX, 0X0F, ABS)                                             \
-  ILLEGAL_OPC_CASE(SAX, 0X17, ZP_Y)
-
-#define IS_ILLEGAL_SBC() IS_ILLEGAL_OPC(SBC, 0XEB, IMM)
-
-#define IS_ILLEGAL_RMW_OPC(op)                                                 \
-  ILLEGAL_OPC_CASE(op, 0x03, IND_X)                                            \
-  ILLEGAL_OPC_CASE(op, 0x07, ZP)                                               \
-  ILLEGAL_OPC_CASE(op, 0x0f, ABS)                                              \
-  ILLEGAL_OPC_CASE(op, 0x13, IND_Y_EC)                                         \
-  ILLEGAL_OPC_CASE(op, 0x17, ZP_X)                                             \
-  ILLEGAL_OPC_CASE(op, 0x1b, ABS_Y_EC)                                         \
-  ILLEGAL_OPC_CASE(op, 0x1f, ABS_X_EC)
-
-/* apparently this one doesn't work properly: */
-/*ILLEGAL_OPC_CASE(LAX, 0X0B, IMM)		\*/
-
 /* Masks for CPU flags: */
 
 /* 0x30: 00110000 */
@@ -241,95 +54,21 @@
 /* 0x7C: 01111100 */
 #define MASK_NZC 0x7C
 
+/* 0xBE: 10111110 */
+#define MASK_VC 0xBE
+
+/* 0xBF: 10111111 */
+#define MASK_V 0xBF
+
+/* 0xFE: 11111110 */
+#define MASK_C 0xFE
+
 /* 0x7D: 01111101 */
 #define MASK_NZ 0x7D
 
 /* 0xFB: 11111011 */
 #define MASK_I 0xFB
 
-enum {
-  BPL_BASE = 0x0,
-  ORA_BASE = 0x0,
-  ASL_BASE = 0x0,
-  JSR_BASE = 0x20,
-  BMI_BASE = 0x20,
-  BIT_BASE = 0X20,
-  ROL_BASE = 0x20,
-  AND_BASE = 0x20,
-  BVC_BASE = 0x40,
-  LSR_BASE = 0x40,
-  EOR_BASE = 0x40,
-  BVS_BASE = 0x60,
-  ROR_BASE = 0x60,
-  ADC_BASE = 0x60,
-  BCC_BASE = 0x80,
-  STX_BASE = 0x80,
-  STY_BASE = 0x80,
-  STA_BASE = 0x80,
-  BCS_BASE = 0xA0,
-  LDX_BASE = 0xA0,
-  LDY_BASE = 0xA0,
-  LDA_BASE = 0xA0,
-  BNE_BASE = 0xC0,
-  DEC_BASE = 0xC0,
-  CMP_BASE = 0xC0,
-  CPY_BASE = 0xC0,
-  BEQ_BASE = 0xE0,
-  CPX_BASE = 0xE0,
-  INC_BASE = 0xE0,
-  SBC_BASE = 0xE0
-};
-
-enum {
-  BRK_OPC = 0x0,
-  PHP_OPC = 0x8,
-  CLC_OPC = 0x18,
-  PLP_OPC = 0x28,
-  SEC_OPC = 0x38,
-  RTI_OPC = 0x40,
-  PHA_OPC = 0x48,
-  CLI_OPC = 0x58,
-  RTS_OPC = 0x60,
-  PLA_OPC = 0x68,
-  SEI_OPC = 0x78,
-  DEY_OPC = 0x88,
-  TXA_OPC = 0x8A,
-  TYA_OPC = 0x98,
-  TXS_OPC = 0X9A,
-  TAY_OPC = 0xA8,
-  TAX_OPC = 0xAA,
-  CLV_OPC = 0xB8,
-  TSX_OPC = 0xBA,
-  INY_OPC = 0xC8,
-  DEX_OPC = 0xCA,
-  CLD_OPC = 0xD8,
-  INX_OPC = 0xE8,
-  NOP_OPC = 0xEA,
-  SED_OPC = 0xF8,
-};
-
-#define JMP_OFFSET 0xC
-
-/* illegal opcode stuff */
-enum {
-  NOP_ZP_OFFSET = 0X4,
-  NOP_ABS_OFFSET = 0XC,
-  NOP_ZP_X_OFFSET = 0X14,
-  NOP_ABS_X_OFFSET = 0X1C,
-  NOP_IMP_OFFSET = 0X1A
-};
-
-enum {
-  SLO_BASE = 0X0,
-  RLA_BASE = 0X20,
-  SRE_BASE = 0X40,
-  RRA_BASE = 0X60,
-  SAX_BASE = 0X80,
-  LAX_BASE = 0xA0,
-  DCP_BASE = 0XC0,
-  ISB_BASE = 0xE0,
-};
-
 enum {
   FLAG_CARRY = 1 << 0,
   FLAG_ZERO = 1 << 1,
@@ -368,22 +107,7 @@ static inline uint16_t absolute_y_extra_cycle(cpu_s *cpu);
 static inline uint16_t indirect_indexed_extra_cycle(cpu_s *cpu);
 static inline uint16_t implied(cpu_s *cpu);
 
-/* This lets me index the addressing mode handlers by the addressing mode
- * enum without having to worry about ordering
- */
-#define ADDRESS_MODE_LIST                                                      \
-  X(IMP, implied), X(REL, relative), X(IMM, immediate), X(ABS, absolute),      \
-      X(ABS_X, absolute_x), X(ABS_Y, absolute_y),                              \
-      X(ABS_IND, absolute_indirect), X(IND_X, indexed_indirect),               \
-      X(IND_Y, indirect_indexed), X(ZP, zero_page), X(ZP_X, zero_page_x),      \
-      X(ZP_Y, zero_page_y), X(ABS_X_EC, absolute_x_extra_cycle),               \
-      X(ABS_Y_EC, absolute_y_extra_cycle),                                     \
-      X(IND_Y_EC, indirect_indexed_extra_cycle)
-
-#define X(id, x) id
-typedef enum { ADDRESS_MODE_LIST } addr_mode_e;
-#undef X
-
+/* ADDRESS_MODE_LIST is in opcodesp.h */
 #define X(x, handler) handler
 static uint16_t (*addr_mode_handlers[])(cpu_s *) = {ADDRESS_MODE_LIST};
 #undef X
@@ -395,6 +119,7 @@ static inline void stack_push(cpu_s *cpu, uint8_t val);
 static inline uint8_t stack_pop(cpu_s *cpu);
 static inline uint8_t fetch8(cpu_s *cpu, uint16_t addr);
 static inline uint16_t fetch16(cpu_s *cpu, uint16_t addr);
+static inline uint8_t read8(cpu_s *cpu, uint16_t addr, addr_mode_e mode);
 static inline void write8(cpu_s *cpu, uint16_t addr, uint8_t val);
 
 /* Instructions */
@@ -466,6 +191,11 @@ static inline void SRE(cpu_s *cpu, addr_mode_e mode);
 static inline void RRA(cpu_s *cpu, addr_mode_e mode);
 
 static inline void update_flags(cpu_s *cpu);
+static inline uint8_t get_flags(const cpu_s *cpu);
+static inline void set_flags(cpu_s *cpu, uint8_t flags);
+static inline void set_nz(cpu_s *cpu, uint8_t res);
+static inline void set_nz_bit(cpu_s *cpu, uint8_t oper);
+static inline int flag_is_set(const cpu_s *cpu, uint8_t flag);
 static inline void update_cpu_state(const cpu_s *cpu);
 
 static void (*on_cpu_state_update)(const cpu_state_s *, void *) = NULL;
@@ -476,6 +206,89 @@ static cpu_state_s cpu_state;
 
 // uint16_t (*addr_mode_handlers[])(void)
 
+/* What each opcode does, built from OPCODE_LIST. handler is NULL for
+ * opcodes that aren't implemented.
+ */
+typedef struct opcode_info_s {
+  void (*handler)(cpu_s *, addr_mode_e);
+  addr_mode_e mode;
+  const char *name;
+  const char *mode_name;
+} opcode_info_s;
+
+#define OPCODE_ENTRY(opcode, op, opstr, mode)                                  \
+  [opcode] = {op, mode, opstr, #mode},
+static const opcode_info_s opcode_table[0x100] = {OPCODE_LIST};
+#undef OPCODE_ENTRY
+
+/* decoded prg rom instructions, one record for each address in
+ * 0x8000-0xFFFF, filled the first time the address is run. A record is
+ * only used while memory_code_generation() is the same as when it was
+ * decoded, so it is decoded again after a bank switch or a write to rom.
+ * Code in ram is never cached.
+ */
+typedef struct decoded_op_s {
+  uint32_t generation;
+  uint8_t valid;
+  uint8_t length;
+  /* the opcode, which is the handler index, then the two bytes after it:
+   * the operand, or what is read in a dummy fetch of pc + 1 or pc + 2 */
+  uint8_t bytes[3];
+} decoded_op_s;
+
+static decoded_op_s decoded_ops[0x8000];
+
+/* while an instruction from decoded_ops runs, fetch8 takes its bytes at
+ * cached_pc from cached_bytes instead of the memory map. cached_len is 0
+ * otherwise */
+static uint16_t cached_pc;
+static uint8_t cached_len = 0;
+static const uint8_t *cached_bytes;
+
+static inline const decoded_op_s *decode_lookup(uint16_t pc);
+
+/* idle loop state, see cpu_set_idle_skip() */
+#define IDLE_MAX_LOOP_BYTES 16
+#define IDLE_MAX_OPS 8
+
+typedef struct idle_regs_s {
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t sp;
+  uint8_t flags;
+} idle_regs_s;
+
+typedef struct idle_op_s {
+  uint16_t pc;
+  uint8_t opc;
+  uint8_t cycles;
+  uint8_t real; /* reads a register so always has to be executed */
+  idle_regs_s after;
+} idle_op_s;
+
+typedef enum idle_status_e {
+  IDLE_NONE,
+  IDLE_RECORDING, /* going round a loop for the first time */
+  IDLE_CONFIRMED  /* loop is idle, idle_next is the op at pc */
+} idle_status_e;
+
+static uint8_t idle_skip = 0;
+static idle_status_e idle_status = IDLE_NONE;
+static uint16_t idle_loop_pc;
+static idle_regs_s idle_start; /* registers at idle_loop_pc */
+static idle_op_s idle_ops[IDLE_MAX_OPS];
+static uint8_t idle_n_ops;
+static uint8_t idle_next;
+static uint64_t idle_cycles = 0;
+static uint64_t idle_instructions = 0;
+
+static int idle_fast_forward(cpu_s *cpu);
+static void idle_track(cpu_s *cpu, uint16_t pc, uint16_t cycles_before);
+
+static int debug_begin_exec(const cpu_s *cpu);
+static void cdl_mark_code(const cpu_s *cpu, uint16_t pc);
+
 
 /* This is BRK but no pc increment, B flag not pushed, and goes to NMI handler
  * 0xFFFA */
@@ -487,7 +300,7 @@ static void NMI(cpu_s *cpu) {
   SET_INSTRUCTION(NMI, 0, IMP);
   stack_push(cpu, (cpu->pc & 0xFF00) >> 8);
   stack_push(cpu, cpu->pc & 0xFF);
-  stack_push(cpu, (cpu->flags & ~MASK_NVDIZC) | FLAG_UNUSED);
+  stack_push(cpu, (get_flags(cpu) & ~MASK_NVDIZC) | FLAG_UNUSED);
   cpu->flags = (cpu->flags & MASK_I) | FLAG_INT_DISABLE;
   cpu->pc = fetch16(cpu, 0xFFFA);
   
@@ -501,7 +314,7 @@ static void update_cpu_state(const cpu_s *cpu) {
   cpu_state.a = cpu->a;
   cpu_state.x = cpu->x;
   cpu_state.y = cpu->y;
-  cpu_state.p = cpu->flags;
+  cpu_state.p = get_flags(cpu);
   cpu_state.sp = cpu->sp;
   cpu_state.cycles = cpu->cycles;
   cpu_state.pc = cpu->pc;
@@ -529,6 +342,15 @@ void cpu_register_error_callback(void (*log_error_cb)(const char *, ...)) {
 
 void cpu_unregister_error_callback(void) { log_error = NULL; }
 
+void cpu_set_idle_skip(uint8_t on) {
+  idle_skip = on;
+  idle_status = IDLE_NONE;
+}
+
+uint64_t cpu_get_idle_cycles(void) { return idle_cycles; }
+
+uint64_t cpu_get_idle_instructions(void) { return idle_instructions; }
+
 void cpu_init_harte_test_case(cpu_s *cpu, cpu_state_s *test_case) {
   memset(cpu, 0, sizeof(cpu_s));
   cpu->pc = test_case->pc;
@@ -536,7 +358,7 @@ void cpu_init_harte_test_case(cpu_s *cpu, cpu_state_s *test_case) {
   cpu->x = test_case->x;
   cpu->y = test_case->y;
   cpu->sp = test_case->sp;
-  cpu->flags = test_case->p;
+  set_flags(cpu, test_case->p);
   update_cpu_state(cpu);
 }
 
@@ -549,7 +371,7 @@ int cpu_init_no_alloc(cpu_s *cpu, uint8_t nestest) {
   cpu->x = 0;
   cpu->y = 0;
   cpu->sp = 0xFD;
-  cpu->flags = FLAG_UNUSED | FLAG_INT_DISABLE;
+  set_flags(cpu, FLAG_UNUSED | FLAG_INT_DISABLE);
   cpu->to_oamdma = 0;
   cpu->to_update_flags = 0;
   cpu->to_irq = 0;
@@ -565,6 +387,9 @@ int cpu_init_no_alloc(cpu_s *cpu, uint8_t nestest) {
   }
   SET_INSTRUCTION(JMP, 0x40 + JMP_OFFSET, ABS);
   update_cpu_state(cpu);
+  idle_status = IDLE_NONE;
+  idle_cycles = 0;
+  idle_instructions = 0;
   return E_NO_ERROR;
 }
   
@@ -582,7 +407,7 @@ int cpu_init(cpu_s **p_cpu, uint8_t nestest) {
   cpu->x = 0;
   cpu->y = 0;
   cpu->sp = 0xFD;
-  cpu->flags = FLAG_UNUSED | FLAG_INT_DISABLE;
+  set_flags(cpu, FLAG_UNUSED | FLAG_INT_DISABLE);
   cpu->to_oamdma = 0;
   cpu->to_update_flags = 0;
   cpu->to_irq = 0;
@@ -604,6 +429,9 @@ int cpu_init(cpu_s **p_cpu, uint8_t nestest) {
   }
   SET_INSTRUCTION(JMP, 0x40 + JMP_OFFSET, ABS);
   update_cpu_state(cpu);
+  idle_status = IDLE_NONE;
+  idle_cycles = 0;
+  idle_instructions = 0;
   return E_NO_ERROR;
 }
 
@@ -613,109 +441,109 @@ void cpu_destroy(cpu_s *cpu) { free(cpu); }
  * TODO: Proper interrupt handling
  */
 int cpu_exec(cpu_s *cpu) {
+  PROFILE_SCOPE(PROFILE_CPU_EXEC);
   /*
   if (on_cpu_state_update == NULL || log_error == NULL) {
     return -E_NO_CALLBACK;
     }*/
+  /* before anything changes, so that running it again is the same */
+  if (DEBUG_ARMED() && debug_begin_exec(cpu)) {
+    return CPU_BREAKPOINT;
+  }
 #ifndef DOING_HARTE_TESTS
   update_cpu_state(cpu);
   update_flags(cpu);
 #endif
   if (cpu->to_nmi) {
     NMI(cpu);
+    idle_status = IDLE_NONE;
   }
   /*
   else if (cpu->to_irq) {
     IRQ(cpu);
   }
   */
-  else {
+  else if (idle_skip && !DEBUG_ARMED() && idle_fast_forward(cpu)) {
+    /* skipped to the next nmi, frame or register read */
+  } else {
+    uint16_t pc = cpu->pc;
+    uint16_t cycles_before = cpu->cycles;
+    const decoded_op_s *op = decode_lookup(pc);
+    if (op != NULL) {
+      cached_pc = pc;
+      cached_bytes = op->bytes;
+      cached_len = sizeof(op->bytes);
+    }
     uint8_t opc = fetch8(cpu, cpu->pc++); /* 1 cycle */
     switch (opc) {
-
-      /* Grouped by "sections" in opcode table: */
-
-      /* Mostly ALU instructions */
-      IS_ALU_OPC(ORA)
-      IS_ALU_OPC(AND)
-      IS_ALU_OPC(EOR)
-      IS_ALU_OPC(ADC)
-      IS_ALU_OPC(LDA)
-      IS_ALU_OPC(CMP)
-      IS_ALU_OPC(SBC)
-      IS_STA()
-
-      /* Mostly RMW (read-modify-write) instructions */
-      IS_RMW_OPC(ASL)
-      IS_RMW_OPC(ROL)
-      IS_RMW_OPC(LSR)
-      IS_RMW_OPC(ROR)
-      IS_INC_DEC(DEC)
-      IS_INC_DEC(INC)
-      IS_STX()
-      IS_LDX()
-      IS_OPC(TXA)
-      IS_OPC(TXS)
-      IS_OPC(TAX)
-      IS_OPC(TSX)
-      IS_OPC(DEX)
-      IS_OPC(NOP)
-
-      /* Control instructions, and unique instructions */
-      IS_BRANCH_OPC()
-      IS_OPC(BRK)
-      IS_OPC(PHP)
-      IS_OPC(CLC)
-      IS_OPC(PLP)
-      IS_OPC(SEC)
-      IS_OPC(RTI)
-      IS_OPC(PHA)
-      IS_OPC(CLI)
-      IS_OPC(RTS)
-      IS_OPC(PLA)
-      IS_OPC(SEI)
-      IS_OPC(DEY)
-      IS_OPC(TYA)
-      IS_OPC(TAY)
-      IS_OPC(CLV)
-      IS_OPC(INY)
-      IS_OPC(CLD)
-      IS_OPC(INX)
-      IS_OPC(SED)
-      IS_JMP()
-      IS_JSR()
-      IS_BIT()
-      IS_LDY()
-      IS_STY()
-      IS_CPX_CPY(CPX)
-      IS_CPX_CPY(CPY)
-
-      /* illegal opcodes */
-      IS_ILLEGAL_NOP()
-      IS_LAX()
-      IS_SAX()
-      IS_ILLEGAL_SBC()
-      IS_ILLEGAL_RMW_OPC(DCP)
-      IS_ILLEGAL_RMW_OPC(ISB)
-      IS_ILLEGAL_RMW_OPC(SLO)
-      IS_ILLEGAL_RMW_OPC(RLA)
-      IS_ILLEGAL_RMW_OPC(SRE)
-      IS_ILLEGAL_RMW_OPC(RRA)
-	
+#define OPCODE_ENTRY(opcode, op, opstr, mode)                                  \
+  case (opcode):                                                               \
+    cpu_state.curr_instruction = opstr;                                        \
+    cpu_state.curr_addr_mode = #mode;                                          \
+    cpu_state.opc = opcode;                                                    \
+    op(cpu, mode);                                                             \
+    break;
+      OPCODE_LIST
+#undef OPCODE_ENTRY
     default:
+      cached_len = 0;
       update_cpu_state(cpu);
       on_cpu_state_update(&cpu_state, on_cpu_state_update_data);
       return -E_ILLEGAL_OPC;
     }
+    cached_len = 0;
+    if (CDL_ON()) {
+      cdl_mark_code(cpu, pc);
+    }
+    if (idle_skip) {
+      idle_track(cpu, pc, cycles_before);
+    }
   }
 #ifdef DOING_HARTE_TESTS
   update_flags(cpu);
   update_cpu_state(cpu);
 #endif
   on_cpu_state_update(&cpu_state, on_cpu_state_update_data);
+  if (DEBUG_ARMED() && debug_hit_now) {
+    return CPU_BREAKPOINT;
+  }
   return E_NO_ERROR;
 }
 
+/* the registers and the instruction at pc for the debugger, which returns
+ * nonzero if there is an execute breakpoint there. an nmi about to be
+ * taken isn't an instruction at pc so isn't checked */
+static int debug_begin_exec(const cpu_s *cpu) {
+  uint8_t opc = memory_peek(cpu->pc);
+  const opcode_info_s *info = &opcode_table[opc];
+  cpu_state_s regs = {.pc = cpu->pc,
+                      .cycles = cpu->cycles,
+                      .a = cpu->a,
+                      .x = cpu->x,
+                      .y = cpu->y,
+                      .sp = cpu->sp,
+                      .p = get_flags(cpu),
+                      .opc = opc,
+                      .curr_instruction =
+                          cpu->to_nmi ? "NMI"
+                          : info->handler != NULL ? info->name
+                                                  : "???",
+                      .curr_addr_mode = cpu->to_nmi ? "IMP" : info->mode_name};
+  return debug_begin(&regs, !cpu->to_nmi);
+}
+
+/* log the bytes of the instruction just run from pc as code, and the target
+ * of JMP (indirect) as indirect code */
+static void cdl_mark_code(const cpu_s *cpu, uint16_t pc) {
+  uint8_t len = mode_lengths[opcode_table[cpu_state.opc].mode];
+  for (uint8_t i = 0; i < len; i++) {
+    cdl_mark_prg(pc + i, CDL_CODE);
+  }
+  if (cpu_state.opc == 0x6C) {
+    cdl_mark_prg(cpu->pc, CDL_CODE | CDL_INDIRECT_CODE);
+  }
+}
+
 /*==============================================================================
  *                                HELPER FUNCTIONS
  *==============================================================================
@@ -743,8 +571,70 @@ static inline void update_flags(cpu_s *cpu) {
 #endif
 }
 
+/* With NES_LAZY_FLAGS defined, instructions store the result N and Z come
+ * from in cpu->nz instead of working them out, since most of the time the
+ * next instruction overwrites them anyway. Bits 0-7 are the result (Z if 0,
+ * N if bit 7), and bit 8 is an extra N for BIT, where N comes from the
+ * operand rather than the result. The N and Z bits of cpu->flags are kept
+ * 0, and get_flags() puts them back for anything that reads all the flags.
+ */
+#ifdef NES_LAZY_FLAGS
+static inline uint8_t get_flags(const cpu_s *cpu) {
+  return cpu->flags | (!(cpu->nz & 0xFF) << ZERO_SHIFT) |
+         (((cpu->nz & 0x180) != 0) << NEGATIVE_SHIFT);
+}
+
+static inline void set_flags(cpu_s *cpu, uint8_t flags) {
+  cpu->flags = flags & MASK_NZ;
+  cpu->nz = (!(flags & FLAG_ZERO)) | ((flags & FLAG_NEGATIVE) << 1);
+}
+
+static inline void set_nz(cpu_s *cpu, uint8_t res) { cpu->nz = res; }
+
+static inline void set_nz_bit(cpu_s *cpu, uint8_t oper) {
+  cpu->nz = (oper & cpu->a) | ((oper & FLAG_NEGATIVE) << 1);
+}
+
+static inline int flag_is_set(const cpu_s *cpu, uint8_t flag) {
+  switch (flag) {
+  case FLAG_ZERO:
+    return !(cpu->nz & 0xFF);
+  case FLAG_NEGATIVE:
+    return (cpu->nz & 0x180) != 0;
+  default:
+    return (cpu->flags & flag) != 0;
+  }
+}
+#else
+static inline uint8_t get_flags(const cpu_s *cpu) { return cpu->flags; }
+
+static inline void set_flags(cpu_s *cpu, uint8_t flags) { cpu->flags = flags; }
+
+static inline void set_nz(cpu_s *cpu, uint8_t res) {
+  cpu->flags = (cpu->flags & MASK_NZ) | (!res << ZERO_SHIFT) |
+               (((res & 0x80) != 0) << NEGATIVE_SHIFT);
+}
+
+static inline void set_nz_bit(cpu_s *cpu, uint8_t oper) {
+  cpu->flags = (cpu->flags & MASK_NZ) | (oper & FLAG_NEGATIVE) |
+               (!(oper & cpu->a) << ZERO_SHIFT);
+}
+
+static inline int flag_is_set(const cpu_s *cpu, uint8_t flag) {
+  return (cpu->flags & flag) != 0;
+}
+#endif
+
+/* bytes of the current instruction in prg rom come from its decoded
+ * record. the fetch still takes its cycle and is reported, it just doesn't
+ * go through the memory map */
 static inline uint8_t fetch8(cpu_s *cpu, uint16_t addr) {
   cpu->cycles++;
+  uint16_t offset = addr - cached_pc;
+  if (offset < cached_len) {
+    memory_fetch_known(addr, cached_bytes[offset], &(cpu->to_nmi));
+    return cached_bytes[offset];
+  }
   return memory_fetch(addr, &(cpu->to_nmi));
 }
 
@@ -754,7 +644,21 @@ static inline uint16_t fetch16(cpu_s *cpu, uint16_t addr) {
   return (val_low | val_high << 8);
 }
 
+/* fetch8 for an instruction reading its operand, which the code/data log
+ * counts as data. immediate operands are part of the instruction */
+static inline uint8_t read8(cpu_s *cpu, uint16_t addr, addr_mode_e mode) {
+  if (CDL_ON() && mode != IMM) {
+    cdl_mark_prg(addr, (mode == IND_X || mode == IND_Y || mode == IND_Y_EC)
+                           ? CDL_DATA | CDL_INDIRECT_DATA
+                           : CDL_DATA);
+  }
+  return fetch8(cpu, addr);
+}
+
 static inline void write8(cpu_s *cpu, uint16_t addr, uint8_t val) {
+  if (addr >= 0x8000) { /* could change prg rom, e.g. switching bank */
+    cached_len = 0;
+  }
   memory_write(addr, val, &(cpu->to_oamdma), &(cpu->to_nmi));
   cpu->cycles++;
   /*
@@ -775,6 +679,216 @@ static inline uint8_t stack_pop(cpu_s *cpu) {
   return fetch8(cpu, cpu->sp | (1 << 8));
 }
 
+/* =============================================================================
+ *                             DECODED INSTRUCTIONS
+ * =============================================================================
+ */
+
+/* the record for the instruction at pc, decoding it if it isn't there or is
+ * out of date. NULL if pc isn't in prg rom, or is too near the end of it
+ * for the bytes after the opcode */
+static inline const decoded_op_s *decode_lookup(uint16_t pc) {
+  if (pc < 0x8000 || pc > 0xFFFD) {
+    return NULL;
+  }
+  decoded_op_s *op = &decoded_ops[pc - 0x8000];
+  uint32_t generation = memory_code_generation();
+  if (!op->valid || op->generation != generation) {
+    for (int i = 0; i < 3; i++) {
+      op->bytes[i] = memory_peek(pc + i);
+    }
+    op->length = mode_lengths[opcode_table[op->bytes[0]].mode];
+    op->generation = generation;
+    op->valid = 1;
+  }
+  return op;
+}
+
+int cpu_decode_warmup(void) {
+  size_t size;
+  const uint8_t *log = cdl_prg_log(&size);
+  int n_ops = 0;
+  if (log == NULL) {
+    return 0;
+  }
+  size_t off = 0;
+  while (off < size) {
+    const decoded_op_s *op = NULL;
+    if (log[off] & CDL_CODE) {
+      op = decode_lookup(0x8000 | (log[off] & CDL_PRG_WINDOW) << 11 |
+                         (off & 0x1FFF));
+    }
+    if (op != NULL) {
+      n_ops++;
+      off += op->length;
+    } else {
+      off++;
+    }
+  }
+  return n_ops;
+}
+
+/* =============================================================================
+ *                                 IDLE LOOPS
+ * =============================================================================
+ */
+
+/* A loop is found when a branch or JMP goes back at most IDLE_MAX_LOOP_BYTES.
+ * The next time round, each instruction and the registers after it are
+ * recorded. If that pass made no writes and ends with the same registers it
+ * started with, every later pass does exactly the same thing (ram can't
+ * change, as only the cpu writes to it) until an nmi, or until a register
+ * read returns something different. So the loop is confirmed, and from then
+ * on instructions that only read rom and ram are replaced by stepping the
+ * ppu for their recorded cycles and setting their recorded registers.
+ */
+
+static inline void idle_regs_get(const cpu_s *cpu, idle_regs_s *regs) {
+  regs->a = cpu->a;
+  regs->x = cpu->x;
+  regs->y = cpu->y;
+  regs->sp = cpu->sp;
+  regs->flags = get_flags(cpu);
+}
+
+static inline void idle_regs_set(cpu_s *cpu, const idle_regs_s *regs) {
+  cpu->a = regs->a;
+  cpu->x = regs->x;
+  cpu->y = regs->y;
+  cpu->sp = regs->sp;
+  set_flags(cpu, regs->flags);
+}
+
+static inline int idle_regs_equal(const cpu_s *cpu, const idle_regs_s *regs) {
+  return cpu->a == regs->a && cpu->x == regs->x && cpu->y == regs->y &&
+         cpu->sp == regs->sp && get_flags(cpu) == regs->flags;
+}
+
+static inline int writes_memory(const opcode_info_s *info) {
+  void (*h)(cpu_s *, addr_mode_e) = info->handler;
+  if (h == STA || h == STX || h == STY || h == SAX || h == PHA || h == PHP ||
+      h == JSR || h == BRK) {
+    return 1;
+  }
+  return info->mode != IMP &&
+         (h == ASL || h == ROL || h == LSR || h == ROR || h == INC ||
+          h == DEC || h == DCP || h == ISB || h == SLO || h == RLA ||
+          h == SRE || h == RRA);
+}
+
+/* could the instruction read a ppu, apu or controller register? indirect
+ * modes could read anything, and indexed absolute ones can reach 0x2000 from
+ * the page below */
+static inline int reads_register(const opcode_info_s *info, uint16_t pc) {
+  if (pc >= 0x1FFD && pc < 0x4020) {
+    return 1;
+  }
+  switch (info->mode) {
+  case IND_X:
+  case IND_Y:
+  case IND_Y_EC:
+    return 1;
+  default:
+    break;
+  }
+  if (mode_lengths[info->mode] == 3 && info->handler != JSR &&
+      !(info->handler == JMP && info->mode == ABS)) {
+    uint16_t oper = memory_peek(pc + 1) | (memory_peek(pc + 2) << 8);
+    return (oper >= 0x1F00 && oper < 0x4020);
+  }
+  return 0;
+}
+
+static inline int starts_loop(const opcode_info_s *info, uint16_t pc,
+                              uint16_t next) {
+  return (info->mode == REL || (info->handler == JMP && info->mode == ABS)) &&
+         next <= pc && pc - next < IDLE_MAX_LOOP_BYTES;
+}
+
+/* called after each instruction executed normally. pc is where it started */
+static void idle_track(cpu_s *cpu, uint16_t pc, uint16_t cycles_before) {
+  const opcode_info_s *info = &opcode_table[cpu_state.opc];
+
+  if (idle_status == IDLE_CONFIRMED) {
+    /* a register read, or an op that couldn't be skipped last time. still
+     * idle if it did what it did when the loop was recorded */
+    const idle_op_s *op = &idle_ops[idle_next];
+    uint8_t next = (idle_next + 1) % idle_n_ops;
+    if (pc == op->pc && cpu->pc == idle_ops[next].pc &&
+        idle_regs_equal(cpu, &op->after) && !cpu->to_update_flags) {
+      idle_next = next;
+      return;
+    }
+    idle_status = IDLE_NONE;
+  }
+
+  if (idle_status == IDLE_RECORDING) {
+    if (writes_memory(info) || cpu->to_update_flags ||
+        idle_n_ops == IDLE_MAX_OPS || pc < idle_loop_pc ||
+        pc - idle_loop_pc >= IDLE_MAX_LOOP_BYTES) {
+      idle_status = IDLE_NONE;
+    } else {
+      idle_op_s *op = &idle_ops[idle_n_ops++];
+      op->pc = pc;
+      op->opc = cpu_state.opc;
+      op->cycles = cpu->cycles - cycles_before;
+      op->real = reads_register(info, pc);
+      idle_regs_get(cpu, &op->after);
+      if (cpu->pc == idle_loop_pc) {
+        if (idle_regs_equal(cpu, &idle_start)) {
+          idle_status = IDLE_CONFIRMED;
+          idle_next = 0;
+        } else { /* e.g. a counting loop, try again next time round */
+          idle_regs_get(cpu, &idle_start);
+          idle_n_ops = 0;
+        }
+      }
+      return;
+    }
+  }
+
+  if (starts_loop(info, pc, cpu->pc) && !cpu->to_update_flags) {
+    idle_status = IDLE_RECORDING;
+    idle_loop_pc = cpu->pc;
+    idle_regs_get(cpu, &idle_start);
+    idle_n_ops = 0;
+  }
+}
+
+/* skip ops of a confirmed idle loop from pc, stopping at an op which has to
+ * be executed, a pending nmi, or the end of a frame. returns 0 if nothing
+ * could be skipped */
+static int idle_fast_forward(cpu_s *cpu) {
+  if (idle_status != IDLE_CONFIRMED || cpu->to_update_flags) {
+    return 0;
+  }
+  const idle_op_s *op = &idle_ops[idle_next];
+  const idle_op_s *prev = &idle_ops[(idle_next + idle_n_ops - 1) % idle_n_ops];
+  if (op->real || cpu->pc != op->pc || !idle_regs_equal(cpu, &prev->after)) {
+    return 0;
+  }
+
+  const opcode_info_s *info = &opcode_table[op->opc];
+  cpu_state.curr_instruction = info->name;
+  cpu_state.curr_addr_mode = info->mode_name;
+  cpu_state.opc = op->opc;
+
+  int frame_done;
+  idle_instructions--; /* the cpu state callback is called for the first */
+  do {
+    frame_done = memory_idle_cycles(op->cycles, &(cpu->to_nmi));
+    cpu->cycles += op->cycles;
+    idle_cycles += op->cycles;
+    idle_instructions++;
+    idle_regs_set(cpu, &op->after);
+    idle_next = (idle_next + 1) % idle_n_ops;
+    op = &idle_ops[idle_next];
+    cpu->pc = op->pc;
+  } while (!frame_done && !cpu->to_nmi && !op->real);
+
+  return 1;
+}
+
 /* =============================================================================
  *                              ADDRESSING MODE HANDLERS
  * =============================================================================
@@ -969,14 +1083,13 @@ static void NOP(cpu_s *cpu, addr_mode_e mode) {
  * IND_Y: 2 | 5 (+1)
  */
 static void ADC(cpu_s *cpu, addr_mode_e mode) {
-  uint8_t m = fetch8(cpu, addr_mode_handlers[mode](cpu));
+  uint8_t m = read8(cpu, addr_mode_handlers[mode](cpu), mode);
   uint16_t oper = m + (cpu->flags & FLAG_CARRY);
   uint16_t res = cpu->a + oper;
   uint8_t trunc_res = res & 0xFF;
-  cpu->flags = (cpu->flags & MASK_NVZC) | ((res != trunc_res) << CARRY_SHIFT) |
-               (!trunc_res << ZERO_SHIFT) |
-               (OVERFLOW(cpu->a, m, res) << OVERFLOW_SHIFT) |
-               (NEGATIVE(trunc_res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_VC) | ((res != trunc_res) << CARRY_SHIFT) |
+               (OVERFLOW(cpu->a, m, res) << OVERFLOW_SHIFT);
+  set_nz(cpu, trunc_res);
   cpu->a = trunc_res;
 }
 
@@ -985,13 +1098,12 @@ static void ADC(cpu_s *cpu, addr_mode_e mode) {
  * See ADC
  */
 static void SBC(cpu_s *cpu, addr_mode_e mode) {
-  uint8_t m = fetch8(cpu, addr_mode_handlers[mode](cpu));
+  uint8_t m = read8(cpu, addr_mode_handlers[mode](cpu), mode);
   uint16_t res = cpu->a + (uint8_t)~m + (cpu->flags & FLAG_CARRY);
   uint8_t trunc_res = res & 0xFF;
-  cpu->flags = (cpu->flags & MASK_NVZC) | ((res != trunc_res) << CARRY_SHIFT) |
-               (!trunc_res << ZERO_SHIFT) |
-               (OVERFLOW(cpu->a, ~m, res) << OVERFLOW_SHIFT) |
-               (NEGATIVE(trunc_res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_VC) | ((res != trunc_res) << CARRY_SHIFT) |
+               (OVERFLOW(cpu->a, ~m, res) << OVERFLOW_SHIFT);
+  set_nz(cpu, trunc_res);
   cpu->a = trunc_res;
 }
 
@@ -1007,12 +1119,11 @@ static void SBC(cpu_s *cpu, addr_mode_e mode) {
  */
 static void DEC(cpu_s *cpu, addr_mode_e mode) {
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  uint8_t val = fetch8(cpu, addr);
+  uint8_t val = read8(cpu, addr, mode);
   write8(cpu, addr, val); /* dummy write */
   uint8_t res = val - 1;
   write8(cpu, addr, res);
-  cpu->flags = (cpu->flags & MASK_NZ) | (!res << ZERO_SHIFT) |
-               (NEGATIVE(res) << NEGATIVE_SHIFT);
+  set_nz(cpu, res);
 }
 
 /* DEX (Decrement X)
@@ -1025,8 +1136,7 @@ static void DEC(cpu_s *cpu, addr_mode_e mode) {
 static void DEX(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, addr_mode_handlers[mode](cpu)); /* dummy fetch pc + 1 */
   cpu->x--;
-  cpu->flags = (cpu->flags & MASK_NZ) | (!cpu->x << ZERO_SHIFT) |
-               (NEGATIVE(cpu->x) << NEGATIVE_SHIFT);
+  set_nz(cpu, cpu->x);
 }
 
 /* DEY (Decrement Y)
@@ -1036,8 +1146,7 @@ static void DEX(cpu_s *cpu, addr_mode_e mode) {
 static void DEY(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, addr_mode_handlers[mode](cpu)); /* dummy fetch pc + 1 */
   cpu->y--;
-  cpu->flags = (cpu->flags & MASK_NZ) | (!cpu->y << ZERO_SHIFT) |
-               (NEGATIVE(cpu->y) << NEGATIVE_SHIFT);
+  set_nz(cpu, cpu->y);
 }
 
 /* INC (Increment Memory)
@@ -1046,12 +1155,11 @@ static void DEY(cpu_s *cpu, addr_mode_e mode) {
  */
 static void INC(cpu_s *cpu, addr_mode_e mode) {
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  uint8_t val = fetch8(cpu, addr);
+  uint8_t val = read8(cpu, addr, mode);
   write8(cpu, addr, val); /* dummy write */
   uint8_t res = val + 1;
   write8(cpu, addr, res);
-  cpu->flags = (cpu->flags & MASK_NZ) | (!res << ZERO_SHIFT) |
-               (NEGATIVE(res) << NEGATIVE_SHIFT);
+  set_nz(cpu, res);
 }
 
 /* INX (Increment X)
@@ -1061,8 +1169,7 @@ static void INC(cpu_s *cpu, addr_mode_e mode) {
 static void INX(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, addr_mode_handlers[mode](cpu)); /* dummy fetch pc + 1 */
   cpu->x++;
-  cpu->flags = (cpu->flags & MASK_NZ) | (!cpu->x << ZERO_SHIFT) |
-               (NEGATIVE(cpu->x) << NEGATIVE_SHIFT);
+  set_nz(cpu, cpu->x);
 }
 
 /* INY (Increment Y)
@@ -1072,8 +1179,7 @@ static void INX(cpu_s *cpu, addr_mode_e mode) {
 static void INY(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, addr_mode_handlers[mode](cpu)); /* dummy fetch pc + 1 */
   cpu->y++;
-  cpu->flags = (cpu->flags & MASK_NZ) | (!cpu->y << ZERO_SHIFT) |
-               (NEGATIVE(cpu->y) << NEGATIVE_SHIFT);
+  set_nz(cpu, cpu->y);
 }
 
 /*-----------------------------------------------------------------------------*/
@@ -1095,9 +1201,8 @@ static void INY(cpu_s *cpu, addr_mode_e mode) {
  * IND_Y: 2 | 5 (+1)
  */
 static void AND(cpu_s *cpu, addr_mode_e mode) {
-  cpu->a &= fetch8(cpu, addr_mode_handlers[mode](cpu));
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(cpu->a) << NEGATIVE_SHIFT) |
-               (!cpu->a << ZERO_SHIFT);
+  cpu->a &= read8(cpu, addr_mode_handlers[mode](cpu), mode);
+  set_nz(cpu, cpu->a);
 }
 
 /* ORA (Bitwise OR)
@@ -1105,9 +1210,8 @@ static void AND(cpu_s *cpu, addr_mode_e mode) {
  * See AND
  */
 static void ORA(cpu_s *cpu, addr_mode_e mode) {
-  cpu->a |= fetch8(cpu, addr_mode_handlers[mode](cpu));
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(cpu->a) << NEGATIVE_SHIFT) |
-               (!cpu->a << ZERO_SHIFT);
+  cpu->a |= read8(cpu, addr_mode_handlers[mode](cpu), mode);
+  set_nz(cpu, cpu->a);
 }
 
 /* EOR (Bitwise Exclusive OR)
@@ -1115,9 +1219,8 @@ static void ORA(cpu_s *cpu, addr_mode_e mode) {
  * See AND
  */
 static void EOR(cpu_s *cpu, addr_mode_e mode) {
-  cpu->a ^= fetch8(cpu, addr_mode_handlers[mode](cpu));
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(cpu->a) << NEGATIVE_SHIFT) |
-               (!cpu->a << ZERO_SHIFT);
+  cpu->a ^= read8(cpu, addr_mode_handlers[mode](cpu), mode);
+  set_nz(cpu, cpu->a);
 }
 
 /* BIT: Bit Test
@@ -1129,9 +1232,9 @@ static void EOR(cpu_s *cpu, addr_mode_e mode) {
  * ABS: 3 | 4
  */
 static void BIT(cpu_s *cpu, addr_mode_e mode) {
-  uint8_t oper = fetch8(cpu, addr_mode_handlers[mode](cpu));
-  cpu->flags = (cpu->flags & MASK_NVZ) | (oper & FLAG_NEGATIVE) |
-               (oper & FLAG_OVERFLOW) | (!(oper & cpu->a) << ZERO_SHIFT);
+  uint8_t oper = read8(cpu, addr_mode_handlers[mode](cpu), mode);
+  cpu->flags = (cpu->flags & MASK_V) | (oper & FLAG_OVERFLOW);
+  set_nz_bit(cpu, oper);
 }
 
 /*-----------------------------------------------------------------------------*/
@@ -1159,13 +1262,13 @@ static void ASL(cpu_s *cpu, addr_mode_e mode) {
     res = cpu->a << 1;
     cpu->a = res;
   } else {
-    oper = fetch8(cpu, addr);
+    oper = read8(cpu, addr, mode);
     write8(cpu, addr, oper); /* dummy write */
     res = oper << 1;
     write8(cpu, addr, res);
   }
-  cpu->flags = (cpu->flags & MASK_NZC) | (((oper & 0x80) >> 7) << CARRY_SHIFT) |
-               (!res << ZERO_SHIFT) | (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | (((oper & 0x80) >> 7) << CARRY_SHIFT);
+  set_nz(cpu, res);
 }
 
 /* LSR (Logical Shift Right)
@@ -1181,13 +1284,13 @@ static void LSR(cpu_s *cpu, addr_mode_e mode) {
     res = cpu->a >> 1;
     cpu->a = res;
   } else {
-    oper = fetch8(cpu, addr);
+    oper = read8(cpu, addr, mode);
     write8(cpu, addr, oper); /* dummy write */
     res = oper >> 1;
     write8(cpu, addr, res);
   }
-  cpu->flags = (cpu->flags & MASK_NZC) | ((oper & 0x1) << CARRY_SHIFT) |
-               (!res << ZERO_SHIFT) | (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | ((oper & 0x1) << CARRY_SHIFT);
+  set_nz(cpu, res);
 }
 
 /* ROR (Rotate Right)
@@ -1203,13 +1306,13 @@ static void ROR(cpu_s *cpu, addr_mode_e mode) {
     res = (cpu->a >> 1) | ((cpu->flags & FLAG_CARRY) << (7 - CARRY_SHIFT));
     cpu->a = res;
   } else {
-    oper = fetch8(cpu, addr);
+    oper = read8(cpu, addr, mode);
     write8(cpu, addr, oper); /* dummy write */
     res = (oper >> 1) | ((cpu->flags & FLAG_CARRY) << (7 - CARRY_SHIFT));
     write8(cpu, addr, res);
   }
-  cpu->flags = (cpu->flags & MASK_NZC) | ((oper & 0x1) << CARRY_SHIFT) |
-               (!res << ZERO_SHIFT) | (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | ((oper & 0x1) << CARRY_SHIFT);
+  set_nz(cpu, res);
 }
 
 /* ROL (Rotate Left)
@@ -1225,13 +1328,13 @@ static void ROL(cpu_s *cpu, addr_mode_e mode) {
     res = (cpu->a << 1) | ((cpu->flags & FLAG_CARRY) >> CARRY_SHIFT);
     cpu->a = res;
   } else {
-    oper = fetch8(cpu, addr);
+    oper = read8(cpu, addr, mode);
     write8(cpu, addr, oper); /* dummy write */
     res = (oper << 1) | ((cpu->flags & FLAG_CARRY) >> CARRY_SHIFT);
     write8(cpu, addr, res);
   }
-  cpu->flags = (cpu->flags & MASK_NZC) | (((oper & 0x80) >> 7) << CARRY_SHIFT) |
-               (!res << ZERO_SHIFT) | (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | (((oper & 0x80) >> 7) << CARRY_SHIFT);
+  set_nz(cpu, res);
 }
 
 /*-----------------------------------------------------------------------------*/
@@ -1244,7 +1347,7 @@ static void ROL(cpu_s *cpu, addr_mode_e mode) {
 static inline void branch_flag_clear(cpu_s *cpu, addr_mode_e mode,
                                      uint8_t flag) {
   uint8_t offset = fetch8(cpu, addr_mode_handlers[mode](cpu));
-  if (!(cpu->flags & flag)) {
+  if (!flag_is_set(cpu, flag)) {
     fetch8(cpu, cpu->pc); /* dummy fetch pc + 2 */
     uint16_t page = cpu->pc & 0xFF00;
     cpu->pc += (int8_t)offset;
@@ -1259,7 +1362,7 @@ static inline void branch_flag_clear(cpu_s *cpu, addr_mode_e mode,
 
 static inline void branch_flag_set(cpu_s *cpu, addr_mode_e mode, uint8_t flag) {
   uint8_t offset = fetch8(cpu, addr_mode_handlers[mode](cpu));
-  if (cpu->flags & flag) {
+  if (flag_is_set(cpu, flag)) {
     fetch8(cpu, cpu->pc); /* dummy fetch pc + 2 */
     uint16_t page = cpu->pc & 0xFF00;
     cpu->pc += (int8_t)offset;
@@ -1371,11 +1474,10 @@ static void SEI(cpu_s *cpu, addr_mode_e mode) {
 
 static inline void comparison_instruction(cpu_s *cpu, addr_mode_e mode,
                                           uint8_t reg) {
-  uint8_t oper = fetch8(cpu, addr_mode_handlers[mode](cpu));
+  uint8_t oper = read8(cpu, addr_mode_handlers[mode](cpu), mode);
   uint8_t res = reg - oper;
-  cpu->flags = (cpu->flags & MASK_NZC) | ((reg >= oper) << CARRY_SHIFT) |
-               ((reg == oper) << ZERO_SHIFT) |
-               (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | ((reg >= oper) << CARRY_SHIFT);
+  set_nz(cpu, res);
 }
 
 static void CMP(cpu_s *cpu, addr_mode_e mode) {
@@ -1407,9 +1509,8 @@ static void CPY(cpu_s *cpu, addr_mode_e mode) {
 
 static inline void load_instruction(cpu_s *cpu, addr_mode_e mode,
                                     uint8_t *reg) {
-  *reg = fetch8(cpu, addr_mode_handlers[mode](cpu));
-  cpu->flags = (cpu->flags & MASK_NZ) | (!(*reg) << ZERO_SHIFT) |
-               (NEGATIVE((*reg)) << NEGATIVE_SHIFT);
+  *reg = read8(cpu, addr_mode_handlers[mode](cpu), mode);
+  set_nz(cpu, *reg);
 }
 
 static void LDA(cpu_s *cpu, addr_mode_e mode) {
@@ -1454,8 +1555,7 @@ static inline void transfer_instruction(cpu_s *cpu, addr_mode_e mode,
                                         uint8_t *src, uint8_t *dest) {
   fetch8(cpu, addr_mode_handlers[mode](cpu)); /* dummy fetch pc + 1 */
   *dest = *src;
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(*dest) << NEGATIVE_SHIFT) |
-               (!(*dest) << ZERO_SHIFT);
+  set_nz(cpu, *dest);
 }
 
 static void TAX(cpu_s *cpu, addr_mode_e mode) {
@@ -1514,7 +1614,7 @@ static void BRK(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, cpu->pc); /* dummy fetch pc + 1 (pc again if NMI)*/
   stack_push(cpu, ((cpu->pc + 1) & 0xFF00) >> 8);
   stack_push(cpu, (cpu->pc + 1) & 0xFF);
-  stack_push(cpu, (cpu->flags & ~MASK_NVDIZC) | FLAG_BREAK | FLAG_UNUSED);
+  stack_push(cpu, (get_flags(cpu) & ~MASK_NVDIZC) | FLAG_BREAK | FLAG_UNUSED);
   cpu->flags = (cpu->flags & MASK_I) | FLAG_INT_DISABLE;
   cpu->pc = fetch16(cpu, 0xFFFE);
 }
@@ -1522,7 +1622,7 @@ static void BRK(cpu_s *cpu, addr_mode_e mode) {
 static void RTI(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, cpu->pc);            /* 2x dummy fetch pc + 1 */
   fetch8(cpu, (1 << 8) | cpu->sp); /* dummy fetch stack ? */
-  cpu->flags = (cpu->flags & MASK_NVDIZC) | stack_pop(cpu);
+  set_flags(cpu, (cpu->flags & MASK_NVDIZC) | stack_pop(cpu));
 /* harte tests require break "flag" not set */
 //#ifdef DOING_HARTE_TESTS
   cpu->flags &= ~FLAG_BREAK;
@@ -1542,7 +1642,7 @@ static void PHA(cpu_s *cpu, addr_mode_e mode) {
 
 static void PHP(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, addr_mode_handlers[mode](cpu)); /* dummy fetch pc + 1 */
-  stack_push(cpu, cpu->flags | FLAG_BREAK | FLAG_UNUSED);
+  stack_push(cpu, get_flags(cpu) | FLAG_BREAK | FLAG_UNUSED);
 }
 
 /* Flags: N+ V 1 B D I Z+ C */
@@ -1550,8 +1650,7 @@ static void PLA(cpu_s *cpu, addr_mode_e mode) {
   fetch8(cpu, cpu->pc); /* dummy fetch pc + 1 */
   fetch8(cpu, (1 << 8) | cpu->sp);
   cpu->a = stack_pop(cpu);
-  cpu->flags = (cpu->flags & MASK_NZ) | (!cpu->a << ZERO_SHIFT) |
-               (NEGATIVE(cpu->a) << NEGATIVE_SHIFT);
+  set_nz(cpu, cpu->a);
 }
 
 /* Flags: N+ V+ 1 1 D+ I (+1) Z+ C+ */
@@ -1561,7 +1660,7 @@ static void PLP(cpu_s *cpu, addr_mode_e mode) {
   uint8_t flags = stack_pop(cpu);
   cpu->to_update_flags = 2;
   cpu->new_int_disable_flag = flags & FLAG_INT_DISABLE;
-  cpu->flags = (cpu->flags & MASK_NVDZC) | (flags & ~MASK_NVDZC);
+  set_flags(cpu, (cpu->flags & MASK_NVDZC) | (flags & ~MASK_NVDZC));
 }
 
 /*=================================ILLEGAL
@@ -1572,8 +1671,7 @@ static void PLP(cpu_s *cpu, addr_mode_e mode) {
 static void LAX(cpu_s *cpu, addr_mode_e mode) {
   LDX(cpu, mode);
   cpu->a = cpu->x;
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(cpu->a) << NEGATIVE_SHIFT) |
-               (!(cpu->a) << ZERO_SHIFT);
+  set_nz(cpu, cpu->a);
 }
 
 static void SAX(cpu_s *cpu, addr_mode_e mode) {
@@ -1583,38 +1681,34 @@ static void SAX(cpu_s *cpu, addr_mode_e mode) {
 static void DCP(cpu_s *cpu, addr_mode_e mode) {
   /* dec */
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  uint8_t val = fetch8(cpu, addr);
+  uint8_t val = read8(cpu, addr, mode);
   write8(cpu, addr, val); /* dummy write */
   uint8_t res = val - 1;
   write8(cpu, addr, res);
-  cpu->flags = (cpu->flags & MASK_NZ) | (!res << ZERO_SHIFT) |
-               (NEGATIVE(res) << NEGATIVE_SHIFT);
+  set_nz(cpu, res);
   /* cmp */
   uint8_t reg = cpu->a;
   uint8_t oper = res;
   res = reg - oper;
-  cpu->flags = (cpu->flags & MASK_NZC) | ((reg >= oper) << CARRY_SHIFT) |
-               ((reg == oper) << ZERO_SHIFT) |
-               (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | ((reg >= oper) << CARRY_SHIFT);
+  set_nz(cpu, res);
 }
 
 static void ISB(cpu_s *cpu, addr_mode_e mode) {
   /* inc */
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  uint8_t val = fetch8(cpu, addr);
+  uint8_t val = read8(cpu, addr, mode);
   write8(cpu, addr, val); /* dummy write */
   uint8_t inc_res = val + 1;
   write8(cpu, addr, inc_res);
-  cpu->flags = (cpu->flags & MASK_NZ) | (!inc_res << ZERO_SHIFT) |
-               (NEGATIVE(inc_res) << NEGATIVE_SHIFT);
+  set_nz(cpu, inc_res);
   /* sbc */
   uint8_t m = inc_res;
   uint16_t res = cpu->a + (uint8_t)~m + (cpu->flags & FLAG_CARRY);
   uint8_t trunc_res = res & 0xFF;
-  cpu->flags = (cpu->flags & MASK_NVZC) | (((res >> 8) & 1) << CARRY_SHIFT) |
-               (!trunc_res << ZERO_SHIFT) |
-               (OVERFLOW(cpu->a, ~m, res) << OVERFLOW_SHIFT) |
-               (NEGATIVE(trunc_res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_VC) | (((res >> 8) & 1) << CARRY_SHIFT) |
+               (OVERFLOW(cpu->a, ~m, res) << OVERFLOW_SHIFT);
+  set_nz(cpu, trunc_res);
   cpu->a = trunc_res;
 }
 
@@ -1622,69 +1716,65 @@ static void SLO(cpu_s *cpu, addr_mode_e mode) {
   /* asl */
   uint8_t oper, res;
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  oper = fetch8(cpu, addr);
+  oper = read8(cpu, addr, mode);
   write8(cpu, addr, oper);
   res = oper << 1;
   write8(cpu, addr, res);
-  cpu->flags = (cpu->flags & MASK_NZC) | (((oper & 0x80) >> 7) << CARRY_SHIFT) |
-               (!res << ZERO_SHIFT) | (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | (((oper & 0x80) >> 7) << CARRY_SHIFT);
+  set_nz(cpu, res);
   /* ora */
   cpu->a |= res;
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(cpu->a) << NEGATIVE_SHIFT) |
-               (!cpu->a << ZERO_SHIFT);
+  set_nz(cpu, cpu->a);
 }
 
 static void RLA(cpu_s *cpu, addr_mode_e mode) {
   /* ROL */
   uint8_t oper, res;
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  oper = fetch8(cpu, addr);
+  oper = read8(cpu, addr, mode);
   write8(cpu, addr, oper);
   res = (oper << 1) | ((cpu->flags & FLAG_CARRY) >> CARRY_SHIFT);
   write8(cpu, addr, res);
-  cpu->flags = (cpu->flags & MASK_NZC) | (((oper & 0x80) >> 7) << CARRY_SHIFT) |
-               (!res << ZERO_SHIFT) | (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | (((oper & 0x80) >> 7) << CARRY_SHIFT);
+  set_nz(cpu, res);
   /* AND */
   cpu->a &= res;
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(cpu->a) << NEGATIVE_SHIFT) |
-               (!cpu->a << ZERO_SHIFT);
+  set_nz(cpu, cpu->a);
 }
 
 static void SRE(cpu_s *cpu, addr_mode_e mode) {
   /* lsr */
   uint8_t oper, res;
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  oper = fetch8(cpu, addr);
+  oper = read8(cpu, addr, mode);
   write8(cpu, addr, oper); /* dummy write */
   res = oper >> 1;
   write8(cpu, addr, res);
-  cpu->flags = (cpu->flags & MASK_NZC) | ((oper & 0x1) << CARRY_SHIFT) |
-               (!res << ZERO_SHIFT) | (NEGATIVE(res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | ((oper & 0x1) << CARRY_SHIFT);
+  set_nz(cpu, res);
 
   /* eor */
   cpu->a ^= res;
-  cpu->flags = (cpu->flags & MASK_NZ) | (NEGATIVE(cpu->a) << NEGATIVE_SHIFT) |
-               (!cpu->a << ZERO_SHIFT);
+  set_nz(cpu, cpu->a);
 }
 
 static void RRA(cpu_s *cpu, addr_mode_e mode) {
   /* ror */
   uint8_t oper, ror_res;
   uint16_t addr = addr_mode_handlers[mode](cpu);
-  oper = fetch8(cpu, addr);
+  oper = read8(cpu, addr, mode);
   write8(cpu, addr, oper); /* dummy write */
   ror_res = (oper >> 1) | ((cpu->flags & FLAG_CARRY) << (7 - CARRY_SHIFT));
   write8(cpu, addr, ror_res);
-  cpu->flags = (cpu->flags & MASK_NZC) | ((oper & 0x1) << CARRY_SHIFT) |
-               (!ror_res << ZERO_SHIFT) | (NEGATIVE(ror_res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_C) | ((oper & 0x1) << CARRY_SHIFT);
+  set_nz(cpu, ror_res);
 
   /* adc */
   uint8_t m = ror_res;
   uint16_t res = cpu->a + (uint8_t)m + (cpu->flags & FLAG_CARRY);
   uint8_t trunc_res = res & 0xFF;
-  cpu->flags = (cpu->flags & MASK_NVZC) | ((res != trunc_res) << CARRY_SHIFT) |
-               (!trunc_res << ZERO_SHIFT) |
-               (OVERFLOW(cpu->a, m, res) << OVERFLOW_SHIFT) |
-               (NEGATIVE(trunc_res) << NEGATIVE_SHIFT);
+  cpu->flags = (cpu->flags & MASK_VC) | ((res != trunc_res) << CARRY_SHIFT) |
+               (OVERFLOW(cpu->a, m, res) << OVERFLOW_SHIFT);
+  set_nz(cpu, trunc_res);
   cpu->a = trunc_res;
 }
@@ -0,0 +1,320 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/debug.h"
+#include "core/errors.h"
+#include "debugp.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*======================Global State============================*/
+
+static debug_breakpoint_s breakpoints[DEBUG_MAX_BREAKPOINTS];
+static uint8_t breakpoint_used[DEBUG_MAX_BREAKPOINTS] = {0};
+
+/* a bit for every address that has a breakpoint of each kind, the
+ * conditions are only looked at if the bit is set */
+static uint8_t bitmaps[DEBUG_N_ACCESS][0x10000 / 8];
+
+uint8_t debug_armed = 0;
+uint8_t debug_hit_now = 0;
+
+/* at the start of the current instruction */
+static cpu_state_s regs;
+
+static debug_hit_s last_hit;
+static uint8_t have_hit = 0;
+
+/* pc of the execute breakpoint just hit, which the next instruction
+ * doesn't hit again, so that calling cpu_exec again carries on. -1 if
+ * none */
+static int32_t skip_pc = -1;
+
+static void rebuild_bitmaps(void);
+static int valid(const debug_breakpoint_s *breakpoint);
+static int condition_holds(const debug_breakpoint_s *breakpoint, uint8_t val);
+static int find_hit(debug_access_e access, uint16_t addr, uint8_t val);
+static const char *parse_number(const char *text, uint16_t *n);
+
+static inline int bit_set(debug_access_e access, uint16_t addr) {
+  return bitmaps[access][addr >> 3] & (1 << (addr & 7));
+}
+
+/*======================Global Functions==========================*/
+
+int debug_add(const debug_breakpoint_s *breakpoint) {
+  if (!valid(breakpoint)) {
+    return -E_DEBUG_BREAKPOINT;
+  }
+  for (int id = 0; id < DEBUG_MAX_BREAKPOINTS; id++) {
+    if (!breakpoint_used[id]) {
+      breakpoints[id] = *breakpoint;
+      breakpoint_used[id] = 1;
+      rebuild_bitmaps();
+      return id;
+    }
+  }
+  return -E_DEBUG_FULL;
+}
+
+int debug_remove(int id) {
+  if (id < 0 || id >= DEBUG_MAX_BREAKPOINTS || !breakpoint_used[id]) {
+    return -E_DEBUG_BREAKPOINT;
+  }
+  breakpoint_used[id] = 0;
+  rebuild_bitmaps();
+  return E_NO_ERROR;
+}
+
+void debug_clear(void) {
+  memset(breakpoint_used, 0, sizeof(breakpoint_used));
+  rebuild_bitmaps();
+  have_hit = 0;
+  debug_hit_now = 0;
+  skip_pc = -1;
+}
+
+int debug_parse(const char *text, debug_breakpoint_s *breakpoint) {
+  static const struct {
+    const char *name;
+    debug_reg_e reg;
+  } reg_names[] = {{"a", DEBUG_REG_A},   {"x", DEBUG_REG_X},
+                   {"y", DEBUG_REG_Y},   {"sp", DEBUG_REG_SP},
+                   {"p", DEBUG_REG_P},   {"val", DEBUG_REG_VALUE}};
+  static const struct {
+    const char *name;
+    debug_cmp_e cmp;
+  } cmp_names[] = {{"==", DEBUG_CMP_EQ}, {"!=", DEBUG_CMP_NE},
+                   {">=", DEBUG_CMP_GE}, {"<", DEBUG_CMP_LT},
+                   {"&", DEBUG_CMP_AND}};
+  debug_breakpoint_s b = {.reg = DEBUG_REG_NONE, .cmp = DEBUG_CMP_EQ};
+
+  while (isspace((unsigned char)*text)) {
+    text++;
+  }
+  switch (tolower((unsigned char)*text++)) {
+  case 'x':
+    b.access = DEBUG_EXEC;
+    break;
+  case 'r':
+    b.access = DEBUG_READ;
+    break;
+  case 'w':
+    b.access = DEBUG_WRITE;
+    break;
+  default:
+    return -E_DEBUG_BREAKPOINT;
+  }
+  if ((text = parse_number(text, &b.first)) == NULL) {
+    return -E_DEBUG_BREAKPOINT;
+  }
+  b.last = b.first;
+  if (*text == '-' && (text = parse_number(text + 1, &b.last)) == NULL) {
+    return -E_DEBUG_BREAKPOINT;
+  }
+
+  while (isspace((unsigned char)*text)) {
+    text++;
+  }
+  if (strncmp(text, "if", 2) == 0 && isspace((unsigned char)text[2])) {
+    text += 2;
+    while (isspace((unsigned char)*text)) {
+      text++;
+    }
+    size_t len = 0;
+    while (isalpha((unsigned char)text[len])) {
+      len++;
+    }
+    for (size_t i = 0; i < sizeof(reg_names) / sizeof(reg_names[0]); i++) {
+      if (strlen(reg_names[i].name) == len &&
+          strncmp(text, reg_names[i].name, len) == 0) {
+        b.reg = reg_names[i].reg;
+      }
+    }
+    if (b.reg == DEBUG_REG_NONE) {
+      return -E_DEBUG_BREAKPOINT;
+    }
+    text += len;
+    while (isspace((unsigned char)*text)) {
+      text++;
+    }
+    size_t i;
+    for (i = 0; i < sizeof(cmp_names) / sizeof(cmp_names[0]); i++) {
+      size_t n = strlen(cmp_names[i].name);
+      if (strncmp(text, cmp_names[i].name, n) == 0) {
+        b.cmp = cmp_names[i].cmp;
+        text += n;
+        break;
+      }
+    }
+    uint16_t val;
+    if (i == sizeof(cmp_names) / sizeof(cmp_names[0]) ||
+        (text = parse_number(text, &val)) == NULL || val > 0xFF) {
+      return -E_DEBUG_BREAKPOINT;
+    }
+    b.val = val;
+  }
+
+  while (isspace((unsigned char)*text)) {
+    text++;
+  }
+  if (*text != '\0' || !valid(&b)) {
+    return -E_DEBUG_BREAKPOINT;
+  }
+  *breakpoint = b;
+  return E_NO_ERROR;
+}
+
+int debug_get_hit(debug_hit_s *hit) {
+  if (!have_hit) {
+    return 0;
+  }
+  *hit = last_hit;
+  return 1;
+}
+
+/*======================Private header functions============================*/
+
+int debug_begin(const cpu_state_s *cpu_regs, int check_exec) {
+  regs = *cpu_regs;
+  debug_hit_now = 0;
+  if (!check_exec) {
+    return 0;
+  }
+  if (skip_pc >= 0) {
+    int skip = (skip_pc == regs.pc);
+    skip_pc = -1;
+    if (skip) {
+      return 0;
+    }
+  }
+  if (bit_set(DEBUG_EXEC, regs.pc) && find_hit(DEBUG_EXEC, regs.pc, 0)) {
+    skip_pc = regs.pc;
+    return 1;
+  }
+  return 0;
+}
+
+void debug_access(debug_access_e access, uint16_t addr, uint8_t val) {
+  if (bit_set(access, addr)) {
+    find_hit(access, addr, val);
+  }
+}
+
+/*==========================Static functions=================================*/
+
+static void rebuild_bitmaps(void) {
+  memset(bitmaps, 0, sizeof(bitmaps));
+  debug_armed = 0;
+  for (int id = 0; id < DEBUG_MAX_BREAKPOINTS; id++) {
+    if (!breakpoint_used[id]) {
+      continue;
+    }
+    const debug_breakpoint_s *b = &breakpoints[id];
+    for (uint32_t addr = b->first; addr <= b->last; addr++) {
+      bitmaps[b->access][addr >> 3] |= 1 << (addr & 7);
+    }
+    debug_armed = 1;
+  }
+}
+
+static int valid(const debug_breakpoint_s *b) {
+  return b->access < DEBUG_N_ACCESS && b->first <= b->last &&
+         b->reg <= DEBUG_REG_VALUE && b->cmp <= DEBUG_CMP_AND &&
+         !(b->access == DEBUG_EXEC && b->reg == DEBUG_REG_VALUE);
+}
+
+static int condition_holds(const debug_breakpoint_s *b, uint8_t val) {
+  uint8_t lhs;
+  switch (b->reg) {
+  case DEBUG_REG_NONE:
+    return 1;
+  case DEBUG_REG_A:
+    lhs = regs.a;
+    break;
+  case DEBUG_REG_X:
+    lhs = regs.x;
+    break;
+  case DEBUG_REG_Y:
+    lhs = regs.y;
+    break;
+  case DEBUG_REG_SP:
+    lhs = regs.sp;
+    break;
+  case DEBUG_REG_P:
+    lhs = regs.p;
+    break;
+  default:
+    lhs = val;
+    break;
+  }
+  switch (b->cmp) {
+  case DEBUG_CMP_EQ:
+    return lhs == b->val;
+  case DEBUG_CMP_NE:
+    return lhs != b->val;
+  case DEBUG_CMP_LT:
+    return lhs < b->val;
+  case DEBUG_CMP_GE:
+    return lhs >= b->val;
+  default:
+    return (lhs & b->val) != 0;
+  }
+}
+
+/* the first hit of an instruction is the one kept */
+static int find_hit(debug_access_e access, uint16_t addr, uint8_t val) {
+  for (int id = 0; id < DEBUG_MAX_BREAKPOINTS; id++) {
+    const debug_breakpoint_s *b = &breakpoints[id];
+    if (breakpoint_used[id] && b->access == access && addr >= b->first &&
+        addr <= b->last && condition_holds(b, val)) {
+      if (!debug_hit_now) {
+        last_hit.id = id;
+        last_hit.access = access;
+        last_hit.addr = addr;
+        last_hit.val = val;
+        last_hit.regs = regs;
+        have_hit = 1;
+        debug_hit_now = 1;
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* hex number up to 0xFFFF after any spaces and an optional $, returning
+ * where it ends or NULL if there isn't one */
+static const char *parse_number(const char *text, uint16_t *n) {
+  while (isspace((unsigned char)*text)) {
+    text++;
+  }
+  if (*text == '$') {
+    text++;
+  }
+  if (!isxdigit((unsigned char)*text)) {
+    return NULL;
+  }
+  char *end;
+  unsigned long val = strtoul(text, &end, 16);
+  if (val > 0xFFFF) {
+    return NULL;
+  }
+  *n = val;
+  return end;
+}
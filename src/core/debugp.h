@@ -0,0 +1,36 @@
+#ifndef DEBUGP_H_
+#define DEBUGP_H_
+
+#include "core/debug.h"
+#include <stdint.h>
+
+/* nonzero while any breakpoint is set */
+extern uint8_t debug_armed;
+
+/* nonzero if a breakpoint has been hit since the last debug_begin */
+extern uint8_t debug_hit_now;
+
+/* called by cpu_exec before each instruction, or nmi with check_exec 0,
+ * with the registers as they are. returns nonzero if there is an execute
+ * breakpoint at regs->pc, in which case the instruction shouldn't run */
+int debug_begin(const cpu_state_s *regs, int check_exec);
+
+/* called by memory_fetch and memory_write */
+void debug_access(debug_access_e access, uint16_t addr, uint8_t val);
+
+/* DEBUG_ARMED() is a branch that is never taken without breakpoints, and
+ * nothing at all in the harte tests build */
+#ifdef DOING_HARTE_TESTS
+#define DEBUG_ARMED() 0
+#else
+#define DEBUG_ARMED() __builtin_expect(debug_armed, 0)
+#endif
+
+#define DEBUG_ACCESS(access, addr, val)                                        \
+  do {                                                                         \
+    if (DEBUG_ARMED()) {                                                       \
+      debug_access(access, addr, val);                                         \
+    }                                                                          \
+  } while (0)
+
+#endif
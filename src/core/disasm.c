@@ -0,0 +1,367 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/disasm.h"
+#include "core/errors.h"
+#include "memoryp.h"
+#include "opcodesp.h"
+
+/* name and addressing mode of each opcode, built from OPCODE_LIST. name is
+ * NULL for opcodes the cpu doesn't implement */
+typedef struct disasm_opcode_s {
+  const char *name;
+  addr_mode_e mode;
+} disasm_opcode_s;
+
+#define OPCODE_ENTRY(opcode, op, opstr, mode) [opcode] = {opstr, mode},
+static const disasm_opcode_s opcodes[0x100] = {OPCODE_LIST};
+#undef OPCODE_ENTRY
+
+#define MAX_SEGMENT_SIZE 0x4000
+
+static const struct {
+  uint16_t start;
+  uint16_t size;
+  uint8_t banked;
+} segments[DISASM_N_SEGMENTS] = {{0x0000, 0x0800, 0},
+                                 {0x6000, 0x2000, 0},
+                                 {0x8000, 0x4000, 1},
+                                 {0xC000, 0x4000, 1}};
+
+/* the listing of one segment with one bank mapped */
+typedef struct listing_s {
+  uint8_t valid;
+  uint16_t bank;
+  uint32_t last_used;
+  size_t n_lines;
+  disasm_line_s *lines;
+  /* what the lines were decoded from */
+  uint8_t bytes[MAX_SEGMENT_SIZE];
+  /* a bit for each pc seen, which instructions mustn't run over */
+  uint8_t starts[MAX_SEGMENT_SIZE / 8];
+} listing_s;
+
+struct disasm_s {
+  /* the ram segments only use the first slot */
+  listing_s *slots[DISASM_N_SEGMENTS][DISASM_CACHED_BANKS];
+  listing_s *current[DISASM_N_SEGMENTS];
+  /* decoded into, then swapped with the listing's lines */
+  disasm_line_s *scratch;
+  uint32_t clock;
+};
+
+static inline int is_start(const listing_s *l, size_t off) {
+  return l->starts[off >> 3] & (1 << (off & 7));
+}
+
+/* decode the instruction at off in l->bytes, size long, as data if it would
+ * run off the end or over a known instruction start */
+static void decode_at(const listing_s *l, size_t size, uint16_t start,
+                      size_t off, disasm_line_s *line) {
+  const disasm_opcode_s *op = &opcodes[l->bytes[off]];
+  size_t len = (op->name != NULL) ? mode_lengths[op->mode] : 1;
+  if (off + len > size) {
+    len = 1;
+  }
+  for (size_t i = 1; i < len; i++) {
+    if (is_start(l, off + i)) {
+      len = 1;
+      break;
+    }
+  }
+  line->addr = start + off;
+  line->len = len;
+  for (size_t i = 0; i < 3; i++) {
+    line->bytes[i] = (i < len) ? l->bytes[off + i] : 0;
+  }
+}
+
+/* index of the line off is part of. lines cover the whole segment */
+static size_t line_index(const listing_s *l, uint16_t start, size_t off) {
+  size_t lo = 0, hi = l->n_lines;
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if ((size_t)(uint16_t)(l->lines[mid].addr - start) <= off) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/* decode again from the line first is in until past last and back at the
+ * start of an old line, keeping the old lines either side */
+static void redecode(disasm_s *d, listing_s *l, int segment, size_t first,
+                     size_t last) {
+  uint16_t start = segments[segment].start;
+  size_t size = segments[segment].size;
+  size_t n = (l->n_lines > 0) ? line_index(l, start, first) : 0;
+  size_t off = (l->n_lines > 0) ? (uint16_t)(l->lines[n].addr - start) : 0;
+  memcpy(d->scratch, l->lines, n * sizeof(disasm_line_s));
+
+  size_t old = n;
+  while (off < size) {
+    while (old < l->n_lines && (uint16_t)(l->lines[old].addr - start) < off) {
+      old++;
+    }
+    if (off > last && old < l->n_lines &&
+        (uint16_t)(l->lines[old].addr - start) == off) {
+      memcpy(&d->scratch[n], &l->lines[old],
+             (l->n_lines - old) * sizeof(disasm_line_s));
+      n += l->n_lines - old;
+      break;
+    }
+    decode_at(l, size, start, off, &d->scratch[n]);
+    off += d->scratch[n].len;
+    n++;
+  }
+
+  disasm_line_s *lines = l->lines;
+  l->lines = d->scratch;
+  l->n_lines = n;
+  d->scratch = lines;
+}
+
+/* the cached listing of bank in segment, or the least recently used slot
+ * emptied for it. NULL if a new slot can't be allocated */
+static listing_s *find_listing(disasm_s *d, int segment, uint16_t bank) {
+  int n_slots = segments[segment].banked ? DISASM_CACHED_BANKS : 1;
+  listing_s *oldest = NULL;
+  for (int i = 0; i < n_slots; i++) {
+    listing_s *l = d->slots[segment][i];
+    if (l == NULL) {
+      if ((l = calloc(1, sizeof(listing_s))) == NULL) {
+        return NULL;
+      }
+      if ((l->lines = malloc(MAX_SEGMENT_SIZE * sizeof(disasm_line_s))) ==
+          NULL) {
+        free(l);
+        return NULL;
+      }
+      d->slots[segment][i] = l;
+      return l;
+    }
+    if (l->valid && l->bank == bank) {
+      return l;
+    }
+    if (oldest == NULL || l->last_used < oldest->last_used) {
+      oldest = l;
+    }
+  }
+  oldest->valid = 0;
+  return oldest;
+}
+
+int disasm_create(disasm_s **disasm) {
+  disasm_s *d = calloc(1, sizeof(disasm_s));
+  if (d == NULL) {
+    return -E_MALLOC;
+  }
+  if ((d->scratch = malloc(MAX_SEGMENT_SIZE * sizeof(disasm_line_s))) ==
+      NULL) {
+    free(d);
+    return -E_MALLOC;
+  }
+  *disasm = d;
+  return E_NO_ERROR;
+}
+
+void disasm_destroy(disasm_s *disasm) {
+  if (disasm == NULL) {
+    return;
+  }
+  for (int s = 0; s < DISASM_N_SEGMENTS; s++) {
+    for (int i = 0; i < DISASM_CACHED_BANKS; i++) {
+      if (disasm->slots[s][i] != NULL) {
+        free(disasm->slots[s][i]->lines);
+        free(disasm->slots[s][i]);
+      }
+    }
+  }
+  free(disasm->scratch);
+  free(disasm);
+}
+
+int disasm_decode(const uint8_t *mem, uint16_t addr, disasm_line_s *line) {
+  const disasm_opcode_s *op = &opcodes[mem[addr]];
+  int len = (op->name != NULL) ? mode_lengths[op->mode] : 1;
+  line->addr = addr;
+  line->len = len;
+  for (int i = 0; i < 3; i++) {
+    line->bytes[i] = (i < len) ? mem[(uint16_t)(addr + i)] : 0;
+  }
+  return len;
+}
+
+void disasm_format(const disasm_line_s *line, char *text, size_t text_len) {
+  const disasm_opcode_s *op = &opcodes[line->bytes[0]];
+  if (op->name == NULL || mode_lengths[op->mode] != line->len) {
+    snprintf(text, text_len, ".db $%02x", line->bytes[0]);
+    return;
+  }
+  uint8_t zp = line->bytes[1];
+  uint16_t abs = line->bytes[1] | line->bytes[2] << 8;
+  switch (op->mode) {
+  case IMP:
+    snprintf(text, text_len, "%s", op->name);
+    break;
+  case IMM:
+    snprintf(text, text_len, "%s #$%02x", op->name, zp);
+    break;
+  case REL:
+    snprintf(text, text_len, "%s $%04x", op->name,
+             (uint16_t)(line->addr + 2 + (int8_t)zp));
+    break;
+  case ZP:
+    snprintf(text, text_len, "%s $%02x", op->name, zp);
+    break;
+  case ZP_X:
+    snprintf(text, text_len, "%s $%02x,X", op->name, zp);
+    break;
+  case ZP_Y:
+    snprintf(text, text_len, "%s $%02x,Y", op->name, zp);
+    break;
+  case ABS:
+    snprintf(text, text_len, "%s $%04x", op->name, abs);
+    break;
+  case ABS_X:
+  case ABS_X_EC:
+    snprintf(text, text_len, "%s $%04x,X", op->name, abs);
+    break;
+  case ABS_Y:
+  case ABS_Y_EC:
+    snprintf(text, text_len, "%s $%04x,Y", op->name, abs);
+    break;
+  case ABS_IND:
+    snprintf(text, text_len, "%s ($%04x)", op->name, abs);
+    break;
+  case IND_X:
+    snprintf(text, text_len, "%s ($%02x,X)", op->name, zp);
+    break;
+  case IND_Y:
+  case IND_Y_EC:
+    snprintf(text, text_len, "%s ($%02x),Y", op->name, zp);
+    break;
+  }
+}
+
+void disasm_get_banks(uint16_t *banks) {
+  for (int s = 0; s < DISASM_N_SEGMENTS; s++) {
+    banks[s] = segments[s].banked ? memory_prg_bank(segments[s].start) : 0;
+  }
+}
+
+int disasm_update(disasm_s *disasm, const uint8_t *mem, const uint16_t *banks,
+                  uint16_t pc) {
+  int changed = 0;
+  disasm->clock++;
+  for (int s = 0; s < DISASM_N_SEGMENTS; s++) {
+    uint16_t start = segments[s].start;
+    size_t size = segments[s].size;
+    uint16_t bank = segments[s].banked ? banks[s] : 0;
+    const uint8_t *bytes = mem + start;
+    listing_s *l = find_listing(disasm, s, bank);
+    if (l == NULL) {
+      return -E_MALLOC;
+    }
+
+    /* the range of bytes to decode again */
+    size_t first = size, last = 0;
+    if (!l->valid) {
+      l->valid = 1;
+      l->bank = bank;
+      l->n_lines = 0;
+      memset(l->starts, 0, sizeof(l->starts));
+      first = 0;
+      last = size - 1;
+    } else if (memcmp(l->bytes, bytes, size) != 0) {
+      for (first = 0; l->bytes[first] == bytes[first]; first++)
+        ;
+      for (last = size - 1; l->bytes[last] == bytes[last]; last--)
+        ;
+    }
+    if (first <= last) {
+      memcpy(l->bytes, bytes, size);
+    }
+
+    size_t pc_off = (uint16_t)(pc - start);
+    if (pc_off < size && !is_start(l, pc_off)) {
+      l->starts[pc_off >> 3] |= 1 << (pc_off & 7);
+      if (l->n_lines > 0 &&
+          (uint16_t)(l->lines[line_index(l, start, pc_off)].addr - start) !=
+              pc_off) {
+        first = (pc_off < first) ? pc_off : first;
+        last = (pc_off > last) ? pc_off : last;
+      }
+    }
+
+    if (first <= last) {
+      redecode(disasm, l, s, first, last);
+      changed = 1;
+    }
+    if (disasm->current[s] != l) {
+      disasm->current[s] = l;
+      changed = 1;
+    }
+    l->last_used = disasm->clock;
+  }
+  return changed;
+}
+
+size_t disasm_n_lines(const disasm_s *disasm) {
+  size_t n = 0;
+  for (int s = 0; s < DISASM_N_SEGMENTS; s++) {
+    if (disasm->current[s] != NULL) {
+      n += disasm->current[s]->n_lines;
+    }
+  }
+  return n;
+}
+
+const disasm_line_s *disasm_get_line(const disasm_s *disasm, size_t i) {
+  for (int s = 0; s < DISASM_N_SEGMENTS; s++) {
+    const listing_s *l = disasm->current[s];
+    if (l == NULL) {
+      continue;
+    }
+    if (i < l->n_lines) {
+      return &l->lines[i];
+    }
+    i -= l->n_lines;
+  }
+  return NULL;
+}
+
+long disasm_find_line(const disasm_s *disasm, uint16_t addr) {
+  size_t before = 0;
+  for (int s = 0; s < DISASM_N_SEGMENTS; s++) {
+    const listing_s *l = disasm->current[s];
+    if (l == NULL) {
+      continue;
+    }
+    size_t off = (uint16_t)(addr - segments[s].start);
+    if (off < segments[s].size) {
+      return before + line_index(l, segments[s].start, off);
+    }
+    before += l->n_lines;
+  }
+  return -1;
+}
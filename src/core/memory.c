@@ -20,6 +20,9 @@
 #include "memoryp.h"
 #include "ppup.h"
 #include "controllerp.h"
+#include "profilep.h"
+#include "debugp.h"
+#include "cdlp.h"
 #include "core/memory.h"
 #include "core/errors.h"
 
@@ -55,6 +58,7 @@ static int init_mapper_0(ines_header_s *header_data, FILE *fp, char *e_context);
 static inline void do_three_ppu_steps(uint8_t *to_nmi);
 static inline uint8_t vram_fetch(uint16_t addr);
 static inline void vram_write(uint16_t addr, uint8_t val);
+static inline uint16_t vram_index(uint16_t addr);
 static inline uint16_t nametable_horizontal(uint16_t addr);
 static inline uint16_t nametable_vertical(uint16_t addr);
 
@@ -99,6 +103,9 @@ static void *on_fetch_data = NULL;
 static void *on_write_data = NULL;
 static uint16_t (*nametable_mirror)(uint16_t addr) = NULL;
 
+/* see memory_code_generation() */
+uint32_t memory_code_gen = 0;
+
 /*======================Global Functions==========================*/
 
 void memory_register_cb(void (*memory_cb)(uint16_t, uint8_t, void *),
@@ -133,8 +140,10 @@ int memory_init(const char *filename, ppu_s *p, char *e_context) {
     return -E_NO_CALLBACK;
   }
 
+  cdl_reset();
   if (filename == NULL && p == NULL) { /* no ppu mode for testing cpu */
     ppu = p;
+    memory_code_gen++;
     // memset(memory_cpu, 0, sizeof(memory_cpu));
     return E_NO_ERROR;
   } else if (p == NULL) {
@@ -148,6 +157,7 @@ int memory_init(const char *filename, ppu_s *p, char *e_context) {
   int err;
 
   ppu = p;
+  memory_code_gen++;
 
   if ((fp = fopen(filename, "rb")) == NULL) {
     strncpy(e_context, filename, LEN_E_CONTEXT - 1);
@@ -222,83 +232,63 @@ int memory_dump_file(FILE *fp) {
 }
 #undef FPRINTF_CHECK_ERROR
 
-int memory_dump_string(char *dump, size_t dump_len) {
-  if (dump == NULL) {
-    return -E_NO_STRING;
-  }
-  char buf[2048];
-  size_t offset, read = 0;
-  size_t i, j;
-  char c;
-
-  /* What if sprintf returns negative? */
-  for (i = 0; i < 0x1000; i++) {
-    offset = 0;
-    offset += sprintf(buf + offset, "%3x0: ", (unsigned)i);
-    for (j = 0; j < 0x10; j++) {
-      offset += sprintf(buf + offset, "%2x ", memory_cpu[0x10 * i + j]);
-    }
-    offset += sprintf(buf + offset, "|");
-    for (j = 0; j < 0x10; j++) {
-      c = memory_cpu[0x10 * i + j];
-      if (c == 0 || !isprint(c)) {
-        offset += sprintf(buf + offset, ".");
-      } else {
-        offset += sprintf(buf + offset, "%c", c);
-      }
-    }
-    offset += sprintf(buf + offset, "|\n");
-
-    read += offset;
-    if (read > dump_len) {
-      return -E_BUF_SIZE;
-    } else {
-      strncpy(dump, buf, offset);
-      dump += offset;
-    }
+size_t memory_region_size(memory_region_e region) {
+  switch (region) {
+  case MEMORY_REGION_CPU:
+    return sizeof(memory_cpu);
+  case MEMORY_REGION_VRAM:
+    return sizeof(memory_ppu);
+  case MEMORY_REGION_OAM:
+    return PPU_OAM_SIZE;
+  case MEMORY_REGION_PALETTE:
+    return 0x20;
+  case MEMORY_REGION_CODE:
+    return 0x10000;
+  default:
+    return 0;
   }
-  *dump = '\0';
-  return E_NO_ERROR;
 }
 
-int memory_vram_dump_string(char *dump, size_t dump_len) {
-  if (dump == NULL) {
-    return -E_NO_STRING;
+int memory_snapshot(memory_region_e region, uint8_t *buf, size_t buf_len) {
+  size_t size = memory_region_size(region);
+  if (buf_len < size) {
+    return -E_BUF_SIZE;
   }
-  char buf[2048];
-  size_t offset, read = 0;
-  size_t i, j;
-  char c;
-
-  /* What if sprintf returns negative? */
-  for (i = 0; i < 0x400; i++) {
-    offset = 0;
-    offset += sprintf(buf + offset, "%3x0: ", (unsigned)i);
-    for (j = 0; j < 0x10; j++) {
-      offset += sprintf(buf + offset, "%2x ", memory_ppu[0x10 * i + j]);
-    }
-    offset += sprintf(buf + offset, "|");
-    for (j = 0; j < 0x10; j++) {
-      c = memory_ppu[0x10 * i + j];
-      if (c == 0 || !isprint(c)) {
-        offset += sprintf(buf + offset, ".");
-      } else {
-        offset += sprintf(buf + offset, "%c", c);
-      }
+  switch (region) {
+  case MEMORY_REGION_CPU:
+    memcpy(buf, memory_cpu, size);
+    break;
+  case MEMORY_REGION_VRAM:
+    memcpy(buf, memory_ppu, size);
+    break;
+  case MEMORY_REGION_OAM:
+    ppu_get_oam(buf);
+    break;
+  case MEMORY_REGION_PALETTE:
+    memcpy(buf, memory_ppu + 0x3F00, size);
+    break;
+  case MEMORY_REGION_CODE:
+    /* memory_peek for every address, a block at a time */
+    if (ppu == NULL) {
+      memcpy(buf, memory_cpu, size);
+      break;
     }
-    offset += sprintf(buf + offset, "|\n");
-
-    read += offset;
-    if (read > dump_len) {
-      return -E_BUF_SIZE;
-    } else {
-      strncpy(dump, buf, offset);
-      dump += offset;
+    for (size_t addr = 0; addr < 0x2000; addr += MEMORY_RAM_SIZE) {
+      memcpy(buf + addr, memory_cpu, MEMORY_RAM_SIZE);
     }
+    memset(buf + 0x2000, 0, 0x4020 - 0x2000);
+    memcpy(buf + 0x4020, memory_cpu + 0x4020, 0x8000 - 0x4020);
+    memcpy(buf + 0x8000,
+           memory_cpu + ((header_data.prg_rom_size == 1) ? 0xC000 : 0x8000),
+           0x4000);
+    memcpy(buf + 0xC000, memory_cpu + 0xC000, 0x4000);
+    break;
+  default:
+    break;
   }
-  *dump = '\0';
   return E_NO_ERROR;
 }
+
 /*
 void ines_header_dump(void) {
   FILE *fp;
@@ -322,12 +312,21 @@ void ines_header_dump(void) {
 
 void memory_init_harte_test_case(const uint16_t *addrs, const uint8_t *vals,
                                  size_t length) {
+  memory_code_gen++;
   memset(memory_cpu, 0, sizeof(memory_cpu));
   for (size_t i = 0; i < length; i++) {
     memory_cpu[addrs[i]] = vals[i];
   }
 }
 
+void memory_set_harte_test_case(const uint16_t *addrs, const uint8_t *vals,
+                                size_t length) {
+  memory_code_gen++;
+  for (size_t i = 0; i < length; i++) {
+    memory_cpu[addrs[i]] = vals[i];
+  }
+}
+
 void memory_reset_harte(const uint16_t *addrs, uint8_t *final_vals,
                         size_t length) {
   for (size_t i = 0; i < length; i++) {
@@ -354,7 +353,48 @@ void memory_do_oamdma(uint8_t val, uint16_t *cycles, uint8_t *to_nmi) {
   }
 }
 
+uint8_t memory_peek(uint16_t addr) {
+  if (ppu == NULL) {
+    return memory_cpu[addr];
+  } else if (addr < 0x2000) {
+    return memory_cpu[addr % 0x800];
+  } else if (addr < 0x4020) {
+    return 0;
+  } else if (addr >= 0x8000 && addr < 0xC000 &&
+             header_data.prg_rom_size == 1) {
+    return memory_cpu[addr + 0x4000];
+  }
+  return memory_cpu[addr];
+}
+
+uint16_t memory_prg_bank(uint16_t addr) { return 0; }
+
+void memory_rom_sizes(size_t *prg, size_t *chr) {
+  *prg = (ppu != NULL) ? 0x4000 * header_data.prg_rom_size : 0;
+  *chr = (ppu != NULL) ? 0x2000 * header_data.chr_rom_size : 0;
+}
+
+void memory_get_ram(uint8_t *ram) {
+  memcpy(ram, memory_cpu, MEMORY_RAM_SIZE);
+}
+
+void memory_set_ram(const uint8_t *ram) {
+  memcpy(memory_cpu, ram, MEMORY_RAM_SIZE);
+}
+
+int memory_idle_cycles(uint16_t n_cycles, uint8_t *to_nmi) {
+  if (ppu == NULL) {
+    return 1;
+  }
+  uint32_t frame_count = ppu_get_frame_count(ppu);
+  for (uint16_t i = 0; i < n_cycles; i++) {
+    do_three_ppu_steps(to_nmi);
+  }
+  return ppu_get_frame_count(ppu) != frame_count;
+}
+
 uint8_t memory_fetch(uint16_t addr, uint8_t *to_nmi) {
+  PROFILE_SCOPE(PROFILE_MEMORY_FETCH);
   static uint8_t val;
   static uint16_t effective_addr;
   if (ppu == NULL) { /* no ppu mode */
@@ -374,9 +414,9 @@ uint8_t memory_fetch(uint16_t addr, uint8_t *to_nmi) {
       val = ppu_register_fetch(ppu, effective_addr);
     }
 
-    else if (addr == 0x4016) {
+    else if (addr == 0x4016 || addr == 0x4017) {
       effective_addr = addr;
-      val = controller_fetch();
+      val = controller_fetch(addr - 0x4016);
     }
     /* apu, i/o registers */
     else if (addr < 0x4020) {
@@ -403,17 +443,36 @@ uint8_t memory_fetch(uint16_t addr, uint8_t *to_nmi) {
     }
     do_three_ppu_steps(to_nmi);
   }
+  DEBUG_ACCESS(DEBUG_READ, addr, val);
   on_fetch(effective_addr, val, on_fetch_data);
   return val;
 }
 
+void memory_fetch_known(uint16_t addr, uint8_t val, uint8_t *to_nmi) {
+  PROFILE_SCOPE(PROFILE_MEMORY_FETCH);
+  uint16_t effective_addr = addr;
+  if (ppu != NULL) {
+    if (addr < 0xC000 && header_data.prg_rom_size == 1) {
+      effective_addr = addr + 0x4000;
+    }
+    do_three_ppu_steps(to_nmi);
+  }
+  DEBUG_ACCESS(DEBUG_READ, addr, val);
+  on_fetch(effective_addr, val, on_fetch_data);
+}
+
 void memory_write(uint16_t addr, uint8_t val, uint8_t *to_oamdma,
                   uint8_t *to_nmi) {
+  PROFILE_SCOPE(PROFILE_MEMORY_WRITE);
+  DEBUG_ACCESS(DEBUG_WRITE, addr, val);
 
   static uint16_t effective_addr;
   if (ppu == NULL) { /* no ppu mode */
     effective_addr = addr;
     memory_cpu[effective_addr] = val;
+    if (addr >= 0x8000) {
+      memory_code_gen++;
+    }
 
   } else {
     if (addr < 0x2000) {
@@ -542,36 +601,29 @@ static int init_mapper_0(ines_header_s *header_data, FILE *fp,
                                                   : &nametable_horizontal;
   ppu_register_vram_fetch_callback(&vram_fetch);
   ppu_register_vram_write_callback(&vram_write);
+  ppu_register_vram_index_callback(&vram_index);
   
   return E_NO_ERROR;
 }
 
-static uint8_t vram_fetch(uint16_t addr) {
+static uint16_t vram_index(uint16_t addr) {
   if (addr < 0x2000) {
-    return memory_ppu[addr];
+    return addr;
   }
 
   else if (addr < 0x3F00) {
-    return memory_ppu[nametable_mirror(addr)];
+    return nametable_mirror(addr);
   }
 
   else {
-    return memory_ppu[0x3F00 + (addr % 0x20)]; // palette
+    return 0x3F00 + (addr % 0x20); // palette
   }
 }
 
-static void vram_write(uint16_t addr, uint8_t val) {
-  if (addr < 0x2000) {
-    memory_ppu[addr] = val;
-  }
+static uint8_t vram_fetch(uint16_t addr) { return memory_ppu[vram_index(addr)]; }
 
-  else if (addr < 0x3F00) {
-    memory_ppu[nametable_mirror(addr)] = val;
-  }
-
-  else {
-    memory_ppu[0x3F00 + (addr % 0x20)] = val; // palette
-  }
+static void vram_write(uint16_t addr, uint8_t val) {
+  memory_ppu[vram_index(addr)] = val;
 }
 
 /* must be better way than this but just getting it work first */
@@ -1,6 +1,7 @@
 #ifndef MEMORYP_H_
 #define MEMORYP_H_
 
+#include  <stddef.h>
 #include  <stdint.h>
 /* return value from addr of cpu memory, or result of reading
  * ppu memory-mapped register if addr corresponds to one.
@@ -17,6 +18,11 @@
  */
 uint8_t memory_fetch(uint16_t addr, uint8_t *to_nmi);
 
+/* memory_fetch of prg rom at addr (0x8000 and up) when the caller already
+ * has the value, val: steps the ppu and calls the read breakpoints and the
+ * fetch callback the same way, without going through the memory map */
+void memory_fetch_known(uint16_t addr, uint8_t val, uint8_t *to_nmi);
+
 /* write value val to cpu memory at address addr. if addr corresponds to
  * a ppu memory-mapped register, ppu does stuff. else val is written to
  * cpu memory, accounting for mirroring etc defined by the mapper.
@@ -34,4 +40,44 @@ void memory_write(uint16_t addr, uint8_t val, uint8_t *oamdma, uint8_t *to_nmi);
 /* does nothing right now but will do oamdma in the future */
 void memory_do_oamdma(uint8_t val, uint16_t *cycles, uint8_t *to_nmi);
 
+/* return value at addr without stepping the ppu or calling the fetch
+ * callback. ppu and apu registers (0x2000 - 0x401F) have side effects
+ * when read so return 0 for them.
+ *
+ * used to decode instructions ahead of executing them
+ */
+uint8_t memory_peek(uint16_t addr);
+
+/* prg rom bank currently mapped at addr. always 0 for mapper 0 */
+uint16_t memory_prg_bank(uint16_t addr);
+
+/* sizes in bytes of the prg and chr rom of the rom loaded, 0 in no ppu
+ * mode. chr is 0 if the cartridge has chr ram */
+void memory_rom_sizes(size_t *prg, size_t *chr);
+
+/* step the ppu for n_cycles cpu cycles without a bus access, as if the cpu
+ * had spent them fetching from rom or ram. used to skip idle loops.
+ *
+ * to_nmi is set as in memory_fetch. returns nonzero if a frame was
+ * finished during the cycles, or always in no ppu mode since there is
+ * nothing to wait for.
+ */
+int memory_idle_cycles(uint16_t n_cycles, uint8_t *to_nmi);
+
+#define MEMORY_RAM_SIZE 0x800
+
+/* copy the 2KB of cpu ram out or in, for the power on state of movies */
+void memory_get_ram(uint8_t *ram);
+void memory_set_ram(const uint8_t *ram);
+
+/* only for memory_code_generation(), which cpu_exec calls every
+ * instruction */
+extern uint32_t memory_code_gen;
+
+/* changes whenever code that could have been decoded with memory_peek
+ * may have changed, i.e. a new rom is loaded, a bank is switched, or
+ * prg rom is written to in no ppu mode
+ */
+static inline uint32_t memory_code_generation(void) { return memory_code_gen; }
+
 #endif
@@ -0,0 +1,271 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/controller.h"
+#include "core/movie.h"
+#include "core/errors.h"
+#include "controllerp.h"
+#include "memoryp.h"
+#include "moviep.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* file layout, all numbers little endian:
+ *   0  "NESM"
+ *   4  version
+ *   5  controller_device_e on port 0 and port 1
+ *   7  unused
+ *   8  64 bit FNV-1a hash of the rom file
+ *  16  32 bit number of strobes
+ *  20  cpu ram at power on, MEMORY_RAM_SIZE bytes
+ *      then the input each device latched on each strobe, in order
+ */
+#define MOVIE_MAGIC "NESM"
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE (20 + MEMORY_RAM_SIZE)
+#define MOVIE_INITIAL_CAPACITY 0x1000
+
+enum { MOVIE_OFF, MOVIE_RECORDING, MOVIE_PLAYING };
+
+static int status = MOVIE_OFF;
+static uint64_t rom_hash;
+static uint8_t power_on_ram[MEMORY_RAM_SIZE];
+static uint8_t devices[CTRLR_N_PORTS]; /* when recording started */
+
+/* strobes recorded so far or loaded from file */
+static uint8_t *latches = NULL;
+static uint32_t n_latches = 0;
+static uint32_t capacity = 0;
+static uint32_t next_latch = 0; /* when playing */
+/* set if a strobe couldn't be recorded, so the movie would be out of step */
+static uint8_t record_failed = 0;
+
+static int hash_file(const char *filename, uint64_t *hash, char *e_context);
+static void put_le(uint8_t *p, uint64_t val, int n_bytes);
+static uint64_t get_le(const uint8_t *p, int n_bytes);
+static void free_latches(void);
+
+/*======================Public functions======================*/
+
+int movie_record_start(const char *rom_filename, char *e_context) {
+  int err;
+  if (rom_filename == NULL) {
+    return -E_NO_FILE;
+  }
+  if ((err = hash_file(rom_filename, &rom_hash, e_context)) < 0) {
+    return err;
+  }
+  status = MOVIE_OFF;
+  free_latches();
+  if ((latches = malloc(MOVIE_INITIAL_CAPACITY)) == NULL) {
+    return -E_MALLOC;
+  }
+  capacity = MOVIE_INITIAL_CAPACITY;
+  record_failed = 0;
+  memory_get_ram(power_on_ram);
+  devices[0] = controller_get_device(0);
+  devices[1] = controller_get_device(1);
+  controller_reset();
+  status = MOVIE_RECORDING;
+  return E_NO_ERROR;
+}
+
+int movie_record_stop(const char *filename, char *e_context) {
+  if (status != MOVIE_RECORDING) {
+    return E_NO_ERROR;
+  }
+  status = MOVIE_OFF;
+  int err = E_NO_ERROR;
+  FILE *fp;
+  uint8_t header[MOVIE_HEADER_SIZE] = {0};
+
+  if (record_failed) {
+    err = -E_MALLOC;
+    goto done;
+  }
+  if (filename == NULL) {
+    err = -E_NO_FILE;
+    goto done;
+  }
+  if ((fp = fopen(filename, "wb")) == NULL) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+    err = -E_OPEN_FILE;
+    goto done;
+  }
+  memcpy(header, MOVIE_MAGIC, 4);
+  header[4] = MOVIE_VERSION;
+  header[5] = devices[0];
+  header[6] = devices[1];
+  put_le(header + 8, rom_hash, 8);
+  put_le(header + 16, n_latches, 4);
+  memcpy(header + 20, power_on_ram, MEMORY_RAM_SIZE);
+  if (fwrite(header, 1, MOVIE_HEADER_SIZE, fp) < MOVIE_HEADER_SIZE ||
+      fwrite(latches, 1, n_latches, fp) < n_latches) {
+    err = -E_WRITE_FILE;
+  }
+  if (fclose(fp) != 0) {
+    err = -E_WRITE_FILE;
+  }
+  if (err == -E_WRITE_FILE) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+  }
+
+done:
+  free_latches();
+  return err;
+}
+
+int movie_play_start(const char *filename, const char *rom_filename,
+                     char *e_context) {
+  int err;
+  FILE *fp;
+  uint8_t header[MOVIE_HEADER_SIZE];
+  uint64_t hash;
+
+  if (filename == NULL || rom_filename == NULL) {
+    return -E_NO_FILE;
+  }
+  if ((err = hash_file(rom_filename, &hash, e_context)) < 0) {
+    return err;
+  }
+  status = MOVIE_OFF;
+  free_latches();
+  if ((fp = fopen(filename, "rb")) == NULL) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+    return -E_OPEN_FILE;
+  }
+  if (fread(header, 1, MOVIE_HEADER_SIZE, fp) < MOVIE_HEADER_SIZE ||
+      memcmp(header, MOVIE_MAGIC, 4) != 0 || header[4] != MOVIE_VERSION) {
+    err = -E_MOVIE_FORMAT;
+    goto error;
+  }
+  if (get_le(header + 8, 8) != hash) {
+    err = -E_MOVIE_ROM;
+    goto error;
+  }
+  if (header[5] != controller_get_device(0) ||
+      header[6] != controller_get_device(1)) {
+    err = -E_MOVIE_DEVICES;
+    goto error;
+  }
+  n_latches = get_le(header + 16, 4);
+  if ((latches = malloc(n_latches ? n_latches : 1)) == NULL) {
+    err = -E_MALLOC;
+    goto error;
+  }
+  if (fread(latches, 1, n_latches, fp) < n_latches) {
+    err = -E_MOVIE_FORMAT;
+    goto error;
+  }
+  fclose(fp);
+
+  capacity = n_latches;
+  next_latch = 0;
+  memory_set_ram(header + 20);
+  controller_reset();
+  status = MOVIE_PLAYING;
+  return E_NO_ERROR;
+
+error:
+  fclose(fp);
+  free_latches();
+  strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+  return err;
+}
+
+void movie_play_stop(void) {
+  if (status == MOVIE_PLAYING) {
+    status = MOVIE_OFF;
+    free_latches();
+  }
+}
+
+int movie_play_finished(void) {
+  return status == MOVIE_PLAYING && next_latch >= n_latches;
+}
+
+uint32_t movie_length(void) { return n_latches; }
+
+/*======================Private header functions======================*/
+
+uint8_t movie_latch(uint8_t (*get_input)(uint8_t, void *), uint8_t index,
+                    void *data) {
+  if (status == MOVIE_PLAYING) {
+    return (next_latch < n_latches) ? latches[next_latch++] : 0;
+  }
+  uint8_t buttons = get_input(index, data);
+  if (status == MOVIE_RECORDING && !record_failed) {
+    if (n_latches == capacity) {
+      uint8_t *bigger = realloc(latches, 2 * capacity);
+      if (bigger == NULL) { /* every later strobe would be off by one */
+        record_failed = 1;
+        return buttons;
+      }
+      latches = bigger;
+      capacity *= 2;
+    }
+    latches[n_latches++] = buttons;
+  }
+  return buttons;
+}
+
+/*======================Helpers======================*/
+
+static int hash_file(const char *filename, uint64_t *hash, char *e_context) {
+  FILE *fp;
+  uint8_t buf[0x1000];
+  size_t n;
+  if ((fp = fopen(filename, "rb")) == NULL) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+    return -E_OPEN_FILE;
+  }
+  *hash = 0xCBF29CE484222325ULL;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      *hash = (*hash ^ buf[i]) * 0x100000001B3ULL;
+    }
+  }
+  int err = ferror(fp) ? -E_READ_FILE : E_NO_ERROR;
+  fclose(fp);
+  if (err < 0) {
+    strncpy(e_context, filename, LEN_E_CONTEXT - 1);
+  }
+  return err;
+}
+
+static void put_le(uint8_t *p, uint64_t val, int n_bytes) {
+  for (int i = 0; i < n_bytes; i++) {
+    p[i] = (val >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint64_t get_le(const uint8_t *p, int n_bytes) {
+  uint64_t val = 0;
+  for (int i = 0; i < n_bytes; i++) {
+    val |= (uint64_t)p[i] << (8 * i);
+  }
+  return val;
+}
+
+static void free_latches(void) {
+  free(latches);
+  latches = NULL;
+  n_latches = 0;
+  capacity = 0;
+  next_latch = 0;
+}
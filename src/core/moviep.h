@@ -0,0 +1,13 @@
+#ifndef MOVIEP_H_
+#define MOVIEP_H_
+
+#include <stdint.h>
+
+/* input for a controller to latch on a strobe, or for the zapper on a
+ * read. when playing a movie this
+ * is the next byte of it, otherwise it is get_input(index, data), which
+ * is appended to the movie if recording */
+uint8_t movie_latch(uint8_t (*get_input)(uint8_t, void *), uint8_t index,
+                    void *data);
+
+#endif
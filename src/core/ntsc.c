@@ -0,0 +1,382 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/ntsc.h"
+#include "bandpoolp.h"
+#include "core/errors.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NTSC_X86 1
+#endif
+
+/* samples of the signal per pixel, per subcarrier period, and per 3
+ * pixels, after which the subcarrier is back where it started */
+#define SAMPLES_PER_PIXEL 8
+#define SAMPLES_PER_PERIOD 12
+#define SAMPLES_PER_3 24
+
+/* decoding averages the signal over these many samples around each output
+ * pixel for Y, and the signal times the subcarrier for I and Q. Whole
+ * periods, so a flat colour comes out flat */
+#define Y_WIDTH 12
+#define IQ_WIDTH 24
+
+/* where the I axis is relative to the subcarrier in samples, and how much
+ * I and Q are scaled by. picked to make flat colours come out closest to
+ * nes_palette */
+#define HUE_OFFSET 3.8
+#define SATURATION 0.75
+
+/* colours with each combination of emphasis bits */
+#define N_COLOURS 512
+
+/* PPU output levels in volts for the low and high halves of the wave of
+ * each of the 4 brightness levels, from measurements of a 2C02 */
+static const double signal_low[4] = {0.350, 0.518, 0.962, 1.550};
+static const double signal_high[4] = {1.094, 1.506, 1.962, 1.962};
+#define SIGNAL_BLACK 0.518
+#define SIGNAL_WHITE 1.962
+#define EMPHASIS_ATTENUATION 0.746
+
+/* the output pixels a kernel adds to go past the input pixels' own by
+ * this many at each end of a row, at most */
+#define ACC_PAD 16
+
+typedef struct ntsc_job_s {
+  const uint8_t *in;
+  int in_stride;
+  uint8_t emphasis;
+  uint8_t burst_phase;
+  uint32_t *out;
+  int out_stride;
+} ntsc_job_s;
+
+struct ntsc_s {
+  int out_per_3;
+  int out_width;
+  int taps;     /* output pixels each kernel adds to, even */
+  int first[3]; /* first of them for the pixel at each position in a group
+                   of 3, relative to the group's first output pixel */
+  /* RGBA float for each tap, for each (burst phase, colour, position in
+   * group of 3) */
+  float *kernels;
+#ifdef NTSC_X86
+  int avx;
+#endif
+
+  bandpool_s *pool;
+  /* ACC_PAD + out_width + ACC_PAD pixels of RGBA for each thread */
+  float *acc[NTSC_MAX_THREADS];
+};
+
+static void make_kernels(ntsc_s *ntsc);
+static double overlap(double a0, double a1, double b0, double b1);
+static void filter_rows(void *data, void *job, int worker, int first_row,
+                        int end_row);
+
+/*======================Public functions======================*/
+
+int ntsc_create(ntsc_s **ntsc, int out_per_3, int n_threads) {
+  if (out_per_3 < 3 || out_per_3 > 12 || n_threads < 1 ||
+      n_threads > NTSC_MAX_THREADS) {
+    return -E_BUF_SIZE;
+  }
+  ntsc_s *n = calloc(1, sizeof(ntsc_s));
+  if (n == NULL) {
+    return -E_MALLOC;
+  }
+  n->out_per_3 = out_per_3;
+  n->out_width = ((NTSC_IN_WIDTH + 2) / 3) * out_per_3;
+#ifdef NTSC_X86
+  n->avx = __builtin_cpu_supports("avx");
+#endif
+  make_kernels(n);
+  if (n->kernels == NULL) {
+    free(n);
+    return -E_MALLOC;
+  }
+
+  size_t acc_size = (size_t)(n->out_width + 2 * ACC_PAD) * 4 * sizeof(float);
+  for (int i = 0; i < n_threads; i++) {
+    if ((n->acc[i] = aligned_alloc(32, acc_size)) == NULL) {
+      ntsc_destroy(n);
+      return -E_MALLOC;
+    }
+  }
+
+  int err = bandpool_create(&n->pool, n_threads, &filter_rows, n);
+  if (err < 0) {
+    ntsc_destroy(n);
+    return err;
+  }
+  *ntsc = n;
+  return E_NO_ERROR;
+}
+
+void ntsc_destroy(ntsc_s *ntsc) {
+  if (ntsc == NULL) {
+    return;
+  }
+  bandpool_destroy(ntsc->pool);
+  for (int i = 0; i < NTSC_MAX_THREADS; i++) {
+    free(ntsc->acc[i]);
+  }
+  free(ntsc->kernels);
+  free(ntsc);
+}
+
+int ntsc_out_width(const ntsc_s *ntsc) { return ntsc->out_width; }
+
+void ntsc_filter(ntsc_s *ntsc, const uint8_t *in, int in_stride, int height,
+                 uint8_t emphasis, uint8_t burst_phase, uint32_t *out,
+                 int out_stride) {
+  ntsc_job_s job = {in,  in_stride,  emphasis & 7, burst_phase % 3,
+                    out, out_stride};
+  bandpool_run(ntsc->pool, &job, height);
+}
+
+/*======================Kernels======================*/
+
+/* the PPU's output in volts, for sample phase (0 to 11) of colour */
+static double signal_level(int colour, int phase) {
+  int hue = colour & 0x0F;
+  int level = (colour >> 4) & 3;
+  int emphasis = colour >> 6;
+  if (hue > 13) {
+    level = 1; /* $xE and $xF are black */
+  }
+  double low = signal_low[level];
+  double high = signal_high[level];
+  if (hue == 0) {
+    low = high;
+  } else if (hue > 12) {
+    high = low;
+  }
+#define IN_PHASE(h) (((h) + phase) % SAMPLES_PER_PERIOD < 6)
+  double v = IN_PHASE(hue) ? high : low;
+  if (hue < 14 && (((emphasis & 1) && IN_PHASE(0)) ||
+                   ((emphasis & 2) && IN_PHASE(4)) ||
+                   ((emphasis & 4) && IN_PHASE(8)))) {
+    v *= EMPHASIS_ATTENUATION;
+  }
+#undef IN_PHASE
+  return v;
+}
+
+/* what the pixel at position j in its group of 3, of colour, on a row
+ * with burst phase r, adds to output pixel o (relative to the group's
+ * first output pixel) */
+static void contribution(const ntsc_s *ntsc, int r, int colour, int j, int o,
+                         double rgb[3]) {
+  double spacing = (double)SAMPLES_PER_3 / ntsc->out_per_3;
+  double t = (o + 0.5) * spacing;
+  double y = 0, i = 0, q = 0;
+  for (int k = 0; k < SAMPLES_PER_PIXEL; k++) {
+    int s = j * SAMPLES_PER_PIXEL + k;
+    int phase = (s + 4 * r) % SAMPLES_PER_PERIOD;
+    double v = (signal_level(colour, phase) - SIGNAL_BLACK) /
+               (SIGNAL_WHITE - SIGNAL_BLACK);
+    double wy = overlap(s, s + 1, t - Y_WIDTH / 2.0, t + Y_WIDTH / 2.0) /
+                Y_WIDTH;
+    double wc = overlap(s, s + 1, t - IQ_WIDTH / 2.0, t + IQ_WIDTH / 2.0) /
+                IQ_WIDTH;
+    double angle = 2 * M_PI * (phase + HUE_OFFSET) / SAMPLES_PER_PERIOD;
+    y += v * wy;
+    i += v * wc * 2 * SATURATION * cos(angle);
+    q += v * wc * 2 * SATURATION * sin(angle);
+  }
+  rgb[0] = 255 * (y + 0.946882 * i + 0.623557 * q);
+  rgb[1] = 255 * (y - 0.274788 * i - 0.635691 * q);
+  rgb[2] = 255 * (y - 1.108545 * i + 1.709007 * q);
+}
+
+static double overlap(double a0, double a1, double b0, double b1) {
+  double lo = (a0 > b0) ? a0 : b0;
+  double hi = (a1 < b1) ? a1 : b1;
+  return (hi > lo) ? hi - lo : 0;
+}
+
+static float *kernel(const ntsc_s *ntsc, int r, int colour, int j) {
+  return ntsc->kernels + (((size_t)r * N_COLOURS + colour) * 3 + j) *
+                             ntsc->taps * 4;
+}
+
+static void make_kernels(ntsc_s *ntsc) {
+  double spacing = (double)SAMPLES_PER_3 / ntsc->out_per_3;
+  /* output pixels whose windows reach into the pixel's samples */
+  int last[3];
+  ntsc->taps = 0;
+  for (int j = 0; j < 3; j++) {
+    double s0 = j * SAMPLES_PER_PIXEL - IQ_WIDTH / 2.0;
+    double s1 = (j + 1) * SAMPLES_PER_PIXEL + IQ_WIDTH / 2.0;
+    ntsc->first[j] = (int)floor(s0 / spacing - 0.5);
+    last[j] = (int)ceil(s1 / spacing - 0.5);
+    if (last[j] - ntsc->first[j] + 1 > ntsc->taps) {
+      ntsc->taps = last[j] - ntsc->first[j] + 1;
+    }
+  }
+  ntsc->taps = (ntsc->taps + 1) & ~1;
+
+  size_t size = (size_t)3 * N_COLOURS * 3 * ntsc->taps * 4 * sizeof(float);
+  if ((ntsc->kernels = aligned_alloc(32, size)) == NULL) {
+    return;
+  }
+  memset(ntsc->kernels, 0, size);
+  for (int r = 0; r < 3; r++) {
+    for (int colour = 0; colour < N_COLOURS; colour++) {
+      for (int j = 0; j < 3; j++) {
+        float *k = kernel(ntsc, r, colour, j);
+        for (int o = ntsc->first[j]; o <= last[j]; o++) {
+          double rgb[3];
+          contribution(ntsc, r, colour, j, o, rgb);
+          float *tap = &k[(o - ntsc->first[j]) * 4];
+          tap[0] = rgb[0];
+          tap[1] = rgb[1];
+          tap[2] = rgb[2];
+        }
+      }
+    }
+  }
+}
+
+/*======================Filtering======================*/
+
+/* add the kernel for each pixel of the row into acc, then clamp and pack
+ * acc into out. add_taps is inlined into each version of the row, so the
+ * SSE and AVX rows only differ in that */
+#define FILTER_ROW(ADD_TAPS, PACK)                                            \
+  do {                                                                        \
+    memset(acc, 0, (size_t)(ntsc->out_width + 2 * ACC_PAD) * 4 *              \
+                       sizeof(float));                                        \
+    const float *base = kernel(ntsc, r, emphasis << 6, 0);                    \
+    const size_t kernel_size = (size_t)ntsc->taps * 4;                        \
+    for (int x = 0, group = 0; x < NTSC_IN_WIDTH; group++) {                  \
+      float *a = acc + (ACC_PAD + group * ntsc->out_per_3) * 4;               \
+      for (int j = 0; j < 3 && x < NTSC_IN_WIDTH; j++, x++) {                 \
+        const float *k = base + ((in[x] & 0x3F) * 3 + j) * kernel_size;       \
+        ADD_TAPS(a + ntsc->first[j] * 4, k, ntsc->taps);                      \
+      }                                                                       \
+    }                                                                         \
+    PACK(acc + ACC_PAD * 4, out, ntsc->out_width);                            \
+  } while (0)
+
+#ifdef NTSC_X86
+
+static inline void add_taps_sse(float *a, const float *k, int taps) {
+  for (int t = 0; t < taps; t++) {
+    _mm_store_ps(a + t * 4,
+                 _mm_add_ps(_mm_load_ps(a + t * 4), _mm_load_ps(k + t * 4)));
+  }
+}
+
+__attribute__((target("avx"))) static inline void
+add_taps_avx(float *a, const float *k, int taps) {
+  for (int t = 0; t < taps; t += 2) {
+    _mm256_storeu_ps(a + t * 4, _mm256_add_ps(_mm256_loadu_ps(a + t * 4),
+                                              _mm256_load_ps(k + t * 4)));
+  }
+}
+
+static inline void pack_sse(const float *acc, uint32_t *out, int width) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 max = _mm_set1_ps(255.0f);
+  const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+  int o = 0;
+  for (; o + 4 <= width; o += 4) {
+    __m128i p0 = _mm_cvtps_epi32(
+        _mm_min_ps(_mm_max_ps(_mm_load_ps(acc + o * 4), zero), max));
+    __m128i p1 = _mm_cvtps_epi32(
+        _mm_min_ps(_mm_max_ps(_mm_load_ps(acc + o * 4 + 4), zero), max));
+    __m128i p2 = _mm_cvtps_epi32(
+        _mm_min_ps(_mm_max_ps(_mm_load_ps(acc + o * 4 + 8), zero), max));
+    __m128i p3 = _mm_cvtps_epi32(
+        _mm_min_ps(_mm_max_ps(_mm_load_ps(acc + o * 4 + 12), zero), max));
+    __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(p0, p1),
+                                     _mm_packs_epi32(p2, p3));
+    _mm_storeu_si128((__m128i *)(out + o), _mm_or_si128(bytes, alpha));
+  }
+  for (; o < width; o++) {
+    __m128i p = _mm_cvtps_epi32(
+        _mm_min_ps(_mm_max_ps(_mm_load_ps(acc + o * 4), zero), max));
+    p = _mm_packus_epi16(_mm_packs_epi32(p, p), p);
+    out[o] = (uint32_t)_mm_cvtsi128_si32(p) | 0xFF000000u;
+  }
+}
+
+static void filter_row_sse(const ntsc_s *ntsc, const uint8_t *in, int r,
+                           int emphasis, float *acc, uint32_t *out) {
+  FILTER_ROW(add_taps_sse, pack_sse);
+}
+
+__attribute__((target("avx"))) static void
+filter_row_avx(const ntsc_s *ntsc, const uint8_t *in, int r, int emphasis,
+               float *acc, uint32_t *out) {
+  FILTER_ROW(add_taps_avx, pack_sse);
+}
+
+#else
+
+/* plain C for other architectures, for the compiler to vectorise */
+static inline void add_taps_c(float *a, const float *k, int taps) {
+  for (int t = 0; t < taps * 4; t++) {
+    a[t] += k[t];
+  }
+}
+
+static inline void pack_c(const float *acc, uint32_t *out, int width) {
+  for (int o = 0; o < width; o++) {
+    uint32_t p = 0xFF000000u;
+    for (int c = 0; c < 3; c++) {
+      float v = acc[o * 4 + c];
+      v = (v < 0) ? 0 : (v > 255) ? 255 : v;
+      p |= (uint32_t)lrintf(v) << (8 * c);
+    }
+    out[o] = p;
+  }
+}
+
+static void filter_row_c(const ntsc_s *ntsc, const uint8_t *in, int r,
+                         int emphasis, float *acc, uint32_t *out) {
+  FILTER_ROW(add_taps_c, pack_c);
+}
+
+#endif
+
+static void filter_rows(void *data, void *job_data, int worker, int first_row,
+                        int end_row) {
+  ntsc_s *ntsc = data;
+  const ntsc_job_s *job = job_data;
+  float *acc = ntsc->acc[worker];
+  for (int row = first_row; row < end_row; row++) {
+    const uint8_t *in = job->in + (size_t)row * job->in_stride;
+    uint32_t *out = job->out + (size_t)row * job->out_stride;
+    int r = (job->burst_phase + row) % 3;
+#ifdef NTSC_X86
+    if (ntsc->avx) {
+      filter_row_avx(ntsc, in, r, job->emphasis, acc, out);
+    } else {
+      filter_row_sse(ntsc, in, r, job->emphasis, acc, out);
+    }
+#else
+    filter_row_c(ntsc, in, r, job->emphasis, acc, out);
+#endif
+  }
+}
@@ -0,0 +1,369 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPCODESP_H_
+#define OPCODESP_H_
+
+#include <stdint.h>
+
+/* The 6502 opcode table as macro lists, shared by the cpu, which builds its
+ * dispatch table from them, and the disassembler, so the two can't disagree
+ * about what an opcode is.
+ */
+
+/* Addressing modes, each with the cpu.c function that works out its
+ * operand address. This lets me index the addressing mode handlers by the
+ * addressing mode enum without having to worry about ordering
+ */
+#define ADDRESS_MODE_LIST                                                      \
+  X(IMP, implied), X(REL, relative), X(IMM, immediate), X(ABS, absolute),      \
+      X(ABS_X, absolute_x), X(ABS_Y, absolute_y),                              \
+      X(ABS_IND, absolute_indirect), X(IND_X, indexed_indirect),               \
+      X(IND_Y, indirect_indexed), X(ZP, zero_page), X(ZP_X, zero_page_x),      \
+      X(ZP_Y, zero_page_y), X(ABS_X_EC, absolute_x_extra_cycle),               \
+      X(ABS_Y_EC, absolute_y_extra_cycle),                                     \
+      X(IND_Y_EC, indirect_indexed_extra_cycle)
+
+#define X(id, x) id
+typedef enum { ADDRESS_MODE_LIST } addr_mode_e;
+#undef X
+
+/* instruction length in bytes, including opcode */
+static const uint8_t mode_lengths[] = {
+    [IMP] = 1,      [REL] = 2,      [IMM] = 2,      [ABS] = 3,
+    [ABS_X] = 3,    [ABS_Y] = 3,    [ABS_IND] = 3,  [IND_X] = 2,
+    [IND_Y] = 2,    [ZP] = 2,       [ZP_X] = 2,     [ZP_Y] = 2,
+    [ABS_X_EC] = 3, [ABS_Y_EC] = 3, [IND_Y_EC] = 2};
+
+/*
+ * These macros expand out all the cases for instructions with different
+ * addressing modes, using that all of the different versions of an instruction
+ * appear on the same row (or in one case column) of the opcode table.
+ *
+ * Each one ends up as OPCODE_ENTRY(opcode, handler, name string, mode), which
+ * is defined where OPCODE_LIST is expanded.
+ */
+
+#define OPC_CASE(op, offset, mode)                                             \
+  OPCODE_ENTRY(op##_BASE + offset, op, #op, mode)
+
+#define IS_ALU_OPC(op)                                                         \
+  OPC_CASE(op, 0x1, IND_X)                                                     \
+  OPC_CASE(op, 0x5, ZP)                                                        \
+  OPC_CASE(op, 0x9, IMM)                                                       \
+  OPC_CASE(op, 0xD, ABS)                                                       \
+  OPC_CASE(op, 0x11, IND_Y)                                                    \
+  OPC_CASE(op, 0x15, ZP_X)                                                     \
+  OPC_CASE(op, 0x19, ABS_Y)                                                    \
+  OPC_CASE(op, 0x1D, ABS_X)
+
+#define IS_RMW_OPC(op)                                                         \
+  OPC_CASE(op, 0x6, ZP)                                                        \
+  OPC_CASE(op, 0xA, IMP)                                                       \
+  OPC_CASE(op, 0xE, ABS)                                                       \
+  OPC_CASE(op, 0x16, ZP_X)                                                     \
+  OPC_CASE(op, 0x1E, ABS_X_EC)
+
+#define IS_INC_DEC(op)                                                         \
+  OPC_CASE(op, 0x6, ZP)                                                        \
+  OPC_CASE(op, 0xE, ABS)                                                       \
+  OPC_CASE(op, 0x16, ZP_X)                                                     \
+  OPC_CASE(op, 0x1E, ABS_X_EC)
+
+#define IS_CPX_CPY(op)                                                         \
+  OPC_CASE(op, 0x0, IMM)                                                       \
+  OPC_CASE(op, 0x4, ZP)                                                        \
+  OPC_CASE(op, 0xC, ABS)
+
+#define IS_STA()                                                               \
+  OPC_CASE(STA, 0x1, IND_X)                                                    \
+  OPC_CASE(STA, 0x5, ZP)                                                       \
+  OPC_CASE(STA, 0xD, ABS)                                                      \
+  OPC_CASE(STA, 0x11, IND_Y_EC)                                                \
+  OPC_CASE(STA, 0x15, ZP_X)                                                    \
+  OPC_CASE(STA, 0x19, ABS_Y_EC)                                                \
+  OPC_CASE(STA, 0x1D, ABS_X_EC)
+
+#define IS_STX()                                                               \
+  OPC_CASE(STX, 0x6, ZP)                                                       \
+  OPC_CASE(STX, 0xE, ABS)                                                      \
+  OPC_CASE(STX, 0x16, ZP_Y)
+
+#define IS_STY()                                                               \
+  OPC_CASE(STY, 0x4, ZP)                                                       \
+  OPC_CASE(STY, 0xC, ABS)                                                      \
+  OPC_CASE(STY, 0x14, ZP_X)
+
+#define IS_LDX()                                                               \
+  OPC_CASE(LDX, 0x2, IMM)                                                      \
+  OPC_CASE(LDX, 0x6, ZP)                                                       \
+  OPC_CASE(LDX, 0xE, ABS)                                                      \
+  OPC_CASE(LDX, 0x16, ZP_Y)                                                    \
+  OPC_CASE(LDX, 0x1E, ABS_Y)
+
+#define IS_LDY()                                                               \
+  OPC_CASE(LDY, 0x0, IMM)                                                      \
+  OPC_CASE(LDY, 0x4, ZP)                                                       \
+  OPC_CASE(LDY, 0xC, ABS)                                                      \
+  OPC_CASE(LDY, 0x14, ZP_X)                                                    \
+  OPC_CASE(LDY, 0x1C, ABS_X)
+
+#define IS_BIT()                                                               \
+  OPC_CASE(BIT, 0x4, ZP)                                                       \
+  OPC_CASE(BIT, 0xC, ABS)
+
+#define IS_JSR() OPC_CASE(JSR, 0x0, ABS)
+
+#define IS_BRANCH_OPC()                                                        \
+  OPC_CASE(BPL, 0x10, REL)                                                     \
+  OPC_CASE(BMI, 0x10, REL)                                                     \
+  OPC_CASE(BVC, 0x10, REL)                                                     \
+  OPC_CASE(BVS, 0x10, REL)                                                     \
+  OPC_CASE(BCC, 0x10, REL)                                                     \
+  OPC_CASE(BCS, 0x10, REL)                                                     \
+  OPC_CASE(BNE, 0x10, REL)                                                     \
+  OPC_CASE(BEQ, 0x10, REL)
+
+#define IS_OPC(op) OPCODE_ENTRY(op##_OPC, op, #op, IMP)
+
+#define _IS_JMP(base, mode) OPCODE_ENTRY(JMP_OFFSET + base, JMP, "JMP", mode)
+
+#define IS_JMP()                                                               \
+  _IS_JMP(0x40, ABS)                                                           \
+  _IS_JMP(0x60, ABS_IND)
+
+/* illegal opcodes */
+
+#define ILLEGAL_OPC_CASE(op, offset, mode)                                     \
+  OPCODE_ENTRY(op##_BASE + offset, op, "*" #op, mode)
+
+/* For individual illegal opcodes */
+#define IS_ILLEGAL_OPC(op, opc, mode) OPCODE_ENTRY(opc, op, "*" #op, mode)
+
+#define _IS_ILLEGAL_NOP(base, mode)                                            \
+  OPCODE_ENTRY(NOP_##mode##_OFFSET + base, NOP, "*NOP", mode)
+
+#define IS_ILLEGAL_NOP()                                                       \
+  _IS_ILLEGAL_NOP(0X0, ZP)                                                     \
+  _IS_ILLEGAL_NOP(0X40, ZP)                                                    \
+  _IS_ILLEGAL_NOP(0X60, ZP)                                                    \
+  _IS_ILLEGAL_NOP(0X0, ABS)                                                    \
+  _IS_ILLEGAL_NOP(0X0, ZP_X)                                                   \
+  _IS_ILLEGAL_NOP(0X20, ZP_X)                                                  \
+  _IS_ILLEGAL_NOP(0X40, ZP_X)                                                  \
+  _IS_ILLEGAL_NOP(0X60, ZP_X)                                                  \
+  _IS_ILLEGAL_NOP(0XC0, ZP_X)                                                  \
+  _IS_ILLEGAL_NOP(0XE0, ZP_X)                                                  \
+  _IS_ILLEGAL_NOP(0X0, ABS_X)                                                  \
+  _IS_ILLEGAL_NOP(0X20, ABS_X)                                                 \
+  _IS_ILLEGAL_NOP(0X40, ABS_X)                                                 \
+  _IS_ILLEGAL_NOP(0X60, ABS_X)                                                 \
+  _IS_ILLEGAL_NOP(0XC0, ABS_X)                                                 \
+  _IS_ILLEGAL_NOP(0XE0, ABS_X)                                                 \
+  _IS_ILLEGAL_NOP(0X0, IMP)                                                    \
+  _IS_ILLEGAL_NOP(0X20, IMP)                                                   \
+  _IS_ILLEGAL_NOP(0X40, IMP)                                                   \
+  _IS_ILLEGAL_NOP(0X60, IMP)                                                   \
+  _IS_ILLEGAL_NOP(0XC0, IMP)                                                   \
+  _IS_ILLEGAL_NOP(0XE0, IMP)                                                   \
+  IS_ILLEGAL_OPC(NOP, 0x80, IMM)                                               \
+  IS_ILLEGAL_OPC(NOP, 0X89, IMM)                                               \
+  IS_ILLEGAL_OPC(NOP, 0X82, IMM)                                               \
+  IS_ILLEGAL_OPC(NOP, 0XC2, IMM)                                               \
+  IS_ILLEGAL_OPC(NOP, 0XE2, IMM)
+
+#define IS_LAX()                                                               \
+  ILLEGAL_OPC_CASE(LAX, 0x03, IND_X)                                           \
+  ILLEGAL_OPC_CASE(LAX, 0X07, ZP)                                              \
+  ILLEGAL_OPC_CASE(LAX, 0X0F, ABS)                                             \
+  ILLEGAL_OPC_CASE(LAX, 0X13, IND_Y)                                           \
+  ILLEGAL_OPC_CASE(LAX, 0X17, ZP_Y)                                            \
+  ILLEGAL_OPC_CASE(LAX, 0X1F, ABS_Y)
+
+#define IS_SAX()                                                               \
+  ILLEGAL_OPC_CASE(SAX, 0X03, IND_X)                                           \
+  ILLEGAL_OPC_CASE(SAX, 0X07, ZP)                                              \
+  ILLEGAL_OPC_CASE(SAX, 0X0F, ABS)                                             \
+  ILLEGAL_OPC_CASE(SAX, 0X17, ZP_Y)
+
+#define IS_ILLEGAL_SBC() IS_ILLEGAL_OPC(SBC, 0XEB, IMM)
+
+#define IS_ILLEGAL_RMW_OPC(op)                                                 \
+  ILLEGAL_OPC_CASE(op, 0x03, IND_X)                                            \
+  ILLEGAL_OPC_CASE(op, 0x07, ZP)                                               \
+  ILLEGAL_OPC_CASE(op, 0x0f, ABS)                                              \
+  ILLEGAL_OPC_CASE(op, 0x13, IND_Y_EC)                                         \
+  ILLEGAL_OPC_CASE(op, 0x17, ZP_X)                                             \
+  ILLEGAL_OPC_CASE(op, 0x1b, ABS_Y_EC)                                         \
+  ILLEGAL_OPC_CASE(op, 0x1f, ABS_X_EC)
+
+/* apparently this one doesn't work properly: */
+/*ILLEGAL_OPC_CASE(LAX, 0X0B, IMM)		\*/
+
+/* Every implemented opcode, grouped by "sections" in opcode table.
+ * Expanded with OPCODE_ENTRY defined as the cases of the switch in
+ * cpu_exec, to build opcode_table in cpu.c, and to build the disassembler's
+ * table in disasm.c.
+ */
+#define OPCODE_LIST                                                            \
+  /* Mostly ALU instructions */                                                \
+  IS_ALU_OPC(ORA)                                                              \
+  IS_ALU_OPC(AND)                                                              \
+  IS_ALU_OPC(EOR)                                                              \
+  IS_ALU_OPC(ADC)                                                              \
+  IS_ALU_OPC(LDA)                                                              \
+  IS_ALU_OPC(CMP)                                                              \
+  IS_ALU_OPC(SBC)                                                              \
+  IS_STA()                                                                     \
+  /* Mostly RMW (read-modify-write) instructions */                            \
+  IS_RMW_OPC(ASL)                                                              \
+  IS_RMW_OPC(ROL)                                                              \
+  IS_RMW_OPC(LSR)                                                              \
+  IS_RMW_OPC(ROR)                                                              \
+  IS_INC_DEC(DEC)                                                              \
+  IS_INC_DEC(INC)                                                              \
+  IS_STX()                                                                     \
+  IS_LDX()                                                                     \
+  IS_OPC(TXA)                                                                  \
+  IS_OPC(TXS)                                                                  \
+  IS_OPC(TAX)                                                                  \
+  IS_OPC(TSX)                                                                  \
+  IS_OPC(DEX)                                                                  \
+  IS_OPC(NOP)                                                                  \
+  /* Control instructions, and unique instructions */                          \
+  IS_BRANCH_OPC()                                                              \
+  IS_OPC(BRK)                                                                  \
+  IS_OPC(PHP)                                                                  \
+  IS_OPC(CLC)                                                                  \
+  IS_OPC(PLP)                                                                  \
+  IS_OPC(SEC)                                                                  \
+  IS_OPC(RTI)                                                                  \
+  IS_OPC(PHA)                                                                  \
+  IS_OPC(CLI)                                                                  \
+  IS_OPC(RTS)                                                                  \
+  IS_OPC(PLA)                                                                  \
+  IS_OPC(SEI)                                                                  \
+  IS_OPC(DEY)                                                                  \
+  IS_OPC(TYA)                                                                  \
+  IS_OPC(TAY)                                                                  \
+  IS_OPC(CLV)                                                                  \
+  IS_OPC(INY)                                                                  \
+  IS_OPC(CLD)                                                                  \
+  IS_OPC(INX)                                                                  \
+  IS_OPC(SED)                                                                  \
+  IS_JMP()                                                                     \
+  IS_JSR()                                                                     \
+  IS_BIT()                                                                     \
+  IS_LDY()                                                                     \
+  IS_STY()                                                                     \
+  IS_CPX_CPY(CPX)                                                              \
+  IS_CPX_CPY(CPY)                                                              \
+  /* illegal opcodes */                                                        \
+  IS_ILLEGAL_NOP()                                                             \
+  IS_LAX()                                                                     \
+  IS_SAX()                                                                     \
+  IS_ILLEGAL_SBC()                                                             \
+  IS_ILLEGAL_RMW_OPC(DCP)                                                      \
+  IS_ILLEGAL_RMW_OPC(ISB)                                                      \
+  IS_ILLEGAL_RMW_OPC(SLO)                                                      \
+  IS_ILLEGAL_RMW_OPC(RLA)                                                      \
+  IS_ILLEGAL_RMW_OPC(SRE)                                                      \
+  IS_ILLEGAL_RMW_OPC(RRA)
+
+enum {
+  BPL_BASE = 0x0,
+  ORA_BASE = 0x0,
+  ASL_BASE = 0x0,
+  JSR_BASE = 0x20,
+  BMI_BASE = 0x20,
+  BIT_BASE = 0X20,
+  ROL_BASE = 0x20,
+  AND_BASE = 0x20,
+  BVC_BASE = 0x40,
+  LSR_BASE = 0x40,
+  EOR_BASE = 0x40,
+  BVS_BASE = 0x60,
+  ROR_BASE = 0x60,
+  ADC_BASE = 0x60,
+  BCC_BASE = 0x80,
+  STX_BASE = 0x80,
+  STY_BASE = 0x80,
+  STA_BASE = 0x80,
+  BCS_BASE = 0xA0,
+  LDX_BASE = 0xA0,
+  LDY_BASE = 0xA0,
+  LDA_BASE = 0xA0,
+  BNE_BASE = 0xC0,
+  DEC_BASE = 0xC0,
+  CMP_BASE = 0xC0,
+  CPY_BASE = 0xC0,
+  BEQ_BASE = 0xE0,
+  CPX_BASE = 0xE0,
+  INC_BASE = 0xE0,
+  SBC_BASE = 0xE0
+};
+
+enum {
+  BRK_OPC = 0x0,
+  PHP_OPC = 0x8,
+  CLC_OPC = 0x18,
+  PLP_OPC = 0x28,
+  SEC_OPC = 0x38,
+  RTI_OPC = 0x40,
+  PHA_OPC = 0x48,
+  CLI_OPC = 0x58,
+  RTS_OPC = 0x60,
+  PLA_OPC = 0x68,
+  SEI_OPC = 0x78,
+  DEY_OPC = 0x88,
+  TXA_OPC = 0x8A,
+  TYA_OPC = 0x98,
+  TXS_OPC = 0X9A,
+  TAY_OPC = 0xA8,
+  TAX_OPC = 0xAA,
+  CLV_OPC = 0xB8,
+  TSX_OPC = 0xBA,
+  INY_OPC = 0xC8,
+  DEX_OPC = 0xCA,
+  CLD_OPC = 0xD8,
+  INX_OPC = 0xE8,
+  NOP_OPC = 0xEA,
+  SED_OPC = 0xF8,
+};
+
+#define JMP_OFFSET 0xC
+
+/* illegal opcode stuff */
+enum {
+  NOP_ZP_OFFSET = 0X4,
+  NOP_ABS_OFFSET = 0XC,
+  NOP_ZP_X_OFFSET = 0X14,
+  NOP_ABS_X_OFFSET = 0X1C,
+  NOP_IMP_OFFSET = 0X1A
+};
+
+enum {
+  SLO_BASE = 0X0,
+  RLA_BASE = 0X20,
+  SRE_BASE = 0X40,
+  RRA_BASE = 0X60,
+  SAX_BASE = 0X80,
+  LAX_BASE = 0xA0,
+  DCP_BASE = 0XC0,
+  ISB_BASE = 0xE0,
+};
+
+#endif
@@ -14,13 +14,17 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "core/errors.h"
 #include "core/ppu.h"
+#include "cdlp.h"
 #include "ppup.h"
+#include "profilep.h"
+#include "schedulerp.h"
 
 #define MASK_PPUCTRL_NAMETABLE 0x3
 #define MASK_PPUCTRL_INCREMENT 0x4
@@ -56,21 +60,46 @@
 
 #define IGNORE_REG_WRITE_CYCLES 29657
 
+#define DOTS_PER_SCANLINE 341
+#define SCANLINES_PER_FRAME 262
+#define DOTS_PER_FRAME (DOTS_PER_SCANLINE * SCANLINES_PER_FRAME)
+#define VBLANK_START_DOT (241 * DOTS_PER_SCANLINE + 1)
+#define VBLANK_END_DOT (261 * DOTS_PER_SCANLINE + 1)
+
 static inline void state_init(const ppu_s *ppu);
 static inline void state_update(const ppu_s *ppu);
 
-static inline void increment_ppu(ppu_s *ppu);
+static inline int increment_ppu(ppu_s *ppu);
 static inline void update_nmi(ppu_s *ppu);
-static inline void background_step(ppu_s *ppu);
+static void schedule_frame_events(const ppu_s *ppu);
+static void schedule_next(const ppu_s *ppu, sched_event_e event,
+                          uint32_t dot);
+/* who is drawing, see ppu_pipeline_start. always a constant so the
+ * compiler can make a version of the rendering functions for each */
+typedef enum render_mode_e {
+  RENDER_DIRECT, /* the ppu draws as it goes */
+  RENDER_TIMING, /* pipeline cpu side, no fetches, only keeps v right */
+  RENDER_COPY    /* pipeline render thread, reads its copy of vram */
+} render_mode_e;
+
+static inline void render_step(ppu_s *ppu, render_mode_e mode);
+static inline void background_step(ppu_s *ppu, render_mode_e mode);
 static inline void sprite_step(ppu_s *ppu);
-static inline void tile_data_fetch(ppu_s *ppu, uint8_t offset);
-static inline void render_pixel(const ppu_s *ppu);
-static inline void nt_byte_fetch(ppu_s *ppu);
-static inline void at_byte_fetch(ppu_s *ppu);
-static inline void ptt_low_byte_fetch(ppu_s *ppu);
-static inline void ptt_high_byte_fetch(ppu_s *ppu);
+static inline void tile_data_fetch(ppu_s *ppu, uint8_t offset,
+                                   render_mode_e mode);
+static inline void render_pixel(const ppu_s *ppu, render_mode_e mode);
+static inline void nt_byte_fetch(ppu_s *ppu, render_mode_e mode);
+static inline void at_byte_fetch(ppu_s *ppu, render_mode_e mode);
+static inline void ptt_low_byte_fetch(ppu_s *ppu, render_mode_e mode);
+static inline void ptt_high_byte_fetch(ppu_s *ppu, render_mode_e mode);
 static inline void inc_hori_v(ppu_s *ppu);
 static inline void inc_vert_v(ppu_s *ppu);
+static inline uint8_t vram_read(const ppu_s *ppu, uint16_t addr,
+                                render_mode_e mode);
+
+static void pipe_new_frame(ppu_s *ppu);
+static void pipe_log_regs(ppu_s *ppu);
+static void pipe_log_vram(ppu_s *ppu, uint16_t addr, uint8_t val);
 
 static inline uint8_t ppustatus_fetch(ppu_s *ppu);
 static inline uint8_t oamdata_fetch(ppu_s *ppu);
@@ -87,12 +116,13 @@ static inline void oamdma_write(ppu_s *ppu, uint8_t val);
 
 /* global state */
 static ppu_state_s ppu_state;
-static uint8_t memory_oam[0x100] = {0};
+static uint8_t memory_oam[PPU_OAM_SIZE] = {0};
 static uint8_t memory_secondary_oam[32] = {0};
 
 /* callbacks */
 static uint8_t default_fetch(uint16_t a) { return 0;}
 static void default_write(uint16_t a, uint8_t v) {}
+static uint16_t default_index(uint16_t a) { return a & 0x3FFF; }
 
 static void (*log_error)(const char *, ...) = NULL;
 static void (*on_ppu_state_update)(const ppu_state_s *ppu_state,
@@ -100,6 +130,7 @@ static void (*on_ppu_state_update)(const ppu_state_s *ppu_state,
 static void (*put_pixel)(int i, int j, uint8_t palette_idx, void *data) = NULL;
 static uint8_t (*vram_fetch)(uint16_t addr) = &default_fetch;
 static void (*vram_write)(uint16_t addr, uint8_t val) = &default_write;
+static uint16_t (*vram_index)(uint16_t addr) = &default_index;
 
 /* callback data */
 static void *on_ppu_state_update_data = NULL;
@@ -159,6 +190,10 @@ void ppu_register_vram_write_callback(void (*callback)(uint16_t, uint8_t)) {
   vram_write = callback;
 }
 
+void ppu_register_vram_index_callback(uint16_t (*callback)(uint16_t)) {
+  vram_index = callback;
+}
+
 int ppu_init_no_alloc(ppu_s *ppu, void (*put_pixel_cb)(int, int, uint8_t, void *),
              void *data) {
   put_pixel = put_pixel_cb;
@@ -167,6 +202,12 @@ int ppu_init_no_alloc(ppu_s *ppu, void (*put_pixel_cb)(int, int, uint8_t, void *
     return -E_NO_CALLBACK;
   }
   ppu->ppustatus = 0xA0;
+  ppu->frame_count = 0;
+  ppu->frame_skip = 0;
+  ppu->skip_render = 0;
+  ppu->pipeline = NULL;
+  ppu->vram = NULL;
+  schedule_frame_events(ppu);
   state_init(ppu);
   // on_ppu_state_update(&ppu_state, on_ppu_state_update_data);
   return E_NO_ERROR;
@@ -184,47 +225,69 @@ int ppu_init(ppu_s **p, void (*put_pixel_cb)(int, int, uint8_t, void *),
   }
   ppu_s *ppu = *p;
   ppu->ppustatus = 0xA0;
+  schedule_frame_events(ppu);
   state_init(ppu);
   // on_ppu_state_update(&ppu_state, on_ppu_state_update_data);
   return E_NO_ERROR;
 }
 
-void ppu_destroy(ppu_s *ppu) { free(ppu); }
+void ppu_destroy(ppu_s *ppu) {
+  ppu_pipeline_stop(ppu);
+  free(ppu);
+}
+
+void ppu_set_frame_skip(ppu_s *ppu, uint8_t n) { ppu->frame_skip = n; }
+
+uint32_t ppu_get_frame_count(const ppu_s *ppu) { return ppu->frame_count; }
+
+/* a frame is 341 * 262 dots of 8 samples, 4 more than a whole number of
+ * periods, so each starts a third of a period on from the last. (with
+ * the dot skipped on odd frames that would alternate between 1 and 2
+ * thirds, but that isn't done here) */
+uint8_t ppu_get_burst_phase(const ppu_s *ppu) {
+  return ppu->frame_count % 3;
+}
+
+void ppu_get_oam(uint8_t *oam) { memcpy(oam, memory_oam, PPU_OAM_SIZE); }
 
 void ppu_step(ppu_s *ppu, uint8_t *to_nmi) {
-  static uint8_t is_rendering;
-  
-  is_rendering = ((ppu->ppumask &
-                   (MASK_PPUMASK_BG_R_ENABLE | MASK_PPUMASK_SPRITE_R_ENABLE)));
-  
+  PROFILE_SCOPE(PROFILE_PPU_STEP);
 
-  
   /* ppuctrl write could have set nmi */
   *to_nmi |= ppu->nmi_occurred;
 
-  if (is_rendering) {
-    background_step(ppu);
-    sprite_step(ppu);
-    if (ppu->scanline < 240 && ppu->cycles < 256) {
-    render_pixel(ppu);
-    }
+  if (ppu->pipeline != NULL) {
+    render_step(ppu, RENDER_TIMING);
+  } else {
+    render_step(ppu, RENDER_DIRECT);
   }
 
-  // Start of vblank
-  if (ppu->scanline == 241 && ppu->cycles == 1) {
-    ppu->ppustatus |= MASK_PPUSTATUS_VBLANK;
-    update_nmi(ppu);
-    *to_nmi |= ppu->nmi_occurred;
+  sched_event_e event;
+  while (scheduler_due() && scheduler_pop(&event)) {
+    switch (event) {
+    case SCHED_VBLANK_START:
+      ppu->ppustatus |= MASK_PPUSTATUS_VBLANK;
+      update_nmi(ppu);
+      scheduler_add(event, scheduler_clock() + DOTS_PER_FRAME);
+      break;
+    case SCHED_VBLANK_END:
+      ppu->ppustatus &= ~MASK_PPUSTATUS_ALL;
+      update_nmi(ppu);
+      scheduler_add(event, scheduler_clock() + DOTS_PER_FRAME);
+      break;
+    default:
+      break;
+    }
   }
 
-  // End of vblank
-  if (ppu->scanline == 261 && ppu->cycles == 1) {
-    ppu->ppustatus &= ~MASK_PPUSTATUS_ALL;
-    update_nmi(ppu);
-    *to_nmi |= ppu->nmi_occurred;
+  int new_frame = increment_ppu(ppu);
+  scheduler_advance(1);
+  if (new_frame) {
+    PROFILE_FRAME_DONE();
+    if (ppu->pipeline != NULL) {
+      pipe_new_frame(ppu);
+    }
   }
-
-  increment_ppu(ppu);
   /*
   ppu->total_cycles++;
   if (!ppu->ready_to_write && ppu->total_cycles > 3 * IGNORE_REG_WRITE_CYCLES) {
@@ -239,6 +302,25 @@ void ppu_step(ppu_s *ppu, uint8_t *to_nmi) {
   on_ppu_state_update(&ppu_state, on_ppu_state_update_data);
 }
 
+/* vblank starts and ends at fixed dots in the frame, so rather than
+ * checking the scanline and cycle every dot they are scheduled a frame
+ * ahead. scheduler is reset here since there is only one ppu running at a
+ * time. */
+static void schedule_frame_events(const ppu_s *ppu) {
+  scheduler_reset();
+  schedule_next(ppu, SCHED_VBLANK_START, VBLANK_START_DOT);
+  schedule_next(ppu, SCHED_VBLANK_END, VBLANK_END_DOT);
+}
+
+/* schedule event for the next time the ppu gets to dot in the frame,
+ * which is now if it is at dot but hasn't done it yet */
+static void schedule_next(const ppu_s *ppu, sched_event_e event,
+                          uint32_t dot) {
+  uint32_t now = ppu->scanline * DOTS_PER_SCANLINE + ppu->cycles;
+  uint32_t wait = (dot + DOTS_PER_FRAME - now) % DOTS_PER_FRAME;
+  scheduler_add(event, scheduler_clock() + wait);
+}
+
 static inline void update_nmi(ppu_s *ppu) {
   ppu->nmi_occurred = (ppu->ppuctrl & MASK_PPUCTRL_NMI_ENABLE) &&
                       (ppu->ppustatus & MASK_PPUSTATUS_VBLANK);
@@ -254,6 +336,9 @@ uint8_t ppu_register_fetch(ppu_s *ppu, uint16_t addr) {
     break;
   case 0x2007:
     ppu->ppu_db = ppudata_fetch(ppu);
+    if (ppu->pipeline != NULL) {
+      pipe_log_regs(ppu);
+    }
     break;
   }
   return ppu->ppu_db;
@@ -299,6 +384,11 @@ void ppu_register_write(ppu_s *ppu, uint16_t addr, uint8_t val,
     oamdma_write(ppu, val);
     break;
   }
+  /* everything but oam changes something the renderer reads */
+  if (ppu->pipeline != NULL && addr != 0x2003 && addr != 0x2004 &&
+      addr != 0x4014 && addr != 0x2002) {
+    pipe_log_regs(ppu);
+  }
 }
 
 static void state_init(const ppu_s *ppu) { state_update(ppu); }
@@ -321,30 +411,43 @@ static void state_update(const ppu_s *ppu) {
 
 /*------------------------------tile
  * fetching--------------------------------*/
-static void nt_byte_fetch(ppu_s *ppu) {
+
+/* the render thread's ppu reads its own copy of vram */
+static inline uint8_t vram_read(const ppu_s *ppu, uint16_t addr,
+                                render_mode_e mode) {
+  return (mode == RENDER_COPY) ? ppu->vram[vram_index(addr)] : vram_fetch(addr);
+}
+
+static void nt_byte_fetch(ppu_s *ppu, render_mode_e mode) {
   /* according to wiki: */
-  ppu->nt_byte = vram_fetch(0x2000 | (ppu->v & 0xFFF));
+  ppu->nt_byte = vram_read(ppu, 0x2000 | (ppu->v & 0xFFF), mode);
 }
 
-static void at_byte_fetch(ppu_s *ppu) {
+static void at_byte_fetch(ppu_s *ppu, render_mode_e mode) {
  /* according to wiki: */
   uint16_t addr = 0x23C0 | (ppu->v & MASK_T_V_NAMETABLE) |
                   ((ppu->v >> 4) & 0x38) | ((ppu->v >> 2) & 0x07);
-  ppu->at_byte = vram_fetch(addr);
+  ppu->at_byte = vram_read(ppu, addr, mode);
 }
 
-static void ptt_low_byte_fetch(ppu_s *ppu) {
+static void ptt_low_byte_fetch(ppu_s *ppu, render_mode_e mode) {
   uint16_t addr = (ppu->v & MASK_T_V_FINE_Y) >> 12;
   addr += (ppu->nt_byte << 4);
   addr += (ppu->ppuctrl & MASK_PPUCTRL_BT_SELECT) ? 0x1000 : 0;
-  ppu->ptt_low = vram_fetch(addr);
+  ppu->ptt_low = vram_read(ppu, addr, mode);
+  if (CDL_ON()) {
+    cdl_mark_chr(cdl_chr_rendered, addr);
+  }
 }
 
-static void ptt_high_byte_fetch(ppu_s *ppu) {
+static void ptt_high_byte_fetch(ppu_s *ppu, render_mode_e mode) {
   uint16_t addr = ((ppu->v & MASK_T_V_FINE_Y) >> 12) + 8;
   addr += (ppu->nt_byte << 4);
   addr += (ppu->ppuctrl & MASK_PPUCTRL_BT_SELECT) ? 0x1000 : 0;
-  ppu->ptt_high = vram_fetch(addr);
+  ppu->ptt_high = vram_read(ppu, addr, mode);
+  if (CDL_ON()) {
+    cdl_mark_chr(cdl_chr_rendered, addr);
+  }
 }
 
 /*-------------------------memory-mapped register reads
@@ -365,6 +468,9 @@ static uint8_t oamdata_fetch(ppu_s *ppu) { return memory_oam[ppu->oamaddr]; }
 static uint8_t ppudata_fetch(ppu_s *ppu) {
   uint8_t val = ppu->ppudata_rb;
   ppu->ppudata_rb = vram_fetch(ppu->v & MASK_T_V_ADDR_ALL);
+  if (CDL_ON()) {
+    cdl_mark_chr(cdl_chr_read, ppu->v & MASK_T_V_ADDR_ALL);
+  }
 
   /* Increment VRAM address by 1 or 32, depending on PPUCTRL second bit */
   ppu->v += (ppu->ppuctrl & MASK_PPUCTRL_INCREMENT) ? 32 : 1;
@@ -438,6 +544,9 @@ static void ppudata_write(ppu_s *ppu, uint8_t val) {
         ppu->ppumask & MASK_PPUMASK_SPRITE_R_ENABLE)) {
     /* not rendering */
     vram_write(ppu->v & MASK_T_V_ADDR_ALL, val);
+    if (ppu->pipeline != NULL) {
+      pipe_log_vram(ppu, ppu->v & MASK_T_V_ADDR_ALL, val);
+    }
   }
   ppu->v += (ppu->ppuctrl & MASK_PPUCTRL_INCREMENT) ? 32 : 1;
   ppu->v &= MASK_T_V_SCROLL_ALL;
@@ -488,19 +597,27 @@ static inline void copy_vert_v_t(ppu_s *ppu) {
   ppu->v = (ppu->v & ~MASK_T_V_VERT) | (ppu->t & MASK_T_V_HORI);
 }
 
-static inline void tile_data_fetch(ppu_s *ppu, uint8_t offset) {
+static inline void tile_data_fetch(ppu_s *ppu, uint8_t offset,
+                                   render_mode_e mode) {
+  if (mode == RENDER_TIMING) {
+    /* the render thread does the fetches, only v matters here */
+    if (offset == 7) {
+      inc_hori_v(ppu);
+    }
+    return;
+  }
   switch (offset) {
   case 1:
-    nt_byte_fetch(ppu);
+    nt_byte_fetch(ppu, mode);
     break;
   case 3:
-    at_byte_fetch(ppu);
+    at_byte_fetch(ppu, mode);
     break;
   case 5:
-    ptt_low_byte_fetch(ppu);
+    ptt_low_byte_fetch(ppu, mode);
     break;
   case 7:
-    ptt_high_byte_fetch(ppu);
+    ptt_high_byte_fetch(ppu, mode);
     inc_hori_v(ppu);
     break;
   }
@@ -508,7 +625,20 @@ static inline void tile_data_fetch(ppu_s *ppu, uint8_t offset) {
 
 /*------------------------------the meat--------------------------------*/
 
-static void background_step(ppu_s *ppu) {
+/* everything a dot does that draws, i.e. all but vblank and nmi */
+static inline void render_step(ppu_s *ppu, render_mode_e mode) {
+  if (ppu->ppumask &
+      (MASK_PPUMASK_BG_R_ENABLE | MASK_PPUMASK_SPRITE_R_ENABLE)) {
+    background_step(ppu, mode);
+    sprite_step(ppu);
+    if (mode != RENDER_TIMING && ppu->scanline < 240 && ppu->cycles < 256 &&
+        !ppu->skip_render) {
+      render_pixel(ppu, mode);
+    }
+  }
+}
+
+static void background_step(ppu_s *ppu, render_mode_e mode) {
   // If rendering scanline
   if (ppu->scanline < 240 || ppu->scanline == 261) {
 
@@ -516,7 +646,7 @@ static void background_step(ppu_s *ppu) {
     if (((ppu->cycles > 0) && (ppu->cycles < 257)) ||
              ((ppu->cycles > 320) && (ppu->cycles < 337))) {
       uint8_t offset = (ppu->cycles - 1) % 8;
-      tile_data_fetch(ppu, offset);
+      tile_data_fetch(ppu, offset, mode);
       
       if (ppu->cycles == 256) {
           inc_vert_v(ppu);
@@ -536,7 +666,8 @@ static void background_step(ppu_s *ppu) {
 
 static void sprite_step(ppu_s *ppu) {}
 
-static void render_pixel(const ppu_s *ppu) {
+static void render_pixel(const ppu_s *ppu, render_mode_e mode) {
+  PROFILE_SCOPE(PROFILE_RENDER_PIXEL);
   // Otherwise tiles are wrong way around
   static uint8_t i, tile_x, tile_y, tile_x_quad_select, tile_y_quad_select,
     quad_id, at_color_idx, ptt_color_idx, color_idx, palette_idx;
@@ -566,20 +697,238 @@ static void render_pixel(const ppu_s *ppu) {
   color_idx = (at_color_idx << 2) | ptt_color_idx;
 
   // Since we are background rendering for now, start at 3F00
-  palette_idx = vram_fetch(0x3F00 + color_idx);
-  put_pixel(ppu->scanline, ppu->cycles, palette_idx, put_pixel_data);
+  palette_idx = vram_read(ppu, 0x3F00 + color_idx, mode);
+  {
+    PROFILE_SCOPE(PROFILE_PUT_PIXEL);
+    put_pixel(ppu->scanline, ppu->cycles, palette_idx, put_pixel_data);
+  }
 }
 
-static void increment_ppu(ppu_s *ppu) {
+/* returns 1 if a new frame has started */
+static int increment_ppu(ppu_s *ppu) {
   if (ppu->cycles > 339) {
     ppu->cycles = 0;
     if (ppu->scanline > 260) {
       ppu->scanline = 0;
       ppu->frame_parity = ~ppu->frame_parity;
+      ppu->frame_count++;
+      ppu->skip_render =
+          (ppu->frame_skip > 1) && (ppu->frame_count % ppu->frame_skip);
+      return 1;
     } else {
       ppu->scanline++;
     }
   } else {
     ppu->cycles++;
   }
+  return 0;
+}
+
+/*----------------------------pipelined rendering----------------------------*/
+
+/* The cpu side records into segments, each a list of changes to what the
+ * renderer reads, tagged with the dot (scheduler clock) they happened
+ * before, and the dot to draw up to. Segments are used in turn, so the
+ * render thread just works through them in order: segment n is
+ * segments[n % PIPE_N_SEGMENTS]. A segment normally ends at the end of a
+ * frame, or earlier if it fills up or for a sync. */
+#define PIPE_N_SEGMENTS 3
+#define PIPE_SEGMENT_EVENTS 4096
+
+typedef enum pipe_event_e { PIPE_REGS, PIPE_VRAM, PIPE_FRAME } pipe_event_e;
+
+typedef struct pipe_event_s {
+  uint64_t dot;
+  uint16_t v; /* PIPE_VRAM: index into vram */
+  uint16_t t;
+  uint8_t type;
+  uint8_t ppuctrl;
+  uint8_t ppumask;
+  uint8_t val; /* PIPE_VRAM: value written, PIPE_FRAME: skip_render */
+} pipe_event_s;
+
+typedef struct pipe_segment_s {
+  pipe_event_s events[PIPE_SEGMENT_EVENTS];
+  uint32_t n_events;
+  uint64_t end; /* draw up to but not including this dot */
+} pipe_segment_s;
+
+typedef struct ppu_pipeline_s {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint64_t submitted; /* segments handed to the render thread */
+  uint64_t rendered;  /* segments it has finished */
+  uint8_t quit;
+  pipe_segment_s segments[PIPE_N_SEGMENTS];
+
+  /* only touched by the render thread while it is running */
+  ppu_s render;
+  uint64_t render_clock;
+  uint8_t vram[0x4000];
+} ppu_pipeline_s;
+
+static void *pipe_thread(void *data);
+
+int ppu_pipeline_start(ppu_s *ppu) {
+  if (ppu->pipeline != NULL) {
+    return E_NO_ERROR;
+  }
+  ppu_pipeline_s *p = calloc(1, sizeof(ppu_pipeline_s));
+  if (p == NULL) {
+    return -E_MALLOC;
+  }
+  for (uint32_t addr = 0; addr < 0x4000; addr++) {
+    p->vram[vram_index(addr)] = vram_fetch(addr);
+  }
+  p->render = *ppu;
+  p->render.vram = p->vram;
+  p->render_clock = scheduler_clock();
+
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  if (pthread_create(&p->thread, NULL, &pipe_thread, p) != 0) {
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+    return -E_THREAD;
+  }
+  ppu->pipeline = p;
+  return E_NO_ERROR;
+}
+
+/* end the segment being recorded at the current dot and hand it over.
+ * waits until the render thread has caught up if wait_all, otherwise only
+ * until there is a free segment to record into */
+static void pipe_submit(ppu_pipeline_s *p, int wait_all) {
+  pthread_mutex_lock(&p->lock);
+  p->segments[p->submitted % PIPE_N_SEGMENTS].end = scheduler_clock();
+  p->submitted++;
+  pthread_cond_broadcast(&p->cond);
+  uint64_t in_flight = wait_all ? 0 : PIPE_N_SEGMENTS - 1;
+  while (p->submitted - p->rendered > in_flight) {
+    pthread_cond_wait(&p->cond, &p->lock);
+  }
+  p->segments[p->submitted % PIPE_N_SEGMENTS].n_events = 0;
+  pthread_mutex_unlock(&p->lock);
+}
+
+void ppu_pipeline_sync(ppu_s *ppu) {
+  if (ppu->pipeline != NULL) {
+    pipe_submit(ppu->pipeline, 1);
+  }
+}
+
+void ppu_pipeline_stop(ppu_s *ppu) {
+  ppu_pipeline_s *p = ppu->pipeline;
+  if (p == NULL) {
+    return;
+  }
+  pipe_submit(p, 1);
+  pthread_mutex_lock(&p->lock);
+  p->quit = 1;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+  pthread_join(p->thread, NULL);
+
+  /* the cpu side didn't do the fetches, so take them from the renderer,
+   * which is at the same dot now */
+  ppu->nt_byte = p->render.nt_byte;
+  ppu->at_byte = p->render.at_byte;
+  ppu->ptt_low = p->render.ptt_low;
+  ppu->ptt_high = p->render.ptt_high;
+  ppu->at_shift = p->render.at_shift;
+  ppu->ptt_shift_low = p->render.ptt_shift_low;
+  ppu->ptt_shift_high = p->render.ptt_shift_high;
+
+  pthread_cond_destroy(&p->cond);
+  pthread_mutex_destroy(&p->lock);
+  free(p);
+  ppu->pipeline = NULL;
+}
+
+static pipe_event_s *pipe_event(ppu_s *ppu, pipe_event_e type) {
+  ppu_pipeline_s *p = ppu->pipeline;
+  pipe_segment_s *segment = &p->segments[p->submitted % PIPE_N_SEGMENTS];
+  if (segment->n_events == PIPE_SEGMENT_EVENTS) {
+    pipe_submit(p, 0);
+    segment = &p->segments[p->submitted % PIPE_N_SEGMENTS];
+  }
+  pipe_event_s *event = &segment->events[segment->n_events++];
+  event->dot = scheduler_clock();
+  event->type = type;
+  return event;
+}
+
+static void pipe_log_regs(ppu_s *ppu) {
+  pipe_event_s *event = pipe_event(ppu, PIPE_REGS);
+  event->ppuctrl = ppu->ppuctrl;
+  event->ppumask = ppu->ppumask;
+  event->v = ppu->v;
+  event->t = ppu->t;
+}
+
+static void pipe_log_vram(ppu_s *ppu, uint16_t addr, uint8_t val) {
+  pipe_event_s *event = pipe_event(ppu, PIPE_VRAM);
+  event->v = vram_index(addr);
+  event->val = val;
+}
+
+/* called at the first dot of each frame, so the frame just finished can
+ * be drawn while the cpu carries on */
+static void pipe_new_frame(ppu_s *ppu) {
+  pipe_submit(ppu->pipeline, 0);
+  pipe_event(ppu, PIPE_FRAME)->val = ppu->skip_render;
+}
+
+static void pipe_render(ppu_pipeline_s *p, const pipe_segment_s *segment) {
+  ppu_s *render = &p->render;
+  for (uint32_t i = 0; i <= segment->n_events; i++) {
+    uint64_t until =
+        (i < segment->n_events) ? segment->events[i].dot : segment->end;
+    for (; p->render_clock < until; p->render_clock++) {
+      render_step(render, RENDER_COPY);
+      increment_ppu(render);
+    }
+    if (i == segment->n_events) {
+      break;
+    }
+    const pipe_event_s *event = &segment->events[i];
+    switch (event->type) {
+    case PIPE_REGS:
+      render->ppuctrl = event->ppuctrl;
+      render->ppumask = event->ppumask;
+      render->v = event->v;
+      render->t = event->t;
+      break;
+    case PIPE_VRAM:
+      p->vram[event->v] = event->val;
+      break;
+    case PIPE_FRAME:
+      render->skip_render = event->val;
+      break;
+    }
+  }
+}
+
+static void *pipe_thread(void *data) {
+  ppu_pipeline_s *p = data;
+  pthread_mutex_lock(&p->lock);
+  for (;;) {
+    while (p->rendered == p->submitted && !p->quit) {
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    if (p->rendered == p->submitted) {
+      break; /* quit, and nothing left to draw */
+    }
+    const pipe_segment_s *segment =
+        &p->segments[p->rendered % PIPE_N_SEGMENTS];
+    pthread_mutex_unlock(&p->lock);
+    pipe_render(p, segment);
+    pthread_mutex_lock(&p->lock);
+    p->rendered++;
+    pthread_cond_broadcast(&p->cond);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
 }
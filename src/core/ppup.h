@@ -13,6 +13,15 @@ void ppu_register_write(ppu_s *ppu, uint16_t addr, uint8_t val, uint8_t *to_oamd
 void ppu_register_vram_write_callback(void (*vram_write)(uint16_t, uint8_t));
 void ppu_register_vram_fetch_callback(uint8_t (*vram_fetch)(uint16_t));
 
+/* where addr ends up in the mapper's 0x4000 bytes of vram after mirroring,
+ * so the render thread can keep a copy of vram, see ppu_pipeline_start */
+void ppu_register_vram_index_callback(uint16_t (*vram_index)(uint16_t));
+
+#define PPU_OAM_SIZE 0x100
+
+/* copy the PPU_OAM_SIZE bytes of oam into oam */
+void ppu_get_oam(uint8_t *oam);
+
 /* does one ppu cycle */
 void ppu_step(ppu_s *ppu, uint8_t *to_nmi);
 
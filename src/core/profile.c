@@ -0,0 +1,285 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "profilep.h"
+
+static const char *section_names[PROFILE_N_SECTIONS] = {
+    [PROFILE_CPU_EXEC] = "cpu_exec",
+    [PROFILE_MEMORY_FETCH] = "memory_fetch",
+    [PROFILE_MEMORY_WRITE] = "memory_write",
+    [PROFILE_PPU_STEP] = "ppu_step",
+    [PROFILE_RENDER_PIXEL] = "render_pixel",
+    [PROFILE_PUT_PIXEL] = "put_pixel",
+};
+
+const char *profile_section_name(profile_section_e section) {
+  return (section < PROFILE_N_SECTIONS) ? section_names[section] : "?";
+}
+
+#ifndef NES_PROFILE
+
+int profile_enabled(void) { return 0; }
+const char *profile_tick_unit(void) { return "ticks"; }
+void profile_reset(void) {}
+void profile_get_total(profile_frame_s *total) {
+  memset(total, 0, sizeof(*total));
+}
+void profile_register_frame_callback(
+    void (*on_frame)(const profile_frame_s *, void *), void *data) {
+  (void)on_frame;
+  (void)data;
+}
+void profile_unregister_frame_callback(void) {}
+
+#else
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* sections only nest a few deep (cpu_exec > memory_fetch > ppu_step >
+ * render_pixel > put_pixel), anything deeper than this isn't timed */
+#define MAX_DEPTH 16
+
+typedef struct open_section_s {
+  profile_section_e section;
+  uint64_t start;
+  uint64_t nested; /* ticks spent in sections entered from this one */
+} open_section_s;
+
+/* per thread, so the render thread of a pipelined ppu doesn't mix its
+ * sections into the cpu thread's. only the cpu thread's are reported */
+static _Thread_local open_section_s stack[MAX_DEPTH];
+static _Thread_local int depth = 0;
+
+static _Thread_local profile_frame_s frame;
+static profile_frame_s total;
+static uint64_t frame_start = 0;
+
+static void (*on_frame_cb)(const profile_frame_s *, void *) = NULL;
+static void *on_frame_data = NULL;
+
+static inline uint64_t now(void) {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* ------------------------------------------------------------------------ */
+/* hardware counters, read once a frame since a read is a syscall           */
+/* ------------------------------------------------------------------------ */
+
+enum { COUNTER_INSTRUCTIONS, COUNTER_CACHE_MISSES, COUNTER_BRANCH_MISSES,
+       N_COUNTERS };
+
+static int counters_tried = 0;
+static int counter_fd = -1; /* group leader, -1 if counters unavailable */
+static uint64_t counter_last[N_COUNTERS];
+
+#ifdef __linux__
+static int open_counter(uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = (group_fd == -1);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/* reads all counters in the group, returns 0 on success */
+static int read_counters(uint64_t *values) {
+  uint64_t buf[1 + N_COUNTERS];
+  if (read(counter_fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf) ||
+      buf[0] != N_COUNTERS) {
+    return -1;
+  }
+  memcpy(values, buf + 1, sizeof(uint64_t) * N_COUNTERS);
+  return 0;
+}
+#endif
+
+static void open_counters(void) {
+  counters_tried = 1;
+#ifdef __linux__
+  static const uint64_t configs[N_COUNTERS] = {
+      [COUNTER_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+      [COUNTER_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+      [COUNTER_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+  };
+  int fds[N_COUNTERS];
+  fds[0] = open_counter(configs[0], -1);
+  if (fds[0] < 0) {
+    return;
+  }
+  for (int i = 1; i < N_COUNTERS; i++) {
+    fds[i] = open_counter(configs[i], fds[0]);
+    if (fds[i] < 0) {
+      /* members are closed with the leader, close what we have */
+      for (int j = i - 1; j >= 0; j--) {
+        close(fds[j]);
+      }
+      return;
+    }
+  }
+  counter_fd = fds[0];
+  ioctl(counter_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(counter_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  if (read_counters(counter_last) < 0) {
+    close(counter_fd);
+    counter_fd = -1;
+  }
+#endif
+}
+
+static void sample_counters(profile_frame_s *f) {
+  f->have_counters = 0;
+#ifdef __linux__
+  uint64_t values[N_COUNTERS];
+  if (counter_fd < 0 || read_counters(values) < 0) {
+    return;
+  }
+  f->have_counters = 1;
+  f->instructions = values[COUNTER_INSTRUCTIONS] -
+                    counter_last[COUNTER_INSTRUCTIONS];
+  f->cache_misses = values[COUNTER_CACHE_MISSES] -
+                    counter_last[COUNTER_CACHE_MISSES];
+  f->branch_misses = values[COUNTER_BRANCH_MISSES] -
+                     counter_last[COUNTER_BRANCH_MISSES];
+  memcpy(counter_last, values, sizeof(counter_last));
+#else
+  (void)f;
+#endif
+}
+
+/* ------------------------------------------------------------------------ */
+
+int profile_enabled(void) { return 1; }
+
+const char *profile_tick_unit(void) {
+#ifdef HAVE_TSC
+  return "tsc cycles";
+#else
+  return "ns";
+#endif
+}
+
+void profile_enter(profile_section_e section) {
+  if (depth < MAX_DEPTH) {
+    stack[depth].section = section;
+    stack[depth].nested = 0;
+    stack[depth].start = now();
+  }
+  depth++;
+}
+
+void profile_leave(profile_scope_s *scope) {
+  (void)scope;
+  uint64_t end = now();
+  depth--;
+  if (depth >= MAX_DEPTH) {
+    return;
+  }
+  open_section_s *open = &stack[depth];
+  uint64_t ticks = end - open->start;
+  profile_section_s *s = &frame.sections[open->section];
+  s->calls++;
+  s->ticks += ticks;
+  s->self_ticks += ticks - open->nested;
+  if (depth > 0) {
+    stack[depth - 1].nested += ticks;
+  }
+}
+
+void profile_frame_done(void) {
+  uint64_t end = now();
+  frame.frames = 1;
+  frame.ticks = (frame_start != 0) ? end - frame_start : 0;
+  if (counters_tried) {
+    sample_counters(&frame);
+  } else {
+    /* first frame, counting starts now */
+    open_counters();
+  }
+
+  total.frames++;
+  total.ticks += frame.ticks;
+  for (int i = 0; i < PROFILE_N_SECTIONS; i++) {
+    total.sections[i].calls += frame.sections[i].calls;
+    total.sections[i].ticks += frame.sections[i].ticks;
+    total.sections[i].self_ticks += frame.sections[i].self_ticks;
+  }
+  if (frame.have_counters) {
+    total.have_counters = 1;
+    total.instructions += frame.instructions;
+    total.cache_misses += frame.cache_misses;
+    total.branch_misses += frame.branch_misses;
+  }
+
+  if (on_frame_cb != NULL) {
+    on_frame_cb(&frame, on_frame_data);
+  }
+  memset(&frame, 0, sizeof(frame));
+  /* don't count the callback as part of the next frame */
+  frame_start = now();
+}
+
+void profile_reset(void) {
+  memset(&frame, 0, sizeof(frame));
+  memset(&total, 0, sizeof(total));
+  frame_start = now();
+#ifdef __linux__
+  if (counter_fd >= 0) {
+    read_counters(counter_last);
+  }
+#endif
+}
+
+void profile_get_total(profile_frame_s *t) { *t = total; }
+
+void profile_register_frame_callback(
+    void (*on_frame)(const profile_frame_s *, void *), void *data) {
+  on_frame_cb = on_frame;
+  on_frame_data = data;
+}
+
+void profile_unregister_frame_callback(void) {
+  on_frame_cb = NULL;
+  on_frame_data = NULL;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef PROFILEP_H_
+#define PROFILEP_H_
+
+#include "core/profile.h"
+
+/* PROFILE_SCOPE(section) at the top of a block times the rest of the
+ * block, however it is left. PROFILE_FRAME_DONE() is called by the ppu
+ * when it finishes a frame. Both are nothing without NES_PROFILE. */
+#ifdef NES_PROFILE
+
+typedef struct profile_scope_s {
+  uint8_t unused;
+} profile_scope_s;
+
+void profile_enter(profile_section_e section);
+void profile_leave(profile_scope_s *scope);
+void profile_frame_done(void);
+
+/* cleanup runs profile_leave when the variable goes out of scope */
+#define PROFILE_SCOPE(section)                                                 \
+  profile_enter(section);                                                      \
+  profile_scope_s profile_scope_##section                                      \
+      __attribute__((cleanup(profile_leave), unused))
+#define PROFILE_FRAME_DONE() profile_frame_done()
+
+#else
+
+#define PROFILE_SCOPE(section)
+#define PROFILE_FRAME_DONE()
+
+#endif
+
+#endif
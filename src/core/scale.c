@@ -0,0 +1,570 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/scale.h"
+#include "bandpoolp.h"
+#include "core/errors.h"
+#include "core/palette.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCALE_SSE2 1
+#endif
+
+/* rows above and below the one being scaled that the filters look at,
+ * xBR goes out 2 */
+#define RADIUS 2
+#define N_LINES (2 * RADIUS + 1)
+
+/* each input row is copied into a line with this many copies of the end
+ * pixels either side, enough for RADIUS and the 16 pixel loads at x - 1
+ * and x + 1 */
+#define LINE_PAD 16
+#define LINE_SIZE (LINE_PAD + SCALE_IN_WIDTH + LINE_PAD)
+
+/* pixels the neighbours are compared for at once */
+#define RUN 16
+
+/* hqx's YUV thresholds for two colours to count as different */
+#define HQX_Y 48
+#define HQX_U 7
+#define HQX_V 6
+
+#define XBR_MAX_FACTOR 4
+
+typedef struct scale_job_s {
+  const uint8_t *in;
+  int in_stride;
+  int height;
+  uint32_t *out;
+  int out_stride;
+} scale_job_s;
+
+struct scale_s;
+
+/* scale lines[RADIUS] into factor rows of out, lines[0] is RADIUS rows
+ * above and lines[N_LINES - 1] RADIUS rows below */
+typedef void (*scale_row_fn)(const struct scale_s *scale,
+                             const uint8_t *const *lines, uint32_t *out,
+                             int out_stride);
+
+struct scale_s {
+  int factor;
+  scale_row_fn row;
+  uint32_t rgba[PALETTE_SIZE];
+  /* hqx: nonzero if two colours are further apart than the thresholds */
+  uint8_t differ[PALETTE_SIZE][PALETTE_SIZE];
+  /* xbr: weighted distance between two colours in YUV */
+  uint16_t dist[PALETTE_SIZE][PALETTE_SIZE];
+  /* xbr: how much of each output pixel of a block the blend for its
+   * bottom right corner covers, out of 256, [y][x] */
+  uint16_t xbr_alpha[XBR_MAX_FACTOR][XBR_MAX_FACTOR];
+
+  bandpool_s *pool;
+  uint8_t *lines[SCALE_MAX_THREADS]; /* N_LINES * LINE_SIZE each */
+};
+
+static void make_tables(scale_s *scale);
+static void scale_rows(void *data, void *job, int worker, int first_row,
+                       int end_row);
+static void nearest_row(const scale_s *scale, const uint8_t *const *lines,
+                        uint32_t *out, int out_stride);
+static void scalex_row(const scale_s *scale, const uint8_t *const *lines,
+                       uint32_t *out, int out_stride);
+static void hqx_row(const scale_s *scale, const uint8_t *const *lines,
+                    uint32_t *out, int out_stride);
+static void xbr_row(const scale_s *scale, const uint8_t *const *lines,
+                    uint32_t *out, int out_stride);
+
+/*======================Public functions======================*/
+
+int scale_create(scale_s **scale, scale_filter_e filter, int factor,
+                 int n_threads) {
+  if (n_threads < 1 || n_threads > SCALE_MAX_THREADS) {
+    return -E_BUF_SIZE;
+  }
+  scale_row_fn row;
+  switch (filter) {
+  case SCALE_NEAREST:
+    row = (factor >= 1 && factor <= SCALE_MAX_FACTOR) ? &nearest_row : NULL;
+    break;
+  case SCALE_SCALEX:
+    row = (factor == 2 || factor == 3) ? &scalex_row : NULL;
+    break;
+  case SCALE_HQX:
+    row = (factor == 2 || factor == 3) ? &hqx_row : NULL;
+    break;
+  case SCALE_XBR:
+    row = (factor >= 2 && factor <= XBR_MAX_FACTOR) ? &xbr_row : NULL;
+    break;
+  default:
+    row = NULL;
+  }
+  if (row == NULL) {
+    return -E_SCALE_FACTOR;
+  }
+
+  scale_s *s = calloc(1, sizeof(scale_s));
+  if (s == NULL) {
+    return -E_MALLOC;
+  }
+  s->factor = factor;
+  s->row = row;
+  make_tables(s);
+
+  for (int i = 0; i < n_threads; i++) {
+    if ((s->lines[i] = malloc(N_LINES * LINE_SIZE)) == NULL) {
+      scale_destroy(s);
+      return -E_MALLOC;
+    }
+  }
+  int err = bandpool_create(&s->pool, n_threads, &scale_rows, s);
+  if (err < 0) {
+    scale_destroy(s);
+    return err;
+  }
+  *scale = s;
+  return E_NO_ERROR;
+}
+
+void scale_destroy(scale_s *scale) {
+  if (scale == NULL) {
+    return;
+  }
+  bandpool_destroy(scale->pool);
+  for (int i = 0; i < SCALE_MAX_THREADS; i++) {
+    free(scale->lines[i]);
+  }
+  free(scale);
+}
+
+int scale_factor(const scale_s *scale) { return scale->factor; }
+
+void scale_frame(scale_s *scale, const uint8_t *in, int in_stride, int height,
+                 uint32_t *out, int out_stride) {
+  scale_job_s job = {in, in_stride, height, out, out_stride};
+  bandpool_run(scale->pool, &job, height);
+}
+
+/*======================Tables======================*/
+
+static int absi(int x) { return x < 0 ? -x : x; }
+
+static void make_tables(scale_s *scale) {
+  int yuv[PALETTE_SIZE][3];
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+    int r = nes_palette[i * 3];
+    int g = nes_palette[i * 3 + 1];
+    int b = nes_palette[i * 3 + 2];
+    scale->rgba[i] = 0xFF000000u | (uint32_t)b << 16 | (uint32_t)g << 8 | r;
+    yuv[i][0] = (299 * r + 587 * g + 114 * b) / 1000;
+    yuv[i][1] = (-169 * r - 331 * g + 500 * b) / 1000;
+    yuv[i][2] = (500 * r - 419 * g - 81 * b) / 1000;
+  }
+
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+    for (int j = 0; j < PALETTE_SIZE; j++) {
+      int dy = absi(yuv[i][0] - yuv[j][0]);
+      int du = absi(yuv[i][1] - yuv[j][1]);
+      int dv = absi(yuv[i][2] - yuv[j][2]);
+      scale->differ[i][j] = dy > HQX_Y || du > HQX_U || dv > HQX_V;
+      scale->dist[i][j] = (uint16_t)(48 * dy + 7 * du + 6 * dv);
+    }
+  }
+
+  /* xBR blends the corner of the block on the far side of a line from
+   * halfway down its right edge to halfway along its bottom edge, so the
+   * output pixel at (x, y) is blended by the area of it past that line,
+   * which is x + y > 1.5 * factor in output pixels */
+  int n = scale->factor;
+  if (n > XBR_MAX_FACTOR) {
+    return;
+  }
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      double t = 1.5 * n - x - y;
+      double area = t <= 0   ? 1
+                    : t <= 1 ? 1 - t * t / 2
+                    : t <= 2 ? (2 - t) * (2 - t) / 2
+                             : 0;
+      scale->xbr_alpha[y][x] = (uint16_t)(area * 256 + 0.5);
+    }
+  }
+}
+
+/*======================Rows======================*/
+
+/* copy SCALE_IN_WIDTH indices from src to line with LINE_PAD copies of
+ * the end ones either side */
+static void copy_line(uint8_t *line, const uint8_t *src) {
+  for (int x = 0; x < SCALE_IN_WIDTH; x++) {
+    line[x] = src[x] % PALETTE_SIZE;
+  }
+  memset(line - LINE_PAD, line[0], LINE_PAD);
+  memset(line + SCALE_IN_WIDTH, line[SCALE_IN_WIDTH - 1], LINE_PAD);
+}
+
+/* rows past the top and bottom are the same as the first and last */
+static const uint8_t *in_row(const scale_job_s *job, int row) {
+  row = row < 0 ? 0 : row >= job->height ? job->height - 1 : row;
+  return job->in + (size_t)row * job->in_stride;
+}
+
+/* the lines around each row are a ring that moves on one row at a time,
+ * so each input row is copied once per band plus RADIUS either side */
+static void scale_rows(void *data, void *job_data, int worker, int first_row,
+                       int end_row) {
+  const scale_s *scale = data;
+  const scale_job_s *job = job_data;
+  const uint8_t *lines[N_LINES];
+  uint8_t *ring[N_LINES];
+  for (int i = 0; i < N_LINES; i++) {
+    ring[i] = scale->lines[worker] + i * LINE_SIZE + LINE_PAD;
+  }
+
+  for (int row = first_row; row < end_row; row++) {
+    if (row == first_row) {
+      for (int i = 0; i < N_LINES; i++) {
+        copy_line(ring[i], in_row(job, row + i - RADIUS));
+      }
+    } else {
+      uint8_t *oldest = ring[0];
+      memmove(ring, ring + 1, (N_LINES - 1) * sizeof(ring[0]));
+      ring[N_LINES - 1] = oldest;
+      copy_line(oldest, in_row(job, row + RADIUS));
+    }
+    for (int i = 0; i < N_LINES; i++) {
+      lines[i] = ring[i];
+    }
+    scale->row(scale, lines,
+               job->out + (size_t)row * scale->factor * job->out_stride,
+               job->out_stride);
+  }
+}
+
+/* each pixel of idx[0 .. count) as a factor x factor block */
+static void fill_run(const scale_s *scale, const uint8_t *idx, int count,
+                     uint32_t *out, int out_stride) {
+  int n = scale->factor;
+  for (int i = 0; i < count; i++) {
+    uint32_t c = scale->rgba[idx[i]];
+    for (int k = 0; k < n; k++) {
+      out[i * n + k] = c;
+    }
+  }
+  for (int r = 1; r < n; r++) {
+    memcpy(out + (size_t)r * out_stride, out, (size_t)count * n * 4);
+  }
+}
+
+static void nearest_row(const scale_s *scale, const uint8_t *const *lines,
+                        uint32_t *out, int out_stride) {
+  fill_run(scale, lines[RADIUS], SCALE_IN_WIDTH, out, out_stride);
+}
+
+/* Bit i of the masks is for pixel x + i of lines[RADIUS]. flat_mask has
+ * it set if the pixel is the same as all 8 around it, so none of the
+ * filters change it. scalex_mask has it set if above and below or left
+ * and right are the same, which is when Scale2x/3x leave it alone. */
+#ifdef SCALE_SSE2
+
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+
+static inline unsigned flat_mask(const uint8_t *const *lines, int x) {
+  const uint8_t *up = lines[RADIUS - 1] + x;
+  const uint8_t *mid = lines[RADIUS] + x;
+  const uint8_t *down = lines[RADIUS + 1] + x;
+  __m128i e = LOAD(mid);
+  __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(e, LOAD(mid - 1)),
+                             _mm_cmpeq_epi8(e, LOAD(mid + 1)));
+  eq = _mm_and_si128(eq, _mm_cmpeq_epi8(e, LOAD(up - 1)));
+  eq = _mm_and_si128(eq, _mm_cmpeq_epi8(e, LOAD(up)));
+  eq = _mm_and_si128(eq, _mm_cmpeq_epi8(e, LOAD(up + 1)));
+  eq = _mm_and_si128(eq, _mm_cmpeq_epi8(e, LOAD(down - 1)));
+  eq = _mm_and_si128(eq, _mm_cmpeq_epi8(e, LOAD(down)));
+  eq = _mm_and_si128(eq, _mm_cmpeq_epi8(e, LOAD(down + 1)));
+  return (unsigned)_mm_movemask_epi8(eq);
+}
+
+static inline unsigned scalex_mask(const uint8_t *const *lines, int x) {
+  const uint8_t *mid = lines[RADIUS] + x;
+  __m128i vert = _mm_cmpeq_epi8(LOAD(lines[RADIUS - 1] + x),
+                                LOAD(lines[RADIUS + 1] + x));
+  __m128i horiz = _mm_cmpeq_epi8(LOAD(mid - 1), LOAD(mid + 1));
+  return (unsigned)_mm_movemask_epi8(_mm_or_si128(vert, horiz));
+}
+
+#undef LOAD
+
+#else
+
+static inline unsigned flat_mask(const uint8_t *const *lines, int x) {
+  const uint8_t *up = lines[RADIUS - 1];
+  const uint8_t *mid = lines[RADIUS];
+  const uint8_t *down = lines[RADIUS + 1];
+  unsigned mask = 0;
+  for (int i = 0; i < RUN; i++) {
+    int p = x + i;
+    uint8_t e = mid[p];
+    int flat = e == mid[p - 1] && e == mid[p + 1] && e == up[p - 1] &&
+               e == up[p] && e == up[p + 1] && e == down[p - 1] &&
+               e == down[p] && e == down[p + 1];
+    mask |= (unsigned)flat << i;
+  }
+  return mask;
+}
+
+static inline unsigned scalex_mask(const uint8_t *const *lines, int x) {
+  const uint8_t *mid = lines[RADIUS];
+  unsigned mask = 0;
+  for (int i = 0; i < RUN; i++) {
+    int p = x + i;
+    int same = lines[RADIUS - 1][p] == lines[RADIUS + 1][p] ||
+               mid[p - 1] == mid[p + 1];
+    mask |= (unsigned)same << i;
+  }
+  return mask;
+}
+
+#endif
+
+#define ALL_SET ((1u << RUN) - 1)
+
+/* the 3x3 around pixel p of lines[RADIUS]:
+ *   A B C
+ *   D E F
+ *   G H I */
+#define NEIGHBOURS(lines, p)                                                  \
+  const uint8_t A = lines[RADIUS - 1][p - 1], B = lines[RADIUS - 1][p],     \
+                C = lines[RADIUS - 1][p + 1], D = lines[RADIUS][p - 1],     \
+                E = lines[RADIUS][p], F = lines[RADIUS][p + 1],             \
+                G = lines[RADIUS + 1][p - 1], H = lines[RADIUS + 1][p],     \
+                I = lines[RADIUS + 1][p + 1]
+
+static void scalex_row(const scale_s *scale, const uint8_t *const *lines,
+                       uint32_t *out, int out_stride) {
+  const uint32_t *rgba = scale->rgba;
+  int n = scale->factor;
+  for (int x = 0; x < SCALE_IN_WIDTH; x += RUN) {
+    unsigned same = scalex_mask(lines, x);
+    if (same == ALL_SET) {
+      fill_run(scale, lines[RADIUS] + x, RUN, out + x * n, out_stride);
+      continue;
+    }
+    for (int i = 0; i < RUN; i++) {
+      int p = x + i;
+      uint32_t *o = out + p * n;
+      if (same >> i & 1) {
+        fill_run(scale, lines[RADIUS] + p, 1, o, out_stride);
+        continue;
+      }
+      NEIGHBOURS(lines, p);
+      (void)A, (void)C, (void)G, (void)I;
+      if (n == 2) {
+        o[0] = rgba[D == B ? D : E];
+        o[1] = rgba[B == F ? F : E];
+        o[out_stride] = rgba[D == H ? D : E];
+        o[out_stride + 1] = rgba[H == F ? F : E];
+      } else {
+        uint32_t *o1 = o + out_stride, *o2 = o + 2 * out_stride;
+        o[0] = rgba[D == B ? D : E];
+        o[1] = rgba[(D == B && E != C) || (B == F && E != A) ? B : E];
+        o[2] = rgba[B == F ? F : E];
+        o1[0] = rgba[(D == B && E != G) || (D == H && E != A) ? D : E];
+        o1[1] = rgba[E];
+        o1[2] = rgba[(B == F && E != I) || (H == F && E != C) ? F : E];
+        o2[0] = rgba[D == H ? D : E];
+        o2[1] = rgba[(D == H && E != I) || (H == F && E != G) ? H : E];
+        o2[2] = rgba[H == F ? F : E];
+      }
+    }
+  }
+}
+
+/* a weighted wa and b 256 - wa, for each byte */
+static inline uint32_t mix2(uint32_t a, uint32_t b, uint32_t wa) {
+  uint32_t wb = 256 - wa;
+  uint32_t rb = (((a & 0x00FF00FF) * wa + (b & 0x00FF00FF) * wb) >> 8) &
+                0x00FF00FF;
+  uint32_t ga = (((a >> 8) & 0x00FF00FF) * wa + ((b >> 8) & 0x00FF00FF) * wb) &
+                0xFF00FF00;
+  return rb | ga;
+}
+
+/* a, b and c weighted wa, wb and 256 - wa - wb */
+static inline uint32_t mix3(uint32_t a, uint32_t b, uint32_t c, uint32_t wa,
+                            uint32_t wb) {
+  uint32_t wc = 256 - wa - wb;
+  uint32_t rb = (((a & 0x00FF00FF) * wa + (b & 0x00FF00FF) * wb +
+                  (c & 0x00FF00FF) * wc) >>
+                 8) &
+                0x00FF00FF;
+  uint32_t ga = (((a >> 8) & 0x00FF00FF) * wa + ((b >> 8) & 0x00FF00FF) * wb +
+                 ((c >> 8) & 0x00FF00FF) * wc) &
+                0xFF00FF00;
+  return rb | ga;
+}
+
+/* The corner of E towards c, which is between e1 and e2. If e1 and e2 are
+ * alike and E isn't, an edge goes across the corner, and it is blended
+ * with them: mostly towards them if c is alike them too and E carries on
+ * along one of the other sides (o1, o2), so E is the corner of a shape,
+ * otherwise halfway, which smooths thin diagonal lines. */
+static inline uint32_t hqx_corner(const scale_s *scale, uint8_t E, uint8_t e1,
+                                  uint8_t e2, uint8_t c, uint8_t o1,
+                                  uint8_t o2) {
+  const uint8_t *differ = scale->differ[E];
+  if (scale->differ[e1][e2] || !differ[e1]) {
+    return scale->rgba[E];
+  }
+  if (differ[c] && !scale->differ[c][e1] && (!differ[o1] || !differ[o2])) {
+    return mix3(scale->rgba[E], scale->rgba[e1], scale->rgba[e2], 64, 96);
+  }
+  return mix3(scale->rgba[E], scale->rgba[e1], scale->rgba[e2], 128, 64);
+}
+
+/* an edge goes across the corner between e1 and e2 */
+#define HQX_EDGE(E, e1, e2) (!differ[e1][e2] && differ[E][e1])
+
+static void hqx_row(const scale_s *scale, const uint8_t *const *lines,
+                    uint32_t *out, int out_stride) {
+  const uint32_t *rgba = scale->rgba;
+  const uint8_t(*differ)[PALETTE_SIZE] = scale->differ;
+  int n = scale->factor;
+  for (int x = 0; x < SCALE_IN_WIDTH; x += RUN) {
+    unsigned flat = flat_mask(lines, x);
+    if (flat == ALL_SET) {
+      fill_run(scale, lines[RADIUS] + x, RUN, out + x * n, out_stride);
+      continue;
+    }
+    for (int i = 0; i < RUN; i++) {
+      int p = x + i;
+      uint32_t *o = out + p * n;
+      uint32_t *last = o + (n - 1) * out_stride;
+      if (flat >> i & 1) {
+        fill_run(scale, lines[RADIUS] + p, 1, o, out_stride);
+        continue;
+      }
+      NEIGHBOURS(lines, p);
+      o[0] = hqx_corner(scale, E, B, D, A, F, H);
+      o[n - 1] = hqx_corner(scale, E, B, F, C, D, H);
+      last[0] = hqx_corner(scale, E, H, D, G, F, B);
+      last[n - 1] = hqx_corner(scale, E, H, F, I, D, B);
+      if (n == 3) {
+        /* the middle of each side takes a little of the neighbour on
+         * that side when an edge from one of its corners carries on
+         * past the other, as in Scale3x */
+        uint32_t *o1 = o + out_stride;
+        uint32_t e = rgba[E];
+        o[1] = (HQX_EDGE(E, B, D) && differ[E][C]) ||
+                       (HQX_EDGE(E, B, F) && differ[E][A])
+                   ? mix2(e, rgba[B], 192)
+                   : e;
+        o1[0] = (HQX_EDGE(E, D, B) && differ[E][G]) ||
+                        (HQX_EDGE(E, D, H) && differ[E][A])
+                    ? mix2(e, rgba[D], 192)
+                    : e;
+        o1[1] = e;
+        o1[2] = (HQX_EDGE(E, F, B) && differ[E][I]) ||
+                        (HQX_EDGE(E, F, H) && differ[E][C])
+                    ? mix2(e, rgba[F], 192)
+                    : e;
+        last[1] = (HQX_EDGE(E, H, D) && differ[E][I]) ||
+                          (HQX_EDGE(E, H, F) && differ[E][G])
+                      ? mix2(e, rgba[H], 192)
+                      : e;
+      }
+    }
+  }
+}
+
+#undef HQX_EDGE
+
+/* Blend the corner of the block for pixel p of lines[RADIUS] in direction
+ * (dx, dy), each 1 or -1, using xBR's rule. With the 5x5 around E turned
+ * so the corner is bottom right:
+ *
+ *      A1 B1 C1
+ *   A0 A  B  C  C4
+ *   D0 D  E  F  F4
+ *   G0 G  H  I  I4
+ *      G5 H5 I5
+ *
+ * an edge goes from F to H if the colours change less along that
+ * diagonal than across it, and then the corner is blended with whichever
+ * of F and H is closer to E. */
+static void xbr_corner(const scale_s *scale, const uint8_t *const *lines,
+                       int p, int dx, int dy, uint32_t *o, int out_stride) {
+#define AT(x, y) lines[RADIUS + (y) * dy][p + (x) * dx]
+  const uint16_t(*d)[PALETTE_SIZE] = scale->dist;
+  uint8_t E = AT(0, 0), F = AT(1, 0), H = AT(0, 1);
+  if (d[E][F] == 0 || d[E][H] == 0) {
+    return;
+  }
+  uint8_t B = AT(0, -1), C = AT(1, -1), D = AT(-1, 0), G = AT(-1, 1),
+          I = AT(1, 1), F4 = AT(2, 0), I4 = AT(2, 1), H5 = AT(0, 2),
+          I5 = AT(1, 2);
+#undef AT
+  int across = d[E][C] + d[E][G] + d[I][F4] + d[I][H5] + 4 * d[H][F];
+  int along = d[H][D] + d[H][I5] + d[F][I4] + d[F][B] + 4 * d[E][I];
+  if (across >= along) {
+    return;
+  }
+  /* leave corners of flat areas and the ends of lines alone, as xBR does */
+  if (!((d[F][B] != 0 && d[H][D] != 0) ||
+        (d[E][I] == 0 && d[F][I4] != 0 && d[H][I5] != 0) || d[E][G] == 0 ||
+        d[E][C] == 0)) {
+    return;
+  }
+
+  uint32_t px = scale->rgba[d[E][F] <= d[E][H] ? F : H];
+  int n = scale->factor;
+  for (int y = 0; y < n; y++) {
+    uint32_t *row = o + (size_t)(dy > 0 ? y : n - 1 - y) * out_stride;
+    for (int x = 0; x < n; x++) {
+      uint32_t alpha = scale->xbr_alpha[y][x];
+      if (alpha != 0) {
+        uint32_t *q = row + (dx > 0 ? x : n - 1 - x);
+        *q = mix2(px, *q, alpha);
+      }
+    }
+  }
+}
+
+static void xbr_row(const scale_s *scale, const uint8_t *const *lines,
+                    uint32_t *out, int out_stride) {
+  int n = scale->factor;
+  for (int x = 0; x < SCALE_IN_WIDTH; x += RUN) {
+    unsigned flat = flat_mask(lines, x);
+    fill_run(scale, lines[RADIUS] + x, RUN, out + x * n, out_stride);
+    if (flat == ALL_SET) {
+      continue;
+    }
+    for (int i = 0; i < RUN; i++) {
+      if (flat >> i & 1) {
+        continue;
+      }
+      uint32_t *o = out + (x + i) * n;
+      xbr_corner(scale, lines, x + i, 1, 1, o, out_stride);
+      xbr_corner(scale, lines, x + i, -1, 1, o, out_stride);
+      xbr_corner(scale, lines, x + i, 1, -1, o, out_stride);
+      xbr_corner(scale, lines, x + i, -1, -1, o, out_stride);
+    }
+  }
+}
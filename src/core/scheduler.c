@@ -0,0 +1,76 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include "schedulerp.h"
+
+typedef struct sched_entry_s {
+  uint64_t time;
+  sched_event_e event;
+} sched_entry_s;
+
+/* pending events sorted by time, earliest last so popping is cheap.
+ * there are only a few kinds of event so a sorted array beats a heap */
+static sched_entry_s entries[SCHED_N_EVENTS];
+static int n_entries = 0;
+
+uint64_t sched_clock = 0;
+uint64_t sched_next_time = UINT64_MAX; /* time of entries[n_entries - 1] */
+
+static inline void update_next_time(void) {
+  sched_next_time = (n_entries > 0) ? entries[n_entries - 1].time : UINT64_MAX;
+}
+
+void scheduler_reset(void) {
+  sched_clock = 0;
+  n_entries = 0;
+  update_next_time();
+}
+
+void scheduler_add(sched_event_e event, uint64_t time) {
+  scheduler_remove(event);
+  int i = n_entries++;
+  while (i > 0 && entries[i - 1].time < time) {
+    entries[i] = entries[i - 1];
+    i--;
+  }
+  entries[i].time = time;
+  entries[i].event = event;
+  update_next_time();
+}
+
+void scheduler_remove(sched_event_e event) {
+  for (int i = 0; i < n_entries; i++) {
+    if (entries[i].event == event) {
+      for (int j = i + 1; j < n_entries; j++) {
+        entries[j - 1] = entries[j];
+      }
+      n_entries--;
+      update_next_time();
+      return;
+    }
+  }
+}
+
+int scheduler_pop(sched_event_e *event) {
+  if (!scheduler_due()) {
+    return 0;
+  }
+  *event = entries[--n_entries].event;
+  update_next_time();
+  return 1;
+}
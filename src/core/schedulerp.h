@@ -0,0 +1,53 @@
+#ifndef SCHEDULERP_H_
+#define SCHEDULERP_H_
+
+#include <stdint.h>
+
+/* Things that happen at a known time are put in the scheduler instead of
+ * being checked for on every ppu dot. Time is counted in ppu dots since
+ * scheduler_reset(), so a cpu cycle is 3.
+ *
+ * Each event is either pending once or not at all, adding one that is
+ * already pending moves it. More events (mapper and apu frame irqs, dma)
+ * go here once those are emulated.
+ */
+typedef enum sched_event_e {
+  SCHED_VBLANK_START,
+  SCHED_VBLANK_END,
+  SCHED_N_EVENTS
+} sched_event_e;
+
+/* clock back to 0 and no events pending */
+void scheduler_reset(void);
+
+/* only for the inline functions below, which ppu_step calls every dot */
+extern uint64_t sched_clock;
+extern uint64_t sched_next_time;
+
+/* dots since scheduler_reset() */
+static inline uint64_t scheduler_clock(void) { return sched_clock; }
+
+/* nonzero if an event is due at or before the current dot */
+static inline int scheduler_due(void) {
+  return sched_next_time <= sched_clock;
+}
+
+/* move the clock on n_dots */
+static inline void scheduler_advance(uint32_t n_dots) {
+  sched_clock += n_dots;
+}
+
+/* event happens at dot time, which must be at or after scheduler_clock() */
+void scheduler_add(sched_event_e event, uint64_t time);
+
+/* event is no longer pending, if it was */
+void scheduler_remove(sched_event_e event);
+
+/* if an event is due at or before the current dot, removes the earliest,
+ * sets *event to it and returns 1, otherwise returns 0 */
+int scheduler_pop(sched_event_e *event);
+
+/* time of the next event, or UINT64_MAX if there are none */
+static inline uint64_t scheduler_next_time(void) { return sched_next_time; }
+
+#endif
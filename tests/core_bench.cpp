@@ -0,0 +1,347 @@
+/* microbenchmarks for the core emulator hot paths */
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Run with e.g.
+ *   ./core_bench --benchmark_out=bench.json --benchmark_out_format=json
+ * to get results that can be compared between commits. The full frame
+ * benchmark uses nestest.nes unless NES_BENCH_ROM is set to another rom.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "core/cppwrapper.hpp"
+
+/* private headers, to get at memory_fetch, memory_write and ppu_step */
+extern "C" {
+#include "memoryp.h"
+#include "ppup.h"
+}
+
+#define PROGRAMME_START 0x0200
+
+static void put_pixel(int, int, uint8_t, void *) {}
+static void cb_error_none(const char *format, ...) {}
+static void cb_ppu_none(const ppu_state_s *ppu_state, void *data) {}
+static void cb_cpu_none(const cpu_state_s *cpu_state, void *data) {}
+static void cb_memory_none(uint16_t addr, uint8_t val, void *data) {}
+static uint8_t cb_buttons_none(void *data) { return 0; }
+
+static void register_callbacks(void) {
+  ppu_register_state_callback(&cb_ppu_none, NULL);
+  ppu_register_error_callback(&cb_error_none);
+  cpu_register_state_callback(&cb_cpu_none, NULL);
+  cpu_register_error_callback(&cb_error_none);
+  memory_register_cb(&cb_memory_none, NULL, MEMORY_CB_WRITE);
+  memory_register_cb(&cb_memory_none, NULL, MEMORY_CB_FETCH);
+  controller_init(&cb_buttons_none, NULL);
+}
+
+static const char *bench_rom(void) {
+  const char *rom = std::getenv("NES_BENCH_ROM");
+  return (rom != NULL) ? rom : "nestest.nes";
+}
+
+/*======================CPU instruction mixes======================*/
+
+/* Each programme is an endless loop starting at PROGRAMME_START, run in the
+ * no ppu mode used for the harte tests so only the cpu is measured. */
+
+/* loop: LDA #$12; ADC #$34; AND $10; ORA $11; EOR #$FF; CMP $12;
+ *       SBC #$01; LDX $13; LDY #$02; JMP loop */
+static const std::vector<uint8_t> alu_programme = {
+    0xA9, 0x12, 0x69, 0x34, 0x25, 0x10, 0x05, 0x11, 0x49, 0xFF, 0xC5,
+    0x12, 0xE9, 0x01, 0xA6, 0x13, 0xA0, 0x02, 0x4C, 0x00, 0x02};
+
+/* loop: ASL $10; ROL $11; LSR $12; ROR $13; INC $14; DEC $15;
+ *       INC $0300,X; ASL A; JMP loop */
+static const std::vector<uint8_t> rmw_programme = {
+    0x06, 0x10, 0x26, 0x11, 0x46, 0x12, 0x66, 0x13, 0xE6, 0x14, 0xC6,
+    0x15, 0xFE, 0x00, 0x03, 0x0A, 0x4C, 0x00, 0x02};
+
+/* loop: DEX; BNE loop; DEY; BPL loop; CLC; BCC loop
+ * inner branch taken 255 times out of 256 */
+static const std::vector<uint8_t> branch_programme = {
+    0xCA, 0xD0, 0xFD, 0x88, 0x10, 0xFA, 0x18, 0x90, 0xF7};
+
+static void BM_cpu_exec(benchmark::State &state,
+                        const std::vector<uint8_t> &programme) {
+  char e_context[LEN_E_CONTEXT];
+  register_callbacks();
+  memory_init(NULL, NULL, e_context);
+
+  std::vector<uint16_t> addrs;
+  for (size_t i = 0; i < programme.size(); i++) {
+    addrs.push_back(PROGRAMME_START + i);
+  }
+  memory_init_harte_test_case(addrs.data(), programme.data(),
+                              programme.size());
+
+  cpu_state_s start_state;
+  std::memset(&start_state, 0, sizeof(start_state));
+  start_state.pc = PROGRAMME_START;
+  start_state.sp = 0xFD;
+  start_state.p = 0x24;
+  cpu_s cpu;
+  cpu_init_harte_test_case(&cpu, &start_state);
+
+  uint64_t cycles = 0;
+  for (auto _ : state) {
+    uint16_t before = cpu.cycles;
+    cpu_exec(&cpu);
+    cycles += (uint16_t)(cpu.cycles - before);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["cycles_per_instr"] =
+      benchmark::Counter((double)cycles / state.iterations());
+}
+BENCHMARK_CAPTURE(BM_cpu_exec, alu, alu_programme);
+BENCHMARK_CAPTURE(BM_cpu_exec, rmw, rmw_programme);
+BENCHMARK_CAPTURE(BM_cpu_exec, branch, branch_programme);
+
+/*======================Memory map======================*/
+
+/* memory_fetch and memory_write include the three ppu steps per access,
+ * which is what an instruction pays for every bus cycle */
+
+static ppu_s *init_rom(const char *rom) {
+  ppu_s *ppu = nullptr;
+  register_callbacks();
+  nes_ppu_init(&ppu, &put_pixel, NULL);
+  nes_memory_init(rom, ppu);
+  return ppu;
+}
+
+static const char *region_label(uint16_t addr) {
+  if (addr < 0x2000) {
+    return "ram";
+  } else if (addr < 0x4000) {
+    return "ppu_register";
+  } else if (addr == 0x4016) {
+    return "controller";
+  } else if (addr < 0x8000) {
+    return "cartridge_ram";
+  } else {
+    return "prg_rom";
+  }
+}
+
+static void BM_memory_fetch(benchmark::State &state) {
+  ppu_s *ppu = init_rom("nestest.nes");
+  uint16_t addr = state.range(0);
+  uint8_t to_nmi = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(memory_fetch(addr, &to_nmi));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(region_label(addr));
+  ppu_destroy(ppu);
+}
+BENCHMARK(BM_memory_fetch)
+    ->Arg(0x0000)
+    ->Arg(0x2002)
+    ->Arg(0x4016)
+    ->Arg(0x6000)
+    ->Arg(0xC000);
+
+static void BM_memory_write(benchmark::State &state) {
+  ppu_s *ppu = init_rom("nestest.nes");
+  uint16_t addr = state.range(0);
+  uint8_t to_nmi = 0;
+  uint8_t to_oamdma = 0;
+  uint8_t val = 0;
+  for (auto _ : state) {
+    memory_write(addr, val++, &to_oamdma, &to_nmi);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(region_label(addr));
+  ppu_destroy(ppu);
+}
+/* 0x2003 is OAMADDR, which has no side effects on rendering */
+BENCHMARK(BM_memory_write)
+    ->Arg(0x0000)
+    ->Arg(0x2003)
+    ->Arg(0x4016)
+    ->Arg(0x6000);
+
+/*======================PPU======================*/
+
+#define DOTS_PER_SCANLINE 341
+
+static void step_until_scanline(ppu_s *ppu, int scanline) {
+  uint8_t to_nmi = 0;
+  while (!(ppu->scanline == scanline && ppu->cycles == 0)) {
+    ppu_step(ppu, &to_nmi);
+  }
+}
+
+/* arg 0: first scanline, arg 1: number of scanlines, arg 2: draw pixels.
+ * each iteration syncs to the first scanline then times a block of dots.
+ * nestest has the background on after a few frames, so the rendering
+ * scanlines go through the background fetches. */
+static void BM_ppu_step(benchmark::State &state) {
+  ppu_s *ppu = init_rom("nestest.nes");
+  cpu_s cpu;
+  nes_cpu_init_no_alloc(&cpu, 0);
+  nes_run_frames(&cpu, ppu, 10);
+
+  int first = state.range(0);
+  int n_dots = state.range(1) * DOTS_PER_SCANLINE;
+  uint8_t to_nmi = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    step_until_scanline(ppu, first);
+    ppu->skip_render = !state.range(2);
+    state.ResumeTiming();
+    for (int i = 0; i < n_dots; i++) {
+      ppu_step(ppu, &to_nmi);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * n_dots);
+  ppu_destroy(ppu);
+}
+BENCHMARK(BM_ppu_step)
+    ->ArgNames({"scanline", "n_scanlines", "draw"})
+    ->Args({0, 240, 1})   /* visible scanlines */
+    ->Args({241, 20, 1}); /* vblank */
+
+/* render_pixel is static in ppu.c, so measure the visible scanlines with and
+ * without drawing; the difference is the cost of render_pixel */
+static void BM_render_pixel(benchmark::State &state) { BM_ppu_step(state); }
+BENCHMARK(BM_render_pixel)
+    ->ArgNames({"scanline", "n_scanlines", "draw"})
+    ->Args({0, 240, 1})
+    ->Args({0, 240, 0});
+
+/*======================NTSC filter and scalers======================*/
+
+static void put_pixel_frame(int i, int j, uint8_t palette_idx, void *data) {
+  static_cast<uint8_t *>(data)[NTSC_IN_WIDTH * i + j] = palette_idx;
+}
+
+/* the 20th frame of nestest, so there are edges for the filters to work on */
+static std::vector<uint8_t> filter_bench_frame(void) {
+  std::vector<uint8_t> frame(NTSC_IN_WIDTH * 240);
+  ppu_s *ppu = nullptr;
+  register_callbacks();
+  nes_ppu_init(&ppu, &put_pixel_frame, frame.data());
+  nes_memory_init("nestest.nes", ppu);
+  cpu_s cpu;
+  nes_cpu_init_no_alloc(&cpu, 0);
+  nes_run_frames(&cpu, ppu, 20);
+  ppu_destroy(ppu);
+  return frame;
+}
+
+/* arg 0: threads each filter splits a frame between. ->Threads(n) runs n
+ * filters at once, each with its own threads */
+static void BM_ntsc_filter(benchmark::State &state) {
+  /* made once, by whichever thread gets here first */
+  static const std::vector<uint8_t> frame = filter_bench_frame();
+  ntsc_s *ntsc = nullptr;
+  nes_ntsc_create(&ntsc, NTSC_DEFAULT_OUT_PER_3, state.range(0));
+  std::vector<uint32_t> out(ntsc_out_width(ntsc) * 240);
+  uint8_t phase = 0;
+  for (auto _ : state) {
+    ntsc_filter(ntsc, frame.data(), NTSC_IN_WIDTH, 240, 0, phase, out.data(),
+                ntsc_out_width(ntsc));
+    phase = (phase + 1) % 3;
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  ntsc_destroy(ntsc);
+}
+BENCHMARK(BM_ntsc_filter)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(BM_ntsc_filter)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Threads(4)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+/* args: scale_filter_e, factor, threads. bytes are the RGBA written */
+static void BM_scale_frame(benchmark::State &state) {
+  static const std::vector<uint8_t> frame = filter_bench_frame();
+  const int factor = state.range(1);
+  scale_s *scale = nullptr;
+  nes_scale_create(&scale, (scale_filter_e)state.range(0), factor,
+                   state.range(2));
+  const int width = SCALE_IN_WIDTH * factor;
+  std::vector<uint32_t> out(width * 240 * factor);
+  for (auto _ : state) {
+    scale_frame(scale, frame.data(), SCALE_IN_WIDTH, 240, out.data(), width);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * out.size() * sizeof(out[0]));
+  scale_destroy(scale);
+}
+BENCHMARK(BM_scale_frame)
+    ->ArgNames({"filter", "factor", "threads"})
+    ->ArgsProduct({{SCALE_NEAREST}, {3, 9}, {1, 4}})
+    ->ArgsProduct({{SCALE_SCALEX, SCALE_HQX}, {2, 3}, {1, 4}})
+    ->ArgsProduct({{SCALE_XBR}, {2, 4}, {1, 4}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+/*======================Whole programme======================*/
+
+#define NESTEST_INSTRUCTIONS 8991
+
+/* nestest automation mode from $C000, the same run as nestest_test */
+static void BM_nestest(benchmark::State &state) {
+  ppu_s *ppu = init_rom("nestest.nes");
+  cpu_s cpu;
+  for (auto _ : state) {
+    state.PauseTiming();
+    nes_memory_init("nestest.nes", ppu);
+    nes_cpu_init_no_alloc(&cpu, 1);
+    state.ResumeTiming();
+    for (int i = 0; i < NESTEST_INSTRUCTIONS; i++) {
+      cpu_exec(&cpu);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * NESTEST_INSTRUCTIONS);
+  ppu_destroy(ppu);
+}
+BENCHMARK(BM_nestest)->Unit(benchmark::kMicrosecond);
+
+static void BM_frame(benchmark::State &state) {
+  ppu_s *ppu = init_rom(bench_rom());
+  cpu_s cpu;
+  nes_cpu_init_no_alloc(&cpu, 0);
+  /* get past the start up code */
+  nes_run_frames(&cpu, ppu, 10);
+  for (auto _ : state) {
+    nes_run_frames(&cpu, ppu, 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(bench_rom());
+  ppu_destroy(ppu);
+}
+BENCHMARK(BM_frame)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
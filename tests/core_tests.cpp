@@ -17,23 +17,293 @@
 
 #define BOOST_TEST_MODULE core_tests
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include "core/cppwrapper.hpp"
 
+#include "golden.hpp"
 #include "nestest.hpp"
 
+extern "C" {
+#include "controllerp.h"
+#include "memoryp.h"
+}
+
 static void put_pixel(int, int, uint8_t, void *) {}
 static void cb_error_none(const char *format, ...) {}
 static void cb_ppu_none(const ppu_state_s *ppu_state, void *data) {}
 static void cb_cpu_none(const cpu_state_s *cpu_state, void *data) {}
 static void cb_memory_none(uint16_t addr, uint8_t val, void *data) {}
+static uint8_t cb_buttons_none(void *data) { return 0; }
+
+/* counts pixels drawn on one row, to count drawn frames */
+static void put_pixel_count_row(int i, int j, uint8_t palette_idx, void *data) {
+  if (i == 100) {
+    (*static_cast<int *>(data))++;
+  }
+}
+
+/* copies each pixel into a 256x240 frame */
+static void put_pixel_frame(int i, int j, uint8_t palette_idx, void *data) {
+  static_cast<uint8_t *>(data)[256 * i + j] = palette_idx;
+}
+
+/* sums cycles and counts instructions, for comparing two runs */
+struct cpu_totals {
+  uint64_t instructions;
+  uint64_t cycles;
+  uint16_t last_cycles;
+  cpu_s end; /* cpu after the last frame */
+};
+
+static void cb_cpu_totals(const cpu_state_s *cpu_state, void *data) {
+  cpu_totals *totals = static_cast<cpu_totals *>(data);
+  totals->instructions++;
+  totals->cycles += (uint16_t)(cpu_state->cycles - totals->last_cycles);
+  totals->last_cycles = cpu_state->cycles;
+}
+
+/* nestest.nes loaded with a new ppu drawing through put_pixel_cb, and
+ * do-nothing callbacks registered that a test can replace afterwards.
+ * start_cpu() is separate so a movie can be started before the cpu reads
+ * the reset vector. Going out of scope unregisters the callbacks and frees
+ * the ppu and cpu */
+struct nestest_machine {
+  ppu_s *ppu = nullptr;
+  cpu_s *cpu = nullptr;
+
+  explicit nestest_machine(
+      void (*put_pixel_cb)(int, int, uint8_t, void *) = &put_pixel,
+      void *pixel_data = NULL) {
+    ppu_register_state_callback(&cb_ppu_none, NULL);
+    ppu_register_error_callback(&cb_error_none);
+    cpu_register_state_callback(&cb_cpu_none, NULL);
+    cpu_register_error_callback(&cb_error_none);
+    memory_register_cb(&cb_memory_none, NULL, MEMORY_CB_WRITE);
+    memory_register_cb(&cb_memory_none, NULL, MEMORY_CB_FETCH);
+    controller_init(&cb_buttons_none, NULL);
+    nes_ppu_init(&ppu, put_pixel_cb, pixel_data);
+    nes_memory_init("nestest.nes", ppu);
+  }
+  nestest_machine(const nestest_machine &) = delete;
+  nestest_machine &operator=(const nestest_machine &) = delete;
+
+  ~nestest_machine() {
+    cpu_unregister_error_callback();
+    cpu_unregister_state_callback();
+    ppu_unregister_state_callback();
+    ppu_unregister_error_callback();
+    memory_unregister_cb(MEMORY_CB_WRITE);
+    memory_unregister_cb(MEMORY_CB_FETCH);
+    ppu_destroy(ppu);
+    cpu_destroy(cpu);
+  }
+
+  void start_cpu(int nestest = 0) { nes_cpu_init(&cpu, nestest); }
+};
+
+/* run nestest.nes from reset for n_frames, return the last frame drawn */
+static std::vector<uint8_t> run_frames(int n_frames, cpu_totals &totals) {
+  std::vector<uint8_t> frame(256 * 240);
+  totals = cpu_totals();
+
+  nestest_machine m(&put_pixel_frame, frame.data());
+  cpu_register_state_callback(&cb_cpu_totals, &totals);
+  m.start_cpu();
+  nes_run_frames(m.cpu, m.ppu, n_frames);
+  totals.end = *m.cpu;
+
+  return frame;
+}
 
 BOOST_AUTO_TEST_SUITE(core_tests)
 
+/* where the vblank flag was seen to go from clear to set */
+struct vblank_starts {
+  uint8_t last_status;
+  std::vector<std::pair<uint16_t, uint16_t>> scanline_cycles;
+};
+
+static void cb_ppu_vblank(const ppu_state_s *ppu_state, void *data) {
+  vblank_starts *starts = static_cast<vblank_starts *>(data);
+  if ((ppu_state->ppustatus & 0x80) && !(starts->last_status & 0x80)) {
+    starts->scanline_cycles.emplace_back(ppu_state->scanline,
+                                         ppu_state->cycles);
+  }
+  starts->last_status = ppu_state->ppustatus;
+}
+
+/* vblank is set on dot 1 of scanline 241, the state callback comes after
+ * the ppu has moved on to dot 2 */
+BOOST_AUTO_TEST_CASE(vblank_timing_test) {
+  vblank_starts starts = vblank_starts();
+  starts.last_status = 0x80; /* ppustatus starts with vblank set */
+
+  nestest_machine m;
+  ppu_register_state_callback(&cb_ppu_vblank, &starts);
+  m.start_cpu();
+  nes_run_frames(m.cpu, m.ppu, 5);
+
+  BOOST_CHECK(starts.scanline_cycles.size() == 5);
+  for (const auto &scanline_cycle : starts.scanline_cycles) {
+    BOOST_CHECK(scanline_cycle.first == 241 && scanline_cycle.second == 2);
+  }
+}
+
+/* presses a different set of buttons on each strobe */
+static uint8_t cb_buttons_changing(void *data) {
+  uint8_t *n = static_cast<uint8_t *>(data);
+  *n += 37;
+  return *n;
+}
+
+enum movie_mode { MOVIE_NONE, MOVIE_RECORD, MOVIE_PLAY };
+
+/* run nestest.nes for n_frames with changing input starting from seed,
+ * recording or playing back movie_filename, and return the last frame */
+static std::vector<uint8_t> run_movie_frames(int n_frames, uint8_t seed,
+                                             movie_mode mode,
+                                             const char *movie_filename,
+                                             cpu_totals &totals) {
+  std::vector<uint8_t> frame(256 * 240);
+  uint8_t buttons = seed;
+  totals = cpu_totals();
+
+  nestest_machine m(&put_pixel_frame, frame.data());
+  cpu_register_state_callback(&cb_cpu_totals, &totals);
+  controller_init(&cb_buttons_changing, &buttons);
+  if (mode == MOVIE_RECORD) {
+    nes_movie_record_start("nestest.nes");
+  } else if (mode == MOVIE_PLAY) {
+    nes_movie_play_start(movie_filename, "nestest.nes");
+  }
+  m.start_cpu();
+  nes_run_frames(m.cpu, m.ppu, n_frames);
+  totals.end = *m.cpu;
+  if (mode == MOVIE_RECORD) {
+    nes_movie_record_stop(movie_filename);
+  }
+  movie_play_stop();
+
+  return frame;
+}
+
+BOOST_AUTO_TEST_CASE(movie_test) {
+  char e_context[LEN_E_CONTEXT];
+  cpu_totals record_totals, play_totals, live_totals;
+  std::vector<uint8_t> record_frame =
+      run_movie_frames(120, 0, MOVIE_RECORD, "movie_test.nesm", record_totals);
+  BOOST_CHECK(movie_length() == 0);
+
+  /* input is different without the movie */
+  std::vector<uint8_t> live_frame =
+      run_movie_frames(120, 1, MOVIE_NONE, nullptr, live_totals);
+  BOOST_CHECK(live_totals.instructions != record_totals.instructions);
+
+  std::vector<uint8_t> play_frame =
+      run_movie_frames(120, 1, MOVIE_PLAY, "movie_test.nesm", play_totals);
+  BOOST_CHECK(play_frame == record_frame);
+  BOOST_CHECK(play_totals.instructions == record_totals.instructions);
+  BOOST_CHECK(play_totals.cycles == record_totals.cycles);
+  BOOST_CHECK(play_totals.end.a == record_totals.end.a &&
+              play_totals.end.pc == record_totals.end.pc);
+
+  BOOST_CHECK(movie_play_start("movie_test.nesm", "nestest.log", e_context) ==
+              -E_MOVIE_ROM);
+  BOOST_CHECK(movie_play_start("nestest.log", "nestest.nes", e_context) ==
+              -E_MOVIE_FORMAT);
+  BOOST_CHECK(movie_play_start("does_not_exist", "nestest.nes", e_context) ==
+              -E_OPEN_FILE);
+}
+
+/* returns data[index], to give each device known input */
+static uint8_t cb_input_array(uint8_t index, void *data) {
+  return static_cast<uint8_t *>(data)[index];
+}
+
+/* strobe, then read port n_reads times masking each read with mask */
+static std::vector<uint8_t> read_port(uint8_t port, int n_reads,
+                                      uint8_t mask) {
+  std::vector<uint8_t> reads;
+  controller_write(1);
+  controller_write(0);
+  for (int i = 0; i < n_reads; i++) {
+    reads.push_back(controller_fetch(port) & mask);
+  }
+  return reads;
+}
+
+BOOST_AUTO_TEST_CASE(controller_test) {
+  uint8_t input[4] = {CTRLR_BUTTON_A | CTRLR_BUTTON_START, CTRLR_BUTTON_B,
+                      CTRLR_BUTTON_UP, CTRLR_BUTTON_RIGHT};
+
+  /* standard pad, a b select start up down left right */
+  controller_set_device(0, CTRLR_DEVICE_PAD, &cb_input_array, input);
+  controller_set_device(1, CTRLR_DEVICE_NONE, NULL, NULL);
+  BOOST_CHECK(read_port(0, 8, 1) ==
+              std::vector<uint8_t>({1, 0, 0, 1, 0, 0, 0, 0}));
+  BOOST_CHECK(read_port(1, 8, 1) == std::vector<uint8_t>(8, 0));
+
+  /* input is read once per strobe */
+  controller_write(1);
+  controller_write(0);
+  input[0] = 0;
+  BOOST_CHECK(controller_fetch(0) == 1);
+
+  /* save states carry on from where they were */
+  controller_state_s saved;
+  controller_save_state(&saved);
+  std::vector<uint8_t> after_save = {controller_fetch(0), controller_fetch(0),
+                                     controller_fetch(0)};
+  controller_load_state(&saved);
+  BOOST_CHECK(after_save == std::vector<uint8_t>({controller_fetch(0),
+                                                  controller_fetch(0),
+                                                  controller_fetch(0)}));
+  input[0] = CTRLR_BUTTON_A | CTRLR_BUTTON_START;
+
+  /* four score, pads 1 and 3 then signature on $4016, 2 and 4 on $4017 */
+  controller_set_device(0, CTRLR_DEVICE_FOUR_SCORE, &cb_input_array, input);
+  BOOST_CHECK(controller_get_device(1) == CTRLR_DEVICE_FOUR_SCORE);
+  std::vector<uint8_t> expected_0 = {1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+                                     1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0};
+  std::vector<uint8_t> expected_1 = {0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                     0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0};
+  BOOST_CHECK(read_port(0, 24, 1) == expected_0);
+  BOOST_CHECK(read_port(1, 24, 1) == expected_1);
+
+  /* zapper, bit 3 is 0 when it sees light and bit 4 is the trigger */
+  controller_set_device(1, CTRLR_DEVICE_ZAPPER, &cb_input_array, input);
+  BOOST_CHECK(controller_get_device(0) == CTRLR_DEVICE_NONE);
+  input[0] = CTRLR_ZAPPER_TRIGGER;
+  BOOST_CHECK(read_port(1, 1, 0x18)[0] == 0x18);
+  input[0] = CTRLR_ZAPPER_LIGHT;
+  BOOST_CHECK(read_port(1, 1, 0x18)[0] == 0);
+  /* read live, not latched by the strobe */
+  input[0] = CTRLR_ZAPPER_TRIGGER;
+  BOOST_CHECK((controller_fetch(1) & 0x18) == 0x18);
+
+  /* paddle, button in bit 3, position inverted and high bit first in 4 */
+  controller_set_device(1, CTRLR_DEVICE_PADDLE, &cb_input_array, input);
+  input[0] = 0xA5;
+  input[1] = 1;
+  std::vector<uint8_t> paddle = read_port(1, 8, 0x18);
+  std::vector<uint8_t> expected_paddle = {0x08, 0x18, 0x08, 0x18,
+                                          0x18, 0x08, 0x18, 0x08};
+  BOOST_CHECK(paddle == expected_paddle);
+
+  controller_set_device(1, CTRLR_DEVICE_NONE, NULL, NULL);
+  controller_init(&cb_buttons_none, NULL);
+}
+
+
 BOOST_AUTO_TEST_CASE(ppu_test) {
 
   ppu_s *ppu = nullptr;
@@ -110,6 +380,25 @@ BOOST_AUTO_TEST_CASE(memory_test) {
   /* this should work now */
   BOOST_CHECK(memory_init("nestest.nes", ppu, e_context) == E_NO_ERROR);
 
+  /* snapshots */
+  BOOST_CHECK(memory_region_size(MEMORY_REGION_CPU) == 0x10000);
+  BOOST_CHECK(memory_region_size(MEMORY_REGION_VRAM) == 0x4000);
+  BOOST_CHECK(memory_region_size(MEMORY_REGION_OAM) == 0x100);
+  BOOST_CHECK(memory_region_size(MEMORY_REGION_PALETTE) == 0x20);
+
+  std::vector<uint8_t> snapshot(0x10000);
+  BOOST_CHECK(memory_snapshot(MEMORY_REGION_CPU, snapshot.data(), 0xFFFF) ==
+              -E_BUF_SIZE);
+  BOOST_CHECK(memory_snapshot(MEMORY_REGION_CPU, snapshot.data(),
+                              snapshot.size()) == E_NO_ERROR);
+  /* nestest's reset vector is 0xC004 */
+  BOOST_CHECK(snapshot[0xFFFC] == 0x04 && snapshot[0xFFFD] == 0xC0);
+  BOOST_CHECK(memory_snapshot(MEMORY_REGION_PALETTE, snapshot.data(), 0x20) ==
+              E_NO_ERROR);
+  for (int i = 0; i < 0x20; i++) {
+    BOOST_CHECK(snapshot[i] == i);
+  }
+
   ppu_destroy(ppu);
   memory_unregister_cb(MEMORY_CB_WRITE);
   memory_unregister_cb(MEMORY_CB_FETCH);
@@ -177,9 +466,656 @@ BOOST_AUTO_TEST_CASE(cpu_test) {
   cpu_destroy(cpu);
 }
 
+BOOST_AUTO_TEST_CASE(frame_skip_test) {
+  int pixels_drawn = 0;
+
+  nestest_machine m(&put_pixel_count_row, &pixels_drawn);
+  m.start_cpu();
+
+  /* nestest has rendering on by now */
+  nes_run_frames(m.cpu, m.ppu, 10);
+  pixels_drawn = 0;
+  nes_run_frames(m.cpu, m.ppu, 2);
+  BOOST_CHECK(pixels_drawn == 2 * 256);
+
+  /* first frame after setting is drawn either way */
+  ppu_set_frame_skip(m.ppu, 3);
+  nes_run_frames(m.cpu, m.ppu, 1);
+  pixels_drawn = 0;
+  nes_run_frames(m.cpu, m.ppu, 6);
+  BOOST_CHECK(pixels_drawn == 2 * 256);
+}
+
+BOOST_AUTO_TEST_CASE(pipeline_test) {
+  cpu_totals totals;
+  std::vector<uint8_t> expected_20 = run_frames(20, totals);
+  std::vector<uint8_t> expected_25 = run_frames(25, totals);
+
+  std::vector<uint8_t> frame(256 * 240);
+
+  nestest_machine m(&put_pixel_frame, frame.data());
+  m.start_cpu();
+
+  nes_ppu_pipeline_start(m.ppu);
+  nes_run_frames(m.cpu, m.ppu, 10);
+  /* sync in the middle of a frame too */
+  for (int i = 0; i < 1000; i++) {
+    nes_cpu_exec(m.cpu);
+  }
+  ppu_pipeline_sync(m.ppu);
+  nes_run_frames(m.cpu, m.ppu, 10);
+  ppu_pipeline_sync(m.ppu);
+  BOOST_CHECK(frame == expected_20);
+
+  /* drawing carries on from where the render thread got to */
+  ppu_pipeline_stop(m.ppu);
+  nes_run_frames(m.cpu, m.ppu, 5);
+  BOOST_CHECK(frame == expected_25);
+}
+
+/* red, green or blue of a pixel ntsc_filter wrote */
+static int ntsc_channel(uint32_t pixel, int c) { return (pixel >> (8 * c)) & 0xFF; }
+
+BOOST_AUTO_TEST_CASE(ntsc_test) {
+  ntsc_s *ntsc = nullptr;
+  BOOST_CHECK(ntsc_create(&ntsc, 2, 1) == -E_BUF_SIZE);
+  BOOST_CHECK(ntsc_create(&ntsc, 7, NTSC_MAX_THREADS + 1) == -E_BUF_SIZE);
+  nes_ntsc_create(&ntsc, NTSC_DEFAULT_OUT_PER_3, 1);
+  const int width = ntsc_out_width(ntsc);
+  BOOST_CHECK(width == NTSC_DEFAULT_OUT_WIDTH);
+
+  /* flat colours come out flat away from the edges, and close to the
+   * palette. greys have no colour */
+  const int height = 8;
+  std::vector<uint8_t> in(NTSC_IN_WIDTH * height);
+  std::vector<uint32_t> out(width * height);
+  for (uint8_t colour : {0x00, 0x16, 0x20, 0x2A, 0x3D}) {
+    std::fill(in.begin(), in.end(), colour);
+    ntsc_filter(ntsc, in.data(), NTSC_IN_WIDTH, height, 0, 0, out.data(),
+                width);
+    bool flat = true, close = true;
+    for (int i = 0; i < height; i++) {
+      for (int o = 20; o < width - 20; o++) {
+        uint32_t pixel = out[i * width + o];
+        flat = flat && (pixel == out[width / 2]);
+        for (int c = 0; c < 3; c++) {
+          close = close && std::abs(ntsc_channel(pixel, c) -
+                                    nes_palette[3 * colour + c]) <= 20;
+        }
+      }
+    }
+    BOOST_CHECK(flat && close);
+    BOOST_CHECK((out[width / 2] >> 24) == 0xFF);
+    if ((colour & 0x0F) == 0 || (colour & 0x0F) == 0x0D) {
+      BOOST_CHECK(ntsc_channel(out[width / 2], 0) ==
+                      ntsc_channel(out[width / 2], 1) &&
+                  ntsc_channel(out[width / 2], 1) ==
+                      ntsc_channel(out[width / 2], 2));
+    }
+  }
+
+  /* emphasising red darkens green and blue */
+  std::fill(in.begin(), in.end(), 0x30);
+  ntsc_filter(ntsc, in.data(), NTSC_IN_WIDTH, height, 1, 0, out.data(), width);
+  BOOST_CHECK(ntsc_channel(out[width / 2], 0) >
+              ntsc_channel(out[width / 2], 2));
+
+  /* a real frame: splitting it between threads gives the same picture,
+   * and the dot crawl repeats every 3 frames */
+  cpu_totals totals;
+  std::vector<uint8_t> frame = run_frames(20, totals);
+  std::vector<uint32_t> expected(width * 240);
+  ntsc_filter(ntsc, frame.data(), NTSC_IN_WIDTH, 240, 0, 1, expected.data(),
+              width);
+  ntsc_destroy(ntsc);
+
+  nes_ntsc_create(&ntsc, NTSC_DEFAULT_OUT_PER_3, 3);
+  std::vector<uint32_t> threaded(width * 240);
+  ntsc_filter(ntsc, frame.data(), NTSC_IN_WIDTH, 240, 0, 4, threaded.data(),
+              width);
+  BOOST_CHECK(threaded == expected);
+  ntsc_filter(ntsc, frame.data(), NTSC_IN_WIDTH, 240, 0, 2, threaded.data(),
+              width);
+  BOOST_CHECK(threaded != expected);
+  ntsc_destroy(ntsc);
+}
+
+/* scale a SCALE_IN_WIDTH x height frame with a new scale_s */
+static std::vector<uint32_t> scale_with(scale_filter_e filter, int factor,
+                                        int n_threads,
+                                        const std::vector<uint8_t> &in,
+                                        int height) {
+  scale_s *scale = nullptr;
+  nes_scale_create(&scale, filter, factor, n_threads);
+  const int width = SCALE_IN_WIDTH * factor;
+  std::vector<uint32_t> out(width * height * factor);
+  scale_frame(scale, in.data(), SCALE_IN_WIDTH, height, out.data(), width);
+  scale_destroy(scale);
+  return out;
+}
+
+/* palette colour as scale_frame writes it */
+static uint32_t scale_rgba(uint8_t colour) {
+  return 0xFF000000u | nes_palette[3 * colour + 2] << 16 |
+         nes_palette[3 * colour + 1] << 8 | nes_palette[3 * colour];
+}
+
+BOOST_AUTO_TEST_CASE(scale_test) {
+  scale_s *scale = nullptr;
+  BOOST_CHECK(scale_create(&scale, SCALE_NEAREST, 0, 1) == -E_SCALE_FACTOR);
+  BOOST_CHECK(scale_create(&scale, SCALE_NEAREST, SCALE_MAX_FACTOR + 1, 1) ==
+              -E_SCALE_FACTOR);
+  BOOST_CHECK(scale_create(&scale, SCALE_SCALEX, 4, 1) == -E_SCALE_FACTOR);
+  BOOST_CHECK(scale_create(&scale, SCALE_HQX, 1, 1) == -E_SCALE_FACTOR);
+  BOOST_CHECK(scale_create(&scale, SCALE_XBR, 5, 1) == -E_SCALE_FACTOR);
+  BOOST_CHECK(scale_create(&scale, SCALE_XBR, 2, SCALE_MAX_THREADS + 1) ==
+              -E_BUF_SIZE);
+
+  const std::pair<scale_filter_e, int> filters[] = {
+      {SCALE_NEAREST, 3}, {SCALE_SCALEX, 2}, {SCALE_SCALEX, 3}, {SCALE_HQX, 2},
+      {SCALE_HQX, 3},     {SCALE_XBR, 2},    {SCALE_XBR, 3},    {SCALE_XBR, 4}};
+  const uint8_t black = 0x0F, white = 0x30;
+  const int height = 32;
+  std::vector<uint8_t> in(SCALE_IN_WIDTH * height, white);
+
+  /* nothing happens to a flat colour */
+  for (auto [filter, factor] : filters) {
+    std::vector<uint32_t> out = scale_with(filter, factor, 1, in, height);
+    BOOST_CHECK(std::all_of(out.begin(), out.end(), [](uint32_t pixel) {
+      return pixel == scale_rgba(0x30);
+    }));
+  }
+
+  /* nearest is blocks of the same colour */
+  for (int i = 0; i < height; i++) {
+    for (int j = 0; j < SCALE_IN_WIDTH; j++) {
+      in[i * SCALE_IN_WIDTH + j] = (i * 7 + j * 3) % PALETTE_SIZE;
+    }
+  }
+  std::vector<uint32_t> out = scale_with(SCALE_NEAREST, 3, 1, in, height);
+  bool blocks = true;
+  for (int y = 0; y < height * 3; y++) {
+    for (int x = 0; x < SCALE_IN_WIDTH * 3; x++) {
+      blocks = blocks && out[y * SCALE_IN_WIDTH * 3 + x] ==
+                             scale_rgba(in[(y / 3) * SCALE_IN_WIDTH + x / 3]);
+    }
+  }
+  BOOST_CHECK(blocks);
+
+  /* a white pixel with black above and to the left: Scale2x makes its
+   * top left corner black, hq2x blends it */
+  std::fill(in.begin(), in.end(), white);
+  in[9 * SCALE_IN_WIDTH + 10] = black;
+  in[10 * SCALE_IN_WIDTH + 9] = black;
+  const int width2 = SCALE_IN_WIDTH * 2;
+  out = scale_with(SCALE_SCALEX, 2, 1, in, height);
+  BOOST_CHECK(out[20 * width2 + 20] == scale_rgba(black));
+  BOOST_CHECK(out[21 * width2 + 21] == scale_rgba(white));
+  out = scale_with(SCALE_HQX, 2, 1, in, height);
+  BOOST_CHECK(ntsc_channel(out[20 * width2 + 20], 0) > nes_palette[3 * black]);
+  BOOST_CHECK(ntsc_channel(out[20 * width2 + 20], 0) < nes_palette[3 * white]);
+  BOOST_CHECK(out[21 * width2 + 21] == scale_rgba(white));
+
+  /* a diagonal edge, white where x >= y: xBR blends the bottom left
+   * corners of the white pixels along it halfway, and nothing else */
+  for (int i = 0; i < height; i++) {
+    for (int j = 0; j < SCALE_IN_WIDTH; j++) {
+      in[i * SCALE_IN_WIDTH + j] = (j >= i) ? white : black;
+    }
+  }
+  out = scale_with(SCALE_XBR, 2, 1, in, height);
+  uint32_t half = out[21 * width2 + 20];
+  BOOST_CHECK(ntsc_channel(half, 1) > nes_palette[3 * black + 1]);
+  BOOST_CHECK(ntsc_channel(half, 1) < nes_palette[3 * white + 1]);
+  BOOST_CHECK(out[20 * width2 + 21] == scale_rgba(white));
+  BOOST_CHECK(out[20 * width2 + 20] == scale_rgba(white));
+  BOOST_CHECK(out[21 * width2 + 21] == scale_rgba(white));
+
+  /* a real frame comes out the same split between threads */
+  cpu_totals totals;
+  std::vector<uint8_t> frame = run_frames(20, totals);
+  for (auto [filter, factor] : filters) {
+    BOOST_CHECK(scale_with(filter, factor, 3, frame, 240) ==
+                scale_with(filter, factor, 1, frame, 240));
+  }
+}
+
+static long file_size(const char *filename) {
+  std::ifstream f(filename, std::ios::binary | std::ios::ate);
+  return f ? (long)f.tellg() : -1;
+}
+
+BOOST_AUTO_TEST_CASE(capture_test) {
+  char e_context[LEN_E_CONTEXT];
+  capture_reader_s *reader = nullptr;
+  BOOST_CHECK(capture_reader_open(&reader, "nestest.nes", e_context) ==
+              -E_CAPTURE_FORMAT);
+
+  /* frames that change a little, not at all, and completely */
+  std::vector<std::vector<uint8_t>> frames(4);
+  frames[0].resize(CAPTURE_FRAME_SIZE);
+  for (int i = 0; i < CAPTURE_FRAME_SIZE; i++) {
+    frames[0][i] = (i / 7 + i / 256) % PALETTE_SIZE;
+  }
+  frames[1] = frames[0];
+  frames[1][1000] = 0x3F;
+  frames[1][1003] = 0x3F;
+  frames[1][CAPTURE_FRAME_SIZE - 1] = 0x3F;
+  frames[2] = frames[1];
+  frames[3].assign(CAPTURE_FRAME_SIZE, 0x21);
+
+  /* delta frames come back as they went in */
+  capture_s *capture = nullptr;
+  nes_capture_start(&capture, "capture_test.nesv", CAPTURE_DELTA,
+                    CAPTURE_DEFAULT_QUEUE, nullptr, 0);
+  for (size_t i = 0; i < frames.size(); i++) {
+    BOOST_CHECK(capture_frame(capture, frames[i].data(), i) == 1);
+  }
+  capture_stats_s stats;
+  nes_capture_stop(capture, &stats);
+  BOOST_CHECK(stats.frames == 4 && stats.frames_written == 4 &&
+              stats.frames_dropped == 0);
+  BOOST_CHECK(stats.bytes_written == (uint64_t)file_size("capture_test.nesv"));
+  /* the unchanged frame is only its header */
+  BOOST_CHECK(stats.bytes_written < 20 + 2 * CAPTURE_FRAME_SIZE + 100);
+
+  nes_capture_reader_open(&reader, "capture_test.nesv");
+  std::vector<uint8_t> frame(CAPTURE_FRAME_SIZE);
+  uint32_t number;
+  uint8_t emphasis;
+  for (size_t i = 0; i < frames.size(); i++) {
+    BOOST_CHECK(capture_reader_next(reader, frame.data(), &number,
+                                    &emphasis) == 1);
+    BOOST_CHECK(frame == frames[i] && number == i && emphasis == i);
+  }
+  BOOST_CHECK(capture_reader_next(reader, frame.data(), &number, &emphasis) ==
+              0);
+  capture_reader_close(reader);
+
+  /* with a queue of 1 the writer can't keep up, so frames are dropped,
+   * but every frame is either written or counted as dropped, and the ones
+   * written are the right ones */
+  nes_capture_start(&capture, "capture_test.nesv", CAPTURE_DELTA, 1, nullptr,
+                    0);
+  int queued = 0;
+  for (int i = 0; i < 200; i++) {
+    queued += capture_frame(capture, frames[i % 4].data(), 0);
+  }
+  nes_capture_stop(capture, &stats);
+  BOOST_CHECK(stats.frames == 200);
+  BOOST_CHECK(stats.frames_written == (uint64_t)queued);
+  BOOST_CHECK(stats.frames_written + stats.frames_dropped == 200);
+  nes_capture_reader_open(&reader, "capture_test.nesv");
+  int read = 0;
+  bool right = true;
+  int64_t last_number = -1;
+  while (capture_reader_next(reader, frame.data(), &number, &emphasis) == 1) {
+    right = right && frame == frames[number % 4] && number > last_number;
+    last_number = number;
+    read++;
+  }
+  BOOST_CHECK(right && read == queued);
+  capture_reader_close(reader);
+
+  /* y4m is a header and then every frame whole, and wav a header and then
+   * the samples */
+  nes_capture_start(&capture, "capture_test.y4m", CAPTURE_Y4M,
+                    CAPTURE_DEFAULT_QUEUE, "capture_test.wav", 44100);
+  std::vector<int16_t> samples(1000, -1234);
+  BOOST_CHECK(capture_audio(capture, samples.data(), samples.size()) == 1000);
+  for (const auto &f : frames) {
+    capture_frame(capture, f.data(), 0);
+  }
+  nes_capture_stop(capture, &stats);
+  std::ifstream y4m("capture_test.y4m", std::ios::binary);
+  std::string header;
+  std::getline(y4m, header);
+  BOOST_CHECK(header.rfind("YUV4MPEG2 W256 H240 ", 0) == 0);
+  BOOST_CHECK(file_size("capture_test.y4m") ==
+              (long)(header.size() + 1 + 4 * (6 + 3 * CAPTURE_FRAME_SIZE)));
+  BOOST_CHECK(stats.samples_written == 1000);
+  BOOST_CHECK(file_size("capture_test.wav") == 44 + 2000);
+}
+
+static void cb_profile_frame(const profile_frame_s *frame, void *data) {
+  int *n_frames = static_cast<int *>(data);
+  *n_frames += frame->frames;
+}
+
+BOOST_AUTO_TEST_CASE(profile_test) {
+  int n_frames = 0;
+  profile_register_frame_callback(&cb_profile_frame, &n_frames);
+  profile_reset();
+
+  nestest_machine m;
+  m.start_cpu();
+  nes_run_frames(m.cpu, m.ppu, 5);
+
+  profile_frame_s total;
+  profile_get_total(&total);
+  if (profile_enabled()) {
+    BOOST_CHECK(n_frames == 5 && total.frames == 5);
+    for (int i = 0; i < PROFILE_N_SECTIONS; i++) {
+      BOOST_CHECK(total.sections[i].calls > 0);
+      BOOST_CHECK(total.sections[i].self_ticks <= total.sections[i].ticks);
+    }
+    /* a cpu cycle is three ppu dots, and fetches are all cycles here */
+    BOOST_CHECK(total.sections[PROFILE_PPU_STEP].calls >=
+                3 * total.sections[PROFILE_MEMORY_FETCH].calls);
+  } else {
+    BOOST_CHECK(n_frames == 0 && total.frames == 0);
+  }
+  BOOST_CHECK(std::string(profile_section_name(PROFILE_CPU_EXEC)) ==
+              "cpu_exec");
+
+  profile_unregister_frame_callback();
+}
 
 BOOST_AUTO_TEST_CASE(nestest_test) {
   BOOST_TEST(nestest_actual() == nestest_log(), boost::test_tools::per_element());
 }
 
+/* nestest waits for its nmi handler to change $D2 in a CMP $D2; BEQ loop */
+BOOST_AUTO_TEST_CASE(idle_skip_test) {
+  cpu_totals skip_totals, no_skip_totals;
+  std::vector<uint8_t> no_skip_frame = run_frames(30, no_skip_totals);
+  BOOST_CHECK(cpu_get_idle_cycles() == 0);
+
+  cpu_set_idle_skip(1);
+  std::vector<uint8_t> skip_frame = run_frames(30, skip_totals);
+  BOOST_CHECK(cpu_get_idle_cycles() > 0);
+  BOOST_CHECK(skip_totals.instructions < no_skip_totals.instructions);
+  BOOST_CHECK(skip_totals.instructions + cpu_get_idle_instructions() ==
+              no_skip_totals.instructions);
+
+  cpu_set_idle_skip(0);
+
+  BOOST_CHECK(skip_frame == no_skip_frame);
+  /* not a: it holds nestest's frame counter from ram, which isn't cleared
+   * between runs */
+  const cpu_s &run = skip_totals.end, &ref = no_skip_totals.end;
+  BOOST_CHECK(run.pc == ref.pc && run.cycles == ref.cycles && run.x == ref.x &&
+              run.y == ref.y && run.sp == ref.sp && run.flags == ref.flags &&
+              run.to_nmi == ref.to_nmi);
+}
+
+static void cb_memory_log(uint16_t addr, uint8_t val, void *data) {
+  static_cast<std::vector<std::pair<uint16_t, uint8_t>> *>(data)->emplace_back(
+      addr, val);
+}
+
+/* prg rom is writable in no ppu mode, so code there can change its own
+ * operand, which has to be seen the next time round */
+BOOST_AUTO_TEST_CASE(decode_test) {
+  /* loop: LDA #$12; ADC #$01; STA loop + 1; JMP loop */
+  const uint8_t programme[] = {0xA9, 0x12, 0x69, 0x01, 0x8D,
+                               0x01, 0x80, 0x4C, 0x00, 0x80};
+  uint16_t addrs[sizeof(programme)];
+  for (size_t i = 0; i < sizeof(programme); i++) {
+    addrs[i] = 0x8000 + i;
+  }
+  char e_context[LEN_E_CONTEXT];
+  nestest_machine m;
+  BOOST_CHECK(memory_init(NULL, NULL, e_context) == E_NO_ERROR);
+  memory_init_harte_test_case(addrs, programme, sizeof(programme));
+  std::vector<std::pair<uint16_t, uint8_t>> fetches;
+  memory_register_cb(&cb_memory_log, &fetches, MEMORY_CB_FETCH);
+
+  cpu_state_s start = {};
+  start.pc = 0x8000;
+  start.sp = 0xFD;
+  start.p = 0x24;
+  cpu_s cpu;
+  cpu_init_harte_test_case(&cpu, &start);
+  for (int pass = 0; pass < 3; pass++) {
+    fetches.clear();
+    BOOST_CHECK(cpu_exec(&cpu) == E_NO_ERROR);
+    BOOST_CHECK(cpu.a == 0x12 + pass);
+    /* the fetches of the operand are still reported */
+    BOOST_CHECK(fetches.size() == 2 && fetches[1].first == 0x8001 &&
+                fetches[1].second == 0x12 + pass);
+    for (int i = 0; i < 3; i++) {
+      BOOST_CHECK(cpu_exec(&cpu) == E_NO_ERROR);
+    }
+    BOOST_CHECK(cpu.pc == 0x8000);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(debug_test) {
+  debug_breakpoint_s b;
+  BOOST_CHECK(debug_parse("x c5f5", &b) == E_NO_ERROR);
+  BOOST_CHECK(b.access == DEBUG_EXEC && b.first == 0xC5F5 &&
+              b.last == 0xC5F5 && b.reg == DEBUG_REG_NONE);
+  BOOST_CHECK(debug_parse(" w $0300-03ff if val >= 80 ", &b) == E_NO_ERROR);
+  BOOST_CHECK(b.access == DEBUG_WRITE && b.first == 0x300 &&
+              b.last == 0x3FF && b.reg == DEBUG_REG_VALUE &&
+              b.cmp == DEBUG_CMP_GE && b.val == 0x80);
+  for (const char *bad : {"", "q 0000", "x", "x 10000", "w 0400-0300",
+                          "x c000 if val == 1", "r 0 if a == 100",
+                          "r 0 if b == 1", "r 0 if a = 1", "r 0 junk"}) {
+    BOOST_CHECK(debug_parse(bad, &b) == -E_DEBUG_BREAKPOINT);
+  }
+
+  nestest_machine m;
+  m.start_cpu(1);
+
+  /* stops before the LDX #$00 at c5f5 that JMP $C5F5 goes to, then runs
+   * it when called again */
+  int exec_id = nes_debug_add(nes_debug_parse("x c5f5"));
+  debug_hit_s hit;
+  BOOST_CHECK(nes_cpu_exec(m.cpu) == E_NO_ERROR);
+  BOOST_CHECK(nes_cpu_exec(m.cpu) == CPU_BREAKPOINT);
+  BOOST_CHECK(m.cpu->pc == 0xC5F5);
+  BOOST_CHECK(debug_get_hit(&hit) && hit.id == exec_id &&
+              hit.access == DEBUG_EXEC && hit.regs.pc == 0xC5F5 &&
+              hit.regs.opc == 0xA2);
+  BOOST_CHECK(nes_cpu_exec(m.cpu) == E_NO_ERROR);
+
+  /* then STX $00, STX $10, STX $11 with x = 0 */
+  nes_debug_add(nes_debug_parse("w 0000 if x != 0"));
+  int write_id = nes_debug_add(nes_debug_parse("w 0010-0011 if val == 0"));
+  BOOST_CHECK(nes_cpu_exec(m.cpu) == E_NO_ERROR);
+  BOOST_CHECK(nes_cpu_exec(m.cpu) == CPU_BREAKPOINT);
+  BOOST_CHECK(m.cpu->pc == 0xC5FB);
+  BOOST_CHECK(debug_get_hit(&hit) && hit.id == write_id &&
+              hit.access == DEBUG_WRITE && hit.addr == 0x10 &&
+              hit.val == 0 && hit.regs.pc == 0xC5F9);
+  BOOST_CHECK(debug_remove(write_id) == E_NO_ERROR);
+  BOOST_CHECK(debug_remove(write_id) == -E_DEBUG_BREAKPOINT);
+  BOOST_CHECK(nes_cpu_exec(m.cpu) == E_NO_ERROR);
+
+  debug_clear();
+  BOOST_CHECK(!debug_get_hit(&hit));
+  b = debug_breakpoint_s{DEBUG_READ, 0, 0xFFFF, DEBUG_REG_NONE};
+  for (int i = 0; i < DEBUG_MAX_BREAKPOINTS; i++) {
+    BOOST_CHECK(debug_add(&b) == i);
+  }
+  BOOST_CHECK(debug_add(&b) == -E_DEBUG_FULL);
+  BOOST_CHECK(nes_run_frames(m.cpu, m.ppu, 1) == CPU_BREAKPOINT);
+  debug_clear();
+}
+
+static std::string disasm_text(const disasm_line_s *line) {
+  char text[DISASM_TEXT_LEN];
+  disasm_format(line, text, sizeof(text));
+  return text;
+}
+
+BOOST_AUTO_TEST_CASE(disasm_test) {
+  std::vector<uint8_t> mem(0x10000, 0);
+  disasm_line_s line;
+  const struct {
+    uint16_t addr;
+    std::vector<uint8_t> bytes;
+    const char *text;
+  } cases[] = {{0x1000, {0xB1, 0x20}, "LDA ($20),Y"},
+               {0x1000, {0xD0, 0xFE}, "BNE $1000"},
+               {0x1000, {0x10, 0x10}, "BPL $1012"},
+               {0x1000, {0x6C, 0x34, 0x12}, "JMP ($1234)"},
+               {0x1000, {0x9D, 0x00, 0x02}, "STA $0200,X"},
+               {0x1000, {0x0A}, "ASL"},
+               {0x1000, {0x04, 0x10}, "*NOP $10"},
+               {0x1000, {0x02}, ".db $02"}};
+  for (const auto &c : cases) {
+    std::copy(c.bytes.begin(), c.bytes.end(), mem.begin() + c.addr);
+    BOOST_CHECK(disasm_decode(mem.data(), c.addr, &line) == (int)c.bytes.size());
+    BOOST_CHECK_EQUAL(disasm_text(&line), c.text);
+  }
+
+  nestest_machine m;
+  BOOST_CHECK(memory_region_size(MEMORY_REGION_CODE) == 0x10000);
+  BOOST_CHECK(memory_snapshot(MEMORY_REGION_CODE, mem.data(), mem.size()) ==
+              E_NO_ERROR);
+  /* 16KB of prg rom, mirrored */
+  BOOST_CHECK(std::equal(mem.begin() + 0x8000, mem.begin() + 0xC000,
+                         mem.begin() + 0xC000));
+  /* clear what earlier tests left in ram */
+  std::fill(mem.begin(), mem.begin() + 0x800, 0);
+  uint16_t banks[DISASM_N_SEGMENTS];
+  disasm_get_banks(banks);
+
+  disasm_s *disasm;
+  nes_disasm_create(&disasm);
+  BOOST_CHECK(disasm_n_lines(disasm) == 0);
+  BOOST_CHECK(nes_disasm_update(disasm, mem.data(), banks, 0xC000));
+  BOOST_CHECK(!nes_disasm_update(disasm, mem.data(), banks, 0xC000));
+  size_t n_lines = disasm_n_lines(disasm);
+  long i = disasm_find_line(disasm, 0xC000);
+  BOOST_CHECK_EQUAL(disasm_text(disasm_get_line(disasm, i)), "JMP $c5f5");
+  BOOST_CHECK(disasm_find_line(disasm, 0xC002) == i);
+  BOOST_CHECK(disasm_find_line(disasm, 0x2000) == -1);
+  i = disasm_find_line(disasm, 0xC5F5);
+  BOOST_CHECK(disasm_get_line(disasm, i)->addr == 0xC5F5);
+  BOOST_CHECK_EQUAL(disasm_text(disasm_get_line(disasm, i)), "LDX #$00");
+  BOOST_CHECK_EQUAL(disasm_text(disasm_get_line(disasm, i + 1)), "STX $00");
+
+  /* a pc in the middle of an instruction makes it data */
+  BOOST_CHECK(nes_disasm_update(disasm, mem.data(), banks, 0xC001));
+  i = disasm_find_line(disasm, 0xC000);
+  BOOST_CHECK_EQUAL(disasm_text(disasm_get_line(disasm, i)), ".db $4c");
+  BOOST_CHECK(disasm_get_line(disasm, i + 1)->addr == 0xC001);
+
+  /* code written to ram over two BRKs, the rest of the listing stays */
+  n_lines = disasm_n_lines(disasm);
+  mem[0x0300] = 0xA9;
+  mem[0x0301] = 0x05;
+  BOOST_CHECK(nes_disasm_update(disasm, mem.data(), banks, 0xC5F5));
+  i = disasm_find_line(disasm, 0x0300);
+  BOOST_CHECK_EQUAL(disasm_text(disasm_get_line(disasm, i)), "LDA #$05");
+  BOOST_CHECK(disasm_get_line(disasm, i + 1)->addr == 0x0302);
+  BOOST_CHECK(disasm_n_lines(disasm) == n_lines - 1);
+  BOOST_CHECK(disasm_find_line(disasm, 0xC5F5) ==
+              disasm_find_line(disasm, 0xC5F6) &&
+              disasm_get_line(disasm, disasm_find_line(disasm, 0xC5F5))
+                      ->addr == 0xC5F5);
+
+  /* another bank, then back to the first one's listing */
+  std::vector<uint8_t> other(mem);
+  std::fill(other.begin() + 0x8000, other.begin() + 0xC000, 0xEA);
+  uint16_t other_banks[DISASM_N_SEGMENTS];
+  std::copy(banks, banks + DISASM_N_SEGMENTS, other_banks);
+  other_banks[2]++;
+  BOOST_CHECK(nes_disasm_update(disasm, other.data(), other_banks, 0xC5F5));
+  BOOST_CHECK_EQUAL(
+      disasm_text(disasm_get_line(disasm, disasm_find_line(disasm, 0x8000))),
+      "NOP");
+  BOOST_CHECK(nes_disasm_update(disasm, mem.data(), banks, 0xC5F5));
+  BOOST_CHECK(!nes_disasm_update(disasm, mem.data(), banks, 0xC5F5));
+  BOOST_CHECK_EQUAL(
+      disasm_text(disasm_get_line(disasm, disasm_find_line(disasm, 0x8000))),
+      "JMP $c5f5");
+  disasm_destroy(disasm);
+}
+
+BOOST_AUTO_TEST_CASE(cdl_test) {
+  cpu_totals totals;
+  std::vector<uint8_t> frame(256 * 240);
+  std::vector<uint8_t> no_log_frame = run_frames(30, totals);
+
+  nestest_machine m(&put_pixel_frame, frame.data());
+  cpu_register_state_callback(&cb_cpu_totals, &totals);
+  BOOST_CHECK(!cdl_is_on() && cdl_size() == 0);
+  nes_cdl_start();
+  BOOST_CHECK(cdl_is_on() && cdl_size() == 0x4000 + 0x2000);
+  m.start_cpu();
+  nes_run_frames(m.cpu, m.ppu, 30);
+  BOOST_CHECK(frame == no_log_frame);
+
+  std::vector<uint8_t> log(cdl_size());
+  BOOST_CHECK(cdl_get(log.data(), log.size() - 1) == -E_BUF_SIZE);
+  BOOST_CHECK(cdl_get(log.data(), log.size()) == E_NO_ERROR);
+  /* the reset handler at 0xC004, run through the 0xC000-0xDFFF window */
+  BOOST_CHECK(log[0x0004] == (CDL_CODE | 2 << CDL_PRG_WINDOW_SHIFT));
+  /* vectors are read by the cpu, not by an instruction */
+  BOOST_CHECK(log[0x3FFC] == 0);
+  BOOST_CHECK(std::any_of(log.begin(), log.begin() + 0x4000, [](uint8_t f) {
+    return (f & (CDL_DATA | CDL_CODE)) == CDL_DATA;
+  }));
+  BOOST_CHECK(std::any_of(log.begin() + 0x4000, log.end(),
+                          [](uint8_t f) { return f & CDL_RENDERED; }));
+
+  /* read back into a new log */
+  nes_cdl_write("cdl_test.cdl");
+  nes_memory_init("nestest.nes", m.ppu);
+  BOOST_CHECK(cdl_size() == 0);
+  BOOST_CHECK(cpu_decode_warmup() == 0);
+  nes_cdl_start();
+  BOOST_CHECK(nes_cdl_read("cdl_test.cdl"));
+  std::vector<uint8_t> read_log(cdl_size());
+  BOOST_CHECK(cdl_get(read_log.data(), read_log.size()) == E_NO_ERROR);
+  BOOST_CHECK(read_log == log);
+  BOOST_CHECK(!nes_cdl_read("does_not_exist"));
+  BOOST_CHECK_THROW(nes_cdl_read("nestest.nes"), NESError);
+  BOOST_CHECK(cpu_decode_warmup() > 0);
+}
+
+/* golden files in tests/golden, see golden.hpp */
+static const char *golden_names[] = {"nestest"};
+
+BOOST_AUTO_TEST_CASE(golden_test) {
+  const char *update_dir = std::getenv("NES_GOLDEN_UPDATE");
+  const char *frames_dir = std::getenv("NES_GOLDEN_FRAMES");
+  for (const std::string name : golden_names) {
+    golden_run run = golden_read("golden/" + name + ".golden");
+    golden_result result = golden_check(run, update_dir != nullptr);
+
+    if (update_dir != nullptr) {
+      run.hashes = result.hashes;
+      std::string prefix = std::string(update_dir) + "/" + name;
+      golden_write(prefix + ".golden", run);
+      std::ofstream raw(prefix + ".raw", std::ios::binary);
+      raw.write(reinterpret_cast<const char *>(result.frames.data()),
+                result.frames.size());
+      BOOST_TEST_MESSAGE("wrote " << prefix << ".golden and .raw");
+      continue;
+    }
+
+    BOOST_CHECK_MESSAGE(result.first_mismatch < 0,
+                        name << ": frame " << result.first_mismatch
+                             << " doesn't match, see " << name
+                             << "_actual.ppm");
+    if (result.first_mismatch >= 0) {
+      golden_write_ppm(name + "_actual.ppm", result.frame.data());
+      std::vector<uint8_t> expected(GOLDEN_FRAME_SIZE);
+      std::ifstream raw(std::string(frames_dir ? frames_dir : "") + "/" +
+                            name + ".raw",
+                        std::ios::binary);
+      raw.seekg((std::streamoff)result.first_mismatch * GOLDEN_FRAME_SIZE);
+      if (frames_dir != nullptr &&
+          raw.read(reinterpret_cast<char *>(expected.data()),
+                   GOLDEN_FRAME_SIZE)) {
+        golden_write_ppm(name + "_expected.ppm", expected.data());
+        golden_write_diff(name + "_diff.ppm", expected.data(),
+                          result.frame.data());
+      }
+      continue;
+    }
+
+    /* skipping idle loops has to draw the same thing */
+    cpu_set_idle_skip(1);
+    BOOST_CHECK(golden_check(run).first_mismatch < 0);
+    cpu_set_idle_skip(0);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
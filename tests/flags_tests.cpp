@@ -0,0 +1,32 @@
+/* nestest against the core built with the other NES_LAZY_FLAGS setting */
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE flags_tests
+
+#include <boost/test/unit_test.hpp>
+
+#include "core/cppwrapper.hpp"
+
+#include "nestest.hpp"
+
+BOOST_AUTO_TEST_SUITE(flags_tests)
+
+BOOST_AUTO_TEST_CASE(nestest_test) {
+  BOOST_TEST(nestest_actual() == nestest_log(), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
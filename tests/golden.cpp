@@ -0,0 +1,294 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "core/cppwrapper.hpp"
+#include "golden.hpp"
+
+/* private headers, to start from a clean power on state */
+extern "C" {
+#include "controllerp.h"
+#include "memoryp.h"
+}
+
+/*======================xxHash64======================*/
+
+/* XXH64 from the xxHash spec. the four accumulators are independent, so
+ * the main loop keeps four multiplies in flight at once */
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+  uint64_t val = 0;
+  for (int i = 7; i >= 0; i--) {
+    val = (val << 8) | p[i];
+  }
+  return val;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  return rotl64(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+  acc ^= round64(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t frame_hash(const uint8_t *data, size_t len, uint64_t seed) {
+  const uint8_t *p = data;
+  const uint8_t *end = data + len;
+  uint64_t h;
+
+  if (len >= 32) {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    do {
+      v1 = round64(v1, read64(p));
+      v2 = round64(v2, read64(p + 8));
+      v3 = round64(v3, read64(p + 16));
+      v4 = round64(v4, read64(p + 24));
+      p += 32;
+    } while (p + 32 <= end);
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = merge_round(h, v1);
+    h = merge_round(h, v2);
+    h = merge_round(h, v3);
+    h = merge_round(h, v4);
+  } else {
+    h = seed + PRIME64_5;
+  }
+  h += len;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= round64(0, read64(p));
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)read32(p) * PRIME64_1;
+    h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= *p * PRIME64_5;
+    h = rotl64(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+/*======================Golden files======================*/
+
+golden_run golden_read(const std::string &filename) {
+  std::ifstream file(filename);
+  if (!file) {
+    throw std::runtime_error("Unable to open " + filename);
+  }
+  golden_run run;
+  run.n_frames = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream words(line);
+    std::string word;
+    if (!(words >> word) || word[0] == '#') {
+      continue;
+    }
+    if (word == "rom") {
+      words >> run.rom;
+    } else if (word == "frames") {
+      words >> run.n_frames;
+    } else if (word == "input") {
+      golden_input input;
+      unsigned buttons;
+      words >> input.frame >> std::hex >> buttons;
+      input.buttons = buttons;
+      run.inputs.push_back(input);
+    } else {
+      run.hashes.push_back(std::stoull(word, nullptr, 16));
+    }
+    if (words.fail()) {
+      throw std::runtime_error("Unable to parse " + filename + ": " + line);
+    }
+  }
+  if (run.rom.empty()) {
+    throw std::runtime_error("No rom given in " + filename);
+  }
+  return run;
+}
+
+void golden_write(const std::string &filename, const golden_run &run) {
+  FILE *fp = std::fopen(filename.c_str(), "w");
+  if (fp == nullptr) {
+    throw std::runtime_error("Unable to open " + filename);
+  }
+  std::fprintf(fp, "rom %s\nframes %u\n", run.rom.c_str(), run.n_frames);
+  for (const golden_input &input : run.inputs) {
+    std::fprintf(fp, "input %u %02x\n", input.frame, input.buttons);
+  }
+  for (uint64_t hash : run.hashes) {
+    std::fprintf(fp, "%016" PRIx64 "\n", hash);
+  }
+  if (std::fclose(fp) != 0) {
+    throw std::runtime_error("Unable to write " + filename);
+  }
+}
+
+/*======================Running======================*/
+
+struct golden_state {
+  const golden_run *run;
+  const ppu_s *ppu;
+  std::vector<uint8_t> frame;
+};
+
+static void error_none(const char *, ...) {}
+static void ppu_state_none(const ppu_state_s *, void *) {}
+static void cpu_state_none(const cpu_state_s *, void *) {}
+static void memory_none(uint16_t, uint8_t, void *) {}
+
+static void put_pixel(int i, int j, uint8_t palette_idx, void *data) {
+  static_cast<golden_state *>(data)->frame[256 * i + j] = palette_idx;
+}
+
+/* buttons of the last input at or before the current frame */
+static uint8_t scripted_buttons(void *data) {
+  golden_state *state = static_cast<golden_state *>(data);
+  uint32_t frame = ppu_get_frame_count(state->ppu);
+  uint8_t buttons = 0;
+  for (const golden_input &input : state->run->inputs) {
+    if (input.frame > frame) {
+      break;
+    }
+    buttons = input.buttons;
+  }
+  return buttons;
+}
+
+golden_result golden_check(const golden_run &run, bool keep_frames) {
+  golden_state state;
+  state.run = &run;
+  state.frame.assign(GOLDEN_FRAME_SIZE, 0);
+
+  ppu_register_state_callback(&ppu_state_none, NULL);
+  ppu_register_error_callback(&error_none);
+  cpu_register_state_callback(&cpu_state_none, NULL);
+  cpu_register_error_callback(&error_none);
+  memory_register_cb(&memory_none, NULL, MEMORY_CB_WRITE);
+  memory_register_cb(&memory_none, NULL, MEMORY_CB_FETCH);
+  controller_init(&scripted_buttons, &state);
+  controller_set_device(1, CTRLR_DEVICE_NONE, NULL, NULL);
+
+  ppu_s *ppu = nullptr;
+  cpu_s *cpu = nullptr;
+  nes_ppu_init(&ppu, &put_pixel, &state);
+  state.ppu = ppu;
+  nes_memory_init(run.rom, ppu);
+  uint8_t ram[MEMORY_RAM_SIZE] = {0};
+  memory_set_ram(ram);
+  controller_reset();
+  nes_cpu_init(&cpu, 0);
+
+  golden_result result;
+  result.first_mismatch = -1;
+  for (uint32_t i = 0; i < run.n_frames; i++) {
+    nes_run_frames(cpu, ppu, 1);
+    uint64_t hash = frame_hash(state.frame.data(), state.frame.size());
+    result.hashes.push_back(hash);
+    if (result.first_mismatch < 0 &&
+        (i >= run.hashes.size() || run.hashes[i] != hash)) {
+      result.first_mismatch = i;
+      result.frame = state.frame;
+    }
+    if (keep_frames) {
+      result.frames.insert(result.frames.end(), state.frame.begin(),
+                           state.frame.end());
+    }
+  }
+
+  cpu_unregister_error_callback();
+  cpu_unregister_state_callback();
+  ppu_unregister_state_callback();
+  ppu_unregister_error_callback();
+  memory_unregister_cb(MEMORY_CB_WRITE);
+  memory_unregister_cb(MEMORY_CB_FETCH);
+  ppu_destroy(ppu);
+  cpu_destroy(cpu);
+  return result;
+}
+
+/*======================Images======================*/
+
+static bool write_rgb(const std::string &filename,
+                      const std::vector<uint8_t> &rgb) {
+  FILE *fp = std::fopen(filename.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  std::fprintf(fp, "P6\n256 240\n255\n");
+  bool ok = std::fwrite(rgb.data(), 1, rgb.size(), fp) == rgb.size();
+  return (std::fclose(fp) == 0) && ok;
+}
+
+bool golden_write_ppm(const std::string &filename, const uint8_t *frame) {
+  std::vector<uint8_t> rgb(3 * GOLDEN_FRAME_SIZE);
+  for (size_t i = 0; i < GOLDEN_FRAME_SIZE; i++) {
+    std::memcpy(&rgb[3 * i], &nes_palette[3 * (frame[i] % PALETTE_SIZE)], 3);
+  }
+  return write_rgb(filename, rgb);
+}
+
+bool golden_write_diff(const std::string &filename, const uint8_t *expected,
+                       const uint8_t *actual) {
+  std::vector<uint8_t> rgb(3 * GOLDEN_FRAME_SIZE);
+  for (size_t i = 0; i < GOLDEN_FRAME_SIZE; i++) {
+    if (expected[i] != actual[i]) {
+      rgb[3 * i] = 0xFF;
+      rgb[3 * i + 1] = 0;
+      rgb[3 * i + 2] = 0;
+    } else {
+      for (int c = 0; c < 3; c++) {
+        rgb[3 * i + c] = nes_palette[3 * (expected[i] % PALETTE_SIZE) + c] / 4;
+      }
+    }
+  }
+  return write_rgb(filename, rgb);
+}
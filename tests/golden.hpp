@@ -0,0 +1,88 @@
+/* golden frame hashes, for catching changes to what the ppu draws */
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* A golden file gives a rom, the number of frames to run it for, the
+ * buttons to hold from given frames on, and the hash of every frame's
+ * palette indices from a known good build:
+ *
+ *   rom nestest.nes
+ *   frames 180
+ *   input 20 08        hold start (hex CTRLR_BUTTON_*) from frame 20 on
+ *   input 22 00
+ *   ef46db3751d8e999   hash of frame 0
+ *   ...
+ *
+ * Lines starting with # are comments. The rom is run from power on with
+ * cpu ram cleared, so the result doesn't depend on what ran before.
+ *
+ * To make or update golden files, run core_tests with NES_GOLDEN_UPDATE
+ * set to a directory. It writes NAME.golden there with the hashes from
+ * this build, and NAME.raw with every frame (256x240 bytes each, as
+ * nes-cli --raw). When a frame doesn't match, the test writes the frame
+ * it got as a ppm, and if NES_GOLDEN_FRAMES is set to a directory with
+ * NAME.raw from a good build, the expected frame and a diff too.
+ */
+
+#ifndef GOLDEN_HPP_
+#define GOLDEN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define GOLDEN_FRAME_SIZE (256 * 240)
+
+/* 64 bit xxHash of len bytes at data */
+uint64_t frame_hash(const uint8_t *data, size_t len, uint64_t seed = 0);
+
+struct golden_input {
+  uint32_t frame; /* buttons are held from this frame on */
+  uint8_t buttons;
+};
+
+struct golden_run {
+  std::string rom;
+  uint32_t n_frames;
+  std::vector<golden_input> inputs; /* in frame order */
+  std::vector<uint64_t> hashes;
+};
+
+struct golden_result {
+  std::vector<uint64_t> hashes; /* one per frame run */
+  int first_mismatch;           /* frame, or -1 if they all match */
+  std::vector<uint8_t> frame;   /* frame first_mismatch if there is one */
+  std::vector<uint8_t> frames;  /* every frame, only if keep_frames */
+};
+
+/* throws std::runtime_error if filename can't be read or parsed */
+golden_run golden_read(const std::string &filename);
+void golden_write(const std::string &filename, const golden_run &run);
+
+/* run the rom in run from power on with its input, comparing the hash of
+ * each frame to run.hashes */
+golden_result golden_check(const golden_run &run, bool keep_frames = false);
+
+/* write frame as a ppm */
+bool golden_write_ppm(const std::string &filename, const uint8_t *frame);
+
+/* write expected as a ppm with the pixels that are different in actual
+ * drawn red, and the rest darkened */
+bool golden_write_diff(const std::string &filename, const uint8_t *expected,
+                       const uint8_t *actual);
+
+#endif
@@ -0,0 +1,241 @@
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "harte_bin.hpp"
+
+#define HEADER_SIZE 16
+#define INDEX_ENTRY_SIZE 16
+#define DATA_START (HEADER_SIZE + HARTE_BIN_N_OPCODES * INDEX_ENTRY_SIZE)
+
+static inline uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static inline uint32_t get32(const uint8_t *p) {
+  return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+static inline uint64_t get64(const uint8_t *p) {
+  return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+static inline void put16(uint8_t *p, uint16_t val) {
+  p[0] = val & 0xFF;
+  p[1] = val >> 8;
+}
+
+static inline void put32(uint8_t *p, uint32_t val) {
+  put16(p, val & 0xFFFF);
+  put16(p + 2, val >> 16);
+}
+
+static inline void put64(uint8_t *p, uint64_t val) {
+  put32(p, val & 0xFFFFFFFF);
+  put32(p + 4, val >> 32);
+}
+
+/*======================Reader================================*/
+
+HarteBin::HarteBin(const std::string &filename)
+    : data(nullptr), size(0), curr(nullptr), cases_left(0) {
+  int fd;
+  if ((fd = open(filename.c_str(), O_RDONLY)) < 0) {
+    throw std::runtime_error("Unable to open " + filename);
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < DATA_START) {
+    close(fd);
+    throw std::runtime_error(filename + " is not a packed harte file");
+  }
+  size = st.st_size;
+  void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("Unable to map " + filename);
+  }
+  data = static_cast<const uint8_t *>(mapped);
+  madvise(mapped, size, MADV_SEQUENTIAL);
+
+  if (std::memcmp(data, HARTE_BIN_MAGIC, 8) != 0 ||
+      get32(data + 8) != HARTE_BIN_VERSION ||
+      get32(data + 12) != HARTE_BIN_N_OPCODES) {
+    munmap(mapped, size);
+    throw std::runtime_error(filename + " is not a packed harte file");
+  }
+}
+
+HarteBin::~HarteBin() { munmap(const_cast<uint8_t *>(data), size); }
+
+uint32_t HarteBin::n_cases(uint8_t opc) const {
+  return get32(data + HEADER_SIZE + opc * INDEX_ENTRY_SIZE + 8);
+}
+
+void HarteBin::seek_opcode(uint8_t opc) {
+  uint64_t offset = get64(data + HEADER_SIZE + opc * INDEX_ENTRY_SIZE);
+  cases_left = n_cases(opc);
+  if (cases_left > 0 && offset >= size) {
+    throw std::runtime_error("Index entry out of range");
+  }
+  curr = data + offset;
+}
+
+static const uint8_t *read_state(const uint8_t *p, harte_bin_state &state) {
+  state.pc = get16(p);
+  state.s = p[2];
+  state.a = p[3];
+  state.x = p[4];
+  state.y = p[5];
+  state.p = p[6];
+  state.n_ram = p[7];
+  p += 8;
+  for (size_t i = 0; i < state.n_ram; i++, p += 3) {
+    state.addrs[i] = get16(p);
+    state.vals[i] = p[2];
+  }
+  return p;
+}
+
+/* no bounds checking past the index, the file is trusted */
+bool HarteBin::next_case(harte_bin_case &hc) {
+  if (cases_left == 0) {
+    return false;
+  }
+  cases_left--;
+
+  const uint8_t *p = curr;
+  size_t name_len = *p++;
+  std::memcpy(hc.name, p, name_len);
+  hc.name[name_len] = '\0';
+  p += name_len;
+
+  p = read_state(p, hc.initial);
+  p = read_state(p, hc.final);
+
+  hc.n_cycles = *p++;
+  for (size_t i = 0; i < hc.n_cycles; i++, p += 4) {
+    hc.cycles[i].addr = get16(p);
+    hc.cycles[i].val = p[2];
+    hc.cycles[i].type = p[3];
+  }
+  curr = p;
+  return true;
+}
+
+/*======================Writer================================*/
+
+HarteBinWriter::HarteBinWriter(const std::string &filename)
+    : offsets(), counts(), curr_opc(-1), pos(0) {
+  if ((fp = std::fopen(filename.c_str(), "wb")) == NULL) {
+    throw std::runtime_error("Unable to open " + filename);
+  }
+  /* index is filled in by finish() */
+  uint8_t zeros[DATA_START] = {0};
+  write_bytes(zeros, sizeof(zeros));
+}
+
+HarteBinWriter::~HarteBinWriter() {
+  if (fp != NULL) {
+    std::fclose(fp);
+  }
+}
+
+void HarteBinWriter::begin_opcode(uint8_t opc) {
+  if (opc <= curr_opc) {
+    throw std::runtime_error("Opcodes must be written in increasing order");
+  }
+  curr_opc = opc;
+  offsets[opc] = pos;
+}
+
+void HarteBinWriter::write_case(const harte_bin_case &hc) {
+  if (curr_opc < 0) {
+    throw std::runtime_error("write_case called before begin_opcode");
+  }
+  size_t name_len = std::strlen(hc.name);
+  if (name_len >= HARTE_BIN_MAX_ENTRIES ||
+      hc.n_cycles >= HARTE_BIN_MAX_ENTRIES) {
+    throw std::runtime_error(std::string("Case too large: ") + hc.name);
+  }
+  uint8_t len = name_len;
+  write_bytes(&len, 1);
+  write_bytes(hc.name, name_len);
+
+  write_state(hc.initial);
+  write_state(hc.final);
+
+  uint8_t n_cycles = hc.n_cycles;
+  write_bytes(&n_cycles, 1);
+  for (size_t i = 0; i < hc.n_cycles; i++) {
+    uint8_t buf[4];
+    put16(buf, hc.cycles[i].addr);
+    buf[2] = hc.cycles[i].val;
+    buf[3] = hc.cycles[i].type;
+    write_bytes(buf, sizeof(buf));
+  }
+  counts[curr_opc]++;
+}
+
+void HarteBinWriter::write_state(const harte_bin_state &state) {
+  if (state.n_ram >= HARTE_BIN_MAX_ENTRIES) {
+    throw std::runtime_error("Too many ram entries");
+  }
+  uint8_t buf[8];
+  put16(buf, state.pc);
+  buf[2] = state.s;
+  buf[3] = state.a;
+  buf[4] = state.x;
+  buf[5] = state.y;
+  buf[6] = state.p;
+  buf[7] = state.n_ram;
+  write_bytes(buf, sizeof(buf));
+  for (size_t i = 0; i < state.n_ram; i++) {
+    uint8_t entry[3];
+    put16(entry, state.addrs[i]);
+    entry[2] = state.vals[i];
+    write_bytes(entry, sizeof(entry));
+  }
+}
+
+void HarteBinWriter::finish(void) {
+  uint8_t header[DATA_START] = {0};
+  std::memcpy(header, HARTE_BIN_MAGIC, 8);
+  put32(header + 8, HARTE_BIN_VERSION);
+  put32(header + 12, HARTE_BIN_N_OPCODES);
+  for (int i = 0; i < HARTE_BIN_N_OPCODES; i++) {
+    put64(header + HEADER_SIZE + i * INDEX_ENTRY_SIZE, offsets[i]);
+    put32(header + HEADER_SIZE + i * INDEX_ENTRY_SIZE + 8, counts[i]);
+  }
+  if (std::fseek(fp, 0, SEEK_SET) != 0 ||
+      std::fwrite(header, 1, sizeof(header), fp) != sizeof(header) ||
+      std::fclose(fp) != 0) {
+    fp = NULL;
+    throw std::runtime_error("Error writing index");
+  }
+  fp = NULL;
+}
+
+void HarteBinWriter::write_bytes(const void *bytes, size_t n) {
+  if (std::fwrite(bytes, 1, n, fp) != n) {
+    throw std::runtime_error("Error writing to file");
+  }
+  pos += n;
+}
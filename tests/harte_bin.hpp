@@ -0,0 +1,124 @@
+/* compact binary format for the Tom Harte test vectors */
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Layout, all multi-byte values little endian:
+ *
+ * header (16 bytes):  "NESHARTE", u32 version, u32 number of opcodes (256)
+ * index (256 * 16):   u64 offset of first case, u32 number of cases, u32 0
+ * cases, back to back, for each opcode:
+ *   u8 name length, name
+ *   initial state:    u16 pc, u8 s, a, x, y, p, u8 n_ram, n_ram * (u16, u8)
+ *   final state:      as initial state
+ *   u8 n_cycles, n_cycles * (u16 addr, u8 val, u8 'r' or 'w')
+ *
+ * Cases are variable length so they are read in order with next_case().
+ * The file is mmapped, so nothing is parsed up front.
+ */
+
+#ifndef HARTE_BIN_HPP_
+#define HARTE_BIN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#define HARTE_BIN_MAGIC "NESHARTE"
+#define HARTE_BIN_VERSION 1
+#define HARTE_BIN_N_OPCODES 0x100
+#define HARTE_BIN_MAX_ENTRIES 0x100 /* counts are stored as u8 */
+
+struct harte_bin_state {
+  uint16_t pc;
+  uint8_t s;
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t p;
+  size_t n_ram;
+  uint16_t addrs[HARTE_BIN_MAX_ENTRIES];
+  uint8_t vals[HARTE_BIN_MAX_ENTRIES];
+};
+
+struct harte_bin_cycle {
+  uint16_t addr;
+  uint8_t val;
+  char type; /* 'r' or 'w' */
+};
+
+struct harte_bin_case {
+  char name[HARTE_BIN_MAX_ENTRIES];
+  harte_bin_state initial;
+  harte_bin_state final;
+  size_t n_cycles;
+  harte_bin_cycle cycles[HARTE_BIN_MAX_ENTRIES];
+};
+
+/* read only view of a packed file. throws std::runtime_error if the file
+ * can't be mapped or isn't a packed file. */
+class HarteBin {
+
+public:
+  HarteBin(const std::string &filename);
+  ~HarteBin();
+  HarteBin(const HarteBin &) = delete;
+  HarteBin &operator=(const HarteBin &) = delete;
+
+  uint32_t n_cases(uint8_t opc) const;
+
+  /* start reading cases for opc from the first one */
+  void seek_opcode(uint8_t opc);
+
+  /* decode the next case for the current opcode into hc.
+   * returns false once every case has been read. */
+  bool next_case(harte_bin_case &hc);
+
+private:
+  const uint8_t *data;
+  size_t size;
+  const uint8_t *curr;
+  uint32_t cases_left;
+};
+
+/* appends cases to a packed file, used by harte_pack */
+class HarteBinWriter {
+
+public:
+  HarteBinWriter(const std::string &filename);
+  ~HarteBinWriter();
+  HarteBinWriter(const HarteBinWriter &) = delete;
+  HarteBinWriter &operator=(const HarteBinWriter &) = delete;
+
+  /* cases must be written for opcodes in increasing order */
+  void begin_opcode(uint8_t opc);
+  void write_case(const harte_bin_case &hc);
+
+  /* write the index, after which nothing else can be written */
+  void finish(void);
+
+private:
+  void write_state(const harte_bin_state &state);
+  void write_bytes(const void *bytes, size_t n);
+
+  std::FILE *fp;
+  uint64_t offsets[HARTE_BIN_N_OPCODES];
+  uint32_t counts[HARTE_BIN_N_OPCODES];
+  int curr_opc;
+  uint64_t pos;
+};
+
+#endif
@@ -0,0 +1,311 @@
+/* runs the packed Tom Harte tests, one worker process per opcode */
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Usage: harte_fast [-j jobs] [-o opcode] [harte.bin]
+ *
+ * The core keeps its state in globals (memory, callbacks), so opcodes are
+ * spread over forked worker processes rather than threads. Each worker
+ * runs every case of one opcode and sends a summary back over a pipe.
+ * Exit status is nonzero if any case fails.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/cppwrapper.hpp"
+#include "harte_bin.hpp"
+
+#define LEN_FAILURE 256
+
+/* sent from worker to parent, small enough for one atomic pipe write */
+struct opcode_result {
+  uint8_t opc;
+  uint8_t implemented;
+  uint32_t n_cases;
+  uint32_t n_failed;
+  char instruction[4];
+  char first_failure[LEN_FAILURE];
+};
+
+/* what the callbacks fill in while a case runs */
+struct case_actual {
+  cpu_state_s cpu_state;
+  size_t n_cycles;
+  harte_bin_cycle cycles[HARTE_BIN_MAX_ENTRIES];
+};
+
+static void error_none(const char *, ...) {}
+
+static void record_cycle(case_actual *actual, uint16_t addr, uint8_t val,
+                         char type) {
+  if (actual->n_cycles < HARTE_BIN_MAX_ENTRIES) {
+    actual->cycles[actual->n_cycles].addr = addr;
+    actual->cycles[actual->n_cycles].val = val;
+    actual->cycles[actual->n_cycles].type = type;
+  }
+  actual->n_cycles++;
+}
+
+static void fetch_cycle(uint16_t addr, uint8_t val, void *data) {
+  record_cycle(static_cast<case_actual *>(data), addr, val, 'r');
+}
+
+static void write_cycle(uint16_t addr, uint8_t val, void *data) {
+  record_cycle(static_cast<case_actual *>(data), addr, val, 'w');
+}
+
+static void update_cpu_state(const cpu_state_s *state, void *data) {
+  static_cast<case_actual *>(data)->cpu_state = *state;
+}
+
+/* returns true if actual matches hc, otherwise describes the first
+ * difference in failure */
+static bool check_case(const harte_bin_case &hc, const case_actual &actual,
+                       const uint8_t *final_vals, char *failure) {
+  const harte_bin_state &expected = hc.final;
+  const cpu_state_s &state = actual.cpu_state;
+
+#define CHECK_REGISTER(reg, exp, act)                                          \
+  if ((exp) != (act)) {                                                        \
+    std::snprintf(failure, LEN_FAILURE, "%.64s: %s expected %x got %x",        \
+                  hc.name, reg, (unsigned)(exp), (unsigned)(act));             \
+    return false;                                                              \
+  }
+  CHECK_REGISTER("pc", expected.pc, state.pc);
+  CHECK_REGISTER("s", expected.s, state.sp);
+  CHECK_REGISTER("a", expected.a, state.a);
+  CHECK_REGISTER("x", expected.x, state.x);
+  CHECK_REGISTER("y", expected.y, state.y);
+  CHECK_REGISTER("p", expected.p, state.p);
+#undef CHECK_REGISTER
+
+  for (size_t i = 0; i < expected.n_ram; i++) {
+    if (expected.vals[i] != final_vals[i]) {
+      std::snprintf(failure, LEN_FAILURE, "%.64s: ram[%04x] expected %x got %x",
+                    hc.name, expected.addrs[i], expected.vals[i],
+                    final_vals[i]);
+      return false;
+    }
+  }
+
+  if (hc.n_cycles != actual.n_cycles) {
+    std::snprintf(failure, LEN_FAILURE, "%.64s: expected %zu cycles got %zu",
+                  hc.name, hc.n_cycles, actual.n_cycles);
+    return false;
+  }
+  for (size_t i = 0; i < hc.n_cycles; i++) {
+    const harte_bin_cycle &exp = hc.cycles[i];
+    const harte_bin_cycle &act = actual.cycles[i];
+    if (exp.addr != act.addr || exp.val != act.val || exp.type != act.type) {
+      std::snprintf(failure, LEN_FAILURE,
+                    "%.64s: cycle %zu expected %04x %02x %c got %04x %02x %c",
+                    hc.name, i, exp.addr, exp.val, exp.type, act.addr, act.val,
+                    act.type);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* runs in the worker process */
+static opcode_result run_opcode(HarteBin &harte_bin, uint8_t opc) {
+  opcode_result result;
+  std::memset(&result, 0, sizeof(result));
+  result.opc = opc;
+  result.implemented = 1;
+
+  char e_context[LEN_E_CONTEXT];
+  static case_actual actual;
+  static harte_bin_case hc;
+  cpu_s cpu;
+
+  cpu_register_state_callback(&update_cpu_state, &actual);
+  cpu_register_error_callback(&error_none);
+  memory_register_cb(&fetch_cycle, &actual, MEMORY_CB_FETCH);
+  memory_register_cb(&write_cycle, &actual, MEMORY_CB_WRITE);
+  memory_init(NULL, NULL, e_context);
+  /* clear all of memory once, after that only undo what each case touched */
+  memory_init_harte_test_case(NULL, NULL, 0);
+
+  /* addresses the previous case set up or wrote to */
+  uint16_t touched[2 * HARTE_BIN_MAX_ENTRIES];
+  size_t n_touched = 0;
+  uint8_t zeros[2 * HARTE_BIN_MAX_ENTRIES] = {0};
+  uint8_t final_vals[HARTE_BIN_MAX_ENTRIES];
+
+  harte_bin.seek_opcode(opc);
+  while (harte_bin.next_case(hc)) {
+    memory_set_harte_test_case(touched, zeros, n_touched);
+    memory_set_harte_test_case(hc.initial.addrs, hc.initial.vals,
+                               hc.initial.n_ram);
+
+    cpu_state_s initial;
+    std::memset(&initial, 0, sizeof(initial));
+    initial.pc = hc.initial.pc;
+    initial.sp = hc.initial.s;
+    initial.a = hc.initial.a;
+    initial.x = hc.initial.x;
+    initial.y = hc.initial.y;
+    initial.p = hc.initial.p;
+    cpu_init_harte_test_case(&cpu, &initial);
+
+    actual.n_cycles = 0;
+    if (cpu_exec(&cpu) == -E_ILLEGAL_OPC) {
+      result.implemented = 0;
+      break;
+    }
+    if (result.n_cases == 0) {
+      std::strncpy(result.instruction, actual.cpu_state.curr_instruction,
+                   sizeof(result.instruction) - 1);
+    }
+    result.n_cases++;
+
+    memory_reset_harte(hc.final.addrs, final_vals, hc.final.n_ram);
+    if (!check_case(hc, actual, final_vals,
+                    (result.n_failed == 0) ? result.first_failure
+                                           : e_context)) {
+      result.n_failed++;
+    }
+
+    n_touched = hc.initial.n_ram;
+    std::memcpy(touched, hc.initial.addrs, n_touched * sizeof(uint16_t));
+    for (size_t i = 0; i < actual.n_cycles && i < HARTE_BIN_MAX_ENTRIES;
+         i++) {
+      if (actual.cycles[i].type == 'w') {
+        touched[n_touched++] = actual.cycles[i].addr;
+      }
+    }
+  }
+  return result;
+}
+
+static void usage(const char *argv0) {
+  std::cerr << "Usage: " << argv0 << " [-j jobs] [-o opcode] [harte.bin]"
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  int only_opc = -1;
+  int c;
+  while ((c = getopt(argc, argv, "j:o:h")) != -1) {
+    switch (c) {
+    case 'j':
+      jobs = std::max(1, std::atoi(optarg));
+      break;
+    case 'o':
+      only_opc = std::strtol(optarg, NULL, 16) & 0xFF;
+      break;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  const char *filename = (optind < argc) ? argv[optind] : "harte.bin";
+
+  try {
+    HarteBin harte_bin(filename);
+    auto start = std::chrono::steady_clock::now();
+
+    std::map<pid_t, int> running; /* worker pid to read end of its pipe */
+    std::map<int, opcode_result> results;
+    int next_opc = (only_opc >= 0) ? only_opc : 0;
+    int last_opc = (only_opc >= 0) ? only_opc : HARTE_BIN_N_OPCODES - 1;
+    bool worker_error = false;
+
+    while (next_opc <= last_opc || !running.empty()) {
+      /* start workers until all jobs are in use */
+      while (next_opc <= last_opc && running.size() < jobs) {
+        int opc = next_opc++;
+        if (harte_bin.n_cases(opc) == 0) {
+          continue;
+        }
+        int fds[2];
+        if (pipe(fds) < 0) {
+          throw std::runtime_error("Unable to create pipe");
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+          throw std::runtime_error("Unable to fork");
+        } else if (pid == 0) {
+          close(fds[0]);
+          opcode_result result = run_opcode(harte_bin, opc);
+          ssize_t n = write(fds[1], &result, sizeof(result));
+          _exit((n == sizeof(result)) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        close(fds[1]);
+        running[pid] = fds[0];
+      }
+
+      /* collect a finished worker */
+      int status;
+      pid_t pid = wait(&status);
+      if (pid < 0 || running.count(pid) == 0) {
+        continue;
+      }
+      opcode_result result;
+      ssize_t n = read(running[pid], &result, sizeof(result));
+      close(running[pid]);
+      running.erase(pid);
+      if (n != sizeof(result) || !WIFEXITED(status) ||
+          WEXITSTATUS(status) != EXIT_SUCCESS) {
+        std::cerr << "Worker " << pid << " failed" << std::endl;
+        worker_error = true;
+        continue;
+      }
+      results[result.opc] = result;
+    }
+
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    uint64_t total_cases = 0, total_failed = 0;
+    int n_skipped = 0;
+    for (const auto &r : results) {
+      const opcode_result &result = r.second;
+      if (!result.implemented) {
+        n_skipped++;
+        continue;
+      }
+      std::printf("%02x %-3s %8u cases %8u failed%s%s\n", result.opc,
+                  result.instruction, result.n_cases, result.n_failed,
+                  result.n_failed ? "  first: " : "", result.first_failure);
+      total_cases += result.n_cases;
+      total_failed += result.n_failed;
+    }
+    std::printf("%llu cases, %llu failed, %d opcodes not implemented, "
+                "%.2fs with %u jobs\n",
+                (unsigned long long)total_cases,
+                (unsigned long long)total_failed, n_skipped, seconds, jobs);
+    return (total_failed || worker_error) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+  } catch (std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
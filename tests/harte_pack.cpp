@@ -0,0 +1,127 @@
+/* packs the Tom Harte json test files into one binary file for harte_fast */
+/* Copyright (C) 2024, 2025  Angus McLean
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Usage: harte_pack harte_tests_dir harte.bin */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <rapidjson/document.h>
+#include <rapidjson/filereadstream.h>
+
+#include "harte_bin.hpp"
+
+static void parse_state(const rapidjson::Value &object,
+                        harte_bin_state &state) {
+  state.pc = object["pc"].GetUint();
+  state.s = object["s"].GetUint();
+  state.a = object["a"].GetUint();
+  state.x = object["x"].GetUint();
+  state.y = object["y"].GetUint();
+  state.p = object["p"].GetUint();
+
+  const auto &ram = object["ram"];
+  if (ram.Size() >= HARTE_BIN_MAX_ENTRIES) {
+    throw std::runtime_error("Too many ram entries");
+  }
+  state.n_ram = ram.Size();
+  for (rapidjson::SizeType i = 0; i < ram.Size(); i++) {
+    state.addrs[i] = ram[i][0].GetUint();
+    state.vals[i] = ram[i][1].GetUint();
+  }
+}
+
+static void parse_case(const rapidjson::Value &curr_case, harte_bin_case &hc) {
+  std::strncpy(hc.name, curr_case["name"].GetString(),
+               HARTE_BIN_MAX_ENTRIES - 1);
+  hc.name[HARTE_BIN_MAX_ENTRIES - 1] = '\0';
+
+  parse_state(curr_case["initial"], hc.initial);
+  parse_state(curr_case["final"], hc.final);
+
+  const auto &cycles = curr_case["cycles"];
+  if (cycles.Size() >= HARTE_BIN_MAX_ENTRIES) {
+    throw std::runtime_error("Too many cycles");
+  }
+  hc.n_cycles = cycles.Size();
+  for (rapidjson::SizeType i = 0; i < cycles.Size(); i++) {
+    hc.cycles[i].addr = cycles[i][0].GetUint();
+    hc.cycles[i].val = cycles[i][1].GetUint();
+    hc.cycles[i].type =
+        std::strcmp(cycles[i][2].GetString(), "read") ? 'w' : 'r';
+  }
+}
+
+/* returns number of cases packed, or -1 if there is no file for opc */
+static long pack_opcode(const std::string &dir, uint8_t opc,
+                        HarteBinWriter &writer) {
+  char test_filename[16];
+  std::snprintf(test_filename, sizeof(test_filename), "/%02x.json", opc);
+  FILE *fp;
+  if ((fp = std::fopen((dir + test_filename).c_str(), "r")) == NULL) {
+    return -1;
+  }
+
+  static char buf[65536];
+  rapidjson::Document document;
+  rapidjson::FileReadStream harte_stream(fp, buf, sizeof(buf));
+  document.ParseStream(harte_stream);
+  std::fclose(fp);
+  if (document.HasParseError() || !document.IsArray()) {
+    throw std::runtime_error(dir + test_filename + " is not a harte test file");
+  }
+
+  /* harte_bin_case is large so don't put it on the stack */
+  static harte_bin_case hc;
+  writer.begin_opcode(opc);
+  for (rapidjson::SizeType i = 0; i < document.Size(); i++) {
+    parse_case(document[i], hc);
+    writer.write_case(hc);
+  }
+  return document.Size();
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " harte_tests_dir output_file"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    HarteBinWriter writer(argv[2]);
+    long total = 0;
+    int n_files = 0;
+    for (int opc = 0; opc < HARTE_BIN_N_OPCODES; opc++) {
+      long n = pack_opcode(argv[1], opc, writer);
+      if (n >= 0) {
+        total += n;
+        n_files++;
+      }
+    }
+    writer.finish();
+    std::cout << "Packed " << total << " cases from " << n_files
+              << " files into " << argv[2] << std::endl;
+  } catch (std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -86,9 +86,9 @@ std::vector<std::string> nestest_log(void) {
 
 static void log_cpu_nestest(const cpu_state_s *cpu_state, void *data) {
   static char buf[256];
-  static int line_num = 1;
   std::vector<std::string> *output_lines = static_cast<std::vector<std::string> *>(data);
-  std::snprintf(buf, 256, "%d %04x %02x %s %02x %02x %02x %02x %02x %d", line_num++,
+  int line_num = output_lines->size() + 1;
+  std::snprintf(buf, 256, "%d %04x %02x %s %02x %02x %02x %02x %02x %d", line_num,
               cpu_state->pc, cpu_state->opc, cpu_state->curr_instruction,
               cpu_state->a, cpu_state->x, cpu_state->y, cpu_state->p,
               cpu_state->sp, cpu_state->cycles);
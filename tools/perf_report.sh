@@ -0,0 +1,160 @@
+#!/usr/bin/env bash
+# Copyright (C) 2024, 2025  Angus McLean
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Builds nes-cli in each configuration (debug, release, release-native,
+# release-lto, and pgo: instrument, train, rebuild), checks they all draw
+# the same frames, then benchmarks them with nes-cli --bench and writes a
+# comparison to OUT/report.md.
+#
+# Every build goes in its own folder under OUT from a clean configure, so
+# running it again on the same commit and machine gives the same binaries.
+
+set -euo pipefail
+
+usage() {
+    cat <<USAGE >&2
+Usage: $0 [options]
+  -o DIR     where builds and the report go (default build/perf)
+  -r ROM     rom to train and benchmark on, can be given more than once
+             (default tests/nestest.nes)
+  -f N       frames per run (default 600)
+  -n N       benchmark runs per configuration (default 10)
+  -c LIST    configurations to build, space separated
+             (default "debug release release-native release-lto pgo")
+  -j N       build jobs (default number of cpus)
+USAGE
+    exit 1
+}
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+out=$src/build/perf
+roms=()
+frames=600
+runs=10
+configs="debug release release-native release-lto pgo"
+jobs=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+
+while getopts "o:r:f:n:c:j:h" opt; do
+    case $opt in
+    o) out=$OPTARG ;;
+    r) roms+=("$(realpath "$OPTARG")") ;;
+    f) frames=$OPTARG ;;
+    n) runs=$OPTARG ;;
+    c) configs=$OPTARG ;;
+    j) jobs=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+[ $OPTIND -gt $# ] || usage
+[ ${#roms[@]} -gt 0 ] || roms=("$src/tests/nestest.nes")
+
+mkdir -p "$out/bin"
+out=$(realpath "$out")
+log=$out/build.log
+: > "$log"
+
+# configure from scratch in $out/$1 with the rest of the args, build target
+configure_build() {
+    local dir=$out/$1 target=$2
+    shift 2
+    echo "building $(basename "$dir") ($target)" >&2
+    rm -rf "$dir"
+    cmake -S "$src" -B "$dir" -DNES_BUILD_APP=OFF "$@" >> "$log" 2>&1 &&
+        cmake --build "$dir" -j "$jobs" --target "$target" >> "$log" 2>&1 ||
+        { echo "build failed, see $log" >&2; exit 1; }
+}
+
+pgo_roms=$(IFS=';'; echo "${roms[*]}")
+
+for config in $configs; do
+    case $config in
+    debug)          configure_build $config nes-cli -DCMAKE_BUILD_TYPE=Debug ;;
+    release)        configure_build $config nes-cli -DCMAKE_BUILD_TYPE=Release ;;
+    release-native) configure_build $config nes-cli -DCMAKE_BUILD_TYPE=Release \
+                        -DNES_NATIVE=ON ;;
+    release-lto)    configure_build $config nes-cli -DCMAKE_BUILD_TYPE=Release \
+                        -DNES_LTO=ON ;;
+    pgo)
+        # both stages in one folder, the profile data is keyed on object paths
+        configure_build $config pgo_train -DCMAKE_BUILD_TYPE=Release \
+            -DNES_LTO=ON -DNES_PGO=GENERATE -DNES_PGO_FRAMES="$frames" \
+            "-DNES_PGO_ROMS=$pgo_roms"
+        echo "rebuilding pgo with profile" >&2
+        { cmake "$out/$config" -DNES_PGO=USE &&
+              cmake --build "$out/$config" -j "$jobs" --target nes-cli; } \
+            >> "$log" 2>&1 || { echo "build failed, see $log" >&2; exit 1; }
+        ;;
+    *) echo "unknown configuration $config" >&2; usage ;;
+    esac
+    cp "$out/$config/nes-cli" "$out/bin/nes-cli-$config"
+done
+
+# the options mustn't change what gets drawn
+first=
+for config in $configs; do
+    for i in "${!roms[@]}"; do
+        "$out/bin/nes-cli-$config" --frames "$frames" \
+            --raw "$out/frames-$config-$i.raw" "${roms[$i]}" > /dev/null
+        if [ -n "$first" ] &&
+               ! cmp -s "$out/frames-$first-$i.raw" "$out/frames-$config-$i.raw"; then
+            echo "$config draws different frames to $first for ${roms[$i]}" >&2
+            exit 1
+        fi
+    done
+    first=${first:-$config}
+done
+rm -f "$out"/frames-*.raw
+
+# median frames/s and instructions/s from the p50 column of --bench
+p50() {
+    awk -v name="$1" '$1 == name { print $3 }'
+}
+
+report=$out/report.md
+cc=$(sed -n 's/^CMAKE_C_COMPILER:[A-Z]*=//p' "$out/$first/CMakeCache.txt")
+{
+    echo "# nes-cli build comparison"
+    echo
+    echo "- commit: $(git -C "$src" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+    echo "- compiler: $cc $("$cc" -dumpversion)"
+    echo "- cpu: $(sed -n 's/^model name[[:space:]]*: //p' /proc/cpuinfo 2>/dev/null | head -1)"
+    echo "- $runs runs of $frames frames each, median of the runs"
+    for i in "${!roms[@]}"; do
+        rom=${roms[$i]}
+        for mode in "" "--idle-skip"; do
+            echo
+            echo "## $(basename "$rom") ${mode:-(interpreter)}"
+            echo
+            echo "| build | frames/s | instr/s | vs $first |"
+            echo "|---|---:|---:|---:|"
+            base=
+            for config in $configs; do
+                # shellcheck disable=SC2086
+                bench=$("$out/bin/nes-cli-$config" $mode --bench --runs "$runs" \
+                            --frames "$frames" "$rom")
+                fps=$(p50 frames/s <<< "$bench")
+                ips=$(p50 instr/s <<< "$bench")
+                base=${base:-$fps}
+                printf '| %s | %.1f | %.0f | %.2fx |\n' "$config" "$fps" "$ips" \
+                       "$(awk -v a="$fps" -v b="$base" 'BEGIN { print a / b }')"
+            done
+        done
+    done
+} > "$report"
+
+cat "$report"
+echo
+echo "written to $report"